@@ -0,0 +1,348 @@
+/*
+ * RFB (VNC) server bandwidth and latency meter
+ *
+ * Connects to the SCREEN=RFB server like a VNC viewer, times a full
+ * screen update, then keeps incremental updates requested for the
+ * run time and reports the bytes received, update rate and how well
+ * the encoding compressed. With -m the pointer is moved after each
+ * update and the time until the resulting cursor update arrives is
+ * reported as input to display latency.
+ *
+ * Usage: rfbstat [-r] [-m] [-t seconds] [host[:port]]
+ *	-r   request Raw encoding only (default ZRLE, Raw)
+ *	-m   move pointer and measure pointer to update latency
+ *	-t   run time in seconds [10]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+static int fd;
+static int width, height, bytespp;
+static long bytes;			/* bytes received in updates*/
+static long rawbytes;			/* bytes as uncompressed pixels*/
+static int rects;
+
+static double
+now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void
+readn(void *buf, int n)
+{
+	unsigned char *p = buf;
+
+	while (n > 0) {
+		int ret = read(fd, p, n);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			fprintf(stderr, "rfbstat: server closed connection\n");
+			exit(1);
+		}
+		p += ret;
+		n -= ret;
+	}
+}
+
+static void
+skipn(long n)
+{
+	unsigned char buf[8192];
+
+	while (n > 0) {
+		int len = n > (long)sizeof(buf)? (int)sizeof(buf): (int)n;
+		readn(buf, len);
+		n -= len;
+	}
+}
+
+static void
+writen(const void *buf, int n)
+{
+	if (write(fd, buf, n) != n) {
+		fprintf(stderr, "rfbstat: write failed\n");
+		exit(1);
+	}
+}
+
+static unsigned int
+get16(const unsigned char *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static unsigned long
+get32(const unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void
+request_update(int incremental)
+{
+	unsigned char buf[10];
+
+	buf[0] = 3;
+	buf[1] = incremental;
+	buf[2] = buf[3] = buf[4] = buf[5] = 0;
+	buf[6] = width >> 8;
+	buf[7] = width;
+	buf[8] = height >> 8;
+	buf[9] = height;
+	writen(buf, 10);
+}
+
+static void
+move_pointer(int x, int y)
+{
+	unsigned char buf[6];
+
+	buf[0] = 5;
+	buf[1] = 0;
+	buf[2] = x >> 8;
+	buf[3] = x;
+	buf[4] = y >> 8;
+	buf[5] = y;
+	writen(buf, 6);
+}
+
+/* read server message, return 1 if it was a framebuffer update*/
+static int
+read_message(void)
+{
+	unsigned char buf[16];
+	int i, n;
+
+	readn(buf, 1);
+	switch (buf[0]) {
+	case 0:				/* FramebufferUpdate*/
+		readn(buf, 3);
+		n = get16(&buf[1]);
+		bytes += 4;
+		for (i = 0; i < n; i++) {
+			long w, h, len;
+
+			readn(buf, 12);
+			bytes += 12;
+			w = get16(&buf[4]);
+			h = get16(&buf[6]);
+			rawbytes += w * h * bytespp;
+			switch ((int)get32(&buf[8])) {
+			case 0:		/* Raw*/
+				len = w * h * bytespp;
+				break;
+			case 16:	/* ZRLE*/
+				readn(buf, 4);
+				bytes += 4;
+				len = get32(buf);
+				break;
+			default:
+				fprintf(stderr, "rfbstat: unexpected encoding %ld\n", get32(&buf[8]));
+				exit(1);
+			}
+			skipn(len);
+			bytes += len;
+		}
+		rects += n;
+		return 1;
+
+	case 1:				/* SetColourMapEntries*/
+		readn(buf, 5);
+		skipn(get16(&buf[3]) * 6L);
+		break;
+
+	case 2:				/* Bell*/
+		break;
+
+	case 3:				/* ServerCutText*/
+		readn(buf, 7);
+		skipn(get32(&buf[3]));
+		break;
+
+	default:
+		fprintf(stderr, "rfbstat: unknown server message %d\n", buf[0]);
+		exit(1);
+	}
+	return 0;
+}
+
+/* connect and handshake with security type None*/
+static void
+rfb_connect(char *host, int port, int rawonly)
+{
+	struct addrinfo hints, *ai;
+	unsigned char buf[24];
+	char portstr[16];
+	int on = 1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	sprintf(portstr, "%d", port);
+	if (getaddrinfo(host, portstr, &hints, &ai) != 0) {
+		fprintf(stderr, "rfbstat: unknown host %s\n", host);
+		exit(1);
+	}
+	fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (fd < 0 || connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+		fprintf(stderr, "rfbstat: can't connect to %s:%d\n", host, port);
+		exit(1);
+	}
+	freeaddrinfo(ai);
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	readn(buf, 12);
+	writen("RFB 003.008\n", 12);
+	readn(buf, 1);			/* security types*/
+	if (buf[0] == 0) {
+		fprintf(stderr, "rfbstat: server refused connection\n");
+		exit(1);
+	}
+	skipn(buf[0]);
+	writen("\001", 1);		/* None*/
+	readn(buf, 4);
+	if (get32(buf) != 0) {
+		fprintf(stderr, "rfbstat: security handshake failed\n");
+		exit(1);
+	}
+
+	writen("\001", 1);		/* ClientInit, shared*/
+	readn(buf, 24);			/* ServerInit*/
+	width = get16(&buf[0]);
+	height = get16(&buf[2]);
+	bytespp = buf[4] / 8;
+	skipn(get32(&buf[20]));		/* desktop name*/
+
+	/* SetEncodings*/
+	buf[0] = 2;
+	buf[1] = 0;
+	buf[2] = 0;
+	if (rawonly) {
+		buf[3] = 1;
+		memset(&buf[4], 0, 4);
+		writen(buf, 8);
+	} else {
+		buf[3] = 2;
+		memset(&buf[4], 0, 8);
+		buf[7] = 16;		/* ZRLE, then Raw*/
+		writen(buf, 12);
+	}
+	printf("Connected to %s:%d, %dx%d %dbpp, %s encoding\n", host, port,
+		width, height, bytespp * 8, rawonly? "Raw": "ZRLE");
+}
+
+int
+main(int argc, char **argv)
+{
+	char *host = "127.0.0.1";
+	char *p;
+	int port = 5900;
+	int rawonly = 0, movemouse = 0, seconds = 10;
+	int updates = 0, latencies = 0, moving = 0, x = 0;
+	double start, end, t, sent = 0;
+	double minlat = 1e9, maxlat = 0, totlat = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "rmt:")) != -1) {
+		switch (c) {
+		case 'r':
+			rawonly = 1;
+			break;
+		case 'm':
+			movemouse = 1;
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: rfbstat [-r] [-m] [-t seconds] [host[:port]]\n");
+			return 1;
+		}
+	}
+	if (optind < argc) {
+		host = argv[optind];
+		if ((p = strchr(host, ':')) != NULL) {
+			*p = '\0';
+			port = atoi(p + 1);
+		}
+	}
+
+	rfb_connect(host, port, rawonly);
+
+	/* time full screen update*/
+	start = now_ms();
+	request_update(0);
+	while (!read_message())
+		continue;
+	t = now_ms() - start;
+	printf("Full update: %d rects, %ld bytes (%ld raw) in %.1f ms\n", rects, bytes, rawbytes, t);
+
+	/* incremental updates for run time*/
+	bytes = rawbytes = 0;
+	rects = 0;
+	start = now_ms();
+	end = start + seconds * 1000.0;
+	request_update(1);
+	for (;;) {
+		struct pollfd pfd;
+		int timeout;
+
+		if (movemouse && !moving) {
+			x = (x + 7) % (width / 2);
+			move_pointer(width / 4 + x, height / 2);
+			sent = now_ms();
+			moving = 1;
+		}
+
+		t = now_ms();
+		if (t >= end)
+			break;
+		timeout = (int)(end - t) + 1;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, timeout) <= 0)
+			continue;
+
+		if (read_message()) {
+			t = now_ms();
+			updates++;
+			if (moving) {
+				t -= sent;
+				if (t < minlat)
+					minlat = t;
+				if (t > maxlat)
+					maxlat = t;
+				totlat += t;
+				latencies++;
+				moving = 0;
+			}
+			request_update(1);
+		}
+	}
+	t = (now_ms() - start) / 1000.0;
+
+	printf("%d updates, %d rects, %ld bytes in %.1f s: %.1f KB/s, %.1f updates/s\n",
+		updates, rects, bytes, t, bytes / t / 1024, updates / t);
+	if (bytes)
+		printf("Compression %.1f:1 (%ld raw bytes)\n", (double)rawbytes / bytes, rawbytes);
+	if (latencies)
+		printf("Pointer to update latency: min %.2f avg %.2f max %.2f ms\n",
+			minlat, totlat / latencies, maxlat);
+	close(fd);
+	return 0;
+}
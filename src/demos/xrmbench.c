@@ -0,0 +1,235 @@
+/*
+ * Xrm app-defaults lookup microbenchmark
+ *
+ * Loads an app-defaults style resource database into the NX11 Xrm
+ * routines (nx11/Xrm.c, nx11/Quarks.c) and times XrmQGetResource the
+ * way toolkits call it at widget creation: every resource of one widget
+ * in a row, which reuses the cached search list of the widget's
+ * name/class prefix. The same lookups are then timed interleaved across
+ * widgets, which rebuilds the search list on every call, and the
+ * results of both orders are checked to be identical.
+ *
+ * Usage: xrmbench [-n loops] [app-defaults-file]
+ *	-n   lookup loops over all widgets and resources [2000]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <X11/Xlib.h>
+#include <X11/Xresource.h>
+
+#define NWIDGETS	24
+#define NRESOURCES	16
+
+/* widget name.class paths below the application, as a toolkit would query*/
+static const char *widgets[NWIDGETS][2] = {
+	{ "main.menubar", "Form.MenuBar" },
+	{ "main.menubar.file", "Form.MenuBar.MenuButton" },
+	{ "main.menubar.edit", "Form.MenuBar.MenuButton" },
+	{ "main.menubar.view", "Form.MenuBar.MenuButton" },
+	{ "main.menubar.help", "Form.MenuBar.MenuButton" },
+	{ "main.toolbar", "Form.ToolBar" },
+	{ "main.toolbar.open", "Form.ToolBar.Command" },
+	{ "main.toolbar.save", "Form.ToolBar.Command" },
+	{ "main.toolbar.print", "Form.ToolBar.Command" },
+	{ "main.toolbar.find", "Form.ToolBar.Command" },
+	{ "main.pane", "Form.Paned" },
+	{ "main.pane.list", "Form.Paned.List" },
+	{ "main.pane.text", "Form.Paned.Text" },
+	{ "main.pane.text.vscroll", "Form.Paned.Text.Scrollbar" },
+	{ "main.pane.text.hscroll", "Form.Paned.Text.Scrollbar" },
+	{ "main.status", "Form.Label" },
+	{ "main.dialog", "Form.TransientShell" },
+	{ "main.dialog.box", "Form.TransientShell.Dialog" },
+	{ "main.dialog.box.label", "Form.TransientShell.Dialog.Label" },
+	{ "main.dialog.box.value", "Form.TransientShell.Dialog.Text" },
+	{ "main.dialog.box.ok", "Form.TransientShell.Dialog.Command" },
+	{ "main.dialog.box.cancel", "Form.TransientShell.Dialog.Command" },
+	{ "main.dialog.box.help", "Form.TransientShell.Dialog.Command" },
+	{ "main.popup", "Form.SimpleMenu" },
+};
+
+static const char *resources[NRESOURCES][2] = {
+	{ "background", "Background" },
+	{ "foreground", "Foreground" },
+	{ "borderColor", "BorderColor" },
+	{ "borderWidth", "BorderWidth" },
+	{ "font", "Font" },
+	{ "label", "Label" },
+	{ "width", "Width" },
+	{ "height", "Height" },
+	{ "sensitive", "Sensitive" },
+	{ "cursor", "Cursor" },
+	{ "justify", "Justify" },
+	{ "internalWidth", "Width" },
+	{ "internalHeight", "Height" },
+	{ "translations", "Translations" },
+	{ "accelerators", "Accelerators" },
+	{ "mappedWhenManaged", "MappedWhenManaged" },
+};
+
+/* built in app-defaults, a mix of loose, class and tight bindings*/
+static const char *appdefaults =
+	"*background: grey75\n"
+	"*foreground: black\n"
+	"*borderWidth: 1\n"
+	"*font: -*-helvetica-medium-r-normal--12-*-*-*-*-*-*-*\n"
+	"*Command.background: grey85\n"
+	"*Command.cursor: hand2\n"
+	"*MenuButton.borderWidth: 0\n"
+	"*menubar.background: grey80\n"
+	"*menubar.file.label: File\n"
+	"*menubar.edit.label: Edit\n"
+	"*menubar.view.label: View\n"
+	"*menubar.help.label: Help\n"
+	"*toolbar*internalWidth: 4\n"
+	"*toolbar*internalHeight: 2\n"
+	"*toolbar.open.label: Open\n"
+	"*toolbar.save.label: Save\n"
+	"*toolbar.print.label: Print\n"
+	"*toolbar.find.label: Find\n"
+	"*Paned*Scrollbar.width: 14\n"
+	"*Paned.list.width: 160\n"
+	"*Paned.text.width: 480\n"
+	"*Paned.text.height: 360\n"
+	"*Text.translations: #override <Key>Return: newline()\n"
+	"*Label.justify: left\n"
+	"*status.borderWidth: 0\n"
+	"*dialog*Command.width: 72\n"
+	"*dialog.box.label.label: Name:\n"
+	"*dialog.box.ok.label: OK\n"
+	"*dialog.box.cancel.label: Cancel\n"
+	"*dialog.box.help.sensitive: False\n"
+	"*SimpleMenu.borderWidth: 2\n"
+	"xrmbench.geometry: 640x480\n"
+	"xrmbench*dialog.title: Xrm Benchmark\n";
+
+static XrmQuark names[NWIDGETS][NRESOURCES][16];
+static XrmQuark classes[NWIDGETS][NRESOURCES][16];
+static char *results[NWIDGETS][NRESOURCES];
+
+/* Xrm.c uses _XOpenFile from nx11/Misc.c, which needs the nano-X client*/
+int
+_XOpenFile(const char *path, int flags)
+{
+	return open(path, flags);
+}
+
+static double
+now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec / 1000000.0;
+}
+
+/* build full "xrmbench.widget.resource" quark lists*/
+static void
+makequarks(void)
+{
+	char name[256], class[256];
+	int w, r;
+
+	for (w = 0; w < NWIDGETS; w++) {
+		for (r = 0; r < NRESOURCES; r++) {
+			sprintf(name, "xrmbench.%s.%s", widgets[w][0], resources[r][0]);
+			sprintf(class, "XrmBench.%s.%s", widgets[w][1], resources[r][1]);
+			XrmStringToNameList(name, names[w][r]);
+			XrmStringToClassList(class, classes[w][r]);
+		}
+	}
+}
+
+/* look up widget's resource, check against first result*/
+static int
+lookup(XrmDatabase db, int w, int r, int check)
+{
+	XrmRepresentation type;
+	XrmValue value;
+	char *s = NULL;
+
+	if (XrmQGetResource(db, names[w][r], classes[w][r], &type, &value))
+		s = (char *)value.addr;
+	if (!check) {
+		results[w][r] = s;
+		return 0;
+	}
+	if (s != results[w][r]) {
+		fprintf(stderr, "xrmbench: %s.%s mismatch: %s != %s\n", widgets[w][0],
+			resources[r][0], s? s: "(none)", results[w][r]? results[w][r]: "(none)");
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(int ac, char **av)
+{
+	XrmDatabase db;
+	double t, widgettime, interleavetime;
+	long count;
+	int loops = 2000;
+	int i, w, r, found, errors = 0;
+
+	while (ac > 1 && av[1][0] == '-') {
+		if (av[1][1] == 'n' && ac > 2) {
+			loops = atoi(av[2]);
+			ac--, av++;
+		} else {
+			fprintf(stderr, "Usage: xrmbench [-n loops] [app-defaults-file]\n");
+			return 1;
+		}
+		ac--, av++;
+	}
+	if (loops <= 0)
+		loops = 1;
+
+	XrmInitialize();
+	if (ac > 1) {
+		if (!(db = XrmGetFileDatabase(av[1]))) {
+			fprintf(stderr, "xrmbench: can't read %s\n", av[1]);
+			return 1;
+		}
+	} else
+		db = XrmGetStringDatabase(appdefaults);
+	makequarks();
+
+	/* reference results, also warms the quark and database tables*/
+	for (found = 0, w = 0; w < NWIDGETS; w++)
+		for (r = 0; r < NRESOURCES; r++) {
+			lookup(db, w, r, 0);
+			if (results[w][r])
+				found++;
+		}
+
+	/* widget creation order: all resources of one widget in a row*/
+	t = now();
+	for (i = 0; i < loops; i++)
+		for (w = 0; w < NWIDGETS; w++)
+			for (r = 0; r < NRESOURCES; r++)
+				errors += lookup(db, w, r, 1);
+	widgettime = now() - t;
+
+	/* same lookups with the widget changing on every call*/
+	t = now();
+	for (i = 0; i < loops; i++)
+		for (r = 0; r < NRESOURCES; r++)
+			for (w = 0; w < NWIDGETS; w++)
+				errors += lookup(db, w, r, 1);
+	interleavetime = now() - t;
+
+	count = (long)loops * NWIDGETS * NRESOURCES;
+	printf("%d widgets x %d resources, %d found, %ld lookups per order\n",
+		NWIDGETS, NRESOURCES, found, count);
+	printf("by widget:   %8.1f ns/lookup\n", widgettime * 1e9 / count);
+	printf("interleaved: %8.1f ns/lookup\n", interleavetime * 1e9 / count);
+	if (errors)
+		printf("%d mismatched results\n", errors);
+
+	XrmDestroyDatabase(db);
+	return errors != 0;
+}
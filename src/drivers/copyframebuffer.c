@@ -1,103 +1,474 @@
 /*
  * Copyright (c) 2019 Greg Haerr <greg@censoft.com>
  *
- * Fast framebuffer copy routine TEMPLATE - used with scr_fbe.c when TESTDRIVER=1
+ * Fast framebuffer copy routines for screen drivers that draw into a shadow
+ * framebuffer and copy updated areas to the display: scr_fbe.c, scr_fb.c,
+ * scr_x11.c and scr_sdl2.c.
+ *
+ * Rows are copied with memcpy when source and destination formats match,
+ * otherwise converted with SSE2/SSSE3 or NEON kernels when the compiler
+ * targets them, with C loops for the remaining pixels.
  */
+#include <string.h>
 #include "device.h"
 #include "genmem.h"
 
-/* copy Microwindows framebuffer pixels to another framebuffer, same pixel format*/
-void
-copy_framebuffer(PSD psd, MWCOORD destx, MWCOORD desty, MWCOORD w, MWCOORD h,
-	unsigned char *dstpixels, unsigned int dstpitch)
+#if !MW_CPU_BIG_ENDIAN
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2	1
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define USE_SSSE3	1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON	1
+#endif
+#endif
+
+typedef void (*CONVROWFUNC)(unsigned char *dst, const unsigned char *src, int width);
+
+/* swap red and blue, BGRA8888 <-> RGBA8888*/
+static void
+convrow_swap_8888(unsigned char *dst, const unsigned char *src, int width)
 {
-	unsigned int x, y;
-	unsigned int srcpitch = psd->pitch;
+	int x = 0;
 
-//printf("copy_framebuffer %d,%d %d,%d\n", destx, desty, w, h);
+#if USE_SSE2
+	{
+	__m128i ag = _mm_set1_epi32(0xff00ff00);
+	__m128i lo = _mm_set1_epi32(0x000000ff);
 
-	/* Use optimized loops for most common framebuffer modes */
-	/* NOTE: ASSUMES DEST FRAMEBUFFER IN SAME FORMAT AS MWPIXEL_FORMAT!!!*/
-#if MWPIXEL_FORMAT == MWPF_TRUECOLOR332
+	for (; x + 4 <= width; x += 4, src += 16, dst += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		__m128i rb = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), lo),
+			_mm_slli_epi32(_mm_and_si128(v, lo), 16));
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_and_si128(v, ag), rb));
+	}
+	}
+#elif USE_NEON
+	for (; x + 16 <= width; x += 16, src += 64, dst += 64) {
+		uint8x16x4_t v = vld4q_u8(src);
+		uint8x16_t t = v.val[0];
+		v.val[0] = v.val[2];
+		v.val[2] = t;
+		vst4q_u8(dst, v);
+	}
+#endif
+	for (; x < width; x++, src += 4, dst += 4) {
+		unsigned char t = src[0];
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = t;
+		dst[3] = src[3];
+	}
+}
+
+/* RGB565 to BGRA8888 or RGBA8888, opaque alpha*/
+static inline void
+convrow_565_8888(unsigned char *dst, const unsigned char *src, int width, int rgba)
+{
+	int x = 0;
+
+#if USE_SSE2
 	{
-		unsigned char *src =  psd->addr + desty * srcpitch + destx;
-		unsigned char *dstl = dstpixels + desty * dstpitch + destx;
-		for (y = 0; y < h; y++) {
-			unsigned char *dst = dstl;
-			for (x = 0; x < w; x++) {
-				//MWPIXELVAL c = src[x];
-				//unsigned long pixel = PIXELVAL_to_pixel(c);
-				dst[x] = src[x];
+	__m128i zero = _mm_setzero_si128();
+	__m128i alpha = _mm_set1_epi32(0xff000000);
+	__m128i m_r5 = _mm_set1_epi32(0xf800), m_r3 = _mm_set1_epi32(0xe000);
+	__m128i m_g6 = _mm_set1_epi32(0x07e0), m_g2 = _mm_set1_epi32(0x0600);
+	__m128i m_b5 = _mm_set1_epi32(0x001f), m_b3 = _mm_set1_epi32(0x001c);
+
+	for (; x + 8 <= width; x += 8, src += 16, dst += 32) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		__m128i p[2];
+		int i;
+
+		p[0] = _mm_unpacklo_epi16(v, zero);
+		p[1] = _mm_unpackhi_epi16(v, zero);
+		for (i = 0; i < 2; i++) {
+			/* expand 5/6 bit components by replicating their high bits*/
+			__m128i r, g, b;
+
+			g = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p[i], m_g6), 5),
+				_mm_srli_epi32(_mm_and_si128(p[i], m_g2), 1));
+			if (rgba) {
+				r = _mm_or_si128(_mm_srli_epi32(_mm_and_si128(p[i], m_r5), 8),
+					_mm_srli_epi32(_mm_and_si128(p[i], m_r3), 13));
+				b = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p[i], m_b5), 19),
+					_mm_slli_epi32(_mm_and_si128(p[i], m_b3), 14));
+			} else {
+				r = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p[i], m_r5), 8),
+					_mm_slli_epi32(_mm_and_si128(p[i], m_r3), 3));
+				b = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p[i], m_b5), 3),
+					_mm_srli_epi32(_mm_and_si128(p[i], m_b3), 2));
 			}
-			src += srcpitch;
-			dstl += dstpitch;
+			_mm_storeu_si128((__m128i *)(dst + i * 16),
+				_mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, alpha)));
 		}
 	}
-#elif (MWPIXEL_FORMAT == MWPF_TRUECOLOR565) || (MWPIXEL_FORMAT == MWPF_TRUECOLOR555)
+	}
+#endif
+	for (; x < width; x++, src += 2, dst += 4) {
+		unsigned int p = src[0] | (src[1] << 8);
+		unsigned char r = (p >> 11) & 0x1f;
+		unsigned char g = (p >> 5) & 0x3f;
+		unsigned char b = p & 0x1f;
+
+		r = (r << 3) | (r >> 2);
+		g = (g << 2) | (g >> 4);
+		b = (b << 3) | (b >> 2);
+		dst[0] = rgba? r: b;
+		dst[1] = g;
+		dst[2] = rgba? b: r;
+		dst[3] = 0xff;
+	}
+}
+
+static void
+convrow_565_bgra(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_565_8888(dst, src, width, 0);
+}
+
+static void
+convrow_565_rgba(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_565_8888(dst, src, width, 1);
+}
+
+/* BGRA8888 or RGBA8888 to RGB565*/
+static inline void
+convrow_8888_565(unsigned char *dst, const unsigned char *src, int width, int rgba)
+{
+	int x = 0;
+
+#if USE_SSE2
 	{
-		unsigned char *src =  psd->addr + desty * srcpitch + (destx << 1);
-		unsigned char *dstl = dstpixels + desty * dstpitch + (destx << 1);
-		for (y = 0; y < h; y++) {
-			uint16_t *dst = (uint16_t *)dstl;
-			for (x = 0; x < w; x++) {
-				//MWPIXELVAL c = ((ADDR16)src)[x];
-				//unsigned long pixel = PIXELVAL_to_pixel(c);
-				dst[x] = ((uint16_t *)src)[x];
+	__m128i m_r = _mm_set1_epi32(0xf800), m_g = _mm_set1_epi32(0x07e0);
+	__m128i m_b = _mm_set1_epi32(0x001f);
+	__m128i bias32 = _mm_set1_epi32(0x8000), bias16 = _mm_set1_epi16((short)0x8000);
+
+	for (; x + 8 <= width; x += 8, src += 32, dst += 16) {
+		__m128i p[2];
+		int i;
+
+		for (i = 0; i < 2; i++) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(src + i * 16));
+			__m128i r, g, b;
+
+			g = _mm_and_si128(_mm_srli_epi32(v, 5), m_g);
+			if (rgba) {
+				r = _mm_and_si128(_mm_slli_epi32(v, 8), m_r);
+				b = _mm_and_si128(_mm_srli_epi32(v, 19), m_b);
+			} else {
+				r = _mm_and_si128(_mm_srli_epi32(v, 8), m_r);
+				b = _mm_and_si128(_mm_srli_epi32(v, 3), m_b);
 			}
-			src += srcpitch;
-			dstl += dstpitch;
+			/* bias to signed range for saturating pack*/
+			p[i] = _mm_sub_epi32(_mm_or_si128(_mm_or_si128(r, g), b), bias32);
 		}
+		_mm_storeu_si128((__m128i *)dst,
+			_mm_xor_si128(_mm_packs_epi32(p[0], p[1]), bias16));
 	}
-#elif MWPIXEL_FORMAT == MWPF_TRUECOLORRGB
+	}
+#endif
+	for (; x < width; x++, src += 4, dst += 2) {
+		unsigned char r = rgba? src[0]: src[2];
+		unsigned char b = rgba? src[2]: src[0];
+		unsigned int p = ((r & 0xf8) << 8) | ((src[1] & 0xfc) << 3) | (b >> 3);
+
+		dst[0] = (unsigned char)p;
+		dst[1] = (unsigned char)(p >> 8);
+	}
+}
+
+static void
+convrow_bgra_565(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_8888_565(dst, src, width, 0);
+}
+
+static void
+convrow_rgba_565(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_8888_565(dst, src, width, 1);
+}
+
+/* BGR888 to BGRA8888 or RGBA8888, opaque alpha*/
+static inline void
+convrow_888_8888(unsigned char *dst, const unsigned char *src, int width, int rgba)
+{
+	int x = 0;
+
+#if USE_SSSE3
 	{
-		unsigned char *src =  psd->addr + desty * srcpitch + (destx * 3);
-		unsigned char *dstl = dstpixels + desty * dstpitch + (destx * 3);
-		unsigned int srcextra = srcpitch - (w * 3);
-		for (y = 0; y < h; y++) {
-			unsigned char *dst = dstl;
-			for (x = 0; x < w; x++) {
-				MWPIXELVAL c = RGB2PIXEL888(src[2], src[1], src[0]);
-				//unsigned long pixel = PIXELVAL_to_pixel(c);
-				// FIXME little-endian only
-				*dst++ = (unsigned char)c;			// B
-				*dst++ = (unsigned char)c >> 8;		// G
-				*dst++ = (unsigned char)c >> 16;	// R
-				src += 3;
-			}
-			src += srcextra;
-			dstl += dstpitch;
-		}
+	__m128i alpha = _mm_set1_epi32(0xff000000);
+	__m128i shuf = rgba?
+		_mm_setr_epi8(2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1):
+		_mm_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1);
+
+	/* 16 byte loads use 12 bytes, stay within row*/
+	for (; x + 6 <= width; x += 4, src += 12, dst += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_shuffle_epi8(v, shuf), alpha));
+	}
 	}
-#elif (MWPIXEL_FORMAT == MWPF_TRUECOLORARGB) || (MWPIXEL_FORMAT == MWPF_TRUECOLORABGR)
+#elif USE_NEON
+	for (; x + 16 <= width; x += 16, src += 48, dst += 64) {
+		uint8x16x3_t s = vld3q_u8(src);
+		uint8x16x4_t v;
+
+		v.val[0] = rgba? s.val[2]: s.val[0];
+		v.val[1] = s.val[1];
+		v.val[2] = rgba? s.val[0]: s.val[2];
+		v.val[3] = vdupq_n_u8(0xff);
+		vst4q_u8(dst, v);
+	}
+#endif
+	for (; x < width; x++, src += 3, dst += 4) {
+		dst[0] = rgba? src[2]: src[0];
+		dst[1] = src[1];
+		dst[2] = rgba? src[0]: src[2];
+		dst[3] = 0xff;
+	}
+}
+
+static void
+convrow_bgr888_bgra(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_888_8888(dst, src, width, 0);
+}
+
+static void
+convrow_bgr888_rgba(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_888_8888(dst, src, width, 1);
+}
+
+/* BGRA8888 or RGBA8888 to BGR888*/
+static inline void
+convrow_8888_888(unsigned char *dst, const unsigned char *src, int width, int rgba)
+{
+	int x = 0;
+
+#if USE_SSSE3
 	{
-		// our framebuffer is MWPF_TRUECOLORARGB which is BGRA byte order, and so are SDL screenbits
-		unsigned char *src =  psd->addr + desty * srcpitch + (destx << 2);
-		unsigned char *dstl = dstpixels + desty * dstpitch + (destx << 2);
-		for (y = 0; y < h; y++) {
-			uint32_t *dst = (uint32_t *)dstl;
-			for (x = 0; x < w; x++) {
-				//MWPIXELVAL c = ((ADDR32)src)[x];
-				//unsigned long pixel = PIXELVAL_to_pixel(c);
-				dst[x] = ((uint32_t *)src)[x];
-			}
-			src += srcpitch;
-			dstl += dstpitch;
+	__m128i shuf = rgba?
+		_mm_setr_epi8(2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1):
+		_mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+
+	for (; x + 4 <= width; x += 4, src += 16, dst += 12) {
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), shuf);
+		int last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+
+		_mm_storel_epi64((__m128i *)dst, v);
+		memcpy(dst + 8, &last, 4);
+	}
+	}
+#elif USE_NEON
+	for (; x + 16 <= width; x += 16, src += 64, dst += 48) {
+		uint8x16x4_t s = vld4q_u8(src);
+		uint8x16x3_t v;
+
+		v.val[0] = rgba? s.val[2]: s.val[0];
+		v.val[1] = s.val[1];
+		v.val[2] = rgba? s.val[0]: s.val[2];
+		vst3q_u8(dst, v);
+	}
+#endif
+	for (; x < width; x++, src += 4, dst += 3) {
+		dst[0] = rgba? src[2]: src[0];
+		dst[1] = src[1];
+		dst[2] = rgba? src[0]: src[2];
+	}
+}
+
+static void
+convrow_bgra_bgr888(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_8888_888(dst, src, width, 0);
+}
+
+static void
+convrow_rgba_bgr888(unsigned char *dst, const unsigned char *src, int width)
+{
+	convrow_8888_888(dst, src, width, 1);
+}
+
+/* find row converter between framebuffer formats, NULL if not supported*/
+static CONVROWFUNC
+find_convrow(MWIMGDATFMT src_format, MWIMGDATFMT dst_format)
+{
+	switch (src_format) {
+	case MWIF_BGRA8888:
+		switch (dst_format) {
+		case MWIF_RGBA8888:	return convrow_swap_8888;
+		case MWIF_RGB565:	return convrow_bgra_565;
+		case MWIF_BGR888:	return convrow_bgra_bgr888;
+		}
+		break;
+	case MWIF_RGBA8888:
+		switch (dst_format) {
+		case MWIF_BGRA8888:	return convrow_swap_8888;
+		case MWIF_RGB565:	return convrow_rgba_565;
+		case MWIF_BGR888:	return convrow_rgba_bgr888;
+		}
+		break;
+	case MWIF_RGB565:
+		switch (dst_format) {
+		case MWIF_BGRA8888:	return convrow_565_bgra;
+		case MWIF_RGBA8888:	return convrow_565_rgba;
 		}
+		break;
+	case MWIF_BGR888:
+		switch (dst_format) {
+		case MWIF_BGRA8888:	return convrow_bgr888_bgra;
+		case MWIF_RGBA8888:	return convrow_bgr888_rgba;
+		}
+		break;
 	}
-#else /* MWPF_PALETTE*/
-	{
-		unsigned char *src = psd->addr + desty * srcpitch + destx;
-		unsigned char *dstl = dstpixels + desty * dstpitch + destx;
-		for (y = 0; y < h; y++) {
-			unsigned char *dst = dstl;
-			for (x = 0; x < w; x++) {
-				//MWPIXELVAL c = src[x];
-				//unsigned long pixel = PIXELVAL_to_pixel(c);
-				dst[x] = src[x];
+	return NULL;
+}
+
+/* bytes per pixel of converted formats*/
+static int
+format_bytes(MWIMGDATFMT format)
+{
+	switch (format) {
+	case MWIF_BGRA8888:
+	case MWIF_RGBA8888:
+		return 4;
+	case MWIF_BGR888:
+	case MWIF_RGB888:
+		return 3;
+	case MWIF_RGB565:
+	case MWIF_RGB555:
+		return 2;
+	}
+	return 1;
+}
+
+/*
+ * Copy rectangles of Microwindows framebuffer pixels to the same position
+ * in another framebuffer of dst_format.  Returns 0 if the conversion
+ * isn't supported, in which case nothing is copied.
+ */
+int
+copy_framebuffer_rects(PSD psd, const MWRECT *rects, int count,
+	unsigned char *dstpixels, unsigned int dstpitch, MWIMGDATFMT dst_format)
+{
+	CONVROWFUNC convrow = NULL;
+	unsigned int srcpitch = psd->pitch;
+	int srcbytes = 0, dstbytes = 0;
+	int y;
+
+	if (dst_format != psd->data_format) {
+		if ((convrow = find_convrow(psd->data_format, dst_format)) == NULL)
+			return 0;
+		srcbytes = format_bytes(psd->data_format);
+		dstbytes = format_bytes(dst_format);
+	}
+
+	for (; count > 0; --count, ++rects) {
+		unsigned char *src, *dst;
+		int w = rects->right - rects->left;
+
+		if (w <= 0 || rects->bottom <= rects->top)
+			continue;
+
+		if (!convrow) {
+			/* same format, copy whole rows, works for any bpp*/
+			unsigned int left = (rects->left * psd->bpp) >> 3;
+			unsigned int len = ((rects->right * psd->bpp + 7) >> 3) - left;
+
+			src = psd->addr + rects->top * srcpitch + left;
+			dst = dstpixels + rects->top * dstpitch + left;
+			for (y = rects->top; y < rects->bottom; y++) {
+				memcpy(dst, src, len);
+				src += srcpitch;
+				dst += dstpitch;
 			}
+			continue;
+		}
+
+		src = psd->addr + rects->top * srcpitch + rects->left * srcbytes;
+		dst = dstpixels + rects->top * dstpitch + rects->left * dstbytes;
+		for (y = rects->top; y < rects->bottom; y++) {
+			convrow(dst, src, w);
 			src += srcpitch;
-			dstl += dstpitch;
+			dst += dstpitch;
 		}
 	}
-#endif
+	return 1;
+}
+
+/* copy Microwindows framebuffer pixels to another framebuffer, same pixel format*/
+void
+copy_framebuffer(PSD psd, MWCOORD destx, MWCOORD desty, MWCOORD w, MWCOORD h,
+	unsigned char *dstpixels, unsigned int dstpitch)
+{
+	MWRECT rc;
+
+	rc.left = destx;
+	rc.top = desty;
+	rc.right = destx + w;
+	rc.bottom = desty + h;
+	copy_framebuffer_rects(psd, &rc, 1, dstpixels, dstpitch, psd->data_format);
+}
+
+/*
+ * Add an updated screen area to a list of rectangles for a later
+ * copy_framebuffer_rects, extending a rectangle it touches if possible.
+ * When the list is full all rectangles are merged into one.
+ */
+void
+add_update_rect(PSD psd, UPDATERECTS *up, MWCOORD x, MWCOORD y, MWCOORD width,
+	MWCOORD height)
+{
+	MWRECT *rp;
+	MWCOORD right = x + width;
+	MWCOORD bottom = y + height;
+	int i;
+
+	if (x < 0)
+		x = 0;
+	if (y < 0)
+		y = 0;
+	if (right > psd->xres)
+		right = psd->xres;
+	if (bottom > psd->yres)
+		bottom = psd->yres;
+	if (x >= right || y >= bottom)
+		return;
+
+	for (i = 0, rp = up->rects; i < up->count; i++, rp++)
+		if (x <= rp->right && right >= rp->left && y <= rp->bottom && bottom >= rp->top)
+			break;
+
+	if (i == up->count) {
+		if (up->count < MAX_UPDATE_RECTS) {
+			rp->left = x;
+			rp->top = y;
+			rp->right = right;
+			rp->bottom = bottom;
+			up->count++;
+			return;
+		}
+
+		/* list full, merge into one*/
+		rp = up->rects;
+		for (i = 1; i < up->count; i++) {
+			rp->left = MWMIN(rp->left, up->rects[i].left);
+			rp->top = MWMIN(rp->top, up->rects[i].top);
+			rp->right = MWMAX(rp->right, up->rects[i].right);
+			rp->bottom = MWMAX(rp->bottom, up->rects[i].bottom);
+		}
+		up->count = 1;
+	}
+	rp->left = MWMIN(rp->left, x);
+	rp->top = MWMIN(rp->top, y);
+	rp->right = MWMAX(rp->right, right);
+	rp->bottom = MWMAX(rp->bottom, bottom);
 }
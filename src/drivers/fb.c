@@ -226,7 +226,7 @@ gen_getscreeninfo(PSD psd, PMWSCREENINFO psi)
 	psi->data_format = psd->data_format;
 	psi->ncolors = psd->ncolors;
 	psi->fonts = NUMBER_FONTS;
-	psi->portrait = psd->portrait;
+	psi->portrait = GdGetPortraitMode(psd);
 	psi->size = psd->size;
 	psi->pixtype = psd->pixtype;
 
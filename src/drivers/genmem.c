@@ -13,88 +13,97 @@
 #include "fb.h"
 #include "genmem.h"
 
-/* alloc and initialize a new memory drawing surface (memgc)*/
-PSD
-GdCreatePixmap(PSD rootpsd, MWCOORD width, MWCOORD height, MWIMGDATFMT format, void *pixels, int palsize)
+/* set pixmap bpp, data format and pixtype for image format, return 0 if unsupported*/
+static int
+pixmap_format(PSD rootpsd, MWIMGDATFMT format, int *bpp, MWIMGDATFMT *data_format, int *pixtype)
 {
-	PSD		pmd;
-	int 	bpp, planes, pixtype;
-    MWIMGDATFMT data_format;
-	unsigned int size, pitch;
-   
-	if (width <= 0 || height <= 0)
-		return NULL;
-
-	bpp = rootpsd->bpp;
-	data_format = rootpsd->data_format;
-	pixtype = rootpsd->pixtype;
-	planes = rootpsd->planes;
+	*bpp = rootpsd->bpp;
+	*data_format = rootpsd->data_format;
+	*pixtype = rootpsd->pixtype;
 
 	/* check if format supported*/
 	switch (format) {
 	case 0:			/* default, return framebuffer compatible pixmap*/
 		break;
 	case 32:		/* match framebuffer format if running 32bpp, else RGBA*/
-		if (bpp == 32)
+		if (*bpp == 32)
 			break;
 		/* else fall through - create RGBA8888 pixmap*/
 	case MWIF_RGBA8888:
-		bpp = 32;
-		data_format = format;
-		pixtype = MWPF_TRUECOLORABGR;
+		*bpp = 32;
+		*data_format = format;
+		*pixtype = MWPF_TRUECOLORABGR;
 		break;
 	case MWIF_BGRA8888:
-		bpp = 32;
-		data_format = format;
-		pixtype = MWPF_TRUECOLOR8888;
+		*bpp = 32;
+		*data_format = format;
+		*pixtype = MWPF_TRUECOLOR8888;
 		break;
 	/*case MWIF_PAL1:*/				/* MWIF_PAL1 is MWIF_MONOBYTEMSB*/
 	case MWIF_MONOBYTEMSB:			/* ft2 non-alias*/
 	case MWIF_MONOBYTELSB:			/* t1lib non-alias*/
 	case MWIF_MONOWORDMSB:			/* core mwcfont, pcf*/
-		bpp = 1;
-		data_format = format;
-		pixtype = MWPF_PALETTE;
+		*bpp = 1;
+		*data_format = format;
+		*pixtype = MWPF_PALETTE;
 		break;
 	case MWIF_PAL2:
-		bpp = 2;
-		data_format = format;
-		pixtype = MWPF_PALETTE;
+		*bpp = 2;
+		*data_format = format;
+		*pixtype = MWPF_PALETTE;
 		break;
 	case MWIF_PAL4:
-		bpp = 4;
-		data_format = format;
-		pixtype = MWPF_PALETTE;
+		*bpp = 4;
+		*data_format = format;
+		*pixtype = MWPF_PALETTE;
 		break;
 	case MWIF_PAL8:
-		bpp = 8;
-		data_format = format;
-		pixtype = MWPF_PALETTE;
+		*bpp = 8;
+		*data_format = format;
+		*pixtype = MWPF_PALETTE;
 		break;
         case MWIF_RGB1555:
- 	        bpp = 16;
-		data_format = format;
-		pixtype = MWPF_TRUECOLOR1555;
+ 	        *bpp = 16;
+		*data_format = format;
+		*pixtype = MWPF_TRUECOLOR1555;
 		break;
 	case MWIF_RGB555:
-		bpp = 16;
-		data_format = format;
-		pixtype = MWPF_TRUECOLOR555;
+		*bpp = 16;
+		*data_format = format;
+		*pixtype = MWPF_TRUECOLOR555;
 		break;
 	case MWIF_RGB565:
-		bpp = 16;
-		data_format = format;
-		pixtype = MWPF_TRUECOLOR565;
+		*bpp = 16;
+		*data_format = format;
+		*pixtype = MWPF_TRUECOLOR565;
 		break;
 	case MWIF_RGB888:
-		bpp = 24;
-		data_format = format;
-		pixtype = MWPF_TRUECOLOR888;
+		*bpp = 24;
+		*data_format = format;
+		*pixtype = MWPF_TRUECOLOR888;
 		break;
 	default:
 		DPRINTF("GdCreatePixmap: unsupported format %08x\n", format);
-		return NULL;	/* fail*/
+		return 0;	/* fail*/
 	}
+	return 1;
+}
+
+/* alloc and initialize a new memory drawing surface (memgc)*/
+PSD
+GdCreatePixmap(PSD rootpsd, MWCOORD width, MWCOORD height, MWIMGDATFMT format, void *pixels, int palsize)
+{
+	PSD		pmd;
+	int 	bpp, planes, pixtype;
+    MWIMGDATFMT data_format;
+	unsigned int size, pitch;
+   
+	if (width <= 0 || height <= 0)
+		return NULL;
+
+	planes = rootpsd->planes;
+	if (!pixmap_format(rootpsd, format, &bpp, &data_format, &pixtype))
+		return NULL;
 
 	/*
 	 * Allocate offscreen drawing surface.  If screen driver doesn't
@@ -130,6 +139,29 @@ err:
 	return pmd;
 }
 
+/* return bytes of pixel memory GdCreatePixmap needs, 0 if it would fail*/
+unsigned int
+GdPixmapSize(PSD rootpsd, MWCOORD width, MWCOORD height, MWIMGDATFMT format)
+{
+	PSD		pmd;
+	int 	bpp, pixtype;
+    MWIMGDATFMT data_format;
+	unsigned int size, pitch;
+
+	if (width <= 0 || height <= 0)
+		return 0;
+	if (!pixmap_format(rootpsd, format, &bpp, &data_format, &pixtype))
+		return 0;
+
+	/* size depends on pixmap device, not root device, layout*/
+	pmd = rootpsd->AllocateMemGC(rootpsd);
+	if (!pmd)
+		return 0;
+	GdCalcMemGCAlloc(pmd, width, height, rootpsd->planes, bpp, &size, &pitch);
+	pmd->FreeMemGC(pmd);
+	return size;
+}
+
 void
 GdFreePixmap(PSD pmd)
 {
@@ -154,6 +186,7 @@ gen_allocatememgc(PSD psd)
 	/* initialize*/
 	mempsd->flags = PSF_MEMORY;			/* reset PSF_SCREEN or PSF_ADDRMALLOC flags*/
 	mempsd->portrait = MWPORTRAIT_NONE; /* don't rotate offscreen pixmaps*/
+	mempsd->shadowportrait = MWPORTRAIT_NONE;
 	mempsd->addr = NULL;
 	mempsd->Update = NULL;				/* no external updates required for mem device*/
 	mempsd->palette = NULL;				/* don't copy any palette*/
@@ -290,6 +323,10 @@ GdCalcMemGCAlloc(PSD psd, int width, int height, int planes, int bpp,
 void
 gen_setportrait(PSD psd, int portraitmode)
 {
+#if MW_FEATURE_PORTRAIT && MW_FEATURE_PORTRAIT_SHADOW
+	/* draw directly into driver framebuffer again*/
+	portrait_shadow_close(psd);
+#endif
 	psd->portrait = portraitmode;
 
 	/* swap x and y in left or right portrait modes*/
@@ -306,6 +343,12 @@ gen_setportrait(PSD psd, int portraitmode)
 		psd->yvirtres = psd->yres;
 	}
 
+#if MW_FEATURE_PORTRAIT && MW_FEATURE_PORTRAIT_SHADOW
+	/* draw upright into shadow framebuffer and rotate updates if possible*/
+	if (portraitmode != MWPORTRAIT_NONE && portrait_shadow_open(psd, portraitmode))
+		psd->portrait = MWPORTRAIT_NONE;
+#endif
+
 	/* assign portrait subdriver or original driver*/
 	set_portrait_subdriver(psd);
 }
@@ -11,6 +11,7 @@
 /* genmem.c*/
 PSD     GdCreatePixmap(PSD rootpsd, MWCOORD width, MWCOORD height, MWIMGDATFMT format,
             void *pixels, int palsize);
+unsigned int GdPixmapSize(PSD rootpsd, MWCOORD width, MWCOORD height, MWIMGDATFMT format);
 void	GdFreePixmap(PSD pmd);
 
 PSD 	gen_allocatememgc(PSD psd);
@@ -30,5 +31,22 @@ void	set_subdriver(PSD psd, PSUBDRIVER subdriver);
 void	get_subdriver(PSD psd, PSUBDRIVER subdriver);
 
 /* copyframebuffer.c*/
+#define MAX_UPDATE_RECTS	16	/* updated rectangles kept before merging*/
+
+typedef struct {
+	int	count;
+	MWRECT	rects[MAX_UPDATE_RECTS];
+} UPDATERECTS;
+
 void	copy_framebuffer(PSD psd, MWCOORD destx, MWCOORD desty, MWCOORD w, MWCOORD h,
 	unsigned char *dstpixels, unsigned int dstpitch);
+int	copy_framebuffer_rects(PSD psd, const MWRECT *rects, int count,
+	unsigned char *dstpixels, unsigned int dstpitch, MWIMGDATFMT dst_format);
+void	add_update_rect(PSD psd, UPDATERECTS *up, MWCOORD x, MWCOORD y, MWCOORD width,
+	MWCOORD height);
+
+/* rotateframebuffer.c*/
+void	rotate_framebuffer_rect(int portrait, int bytespp, const unsigned char *src,
+	int srcpitch, unsigned char *dst, int dstpitch, MWCOORD w, MWCOORD h);
+int	portrait_shadow_open(PSD psd, int portraitmode);
+void	portrait_shadow_close(PSD psd);
@@ -0,0 +1,233 @@
+/*
+ * RFB (VNC) remote framebuffer server keyboard driver
+ * Reads key events passed on by the RFB screen driver and
+ * translates X11 keysyms sent by the viewer to MWKEY values.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include "device.h"
+
+static int  RFB_Open(KBDDEVICE *pkd);
+static void RFB_Close(void);
+static void RFB_GetModifierInfo(MWKEYMOD *modifiers, MWKEYMOD *curmodifiers);
+static int  RFB_Read(MWKEY *kbuf, MWKEYMOD *modifiers, MWSCANCODE *scancode);
+
+int rfb_eventfd(int keyboard);
+
+KBDDEVICE kbddev = {
+	RFB_Open,
+	RFB_Close,
+	RFB_GetModifierInfo,
+	RFB_Read,
+	NULL
+};
+
+static int keyboard_fd = -1;
+static MWKEYMOD key_modstate;
+
+/* X11 keysyms for non-ASCII keys*/
+static const struct {
+	unsigned short	keysym;
+	MWKEY		mwkey;
+	MWKEYMOD	modifier;	/* modifier state while held*/
+} keymap[] = {
+	{ 0xff08, MWKEY_BACKSPACE,	0 },
+	{ 0xff09, MWKEY_TAB,		0 },
+	{ 0xff0d, MWKEY_ENTER,		0 },
+	{ 0xff1b, MWKEY_ESCAPE,		0 },
+	{ 0xffff, MWKEY_DELETE,		0 },
+	{ 0xff13, MWKEY_PAUSE,		0 },
+	{ 0xff15, MWKEY_SYSREQ,		0 },
+	{ 0xff50, MWKEY_HOME,		0 },
+	{ 0xff51, MWKEY_LEFT,		0 },
+	{ 0xff52, MWKEY_UP,		0 },
+	{ 0xff53, MWKEY_RIGHT,		0 },
+	{ 0xff54, MWKEY_DOWN,		0 },
+	{ 0xff55, MWKEY_PAGEUP,		0 },
+	{ 0xff56, MWKEY_PAGEDOWN,	0 },
+	{ 0xff57, MWKEY_END,		0 },
+	{ 0xff61, MWKEY_PRINT,		0 },
+	{ 0xff63, MWKEY_INSERT,		0 },
+	{ 0xff67, MWKEY_MENU,		0 },
+	{ 0xff6b, MWKEY_BREAK,		0 },
+	{ 0xff8d, MWKEY_KP_ENTER,	0 },
+	{ 0xff95, MWKEY_HOME,		0 },
+	{ 0xff96, MWKEY_LEFT,		0 },
+	{ 0xff97, MWKEY_UP,		0 },
+	{ 0xff98, MWKEY_RIGHT,		0 },
+	{ 0xff99, MWKEY_DOWN,		0 },
+	{ 0xff9a, MWKEY_PAGEUP,		0 },
+	{ 0xff9b, MWKEY_PAGEDOWN,	0 },
+	{ 0xff9c, MWKEY_END,		0 },
+	{ 0xff9d, MWKEY_KP5,		0 },
+	{ 0xff9e, MWKEY_INSERT,		0 },
+	{ 0xff9f, MWKEY_DELETE,		0 },
+	{ 0xffaa, MWKEY_KP_MULTIPLY,	0 },
+	{ 0xffab, MWKEY_KP_PLUS,	0 },
+	{ 0xffad, MWKEY_KP_MINUS,	0 },
+	{ 0xffae, MWKEY_KP_PERIOD,	0 },
+	{ 0xffaf, MWKEY_KP_DIVIDE,	0 },
+	{ 0xffb0, MWKEY_KP0,		0 },
+	{ 0xffb1, MWKEY_KP1,		0 },
+	{ 0xffb2, MWKEY_KP2,		0 },
+	{ 0xffb3, MWKEY_KP3,		0 },
+	{ 0xffb4, MWKEY_KP4,		0 },
+	{ 0xffb5, MWKEY_KP5,		0 },
+	{ 0xffb6, MWKEY_KP6,		0 },
+	{ 0xffb7, MWKEY_KP7,		0 },
+	{ 0xffb8, MWKEY_KP8,		0 },
+	{ 0xffb9, MWKEY_KP9,		0 },
+	{ 0xffbd, MWKEY_KP_EQUALS,	0 },
+	{ 0xffbe, MWKEY_F1,		0 },
+	{ 0xffbf, MWKEY_F2,		0 },
+	{ 0xffc0, MWKEY_F3,		0 },
+	{ 0xffc1, MWKEY_F4,		0 },
+	{ 0xffc2, MWKEY_F5,		0 },
+	{ 0xffc3, MWKEY_F6,		0 },
+	{ 0xffc4, MWKEY_F7,		0 },
+	{ 0xffc5, MWKEY_F8,		0 },
+	{ 0xffc6, MWKEY_F9,		0 },
+	{ 0xffc7, MWKEY_F10,		0 },
+	{ 0xffc8, MWKEY_F11,		0 },
+	{ 0xffc9, MWKEY_F12,		0 },
+	{ 0xffe1, MWKEY_LSHIFT,		MWKMOD_LSHIFT },
+	{ 0xffe2, MWKEY_RSHIFT,		MWKMOD_RSHIFT },
+	{ 0xffe3, MWKEY_LCTRL,		MWKMOD_LCTRL },
+	{ 0xffe4, MWKEY_RCTRL,		MWKMOD_RCTRL },
+	{ 0xffe7, MWKEY_LMETA,		MWKMOD_LMETA },
+	{ 0xffe8, MWKEY_RMETA,		MWKMOD_RMETA },
+	{ 0xffe9, MWKEY_LALT,		MWKMOD_LALT },
+	{ 0xffea, MWKEY_RALT,		MWKMOD_RALT },
+	{ 0xffeb, MWKEY_LMETA,		MWKMOD_LMETA },
+	{ 0xffec, MWKEY_RMETA,		MWKMOD_RMETA },
+	{ 0xff7e, MWKEY_ALTGR,		MWKMOD_ALTGR },
+	{ 0xfe03, MWKEY_ALTGR,		MWKMOD_ALTGR },
+};
+
+/*
+ * Open the keyboard.
+ */
+static int
+RFB_Open(KBDDEVICE *pkd)
+{
+	keyboard_fd = rfb_eventfd(1);
+
+	if (keyboard_fd < 0)
+		return DRIVER_FAIL;
+
+	key_modstate = 0;
+	return DRIVER_OKFILEDESC(keyboard_fd);
+}
+
+/*
+ * Close the keyboard.
+ * Event pipe belongs to the screen driver.
+ */
+static void
+RFB_Close(void)
+{
+	keyboard_fd = -1;
+}
+
+/*
+ * Return the possible modifiers for the keyboard.
+ */
+static  void
+RFB_GetModifierInfo(MWKEYMOD *modifiers, MWKEYMOD *curmodifiers)
+{
+	if (modifiers)
+		*modifiers = MWKMOD_SHIFT | MWKMOD_CTRL | MWKMOD_ALT | MWKMOD_META |
+			MWKMOD_ALTGR | MWKMOD_CAPS | MWKMOD_NUM | MWKMOD_SCR;
+	if (curmodifiers)
+		*curmodifiers = key_modstate;
+}
+
+/*
+	RFB read keyboard protocol - 6 bytes:
+		buf[0] is 0xF5,
+		buf[1] is nonzero for key press, zero for release
+		buf[2-5] is X11 keysym (little endian long)
+*/
+static int
+RFB_Read(MWKEY *kbuf, MWKEYMOD *modifiers, MWSCANCODE *scancode)
+{
+	unsigned char buf[6];
+	unsigned long keysym;
+	MWKEY mwkey;
+	int n, pressed;
+
+	n = read(keyboard_fd, buf, sizeof(buf));
+	if (n != 6 || buf[0] != 0xF5)
+		return KBD_NODATA;
+
+	pressed = buf[1];
+	keysym = buf[2] | (buf[3] << 8) | ((unsigned long)buf[4] << 16) | ((unsigned long)buf[5] << 24);
+
+	switch (keysym) {
+	/* state modifiers, not sent*/
+	case 0xff7f:			/* Num_Lock*/
+		if (!pressed)
+			key_modstate ^= MWKMOD_NUM;
+		return KBD_NODATA;
+	case 0xffe5:			/* Caps_Lock*/
+	case 0xffe6:			/* Shift_Lock*/
+		if (!pressed)
+			key_modstate ^= MWKMOD_CAPS;
+		return KBD_NODATA;
+	case 0xff14:			/* Scroll_Lock*/
+		if (!pressed)
+			key_modstate ^= MWKMOD_SCR;
+		return KBD_NODATA;
+	}
+
+	if (keysym >= 0x20 && keysym <= 0xff) {
+		/* Latin-1 maps directly*/
+		if (key_modstate & MWKMOD_CTRL)
+			mwkey = keysym & 0x1f;	/* Control code*/
+		else mwkey = keysym;
+	} else if ((keysym & 0xff000000) == 0x01000000 && keysym <= 0x0100ffff) {
+		/* Unicode keysym*/
+		mwkey = keysym & 0xffff;
+	} else {
+		for (n = 0; n < (int)(sizeof(keymap)/sizeof(keymap[0])); n++)
+			if (keymap[n].keysym == keysym)
+				break;
+		if (n == (int)(sizeof(keymap)/sizeof(keymap[0]))) {
+			EPRINTF("Unhandled RFB keysym: %04lx\n", keysym);
+			return KBD_NODATA;
+		}
+		mwkey = keymap[n].mwkey;
+		if (pressed)
+			key_modstate |= keymap[n].modifier;
+		else key_modstate &= ~keymap[n].modifier;
+	}
+
+	if (key_modstate & MWKMOD_NUM) {
+		if (mwkey >= MWKEY_KP0 && mwkey <= MWKEY_KP9)
+			mwkey = mwkey - MWKEY_KP0 + '0';
+		else if (mwkey == MWKEY_KP_PERIOD)
+			mwkey = '.';
+	}
+	switch (mwkey) {
+	case MWKEY_KP_DIVIDE:
+		mwkey = '/';
+		break;
+	case MWKEY_KP_MULTIPLY:
+		mwkey = '*';
+		break;
+	case MWKEY_KP_MINUS:
+		mwkey = '-';
+		break;
+	case MWKEY_KP_PLUS:
+		mwkey = '+';
+		break;
+	case MWKEY_KP_EQUALS:
+		mwkey = '=';
+		break;
+	}
+
+	*kbuf = mwkey;
+	*modifiers = key_modstate;
+	*scancode = 0;
+	return pressed? KBD_KEYPRESS: KBD_KEYRELEASE;
+}
@@ -0,0 +1,588 @@
+/*
+ * Linux evdev Mouse and Touchscreen Driver
+ *
+ * Reads arrays of input_events from /dev/input/eventN and groups them into
+ * frames at each SYN_REPORT.  All frames waiting in the kernel are read on
+ * each wakeup and consecutive frames with the same button state are merged,
+ * so only the latest position is reported when the server falls behind.
+ * Multitouch devices are tracked using ABS_MT slots (protocol B), with the
+ * pointer following the first contact down.  Kernel timestamps are passed
+ * to the server as the event time.
+ *
+ * Environment:
+ *	EVDEV_DEVICE		input device, default /dev/input/event0
+ *	EVDEV_NOGRAB		don't take exclusive access with EVIOCGRAB
+ *	EVDEV_REPLAY		replay a recorded stream (cat /dev/input/eventN >file)
+ *	EVDEV_REPLAY_SPEED	replay speed multiplier, 0 as fast as possible
+ *
+ * Replayed streams report absolute coordinates unscaled, as the
+ * device ranges aren't recorded.  Replay statistics are shown at
+ * end of file for benchmarking.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+#include <linux/input.h>
+#include "device.h"
+#include "osdep.h"
+
+#define	SCALE		3	/* default scaling factor for acceleration */
+#define	THRESH		5	/* default threshhold for acceleration */
+
+#define EVDEV_DEV_FILE	"/dev/input/event0"
+#define MAXEVENTS	64	/* input_events read per read() call*/
+#define MAXSLOTS	16	/* multitouch slots tracked*/
+
+#ifndef input_event_sec
+#define input_event_sec		time.tv_sec
+#define input_event_usec	time.tv_usec
+#endif
+
+#define BITS_PER_LONG		(sizeof(long) * 8)
+#define NLONGS(n)		(((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define TESTBIT(a, n)		((a[(n) / BITS_PER_LONG] >> ((n) % BITS_PER_LONG)) & 1)
+
+typedef long long	USECS;
+
+static int  	Evdev_Open(MOUSEDEVICE *pmd);
+static void 	Evdev_Close(void);
+static int  	Evdev_GetButtonInfo(void);
+static void	Evdev_GetDefaultAccel(int *pscale,int *pthresh);
+static int  	Evdev_Read(MWCOORD *dx, MWCOORD *dy, MWCOORD *dz, int *bp);
+
+MOUSEDEVICE mousedev = {
+	Evdev_Open,
+	Evdev_Close,
+	Evdev_GetButtonInfo,
+	Evdev_GetDefaultAccel,
+	Evdev_Read,
+	NULL,
+	MOUSE_NORMAL	/* flags*/
+};
+
+extern SCREENDEVICE scrdev;
+
+/* multitouch contact*/
+typedef struct {
+	int	id;		/* tracking id, -1 if slot unused*/
+	int	x, y;
+} EVSLOT;
+
+static int	evdev_fd = -1;		/* event device or replay file*/
+static struct input_event evbuf[MAXEVENTS];
+static int	evcount;		/* # events in evbuf*/
+static int	evnext;			/* next event in evbuf to process*/
+
+/* device state, updated as each event is processed*/
+static int	absolute;		/* device reports absolute positions*/
+static int	multitouch;		/* device reports ABS_MT slots*/
+static struct input_absinfo absx, absy;	/* position ranges, unscaled if empty*/
+static EVSLOT	slots[MAXSLOTS];
+static int	curslot;		/* slot for ABS_MT events, -1 if out of range*/
+static int	primary = -1;		/* slot pointer follows, -1 if none*/
+static int	absxpos, absypos;	/* ABS_X/ABS_Y position*/
+static int	relx, rely;		/* relative motion this frame*/
+static int	keybuttons;		/* BTN_ buttons down*/
+static int	wheel;			/* scroll wheel buttons this frame*/
+static int	dropped;		/* SYN_DROPPED, skip to next SYN_REPORT*/
+static int	lastbuttons;		/* buttons last reported*/
+static int	lastx, lasty;		/* absolute position last reported*/
+
+/* replay state*/
+static int	replay;			/* replaying from file*/
+static int	replayspeed;		/* speed multiplier, 0 for no delay*/
+static int	replayeof;		/* replay file done*/
+static int	timer_fd = -1;		/* replay timer, returned as select fd*/
+static USECS	replaystart;		/* monotonic time first event replayed*/
+static USECS	replayfirst;		/* timestamp of first event in file*/
+
+/* statistics*/
+static struct {
+	unsigned long	reads;
+	unsigned long	events;
+	unsigned long	frames;
+	unsigned long	samples;
+	USECS		latency;	/* sum of sample age when reported*/
+	USECS		start;
+} stats;
+
+static USECS
+evtime(struct input_event *ev)
+{
+	return (USECS)ev->input_event_sec * 1000000 + ev->input_event_usec;
+}
+
+static USECS
+monotime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (USECS)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static USECS
+realtime(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (USECS)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* monotonic time recorded event is to be replayed*/
+static USECS
+replaytime(struct input_event *ev)
+{
+	if (replayspeed <= 0)
+		return monotime();
+	return replaystart + (evtime(ev) - replayfirst) / replayspeed;
+}
+
+/* arm replay timer to fire in delay usecs, or disarm if delay < 0*/
+static void
+replay_arm(USECS delay)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (delay >= 0) {
+		if (delay < 1)
+			delay = 1;
+		its.it_value.tv_sec = delay / 1000000;
+		its.it_value.tv_nsec = (delay % 1000000) * 1000;
+	}
+	timerfd_settime(timer_fd, 0, &its, NULL);
+}
+
+/* return TRUE if replay event is due, else arm timer for it*/
+static int
+replay_due(struct input_event *ev)
+{
+	USECS now = monotime();
+	USECS due;
+
+	if (!replaystart) {
+		replaystart = stats.start = now;
+		replayfirst = evtime(ev);
+	}
+	if (replayspeed <= 0)
+		return TRUE;
+	due = replaytime(ev);
+	if (due <= now)
+		return TRUE;
+	replay_arm(due - now);
+	return FALSE;
+}
+
+static void
+replay_end(void)
+{
+	USECS elapsed = monotime() - stats.start;
+
+	replayeof = TRUE;
+	replay_arm(-1);
+	EPRINTF("evdev replay: %lu events, %lu frames in %lu reads, %lu samples, "
+		"%lu us avg latency, %lu ms\n", stats.events, stats.frames, stats.reads,
+		stats.samples, stats.samples? (unsigned long)(stats.latency / stats.samples): 0,
+		(unsigned long)(elapsed / 1000));
+}
+
+/* get device capabilities and position ranges*/
+static void
+evdev_probe(void)
+{
+	unsigned long absbits[NLONGS(ABS_CNT)];
+	unsigned long props[NLONGS(INPUT_PROP_CNT)];
+	int xcode = ABS_X, ycode = ABS_Y;
+
+	memset(absbits, 0, sizeof(absbits));
+	memset(props, 0, sizeof(props));
+	ioctl(evdev_fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits);
+	ioctl(evdev_fd, EVIOCGPROP(sizeof(props)), props);
+
+	if (TESTBIT(absbits, ABS_MT_SLOT) && TESTBIT(absbits, ABS_MT_POSITION_X)) {
+		multitouch = TRUE;
+		xcode = ABS_MT_POSITION_X;
+		ycode = ABS_MT_POSITION_Y;
+	}
+	if (multitouch || TESTBIT(absbits, ABS_X)) {
+		absolute = TRUE;
+		if (ioctl(evdev_fd, EVIOCGABS(xcode), &absx) < 0)
+			memset(&absx, 0, sizeof(absx));
+		if (ioctl(evdev_fd, EVIOCGABS(ycode), &absy) < 0)
+			memset(&absy, 0, sizeof(absy));
+	}
+
+	/* touchscreens don't show a cursor*/
+	if (TESTBIT(props, INPUT_PROP_DIRECT))
+		GdHideCursor(&scrdev);
+	DPRINTF("evdev: %s%s x %d-%d y %d-%d\n", absolute? "absolute": "relative",
+		multitouch? " multitouch": "", absx.minimum, absx.maximum,
+		absy.minimum, absy.maximum);
+}
+
+/* reread device state after the kernel dropped events*/
+static void
+evdev_sync(void)
+{
+	unsigned long keys[NLONGS(KEY_CNT)];
+	struct input_absinfo ai;
+	struct {
+		__u32	code;
+		__s32	values[MAXSLOTS];
+	} mt;
+	int i;
+
+	memset(keys, 0, sizeof(keys));
+	if (ioctl(evdev_fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+		keybuttons = 0;
+		if (TESTBIT(keys, BTN_LEFT) || TESTBIT(keys, BTN_TOUCH))
+			keybuttons |= MWBUTTON_L;
+		if (TESTBIT(keys, BTN_MIDDLE))
+			keybuttons |= MWBUTTON_M;
+		if (TESTBIT(keys, BTN_RIGHT))
+			keybuttons |= MWBUTTON_R;
+	}
+	if (ioctl(evdev_fd, EVIOCGABS(ABS_X), &ai) >= 0)
+		absxpos = ai.value;
+	if (ioctl(evdev_fd, EVIOCGABS(ABS_Y), &ai) >= 0)
+		absypos = ai.value;
+
+	if (multitouch) {
+		if (ioctl(evdev_fd, EVIOCGABS(ABS_MT_SLOT), &ai) >= 0)
+			curslot = (ai.value < MAXSLOTS)? ai.value: -1;
+		mt.code = ABS_MT_TRACKING_ID;
+		if (ioctl(evdev_fd, EVIOCGMTSLOTS(sizeof(mt)), &mt) >= 0)
+			for (i = 0; i < MAXSLOTS; i++)
+				slots[i].id = mt.values[i];
+		mt.code = ABS_MT_POSITION_X;
+		if (ioctl(evdev_fd, EVIOCGMTSLOTS(sizeof(mt)), &mt) >= 0)
+			for (i = 0; i < MAXSLOTS; i++)
+				slots[i].x = mt.values[i];
+		mt.code = ABS_MT_POSITION_Y;
+		if (ioctl(evdev_fd, EVIOCGMTSLOTS(sizeof(mt)), &mt) >= 0)
+			for (i = 0; i < MAXSLOTS; i++)
+				slots[i].y = mt.values[i];
+	}
+}
+
+/* read next batch of events, return FALSE if none*/
+static int
+evdev_fill(void)
+{
+	int n;
+
+	if (evdev_fd < 0 || replayeof)
+		return FALSE;
+
+	n = read(evdev_fd, evbuf, sizeof(evbuf));
+	if (n < (int)sizeof(struct input_event)) {
+		if (n >= 0 && replay)
+			replay_end();
+		return FALSE;
+	}
+	stats.reads++;
+	evcount = n / sizeof(struct input_event);
+	evnext = 0;
+	return TRUE;
+}
+
+/* update device state from event, return TRUE at end of frame*/
+static int
+evdev_event(struct input_event *ev)
+{
+	int button = 0;
+
+	stats.events++;
+	if (ev->type == EV_SYN) {
+		if (ev->code == SYN_DROPPED)
+			dropped = TRUE;
+		else if (ev->code == SYN_REPORT) {
+			if (dropped) {
+				dropped = FALSE;
+				evdev_sync();
+			}
+			return TRUE;
+		}
+		return FALSE;
+	}
+	if (dropped)
+		return FALSE;
+
+	switch (ev->type) {
+	case EV_KEY:
+		switch (ev->code) {
+		case BTN_LEFT:
+		case BTN_TOUCH:
+			button = MWBUTTON_L;
+			break;
+		case BTN_MIDDLE:
+			button = MWBUTTON_M;
+			break;
+		case BTN_RIGHT:
+			button = MWBUTTON_R;
+			break;
+		}
+		if (ev->value == 1)
+			keybuttons |= button;
+		else if (ev->value == 0)
+			keybuttons &= ~button;
+		break;
+
+	case EV_REL:
+		switch (ev->code) {
+		case REL_X:
+			relx += ev->value;
+			break;
+		case REL_Y:
+			rely += ev->value;
+			break;
+		case REL_WHEEL:
+			wheel = (ev->value > 0)? MWBUTTON_SCROLLUP: MWBUTTON_SCROLLDN;
+			break;
+		}
+		break;
+
+	case EV_ABS:
+		switch (ev->code) {
+		case ABS_X:
+			absolute = TRUE;
+			absxpos = ev->value;
+			break;
+		case ABS_Y:
+			absolute = TRUE;
+			absypos = ev->value;
+			break;
+		case ABS_MT_SLOT:
+			curslot = (ev->value >= 0 && ev->value < MAXSLOTS)? ev->value: -1;
+			break;
+		case ABS_MT_TRACKING_ID:
+			absolute = multitouch = TRUE;
+			if (curslot >= 0)
+				slots[curslot].id = ev->value;
+			break;
+		case ABS_MT_POSITION_X:
+			if (curslot >= 0)
+				slots[curslot].x = ev->value;
+			break;
+		case ABS_MT_POSITION_Y:
+			if (curslot >= 0)
+				slots[curslot].y = ev->value;
+			break;
+		}
+		break;
+	}
+	return FALSE;
+}
+
+/* pointer follows first contact down until it's lifted*/
+static void
+evdev_primary(void)
+{
+	int i;
+
+	if (primary >= 0 && slots[primary].id < 0)
+		primary = -1;
+	if (primary < 0) {
+		for (i = 0; i < MAXSLOTS; i++) {
+			if (slots[i].id >= 0) {
+				primary = i;
+				break;
+			}
+		}
+	}
+}
+
+static MWCOORD
+evdev_scale(int value, struct input_absinfo *ai, int res)
+{
+	if (ai->maximum <= ai->minimum)
+		return value;
+	return (MWCOORD)((long)(value - ai->minimum) * res / (ai->maximum - ai->minimum + 1));
+}
+
+/*
+ * Open up the event device, or replay file.
+ * Returns the fd if successful, or negative if unsuccessful.
+ */
+static int
+Evdev_Open(MOUSEDEVICE *pmd)
+{
+	char *path;
+	int i;
+
+	for (i = 0; i < MAXSLOTS; i++)
+		slots[i].id = -1;
+	primary = -1;
+
+	if ((path = getenv("EVDEV_REPLAY")) != NULL) {
+		evdev_fd = open(path, O_RDONLY);
+		if (evdev_fd < 0) {
+			EPRINTF("Can't open evdev replay file %s\n", path);
+			return DRIVER_FAIL;
+		}
+		timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+		if (timer_fd < 0) {
+			EPRINTF("Can't create evdev replay timer\n");
+			close(evdev_fd);
+			evdev_fd = -1;
+			return DRIVER_FAIL;
+		}
+		replay = TRUE;
+		replayspeed = getenv("EVDEV_REPLAY_SPEED")? atoi(getenv("EVDEV_REPLAY_SPEED")): 1;
+		replay_arm(0);
+		return timer_fd;
+	}
+
+	if (!(path = getenv("EVDEV_DEVICE")))
+		path = EVDEV_DEV_FILE;
+	evdev_fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (evdev_fd < 0) {
+		EPRINTF("Can't open evdev device %s\n", path);
+		return DRIVER_FAIL;
+	}
+	if (!getenv("EVDEV_NOGRAB") && ioctl(evdev_fd, EVIOCGRAB, 1) < 0)
+		EPRINTF("Can't grab evdev device %s\n", path);
+	evdev_probe();
+
+	return evdev_fd;
+}
+
+/*
+ * Close the event device.
+ */
+static void
+Evdev_Close(void)
+{
+	if (evdev_fd >= 0) {
+		if (!replay)
+			ioctl(evdev_fd, EVIOCGRAB, 0);
+		close(evdev_fd);
+	}
+	evdev_fd = -1;
+	if (timer_fd >= 0)
+		close(timer_fd);
+	timer_fd = -1;
+}
+
+/*
+ * Get mouse buttons supported
+ */
+static int
+Evdev_GetButtonInfo(void)
+{
+	return MWBUTTON_L | MWBUTTON_M | MWBUTTON_R | MWBUTTON_SCROLLUP | MWBUTTON_SCROLLDN;
+}
+
+/*
+ * Get default mouse acceleration settings
+ */
+static void
+Evdev_GetDefaultAccel(int *pscale,int *pthresh)
+{
+	*pscale = SCALE;
+	*pthresh = THRESH;
+}
+
+/*
+ * Read all frames available and return the last, merging relative
+ * motion.  A frame that changes the buttons is returned immediately
+ * so no press or release is lost; the rest are read on the next call,
+ * which the server makes whenever the buttons have changed.  Lifting
+ * the last contact reports the position it was lifted at.
+ */
+static int
+Evdev_Read(MWCOORD *dx, MWCOORD *dy, MWCOORD *dz, int *bp)
+{
+	struct input_event *ev;
+	int	frames = 0;
+	int	waiting = FALSE;
+	int	buttons = lastbuttons;
+	int	sumx = 0, sumy = 0;
+	int	x = lastx, y = lasty;
+	USECS	when = 0, age;
+	MWCOORD	xres, yres;
+
+	if (replay) {
+		unsigned long long expired;
+
+		/* clear timer so select doesn't return until next due*/
+		if (read(timer_fd, &expired, sizeof(expired)) < 0 && errno != EAGAIN)
+			return MOUSE_FAIL;
+	}
+
+	for (;;) {
+		if (evnext >= evcount && !evdev_fill())
+			break;
+		ev = &evbuf[evnext];
+		if (replay && !replay_due(ev)) {
+			waiting = TRUE;
+			break;
+		}
+		evnext++;
+		if (!evdev_event(ev))
+			continue;
+
+		/* SYN_REPORT, take snapshot of frame*/
+		frames++;
+		stats.frames++;
+		when = replay? replaytime(ev): evtime(ev);
+		evdev_primary();
+		buttons = keybuttons | wheel;
+		if (primary >= 0) {
+			buttons |= MWBUTTON_L;
+			x = slots[primary].x;
+			y = slots[primary].y;
+		} else if (!multitouch) {
+			x = absxpos;
+			y = absypos;
+		}
+		sumx += relx;
+		sumy += rely;
+		relx = rely = wheel = 0;
+
+		if (buttons != lastbuttons || (buttons & (MWBUTTON_SCROLLUP|MWBUTTON_SCROLLDN)))
+			break;
+	}
+
+	/* continue replay on next select unless waiting for an event to be due*/
+	if (replay && !replayeof && !waiting)
+		replay_arm(0);
+
+	if (frames == 0)
+		return MOUSE_NODATA;
+
+	/* pass kernel timestamp as tick count*/
+	age = (replay? monotime(): realtime()) - when;
+	if (age < 0 || age > 10000000L)		/* different clock*/
+		age = 0;
+	GdSetMouseTime(GdGetTickCount() - (MWTIMEOUT)(age / 1000));
+	stats.samples++;
+	stats.latency += age;
+
+	lastbuttons = buttons;
+	lastx = x;
+	lasty = y;
+	*bp = buttons;
+	*dz = 0;
+
+	if (!absolute) {
+		*dx = sumx;
+		*dy = sumy;
+		return MOUSE_RELPOS;
+	}
+
+	/* scale to physical screen, filter_absrotate turns it upright*/
+	GdGetPhysicalSize(&scrdev, &xres, &yres);
+	*dx = evdev_scale(x, &absx, xres);
+	*dy = evdev_scale(y, &absy, yres);
+	return MOUSE_ABSPOS;
+}
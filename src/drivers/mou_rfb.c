@@ -0,0 +1,110 @@
+/*
+ * RFB (VNC) remote framebuffer server mouse driver
+ * Reads pointer events passed on by the RFB screen driver.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include "device.h"
+
+#define	SCALE		3	/* default scaling factor for acceleration */
+#define	THRESH		5	/* default threshhold for acceleration */
+
+static int  RFB_Open(MOUSEDEVICE *pmd);
+static void RFB_Close(void);
+static int  RFB_GetButtonInfo(void);
+static void	RFB_GetDefaultAccel(int *pscale,int *pthresh);
+static int  RFB_Read(MWCOORD *dx, MWCOORD *dy, MWCOORD *dz, int *bp);
+
+int rfb_eventfd(int keyboard);
+
+static int      mouse_fd = -1;
+
+MOUSEDEVICE mousedev = {
+	RFB_Open,
+	RFB_Close,
+	RFB_GetButtonInfo,
+	RFB_GetDefaultAccel,
+	RFB_Read,
+	NULL,
+	MOUSE_NORMAL    /* flags*/
+};
+
+/*
+ * Open up the mouse device.
+ * Returns the fd if successful, or negative if unsuccessful.
+ */
+static int
+RFB_Open(MOUSEDEVICE *pmd)
+{
+	mouse_fd = rfb_eventfd(0);
+
+	if (mouse_fd < 0)
+		return MOUSE_FAIL;
+
+	return DRIVER_OKFILEDESC(mouse_fd);
+}
+
+/*
+ * Close the mouse device.
+ * Event pipe belongs to the screen driver.
+ */
+static void
+RFB_Close(void)
+{
+	mouse_fd = -1;
+}
+
+/*
+ * Get mouse buttons supported
+ */
+static int
+RFB_GetButtonInfo(void)
+{
+	return MWBUTTON_L | MWBUTTON_M | MWBUTTON_R | MWBUTTON_SCROLLUP | MWBUTTON_SCROLLDN;
+}
+
+/*
+ * Get default mouse acceleration settings
+ */
+static void
+RFB_GetDefaultAccel(int *pscale,int *pthresh)
+{
+	*pscale = SCALE;
+	*pthresh = THRESH;
+}
+
+/*
+	RFB read mouse protocol - 6 bytes
+		buf[0] is 0xF4,
+		buf[1] is RFB button mask, bits 0-4 left, middle, right, wheel up, wheel down
+		buf[2-3] is absolute X position (little endian short)
+		buf[4-5] is absolute Y position (little endian short)
+*/
+static int
+RFB_Read(MWCOORD *dx, MWCOORD *dy, MWCOORD *dz, int *bp)
+{
+	unsigned char buf[6];
+	int n, buttons = 0;
+
+	n = read(mouse_fd, buf, sizeof(buf));
+	if (n != 6 || buf[0] != 0xF4)
+		return MOUSE_NODATA;
+
+	if (buf[1] & 0x01)
+		buttons |= MWBUTTON_L;
+	if (buf[1] & 0x02)
+		buttons |= MWBUTTON_M;
+	if (buf[1] & 0x04)
+		buttons |= MWBUTTON_R;
+	if (buf[1] & 0x08)
+		buttons |= MWBUTTON_SCROLLUP;
+	if (buf[1] & 0x10)
+		buttons |= MWBUTTON_SCROLLDN;
+
+	*bp = buttons;
+	*dx = buf[2] | (buf[3] << 8);
+	*dy = buf[4] | (buf[5] << 8);
+	*dz = 0;
+
+	return MOUSE_ABSPOS;
+}
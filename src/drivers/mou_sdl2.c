@@ -117,9 +117,13 @@ mousdl_Read(MWCOORD *dx, MWCOORD *dy, MWCOORD *dz, int *bp)
 
 	/* handle touchpad events FIXME need right mouse button support*/
 	if (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FINGERDOWN, SDL_FINGERMOTION)) {
+		MWCOORD xres, yres;
+
+		/* scale to physical screen, filter_absrotate turns it upright*/
+		GdGetPhysicalSize(&scrdev, &xres, &yres);
 		if (event.type == SDL_FINGERDOWN) {
-			*dx = lastx = (int)(event.tfinger.x * scrdev.xres / sdlZoom);
-			*dy = lasty = (int)(event.tfinger.y * scrdev.yres / sdlZoom);
+			*dx = lastx = (int)(event.tfinger.x * xres / sdlZoom);
+			*dy = lasty = (int)(event.tfinger.y * yres / sdlZoom);
     			lastdn = MWBUTTON_L;
 //printf("mousedn %d,%d\n", lastx, lasty);
 			*dz = 0;
@@ -128,8 +132,8 @@ mousdl_Read(MWCOORD *dx, MWCOORD *dy, MWCOORD *dz, int *bp)
 		}
 
 		if (event.type == SDL_FINGERUP) {
-			*dx = lastx = (int)(event.tfinger.x * scrdev.xres / sdlZoom);
-			*dy = lasty = (int)(event.tfinger.y * scrdev.yres / sdlZoom);
+			*dx = lastx = (int)(event.tfinger.x * xres / sdlZoom);
+			*dy = lasty = (int)(event.tfinger.y * yres / sdlZoom);
 			lastdn = 0;
 //printf("mouseup %d,%d\n", lastx, lasty);
 			*dz = 0;
@@ -140,8 +144,8 @@ mousdl_Read(MWCOORD *dx, MWCOORD *dy, MWCOORD *dz, int *bp)
 		if (event.type == SDL_FINGERMOTION) {
 			if (lastdn == 0)
 				return MOUSE_NODATA;	/* no motion without finger down*/
-			*dx = lastx = (int)(event.tfinger.x * scrdev.xres / sdlZoom);
-			*dy = lasty = (int)(event.tfinger.y * scrdev.yres / sdlZoom);
+			*dx = lastx = (int)(event.tfinger.x * xres / sdlZoom);
+			*dy = lasty = (int)(event.tfinger.y * yres / sdlZoom);
 //printf("mousemv %d,%d\n", lastx, lasty);
 			*dz = 0;
 			*bp = lastdn;
@@ -0,0 +1,445 @@
+/*
+ * Portrait mode shadow framebuffer for screen drivers using gen_setportrait.
+ *
+ * Instead of remapping every drawing coordinate through the fbportrait
+ * subdrivers, the screen is drawn upright by the regular framebuffer
+ * subdriver into a shadow buffer, and updated areas are rotated into the
+ * driver framebuffer before the driver's own Update/PreSelect run.
+ *
+ * Rotation walks the destination in 16x16 tiles so source columns stay
+ * in cache, transposing 4x4 (32bpp) or 8x8 (16bpp) blocks with SSE2 or
+ * NEON when the compiler targets them.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "device.h"
+#include "genmem.h"
+#include "fb.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2	1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON	1
+#endif
+
+#define ROTATE_TILE	16		/* destination tile width and height*/
+
+#if USE_SSE2 || USE_NEON
+/*
+ * Transpose 4x4 block of 32bpp pixels. Each destination row is built
+ * from four source pixels contiguous in memory, starting at s and
+ * running backwards when rstep is negative.
+ */
+static inline void
+rotate_block_32(unsigned char *d, int dstpitch, const unsigned char *s, int rstep, int cstep)
+{
+	const unsigned char *p = (rstep < 0)? s - 12: s;
+#if USE_SSE2
+	__m128i r0 = _mm_loadu_si128((const __m128i *)p);
+	__m128i r1 = _mm_loadu_si128((const __m128i *)(p + cstep));
+	__m128i r2 = _mm_loadu_si128((const __m128i *)(p + 2*cstep));
+	__m128i r3 = _mm_loadu_si128((const __m128i *)(p + 3*cstep));
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+	__m128i o[4];
+
+	o[0] = _mm_unpacklo_epi64(t0, t1);
+	o[1] = _mm_unpackhi_epi64(t0, t1);
+	o[2] = _mm_unpacklo_epi64(t2, t3);
+	o[3] = _mm_unpackhi_epi64(t2, t3);
+	if (rstep < 0) {
+		_mm_storeu_si128((__m128i *)d, o[3]);
+		_mm_storeu_si128((__m128i *)(d + dstpitch), o[2]);
+		_mm_storeu_si128((__m128i *)(d + 2*dstpitch), o[1]);
+		_mm_storeu_si128((__m128i *)(d + 3*dstpitch), o[0]);
+	} else {
+		_mm_storeu_si128((__m128i *)d, o[0]);
+		_mm_storeu_si128((__m128i *)(d + dstpitch), o[1]);
+		_mm_storeu_si128((__m128i *)(d + 2*dstpitch), o[2]);
+		_mm_storeu_si128((__m128i *)(d + 3*dstpitch), o[3]);
+	}
+#else
+	uint32x4x2_t x = vtrnq_u32(vld1q_u32((const uint32_t *)p),
+		vld1q_u32((const uint32_t *)(p + cstep)));
+	uint32x4x2_t y = vtrnq_u32(vld1q_u32((const uint32_t *)(p + 2*cstep)),
+		vld1q_u32((const uint32_t *)(p + 3*cstep)));
+	uint32x4_t o[4];
+
+	o[0] = vcombine_u32(vget_low_u32(x.val[0]), vget_low_u32(y.val[0]));
+	o[1] = vcombine_u32(vget_low_u32(x.val[1]), vget_low_u32(y.val[1]));
+	o[2] = vcombine_u32(vget_high_u32(x.val[0]), vget_high_u32(y.val[0]));
+	o[3] = vcombine_u32(vget_high_u32(x.val[1]), vget_high_u32(y.val[1]));
+	if (rstep < 0) {
+		vst1q_u32((uint32_t *)d, o[3]);
+		vst1q_u32((uint32_t *)(d + dstpitch), o[2]);
+		vst1q_u32((uint32_t *)(d + 2*dstpitch), o[1]);
+		vst1q_u32((uint32_t *)(d + 3*dstpitch), o[0]);
+	} else {
+		vst1q_u32((uint32_t *)d, o[0]);
+		vst1q_u32((uint32_t *)(d + dstpitch), o[1]);
+		vst1q_u32((uint32_t *)(d + 2*dstpitch), o[2]);
+		vst1q_u32((uint32_t *)(d + 3*dstpitch), o[3]);
+	}
+#endif
+}
+
+/* transpose 8x8 block of 16bpp pixels, as rotate_block_32*/
+static inline void
+rotate_block_16(unsigned char *d, int dstpitch, const unsigned char *s, int rstep, int cstep)
+{
+	const unsigned char *p = (rstep < 0)? s - 14: s;
+	int i;
+#if USE_SSE2
+	__m128i r[8], t[8], u[8], o[8];
+
+	for (i = 0; i < 8; i++)
+		r[i] = _mm_loadu_si128((const __m128i *)(p + i*cstep));
+	for (i = 0; i < 8; i += 2) {
+		t[i] = _mm_unpacklo_epi16(r[i], r[i+1]);
+		t[i+1] = _mm_unpackhi_epi16(r[i], r[i+1]);
+	}
+	u[0] = _mm_unpacklo_epi32(t[0], t[2]);
+	u[1] = _mm_unpackhi_epi32(t[0], t[2]);
+	u[2] = _mm_unpacklo_epi32(t[1], t[3]);
+	u[3] = _mm_unpackhi_epi32(t[1], t[3]);
+	u[4] = _mm_unpacklo_epi32(t[4], t[6]);
+	u[5] = _mm_unpackhi_epi32(t[4], t[6]);
+	u[6] = _mm_unpacklo_epi32(t[5], t[7]);
+	u[7] = _mm_unpackhi_epi32(t[5], t[7]);
+	for (i = 0; i < 4; i++) {
+		o[2*i] = _mm_unpacklo_epi64(u[i], u[i+4]);
+		o[2*i+1] = _mm_unpackhi_epi64(u[i], u[i+4]);
+	}
+	for (i = 0; i < 8; i++)
+		_mm_storeu_si128((__m128i *)(d + i*dstpitch), o[(rstep < 0)? 7-i: i]);
+#else
+	uint16x8x2_t t[4];
+	uint32x4x2_t x0, x1, y0, y1;
+	uint16x8_t o[8];
+
+	for (i = 0; i < 4; i++)
+		t[i] = vtrnq_u16(vld1q_u16((const uint16_t *)(p + 2*i*cstep)),
+			vld1q_u16((const uint16_t *)(p + (2*i+1)*cstep)));
+	x0 = vtrnq_u32(vreinterpretq_u32_u16(t[0].val[0]), vreinterpretq_u32_u16(t[1].val[0]));
+	x1 = vtrnq_u32(vreinterpretq_u32_u16(t[0].val[1]), vreinterpretq_u32_u16(t[1].val[1]));
+	y0 = vtrnq_u32(vreinterpretq_u32_u16(t[2].val[0]), vreinterpretq_u32_u16(t[3].val[0]));
+	y1 = vtrnq_u32(vreinterpretq_u32_u16(t[2].val[1]), vreinterpretq_u32_u16(t[3].val[1]));
+	o[0] = vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(x0.val[0]), vget_low_u32(y0.val[0])));
+	o[1] = vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(x1.val[0]), vget_low_u32(y1.val[0])));
+	o[2] = vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(x0.val[1]), vget_low_u32(y0.val[1])));
+	o[3] = vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(x1.val[1]), vget_low_u32(y1.val[1])));
+	o[4] = vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(x0.val[0]), vget_high_u32(y0.val[0])));
+	o[5] = vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(x1.val[0]), vget_high_u32(y1.val[0])));
+	o[6] = vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(x0.val[1]), vget_high_u32(y0.val[1])));
+	o[7] = vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(x1.val[1]), vget_high_u32(y1.val[1])));
+	for (i = 0; i < 8; i++)
+		vst1q_u16((uint16_t *)(d + i*dstpitch), o[(rstep < 0)? 7-i: i]);
+#endif
+}
+#endif /* USE_SSE2 || USE_NEON*/
+
+/*
+ * Rotate one destination tile of tw by th pixels. Destination pixel
+ * (r,c) comes from source address s + r*rstep + c*cstep.
+ */
+static void
+rotate_tile(int bytespp, unsigned char *d, int dstpitch, const unsigned char *s,
+	int rstep, int cstep, int tw, int th)
+{
+	int r = 0, c;
+
+#if USE_SSE2 || USE_NEON
+	/* left and right rotations transpose blocks of contiguous source pixels*/
+	if (bytespp == 4 && (rstep == 4 || rstep == -4)) {
+		for (; r + 4 <= th; r += 4) {
+			for (c = 0; c + 4 <= tw; c += 4)
+				rotate_block_32(d + r*dstpitch + c*4, dstpitch, s + r*rstep + c*cstep,
+					rstep, cstep);
+			for (; c < tw; c++) {
+				const unsigned char *sp = s + r*rstep + c*cstep;
+				unsigned char *dp = d + r*dstpitch + c*4;
+				int i;
+
+				for (i = 0; i < 4; i++, sp += rstep, dp += dstpitch)
+					*(ADDR32)dp = *(ADDR32)sp;
+			}
+		}
+	} else if (bytespp == 2 && (rstep == 2 || rstep == -2)) {
+		for (; r + 8 <= th; r += 8) {
+			for (c = 0; c + 8 <= tw; c += 8)
+				rotate_block_16(d + r*dstpitch + c*2, dstpitch, s + r*rstep + c*cstep,
+					rstep, cstep);
+			for (; c < tw; c++) {
+				const unsigned char *sp = s + r*rstep + c*cstep;
+				unsigned char *dp = d + r*dstpitch + c*2;
+				int i;
+
+				for (i = 0; i < 8; i++, sp += rstep, dp += dstpitch)
+					*(ADDR16)dp = *(ADDR16)sp;
+			}
+		}
+	}
+#endif
+
+	/* remaining rows*/
+	for (; r < th; r++) {
+		const unsigned char *sp = s + r*rstep;
+		unsigned char *dp = d + r*dstpitch;
+
+		switch (bytespp) {
+		case 4:
+			for (c = 0; c < tw; c++, sp += cstep)
+				((ADDR32)dp)[c] = *(ADDR32)sp;
+			break;
+		case 3:
+			for (c = 0; c < tw; c++, sp += cstep, dp += 3) {
+				dp[0] = sp[0];
+				dp[1] = sp[1];
+				dp[2] = sp[2];
+			}
+			break;
+		case 2:
+			for (c = 0; c < tw; c++, sp += cstep)
+				((ADDR16)dp)[c] = *(ADDR16)sp;
+			break;
+		case 1:
+			for (c = 0; c < tw; c++, sp += cstep)
+				dp[c] = *sp;
+			break;
+		}
+	}
+}
+
+/*
+ * Copy w by h upright source rectangle to destination rotated by portrait mode.
+ * The destination rectangle is h by w pixels for left and right rotations.
+ */
+void
+rotate_framebuffer_rect(int portrait, int bytespp, const unsigned char *src,
+	int srcpitch, unsigned char *dst, int dstpitch, MWCOORD w, MWCOORD h)
+{
+	const unsigned char *base;
+	int rstep, cstep, dw, dh, tx, ty;
+
+	switch (portrait) {
+	case MWPORTRAIT_LEFT:
+		base = src + (w - 1) * bytespp;
+		rstep = -bytespp;
+		cstep = srcpitch;
+		dw = h;
+		dh = w;
+		break;
+	case MWPORTRAIT_RIGHT:
+		base = src + (h - 1) * srcpitch;
+		rstep = bytespp;
+		cstep = -srcpitch;
+		dw = h;
+		dh = w;
+		break;
+	case MWPORTRAIT_DOWN:
+		base = src + (h - 1) * srcpitch + (w - 1) * bytespp;
+		rstep = -srcpitch;
+		cstep = -bytespp;
+		dw = w;
+		dh = h;
+		break;
+	default:
+		while (--h >= 0) {
+			memcpy(dst, src, w * bytespp);
+			src += srcpitch;
+			dst += dstpitch;
+		}
+		return;
+	}
+
+	for (ty = 0; ty < dh; ty += ROTATE_TILE) {
+		int th = MWMIN(ROTATE_TILE, dh - ty);
+
+		for (tx = 0; tx < dw; tx += ROTATE_TILE)
+			rotate_tile(bytespp, dst + ty * dstpitch + tx * bytespp, dstpitch,
+				base + ty * rstep + tx * cstep, rstep, cstep,
+				MWMIN(ROTATE_TILE, dw - tx), th);
+	}
+}
+
+#if MW_FEATURE_PORTRAIT_SHADOW
+/* screen driver state saved while drawing into upright shadow buffer*/
+static unsigned char *shadowaddr;		/* upright drawing buffer*/
+static unsigned int shadowpitch;
+static unsigned int shadowsize;
+static unsigned char *hwaddr;			/* driver framebuffer in screen orientation*/
+static unsigned int hwpitch;
+static unsigned int hwsize;
+static MWCOORD hwxres, hwyres;
+static void (*hwUpdate)(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height);
+static int (*hwPreSelect)(PSD psd);
+static void (*hwClose)(PSD psd);
+static UPDATERECTS shadow_updates;		/* upright areas not yet rotated*/
+
+static void shadow_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height);
+static int shadow_preselect(PSD psd);
+static void shadow_close(PSD psd);
+
+/* restore driver framebuffer and entry points before calling driver*/
+static void
+enter_driver(PSD psd)
+{
+	psd->addr = hwaddr;
+	psd->pitch = hwpitch;
+	psd->size = hwsize;
+	psd->xres = hwxres;
+	psd->yres = hwyres;
+	psd->Update = hwUpdate;
+	psd->PreSelect = hwPreSelect;
+	psd->Close = hwClose;
+}
+
+/* save driver state, which may have been changed by the driver, and draw upright*/
+static void
+leave_driver(PSD psd)
+{
+	hwaddr = psd->addr;
+	hwpitch = psd->pitch;
+	hwsize = psd->size;
+	hwUpdate = psd->Update;
+	hwPreSelect = psd->PreSelect;
+	hwClose = psd->Close;
+
+	psd->addr = shadowaddr;
+	psd->pitch = shadowpitch;
+	psd->size = shadowsize;
+	psd->xres = psd->xvirtres;
+	psd->yres = psd->yvirtres;
+	psd->Update = shadow_update;
+	psd->PreSelect = hwPreSelect? shadow_preselect: NULL;
+	psd->Close = shadow_close;
+}
+
+/* rotate upright areas drawn into driver framebuffer, called in driver state*/
+static void
+rotate_updates(PSD psd)
+{
+	int bytespp = (psd->bpp + 7) >> 3;
+	int i;
+
+	for (i = 0; i < shadow_updates.count; i++) {
+		MWRECT *rc = &shadow_updates.rects[i];
+		MWCOORD x = rc->left;
+		MWCOORD y = rc->top;
+		MWCOORD w = rc->right - rc->left;
+		MWCOORD h = rc->bottom - rc->top;
+		MWCOORD dx, dy;
+
+		switch (psd->shadowportrait) {
+		case MWPORTRAIT_LEFT:
+			dx = y;
+			dy = psd->xvirtres - x - w;
+			break;
+		case MWPORTRAIT_RIGHT:
+			dx = psd->yvirtres - y - h;
+			dy = x;
+			break;
+		case MWPORTRAIT_DOWN:
+		default:
+			dx = psd->xvirtres - x - w;
+			dy = psd->yvirtres - y - h;
+			break;
+		}
+		rotate_framebuffer_rect(psd->shadowportrait, bytespp,
+			shadowaddr + y * shadowpitch + x * bytespp, shadowpitch,
+			hwaddr + dy * hwpitch + dx * bytespp, hwpitch, w, h);
+
+		if (hwUpdate) {
+			if (psd->shadowportrait == MWPORTRAIT_DOWN)
+				hwUpdate(psd, dx, dy, w, h);
+			else hwUpdate(psd, dx, dy, h, w);
+		}
+	}
+	shadow_updates.count = 0;
+}
+
+/* add drawn area, rotating immediately unless driver delays updates until PreSelect*/
+static void
+shadow_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height)
+{
+	add_update_rect(psd, &shadow_updates, x, y, width, height);
+
+	if (!(psd->flags & PSF_DELAYUPDATE) || !hwPreSelect) {
+		enter_driver(psd);
+		rotate_updates(psd);
+		leave_driver(psd);
+	}
+}
+
+static int
+shadow_preselect(PSD psd)
+{
+	int ret;
+
+	enter_driver(psd);
+	if (shadow_updates.count)
+		rotate_updates(psd);
+	ret = psd->PreSelect(psd);
+	leave_driver(psd);
+	return ret;
+}
+
+static void
+shadow_close(PSD psd)
+{
+	portrait_shadow_close(psd);
+	psd->Close(psd);
+}
+
+/*
+ * Start drawing screen upright into shadow buffer, rotating updated areas
+ * into the driver framebuffer. Called with xvirtres/yvirtres set for
+ * portrait mode. Returns 0 if not possible, for subdriver rotation.
+ */
+int
+portrait_shadow_open(PSD psd, int portraitmode)
+{
+	int bytespp = (psd->bpp + 7) >> 3;
+
+	if (!(psd->flags & PSF_SCREEN) || psd->bpp < 8 || !psd->addr)
+		return 0;
+
+	shadowpitch = (psd->xvirtres * bytespp + 3) & ~3;
+	shadowsize = shadowpitch * psd->yvirtres;
+	if ((shadowaddr = malloc(shadowsize)) == NULL) {
+		EPRINTF("Can't allocate portrait shadow framebuffer, using portrait subdrivers\n");
+		return 0;
+	}
+	hwxres = psd->xres;
+	hwyres = psd->yres;
+
+	/* start with current screen contents turned upright*/
+	rotate_framebuffer_rect((portraitmode == MWPORTRAIT_LEFT)? MWPORTRAIT_RIGHT:
+		(portraitmode == MWPORTRAIT_RIGHT)? MWPORTRAIT_LEFT: portraitmode, bytespp,
+		psd->addr, psd->pitch, shadowaddr, shadowpitch, psd->xres, psd->yres);
+
+	shadow_updates.count = 0;
+	psd->shadowportrait = portraitmode;
+	leave_driver(psd);
+	return 1;
+}
+
+/* stop drawing into upright shadow buffer, restoring driver framebuffer*/
+void
+portrait_shadow_close(PSD psd)
+{
+	if (psd->shadowportrait == MWPORTRAIT_NONE)
+		return;
+
+	enter_driver(psd);
+	psd->shadowportrait = MWPORTRAIT_NONE;
+	free(shadowaddr);
+	shadowaddr = NULL;
+	shadow_updates.count = 0;
+}
+#endif /* MW_FEATURE_PORTRAIT_SHADOW*/
@@ -6,6 +6,11 @@
  * Microwindows Screen Driver for Linux kernel framebuffers or framebuffer emulator
  *
  * To use with bin/fbe, setenv FRAMEBUFFER=/tmp/fb0 or use scr_fbe.c driver (SCREEN=FBE in config)
+ *
+ * setenv FRAMEBUFFER_MODE=flip to draw into the hidden half of a double height
+ * virtual framebuffer, presented with FBIOPAN_DISPLAY at vertical sync, or
+ * FRAMEBUFFER_MODE=shadow to draw into cached memory and copy changed areas
+ * to uncached framebuffer memory before each select().
  * 
  * Note: modify select_fb_driver() to add new framebuffer subdrivers
  */
@@ -35,12 +40,24 @@
 #ifndef FB_TYPE_VGA_PLANES
 #define FB_TYPE_VGA_PLANES 4
 #endif
+#if LINUX && !defined(FBIO_WAITFORVSYNC)
+#define FBIO_WAITFORVSYNC	_IOW('F', 0x20, __u32)
+#endif
+
+#define FB_DIRECT	0		/* draw directly to framebuffer*/
+#define FB_SHADOW	1		/* draw to memory, copy changes to framebuffer*/
+#define FB_FLIP		2		/* draw to back page, pan to display*/
 
 static PSD  fb_open(PSD psd);
 static void fb_close(PSD psd);
 static void fb_setpalette(PSD psd,int first, int count, MWPALENTRY *palette);
 static PSD open_linuxfb(PSD psd);
 static void	set_directcolor_palette(PSD psd);
+#if LINUX
+static size_t init_buffering(PSD psd);
+static void fb_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height);
+static int fb_preselect(PSD psd);
+#endif
 
 /* static variables*/
 static int fb = -1;				/* framebuffer file handle*/
@@ -50,7 +67,15 @@ static short saved_green[16];
 static short saved_blue[16];
 static struct fb_fix_screeninfo  fb_fix;
 static struct fb_var_screeninfo fb_var;
+static struct fb_var_screeninfo fb_orgvar;	/* original mode, restored on close*/
 #endif
+static int fbmode = FB_DIRECT;		/* FB_DIRECT, FB_SHADOW or FB_FLIP*/
+static unsigned char *fbmem;		/* mmap'd framebuffer*/
+static size_t fbmapsize;		/* size of mmap'd framebuffer*/
+static size_t fbpagesize;		/* offset of second page when flipping*/
+static int backpage;			/* page drawn into when flipping*/
+static int novsync;			/* FBIO_WAITFORVSYNC not supported*/
+static UPDATERECTS dirty;		/* areas changed since last present*/
 
 SCREENDEVICE	scrdev = {
 	0, 0, 0, 0, 0, 0, 0, NULL, 0, NULL, 0, 0, 0, 0, 0, 0,
@@ -106,6 +131,8 @@ fail:
 				fb = -1;
 				return NULL;
 			}
+			fbmem = psd->addr;
+			fbmapsize = psd->size;
 			return psd;		/* FBE success*/
 		}
 	}
@@ -133,6 +160,7 @@ open_linuxfb(PSD psd)
 			EPRINTF("Error reading screen info: %m\n");
 			goto fail;
 	}
+	fb_orgvar = fb_var;
 
 	/* setup screen device from framebuffer info*/
 	type = fb_fix.type;
@@ -250,12 +278,41 @@ open_linuxfb(PSD psd)
 #elif UCLINUX
 	psd->addr = mmap(NULL, psd->size, PROT_READ|PROT_WRITE,0,fb,0);
 #else
-	psd->addr = mmap(NULL, psd->size, PROT_READ|PROT_WRITE,MAP_SHARED,fb,0);
+	fbmapsize = init_buffering(psd);
+	psd->addr = mmap(NULL, fbmapsize, PROT_READ|PROT_WRITE,MAP_SHARED,fb,0);
 #endif
 	if(psd->addr == NULL || psd->addr == (unsigned char *)-1) {
 		EPRINTF("Error mmaping %s: %m\n", MW_PATH_FRAMEBUFFER);
 		goto fail;
 	}
+	fbmem = psd->addr;
+	if (!fbmapsize)
+		fbmapsize = psd->size;
+
+	if (fbmode == FB_SHADOW) {
+		/* draw in cached memory, initialized from framebuffer*/
+		if ((psd->addr = malloc(psd->size)) == NULL) {
+			EPRINTF("No memory for shadow framebuffer\n");
+			psd->addr = fbmem;
+			fbmode = FB_DIRECT;
+		} else {
+			memcpy(psd->addr, fbmem, psd->yres * psd->pitch);
+			psd->flags |= PSF_ADDRMALLOC;
+		}
+	} else if (fbmode == FB_FLIP) {
+		/* display first page, draw into second*/
+		fb_var.xoffset = fb_var.yoffset = 0;
+		ioctl(fb, FBIOPAN_DISPLAY, &fb_var);
+		backpage = 1;
+		psd->addr = fbmem + fbpagesize;
+		memcpy(psd->addr, fbmem, fbpagesize);
+	}
+	if (fbmode != FB_DIRECT) {
+		psd->Update = fb_update;
+		psd->PreSelect = fb_preselect;
+		psd->flags |= PSF_DELAYUPDATE;
+		dirty.count = 0;
+	}
 
 	/* save original palette*/
 	ioctl_getpalette(0, 16, saved_red, saved_green, saved_blue);
@@ -283,9 +340,19 @@ fb_close(PSD psd)
 #if LINUX
   	/* reset hw palette*/
 	ioctl_setpalette(0, 16, saved_red, saved_green, saved_blue);
+
+	/* restore original virtual size and display first page*/
+	if (fb_var.yres_virtual != fb_orgvar.yres_virtual || fb_var.yoffset != fb_orgvar.yoffset)
+		ioctl(fb, FBIOPUT_VSCREENINFO, &fb_orgvar);
+	if (psd->flags & PSF_ADDRMALLOC) {
+		free(psd->addr);
+		psd->flags &= ~PSF_ADDRMALLOC;
+	}
+	psd->addr = fbmem;
+	fbmode = FB_DIRECT;
   
 	/* unmap framebuffer*/
-	munmap(psd->addr, psd->size);
+	munmap(fbmem, fbmapsize);
   
 #if HAVE_TEXTMODE
 	{
@@ -302,6 +369,110 @@ fb_close(PSD psd)
 	fb = -1;
 }
 
+#if LINUX
+/*
+ * Set drawing mode from FRAMEBUFFER_MODE and return the size to mmap,
+ * or 0 for a single page.  Page flipping requires a virtual framebuffer
+ * twice the screen height, which is requested if not already set.
+ */
+static size_t
+init_buffering(PSD psd)
+{
+	char *env = getenv("FRAMEBUFFER_MODE");
+	int extra = getpagesize() - 1;
+	struct fb_var_screeninfo var;
+
+	fbmode = FB_DIRECT;
+	if (!env || !strcmp(env, "direct"))
+		return 0;
+	if (!strcmp(env, "shadow")) {
+		fbmode = FB_SHADOW;
+		return 0;
+	}
+	if (strcmp(env, "flip")) {
+		EPRINTF("Unknown FRAMEBUFFER_MODE %s, drawing directly\n", env);
+		return 0;
+	}
+
+	if (fb_var.yres_virtual < fb_var.yres * 2) {
+		var = fb_var;
+		var.yres_virtual = fb_var.yres * 2;
+		var.xoffset = var.yoffset = 0;
+		if (ioctl(fb, FBIOPUT_VSCREENINFO, &var) == 0) {
+			ioctl(fb, FBIOGET_VSCREENINFO, &fb_var);
+			ioctl(fb, FBIOGET_FSCREENINFO, &fb_fix);
+		}
+	}
+	fbpagesize = fb_var.yres * fb_fix.line_length;
+	if (fb_var.yres_virtual < fb_var.yres * 2 || fb_fix.smem_len < fbpagesize * 2 ||
+	    fb_fix.line_length != psd->pitch || fb_var.yres != psd->yres) {
+		EPRINTF("Framebuffer can't page flip, using shadow framebuffer\n");
+		if (fb_var.yres_virtual != fb_orgvar.yres_virtual) {
+			ioctl(fb, FBIOPUT_VSCREENINFO, &fb_orgvar);
+			fb_var = fb_orgvar;
+		}
+		fbmode = FB_SHADOW;
+		return 0;
+	}
+	fbmode = FB_FLIP;
+	return (fbpagesize * 2 + extra) & ~extra;
+}
+
+/* add changed area to dirty rectangles*/
+static void
+fb_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height)
+{
+	add_update_rect(psd, &dirty, x, y, width, height);
+}
+
+/* called before select(), present areas drawn since last call*/
+static int
+fb_preselect(PSD psd)
+{
+	unsigned char *front;
+	int arg = 0;
+
+	if (!dirty.count)
+		return 0;
+
+	if (fbmode == FB_SHADOW) {
+		copy_framebuffer_rects(psd, dirty.rects, dirty.count, fbmem, psd->pitch,
+			psd->data_format);
+		dirty.count = 0;
+		return 0;
+	}
+
+	/* display page just drawn*/
+	fb_var.xoffset = 0;
+	fb_var.yoffset = backpage * psd->yres;
+	front = fbmem + (backpage ^ 1) * fbpagesize;
+	if (ioctl(fb, FBIOPAN_DISPLAY, &fb_var) == -1) {
+		EPRINTF("Error panning framebuffer, drawing directly: %m\n");
+		copy_framebuffer_rects(psd, dirty.rects, dirty.count, front, psd->pitch,
+			psd->data_format);
+		psd->addr = front;
+		psd->Update = NULL;
+		psd->PreSelect = NULL;
+		psd->flags &= ~PSF_DELAYUPDATE;
+		fbmode = FB_DIRECT;
+		dirty.count = 0;
+		return 0;
+	}
+
+	/* pan is latched at vertical blank, wait until old page is off screen*/
+	if (!novsync && ioctl(fb, FBIO_WAITFORVSYNC, &arg) == -1)
+		novsync = 1;
+
+	/* draw into page no longer displayed, bringing it up to date*/
+	backpage ^= 1;
+	copy_framebuffer_rects(psd, dirty.rects, dirty.count, front, psd->pitch,
+			psd->data_format);
+	psd->addr = front;
+	dirty.count = 0;
+	return 0;
+}
+#endif /* LINUX*/
+
 /* setup directcolor palette - required for ATI cards*/
 static void
 set_directcolor_palette(PSD psd)
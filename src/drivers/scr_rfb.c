@@ -0,0 +1,1267 @@
+/*
+ * Microwindows RFB (VNC) remote framebuffer server screen driver
+ * Set SCREEN=RFB in config, then connect any VNC viewer to port 5900
+ * or the port set in the RFB_PORT environment variable.
+ *
+ * There is no authentication, so by default only local viewers can
+ * connect. Set RFB_LISTEN to an address (0.0.0.0 for all interfaces)
+ * to allow remote viewers, on a trusted network only.
+ *
+ * Drawing is to an in-memory framebuffer. Update() records damaged
+ * rectangles, and PreSelect() hashes each damaged 64x64 tile, copying
+ * only tiles whose contents really changed into a snapshot shared with
+ * the network thread. The network thread answers client requests from
+ * the snapshot, sending changed tiles Raw or ZRLE encoded, and passes
+ * key and pointer events to the RFB keyboard and mouse drivers.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+#include "device.h"
+#include "genfont.h"
+#include "genmem.h"
+#include "fb.h"
+
+#if MWPIXEL_FORMAT == MWPF_PALETTE
+#error RFB screen driver requires a truecolor SCREEN_PIXTYPE
+#endif
+
+#define RFB_PORT	5900	/* default listen port*/
+#define RFB_TILE	64	/* hashed and ZRLE tile size*/
+#define RFB_MAXCLIENTS	4	/* simultaneous viewers*/
+#define RFB_ZLEVEL	1	/* ZRLE deflate level, favor speed*/
+#define RFB_TIMEOUT	10	/* seconds handshake or output may stall before drop*/
+#define RFB_FLUSHSIZE	(256*1024)	/* try sending when output buffer this full*/
+
+/* RFB encodings*/
+#define ENC_RAW		0
+#define ENC_ZRLE	16
+
+/* client handshake states*/
+#define RFB_VERSION	0	/* waiting for ProtocolVersion*/
+#define RFB_SECURITY	1	/* waiting for security type*/
+#define RFB_CLIENTINIT	2	/* waiting for ClientInit*/
+#define RFB_NORMAL	3	/* handshake done*/
+
+/* growable buffer*/
+typedef struct {
+	unsigned char *	data;
+	int		len;
+	int		size;
+} RFBBUF;
+
+/* per client connection state, sockets are non-blocking*/
+typedef struct {
+	int		fd;		/* socket, -1 if slot unused*/
+	int		state;		/* handshake state*/
+	int		minor;		/* client protocol minor version*/
+	time_t		deadline;	/* drop if handshake or output stalled past this*/
+	RFBBUF		in;		/* received, not yet processed*/
+	unsigned long	skip;		/* ClientCutText bytes still to discard*/
+	RFBBUF		out;		/* queued for sending*/
+	int		outpos;		/* bytes of out already sent*/
+	int		bytespp;	/* client bytes per pixel*/
+	int		bigendian;	/* client pixel byte order*/
+	int		cpixbytes;	/* ZRLE CPIXEL size*/
+	int		cpixshift;	/* shift of CPIXEL bytes within pixel*/
+	int		native;		/* client pixel values same as framebuffer*/
+	int		rawcopy;	/* client pixels same bytes as framebuffer*/
+	uint32_t	rtab[256];	/* framebuffer component to client pixel*/
+	uint32_t	gtab[256];
+	uint32_t	btab[256];
+	int		encoding;	/* ENC_RAW or ENC_ZRLE*/
+	int		wantupdate;	/* FramebufferUpdateRequest outstanding*/
+	MWRECT		request;	/* area requested*/
+	unsigned char *	dirty;		/* tiles changed since last sent*/
+	z_stream	zs;		/* ZRLE zlib stream lasts for connection*/
+	int		zsinit;
+} RFBCLIENT;
+
+static PSD  rfb_open(PSD psd);
+static void rfb_close(PSD psd);
+static void rfb_setpalette(PSD psd,int first,int count,MWPALENTRY *pal);
+static int  rfb_preselect(PSD psd);
+static void rfb_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height);
+int rfb_eventfd(int keyboard);
+
+SCREENDEVICE scrdev = {
+	0, 0, 0, 0, 0, 0, 0, NULL, 0, NULL, 0, 0, 0, 0, 0, 0,
+	gen_fonts,
+	rfb_open,
+	rfb_close,
+	rfb_setpalette,
+	gen_getscreeninfo,
+	gen_allocatememgc,
+	gen_mapmemgc,
+	gen_freememgc,
+	NULL,			/* portrait modes would resize remote desktop*/
+	rfb_update,
+	rfb_preselect
+};
+
+/* framebuffer layout, set at open*/
+static int fb_width, fb_height, fb_pitch, fb_bytespp;
+static int fb_depth, fb_bpp;
+static int fb_rmax, fb_gmax, fb_bmax;
+static int fb_rshift, fb_gshift, fb_bshift;
+static uint32_t fb_mask;
+
+/* main thread: damage and tile hashes*/
+static UPDATERECTS damage;
+static uint64_t *tilehash;
+static unsigned char *touched;
+static int tilesx, tilesy;
+
+/* shared with network thread, protected by rfb_mutex*/
+static pthread_mutex_t rfb_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char *remote;		/* framebuffer as of last PreSelect*/
+static RFBCLIENT clients[RFB_MAXCLIENTS];
+static int nclients;
+
+/* network thread*/
+static pthread_t rfb_thread;
+static int thread_running;
+static volatile int rfb_quit;
+static int listen_fd = -1;
+static int wake_fd[2] = { -1, -1 };	/* wakes network thread on new damage*/
+static int event_fd[2][2] = { { -1, -1 }, { -1, -1 } };	/* mouse and keyboard pipes*/
+static RFBBUF zrlebuf;
+static uint32_t *pixbuf;		/* converted tile or row*/
+
+static void *rfb_thread_main(void *arg);
+static void drop_client(RFBCLIENT *cl);
+
+/* load framebuffer pixel value*/
+static inline uint32_t
+load_pixel(const unsigned char *p)
+{
+	switch (fb_bytespp) {
+	case 4:
+		return *(const uint32_t *)p;
+	case 3:
+		return p[0] | (p[1] << 8) | (p[2] << 16);
+	case 2:
+		return *(const unsigned short *)p;
+	}
+	return *p;
+}
+
+static PSD
+rfb_open(PSD psd)
+{
+	struct sockaddr_in sin;
+	char *env;
+	int port = RFB_PORT;
+	int on = 1;
+	int i;
+
+	int flags = PSF_SCREEN | PSF_ADDRMALLOC | PSF_DELAYUPDATE;
+
+	for (i = 0; i < RFB_MAXCLIENTS; i++)
+		clients[i].fd = -1;
+	nclients = 0;
+
+	if (!gen_initpsd(psd, MWPIXEL_FORMAT, SCREEN_WIDTH, SCREEN_HEIGHT, flags))
+		return NULL;
+	memset(psd->addr, 0, psd->size);
+
+	fb_width = psd->xres;
+	fb_height = psd->yres;
+	fb_pitch = psd->pitch;
+	fb_bytespp = psd->bpp >> 3;
+	fb_bpp = (fb_bytespp == 3)? 32: psd->bpp;	/* 24bpp sent as 32bpp*/
+
+	/* describe framebuffer pixels as RFB truecolor format*/
+	switch (psd->pixtype) {
+	case MWPF_TRUECOLORARGB:
+	case MWPF_TRUECOLORRGB:
+		fb_depth = 24;
+		fb_rmax = fb_gmax = fb_bmax = 255;
+		fb_rshift = 16; fb_gshift = 8; fb_bshift = 0;
+		break;
+	case MWPF_TRUECOLORABGR:
+		fb_depth = 24;
+		fb_rmax = fb_gmax = fb_bmax = 255;
+		fb_rshift = 0; fb_gshift = 8; fb_bshift = 16;
+		break;
+	case MWPF_TRUECOLOR565:
+		fb_depth = 16;
+		fb_rmax = 31; fb_gmax = 63; fb_bmax = 31;
+		fb_rshift = 11; fb_gshift = 5; fb_bshift = 0;
+		break;
+	case MWPF_TRUECOLOR555:
+		fb_depth = 15;
+		fb_rmax = fb_gmax = fb_bmax = 31;
+		fb_rshift = 10; fb_gshift = 5; fb_bshift = 0;
+		break;
+	case MWPF_TRUECOLOR332:
+		fb_depth = 8;
+		fb_rmax = 7; fb_gmax = 7; fb_bmax = 3;
+		fb_rshift = 5; fb_gshift = 2; fb_bshift = 0;
+		break;
+	default:
+		EPRINTF("RFB: unsupported pixel format %d\n", psd->pixtype);
+		goto fail;
+	}
+	fb_mask = (fb_rmax << fb_rshift) | (fb_gmax << fb_gshift) | (fb_bmax << fb_bshift);
+
+	/* tile hashes start as hash of cleared framebuffer*/
+	tilesx = (fb_width + RFB_TILE - 1) / RFB_TILE;
+	tilesy = (fb_height + RFB_TILE - 1) / RFB_TILE;
+	tilehash = calloc(tilesx * tilesy, sizeof(uint64_t));
+	touched = calloc(tilesx * tilesy, 1);
+	remote = calloc(psd->size, 1);
+	pixbuf = malloc(MWMAX(fb_width, RFB_TILE * RFB_TILE) * sizeof(uint32_t));
+	if (!tilehash || !touched || !remote || !pixbuf)
+		goto fail;
+	damage.count = 0;
+	add_update_rect(psd, &damage, 0, 0, fb_width, fb_height);
+	rfb_preselect(psd);
+
+	if ((env = getenv("RFB_PORT")) != NULL)
+		port = atoi(env);
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0)
+		goto fail;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(port);
+	if ((env = getenv("RFB_LISTEN")) != NULL && inet_pton(AF_INET, env, &sin.sin_addr) != 1) {
+		EPRINTF("RFB: bad RFB_LISTEN address %s\n", env);
+		goto fail;
+	}
+	if (bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 || listen(listen_fd, 4) < 0) {
+		EPRINTF("RFB: can't listen on port %d: %m\n", port);
+		goto fail;
+	}
+
+	if (pipe(wake_fd) < 0)
+		goto fail;
+	fcntl(wake_fd[0], F_SETFL, O_NONBLOCK);
+	fcntl(wake_fd[1], F_SETFL, O_NONBLOCK);
+
+	rfb_quit = 0;
+	if (pthread_create(&rfb_thread, NULL, rfb_thread_main, NULL) != 0)
+		goto fail;
+	thread_running = 1;
+
+	DPRINTF("RFB: listening on %s port %d\n", inet_ntoa(sin.sin_addr), port);
+	return psd;	/* success*/
+
+fail:
+	rfb_close(psd);
+	return NULL;
+}
+
+static void
+rfb_close(PSD psd)
+{
+	int i;
+
+	if (thread_running) {
+		rfb_quit = 1;
+		if (write(wake_fd[1], "", 1) < 0)
+			EPRINTF("RFB: can't stop network thread\n");
+		pthread_join(rfb_thread, NULL);
+		thread_running = 0;
+	}
+	for (i = 0; i < RFB_MAXCLIENTS; i++)
+		if (clients[i].fd >= 0)
+			drop_client(&clients[i]);
+	nclients = 0;
+
+	if (listen_fd >= 0)
+		close(listen_fd);
+	listen_fd = -1;
+	for (i = 0; i < 2; i++) {
+		if (wake_fd[i] >= 0)
+			close(wake_fd[i]);
+		wake_fd[i] = -1;
+		if (event_fd[i][1] >= 0)
+			close(event_fd[i][1]);	/* input drivers see EOF*/
+		event_fd[i][1] = -1;
+	}
+
+	free(tilehash);
+	free(touched);
+	free(remote);
+	free(pixbuf);
+	free(zrlebuf.data);
+	tilehash = NULL;
+	touched = NULL;
+	remote = NULL;
+	pixbuf = NULL;
+	zrlebuf.data = NULL;
+	zrlebuf.len = zrlebuf.size = 0;
+
+	if ((psd->flags & PSF_ADDRMALLOC))
+		free(psd->addr);
+	psd->addr = NULL;
+}
+
+/* setup palette*/
+static void
+rfb_setpalette(PSD psd,int first,int count,MWPALENTRY *pal)
+{
+}
+
+/*
+ * 64 bit FNV-1a style hash of framebuffer tile, 8 bytes at a time.
+ * Multiply only carries differences upward, so xor-shift after each
+ * word to mix high bits back down before the next word.
+ */
+static uint64_t
+hash_tile(PSD psd, int x, int y, int w, int h)
+{
+	unsigned char *row = psd->addr + y * fb_pitch + x * fb_bytespp;
+	int rowbytes = w * fb_bytespp;
+	uint64_t hash = 14695981039346656037ULL;
+	uint64_t v;
+	int i;
+
+	for (; h > 0; h--) {
+		for (i = 0; i + 8 <= rowbytes; i += 8) {
+			memcpy(&v, row + i, 8);
+			hash = (hash ^ v) * 1099511628211ULL;
+			hash ^= hash >> 29;
+		}
+		for (; i < rowbytes; i++)
+			hash = (hash ^ row[i]) * 1099511628211ULL;
+		row += fb_pitch;
+	}
+	return hash;
+}
+
+/* called before select(), copies changed tiles to network thread snapshot*/
+static int
+rfb_preselect(PSD psd)
+{
+	MWRECT *rp;
+	int i, tx, ty, changed = 0;
+
+	if (!damage.count)
+		return 0;
+
+	for (i = 0, rp = damage.rects; i < damage.count; i++, rp++)
+		for (ty = rp->top / RFB_TILE; ty <= (rp->bottom - 1) / RFB_TILE; ty++)
+			for (tx = rp->left / RFB_TILE; tx <= (rp->right - 1) / RFB_TILE; tx++)
+				touched[ty * tilesx + tx] = 1;
+	damage.count = 0;
+
+	for (ty = 0; ty < tilesy; ty++) {
+		int y = ty * RFB_TILE;
+		int h = MWMIN(RFB_TILE, fb_height - y);
+
+		for (tx = 0; tx < tilesx; tx++) {
+			int t = ty * tilesx + tx;
+			int x = tx * RFB_TILE;
+			int w = MWMIN(RFB_TILE, fb_width - x);
+			uint64_t hash;
+			unsigned char *src, *dst;
+			int n;
+
+			if (!touched[t])
+				continue;
+			touched[t] = 0;
+
+			/* drawing that left tile unchanged isn't sent*/
+			hash = hash_tile(psd, x, y, w, h);
+			if (hash == tilehash[t])
+				continue;
+			tilehash[t] = hash;
+
+			src = psd->addr + y * fb_pitch + x * fb_bytespp;
+			dst = remote + y * fb_pitch + x * fb_bytespp;
+			pthread_mutex_lock(&rfb_mutex);
+			for (n = h; n > 0; n--) {
+				memcpy(dst, src, w * fb_bytespp);
+				src += fb_pitch;
+				dst += fb_pitch;
+			}
+			for (i = 0; i < RFB_MAXCLIENTS; i++)
+				if (clients[i].fd >= 0)
+					clients[i].dirty[t] = 1;
+			pthread_mutex_unlock(&rfb_mutex);
+			changed = 1;
+		}
+	}
+
+	if (changed && nclients && write(wake_fd[1], "", 1) < 0 && errno != EAGAIN)
+		EPRINTF("RFB: can't wake network thread\n");
+	return 0;
+}
+
+/* called from framebuffer drivers with updated framebuffer region*/
+static void
+rfb_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height)
+{
+	add_update_rect(psd, &damage, x, y, width, height);
+}
+
+/*
+ * Return read end of input event pipe for RFB mouse (0) or keyboard (1)
+ * driver. Created on first call as input drivers may open before screen.
+ */
+int
+rfb_eventfd(int keyboard)
+{
+	int *fds = event_fd[keyboard != 0];
+
+	if (fds[0] < 0) {
+		if (pipe(fds) < 0)
+			return -1;
+		fcntl(fds[0], F_SETFL, O_NONBLOCK);
+		fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	}
+	return fds[0];
+}
+
+/* pass input event record to mouse or keyboard driver*/
+static void
+post_event(int keyboard, const unsigned char *buf, int n)
+{
+	int fd = event_fd[keyboard][1];
+
+	if (fd >= 0 && write(fd, buf, n) != n)
+		DPRINTF("RFB: input event dropped\n");
+}
+
+/* reserve space at end of buffer, return NULL if out of memory*/
+static unsigned char *
+buf_reserve(RFBBUF *b, int n)
+{
+	if (b->len + n > b->size) {
+		int size = (b->len + n) * 2;
+		unsigned char *data = realloc(b->data, size);
+		if (!data)
+			return NULL;
+		b->data = data;
+		b->size = size;
+	}
+	return b->data + b->len;
+}
+
+static unsigned char *
+put16(unsigned char *p, int v)
+{
+	*p++ = v >> 8;
+	*p++ = v;
+	return p;
+}
+
+static unsigned char *
+put32(unsigned char *p, uint32_t v)
+{
+	*p++ = v >> 24;
+	*p++ = v >> 16;
+	*p++ = v >> 8;
+	*p++ = v;
+	return p;
+}
+
+/* store n bytes of pixel value in client byte order*/
+static inline unsigned char *
+put_pixel(unsigned char *p, uint32_t v, int n, int bigendian)
+{
+	if (bigendian) {
+		while (n > 0)
+			*p++ = v >> (--n * 8);
+	} else {
+		for (; n > 0; n--) {
+			*p++ = v;
+			v >>= 8;
+		}
+	}
+	return p;
+}
+
+/* RFB PIXEL_FORMAT of framebuffer*/
+static void
+get_pixelformat(unsigned char *pf)
+{
+	memset(pf, 0, 16);
+	pf[0] = fb_bpp;
+	pf[1] = fb_depth;
+#if MW_CPU_BIG_ENDIAN
+	pf[2] = 1;
+#endif
+	pf[3] = 1;			/* truecolor*/
+	put16(&pf[4], fb_rmax);
+	put16(&pf[6], fb_gmax);
+	put16(&pf[8], fb_bmax);
+	pf[10] = fb_rshift;
+	pf[11] = fb_gshift;
+	pf[12] = fb_bshift;
+}
+
+/* check client color component max and shift fit within pixel*/
+static int
+component_fits(int max, int shift, int bpp)
+{
+	return shift < bpp && ((uint64_t)max << shift) < ((uint64_t)1 << bpp);
+}
+
+/* set client pixel format and framebuffer to client conversion*/
+static int
+set_pixelformat(RFBCLIENT *cl, const unsigned char *pf)
+{
+	int bpp = pf[0];
+	int depth = pf[1];
+	int rmax = (pf[4] << 8) | pf[5];
+	int gmax = (pf[6] << 8) | pf[7];
+	int bmax = (pf[8] << 8) | pf[9];
+	int rshift = pf[10], gshift = pf[11], bshift = pf[12];
+	uint32_t mask;
+	int i;
+
+	if (!pf[3] || (bpp != 8 && bpp != 16 && bpp != 32)) {
+		EPRINTF("RFB: unsupported client pixel format, %d bpp truecolor %d\n", bpp, pf[3]);
+		return -1;
+	}
+	if (!component_fits(rmax, rshift, bpp) || !component_fits(gmax, gshift, bpp) ||
+	    !component_fits(bmax, bshift, bpp)) {
+		EPRINTF("RFB: bad client pixel format, color bits outside %d bpp\n", bpp);
+		return -1;
+	}
+	cl->bytespp = bpp >> 3;
+	cl->bigendian = pf[2];
+
+	for (i = 0; i < 256; i++) {
+		cl->rtab[i] = (uint32_t)((MWMIN(i, fb_rmax) * rmax + fb_rmax/2) / fb_rmax) << rshift;
+		cl->gtab[i] = (uint32_t)((MWMIN(i, fb_gmax) * gmax + fb_gmax/2) / fb_gmax) << gshift;
+		cl->btab[i] = (uint32_t)((MWMIN(i, fb_bmax) * bmax + fb_bmax/2) / fb_bmax) << bshift;
+	}
+	cl->native = (rmax == fb_rmax && gmax == fb_gmax && bmax == fb_bmax &&
+		rshift == fb_rshift && gshift == fb_gshift && bshift == fb_bshift);
+#if MW_CPU_BIG_ENDIAN
+	cl->rawcopy = cl->native && cl->bytespp == fb_bytespp && cl->bigendian;
+#else
+	cl->rawcopy = cl->native && cl->bytespp == fb_bytespp && !cl->bigendian;
+#endif
+
+	/* ZRLE CPIXEL drops unused byte of 32bpp pixels*/
+	cl->cpixbytes = cl->bytespp;
+	cl->cpixshift = 0;
+	mask = ((uint32_t)rmax << rshift) | ((uint32_t)gmax << gshift) | ((uint32_t)bmax << bshift);
+	if (bpp == 32 && depth <= 24) {
+		if (!(mask & 0xFF000000))
+			cl->cpixbytes = 3;
+		else if (!(mask & 0x000000FF)) {
+			cl->cpixbytes = 3;
+			cl->cpixshift = 8;
+		}
+	}
+	return 0;
+}
+
+/* convert snapshot area to client pixel values, called with rfb_mutex held*/
+static void
+get_pixels(RFBCLIENT *cl, int x, int y, int w, int h, uint32_t *dst)
+{
+	unsigned char *src = remote + y * fb_pitch + x * fb_bytespp;
+	int i;
+
+	for (; h > 0; h--) {
+		unsigned char *p = src;
+
+		if (cl->native) {
+			for (i = 0; i < w; i++, p += fb_bytespp)
+				*dst++ = load_pixel(p) & fb_mask;
+		} else {
+			for (i = 0; i < w; i++, p += fb_bytespp) {
+				uint32_t v = load_pixel(p);
+				*dst++ = cl->rtab[(v >> fb_rshift) & fb_rmax] |
+					 cl->gtab[(v >> fb_gshift) & fb_gmax] |
+					 cl->btab[(v >> fb_bshift) & fb_bmax];
+			}
+		}
+		src += fb_pitch;
+	}
+}
+
+/* find pixel in ZRLE palette hash, return slot*/
+static inline int
+pal_slot(const unsigned char *hash, const uint32_t *pal, uint32_t v)
+{
+	int slot = (uint32_t)(v * 2654435761U) >> 24;
+
+	while (hash[slot] && pal[hash[slot] - 1] != v)
+		slot = (slot + 1) & 255;
+	return slot;
+}
+
+static inline unsigned char *
+put_runlength(unsigned char *p, int len)
+{
+	for (len -= 1; len >= 255; len -= 255)
+		*p++ = 255;
+	*p++ = len;
+	return p;
+}
+
+/*
+ * Encode a ZRLE tile, choosing the smallest of solid, packed palette,
+ * plain RLE, palette RLE or raw subencodings.
+ */
+static int
+zrle_tile(RFBCLIENT *cl, const uint32_t *pix, int w, int h, RFBBUF *b)
+{
+	uint32_t pal[127];
+	unsigned char hash[256];	/* palette index + 1, by pixel hash*/
+	int n = w * h;
+	int cb = cl->cpixbytes;
+	int cs = cl->cpixshift;
+	int be = cl->bigendian;
+	int npal = 0, runs = 0, singles = 0;
+	int subenc, best, size, i, j;
+	unsigned char *p;
+
+	p = buf_reserve(b, 1 + 127 * 4 + n * 6);
+	if (!p)
+		return -1;
+
+	/* count runs and unique colors*/
+	memset(hash, 0, sizeof(hash));
+	for (i = 0; i < n; ) {
+		uint32_t v = pix[i];
+		int start = i;
+
+		while (++i < n && pix[i] == v)
+			continue;
+		runs++;
+		if (i - start == 1)
+			singles++;
+		if (npal < 128) {
+			int slot = pal_slot(hash, pal, v);
+			if (!hash[slot]) {
+				if (npal < 127) {
+					pal[npal++] = v;
+					hash[slot] = npal;
+				} else npal = 128;	/* too many for palette*/
+			}
+		}
+	}
+
+	if (npal == 1) {
+		*p++ = 1;
+		p = put_pixel(p, pal[0] >> cs, cb, be);
+		b->len = p - b->data;
+		return 0;
+	}
+
+	subenc = 0;
+	best = n * cb;
+	size = runs * (cb + 1);
+	if (size < best) {
+		subenc = 128;
+		best = size;
+	}
+	if (npal <= 127) {
+		size = npal * cb + 2 * runs - singles;
+		if (size < best) {
+			subenc = 128 + npal;
+			best = size;
+		}
+		if (npal <= 16) {
+			int bits = (npal <= 2)? 1: (npal <= 4)? 2: 4;
+			size = npal * cb + h * ((w * bits + 7) / 8);
+			if (size <= best)
+				subenc = npal;
+		}
+	}
+
+	*p++ = subenc;
+	if (subenc == 0) {
+		for (i = 0; i < n; i++)
+			p = put_pixel(p, pix[i] >> cs, cb, be);
+	} else if (subenc == 128) {
+		for (i = 0; i < n; ) {
+			uint32_t v = pix[i];
+			int start = i;
+
+			while (++i < n && pix[i] == v)
+				continue;
+			p = put_pixel(p, v >> cs, cb, be);
+			p = put_runlength(p, i - start);
+		}
+	} else {
+		for (i = 0; i < npal; i++)
+			p = put_pixel(p, pal[i] >> cs, cb, be);
+
+		if (subenc > 128) {
+			for (i = 0; i < n; ) {
+				uint32_t v = pix[i];
+				int start = i;
+				int index = hash[pal_slot(hash, pal, v)] - 1;
+
+				while (++i < n && pix[i] == v)
+					continue;
+				if (i - start == 1)
+					*p++ = index;
+				else {
+					*p++ = index | 128;
+					p = put_runlength(p, i - start);
+				}
+			}
+		} else {
+			/* packed palette, rows padded to byte*/
+			int bits = (npal <= 2)? 1: (npal <= 4)? 2: 4;
+
+			for (j = 0; j < h; j++) {
+				int byte = 0, shift = 8;
+
+				for (i = 0; i < w; i++) {
+					shift -= bits;
+					byte |= (hash[pal_slot(hash, pal, *pix++)] - 1) << shift;
+					if (shift == 0) {
+						*p++ = byte;
+						byte = 0;
+						shift = 8;
+					}
+				}
+				if (shift != 8)
+					*p++ = byte;
+			}
+		}
+	}
+	b->len = p - b->data;
+	return 0;
+}
+
+/* append ZRLE rectangle data to output buffer*/
+static int
+encode_zrle(RFBCLIENT *cl, const MWRECT *rc)
+{
+	int h = rc->bottom - rc->top;
+	int x, lenpos, zlen;
+	unsigned char *p;
+
+	zrlebuf.len = 0;
+	for (x = rc->left; x < rc->right; x += RFB_TILE) {
+		int w = MWMIN(RFB_TILE, rc->right - x);
+
+		pthread_mutex_lock(&rfb_mutex);
+		get_pixels(cl, x, rc->top, w, h, pixbuf);
+		pthread_mutex_unlock(&rfb_mutex);
+		if (zrle_tile(cl, pixbuf, w, h, &zrlebuf) < 0)
+			return -1;
+	}
+
+	if (!cl->zsinit) {
+		memset(&cl->zs, 0, sizeof(cl->zs));
+		if (deflateInit(&cl->zs, RFB_ZLEVEL) != Z_OK)
+			return -1;
+		cl->zsinit = 1;
+	}
+
+	/* zlib data follows 32 bit length*/
+	if (!buf_reserve(&cl->out, 4))
+		return -1;
+	lenpos = cl->out.len;
+	cl->out.len += 4;
+	cl->zs.next_in = zrlebuf.data;
+	cl->zs.avail_in = zrlebuf.len;
+	do {
+		int avail = zrlebuf.len / 2 + 1024;
+
+		if ((p = buf_reserve(&cl->out, avail)) == NULL)
+			return -1;
+		cl->zs.next_out = p;
+		cl->zs.avail_out = avail;
+		if (deflate(&cl->zs, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+			return -1;
+		cl->out.len += avail - cl->zs.avail_out;
+	} while (cl->zs.avail_out == 0);
+
+	zlen = cl->out.len - lenpos - 4;
+	put32(cl->out.data + lenpos, zlen);
+	return 0;
+}
+
+/* append Raw rectangle data to output buffer*/
+static int
+encode_raw(RFBCLIENT *cl, const MWRECT *rc)
+{
+	int w = rc->right - rc->left;
+	int rowbytes = w * cl->bytespp;
+	int y, i;
+	unsigned char *p;
+
+	for (y = rc->top; y < rc->bottom; y++) {
+		if ((p = buf_reserve(&cl->out, rowbytes)) == NULL)
+			return -1;
+		pthread_mutex_lock(&rfb_mutex);
+		if (cl->rawcopy)
+			memcpy(p, remote + y * fb_pitch + rc->left * fb_bytespp, rowbytes);
+		else get_pixels(cl, rc->left, y, w, 1, pixbuf);
+		pthread_mutex_unlock(&rfb_mutex);
+		if (!cl->rawcopy)
+			for (i = 0; i < w; i++)
+				p = put_pixel(p, pixbuf[i], cl->bytespp, cl->bigendian);
+		cl->out.len += rowbytes;
+	}
+	return 0;
+}
+
+/* append data to client output queue*/
+static int
+queue_output(RFBCLIENT *cl, const void *data, int len)
+{
+	unsigned char *p;
+
+	if ((p = buf_reserve(&cl->out, len)) == NULL)
+		return -1;
+	memcpy(p, data, len);
+	cl->out.len += len;
+	return 0;
+}
+
+/* send as much queued output as socket takes without blocking, return < 0 on error*/
+static int
+flush_client(RFBCLIENT *cl)
+{
+	int n;
+
+	while (cl->outpos < cl->out.len) {
+		n = send(cl->fd, cl->out.data + cl->outpos, cl->out.len - cl->outpos,
+			MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		cl->outpos += n;
+		cl->deadline = time(NULL) + RFB_TIMEOUT;
+	}
+	cl->out.len = cl->outpos = 0;
+	return 0;
+}
+
+/* queue changed tiles within requested area as one FramebufferUpdate*/
+static int
+send_update(RFBCLIENT *cl)
+{
+	static MWRECT *rects;
+	static int maxrects;
+	MWRECT *rp;
+	int count = 0, tx, ty, i;
+	int tx1 = cl->request.left / RFB_TILE;
+	int ty1 = cl->request.top / RFB_TILE;
+	int tx2 = (cl->request.right - 1) / RFB_TILE;
+	int ty2 = (cl->request.bottom - 1) / RFB_TILE;
+	unsigned char *p;
+
+	if (maxrects < tilesx * tilesy) {
+		free(rects);
+		maxrects = tilesx * tilesy;
+		if ((rects = malloc(maxrects * sizeof(MWRECT))) == NULL) {
+			maxrects = 0;
+			return -1;
+		}
+	}
+
+	/* gather runs of dirty tiles into rectangles*/
+	pthread_mutex_lock(&rfb_mutex);
+	for (ty = ty1; ty <= ty2; ty++) {
+		unsigned char *dirty = cl->dirty + ty * tilesx;
+
+		for (tx = tx1; tx <= tx2; tx++) {
+			if (!dirty[tx])
+				continue;
+			rp = &rects[count++];
+			rp->left = tx * RFB_TILE;
+			rp->top = ty * RFB_TILE;
+			rp->bottom = MWMIN(rp->top + RFB_TILE, fb_height);
+			while (tx <= tx2 && dirty[tx])
+				dirty[tx++] = 0;
+			rp->right = MWMIN(tx * RFB_TILE, fb_width);
+		}
+	}
+	pthread_mutex_unlock(&rfb_mutex);
+
+	if (count == 0)
+		return 0;		/* request stays outstanding until damage*/
+	cl->wantupdate = 0;
+	cl->deadline = time(NULL) + RFB_TIMEOUT;
+
+	if ((p = buf_reserve(&cl->out, 4)) == NULL)
+		return -1;
+	*p++ = 0;			/* FramebufferUpdate*/
+	*p++ = 0;
+	put16(p, count);
+	cl->out.len += 4;
+
+	for (i = 0, rp = rects; i < count; i++, rp++) {
+		if ((p = buf_reserve(&cl->out, 12)) == NULL)
+			return -1;
+		p = put16(p, rp->left);
+		p = put16(p, rp->top);
+		p = put16(p, rp->right - rp->left);
+		p = put16(p, rp->bottom - rp->top);
+		put32(p, cl->encoding);
+		cl->out.len += 12;
+
+		if (cl->encoding == ENC_ZRLE) {
+			if (encode_zrle(cl, rp) < 0)
+				return -1;
+		} else if (encode_raw(cl, rp) < 0)
+			return -1;
+
+		/* start sending large updates while encoding the rest*/
+		if (cl->out.len - cl->outpos >= RFB_FLUSHSIZE && flush_client(cl) < 0)
+			return -1;
+	}
+	return flush_client(cl);
+}
+
+/* mark tiles within area dirty for full update*/
+static void
+mark_dirty(RFBCLIENT *cl, const MWRECT *rc)
+{
+	int tx, ty;
+
+	pthread_mutex_lock(&rfb_mutex);
+	for (ty = rc->top / RFB_TILE; ty <= (rc->bottom - 1) / RFB_TILE; ty++)
+		for (tx = rc->left / RFB_TILE; tx <= (rc->right - 1) / RFB_TILE; tx++)
+			cl->dirty[ty * tilesx + tx] = 1;
+	pthread_mutex_unlock(&rfb_mutex);
+}
+
+static void
+drop_client(RFBCLIENT *cl)
+{
+	DPRINTF("RFB: client disconnected\n");
+	pthread_mutex_lock(&rfb_mutex);
+	close(cl->fd);
+	cl->fd = -1;
+	nclients--;
+	pthread_mutex_unlock(&rfb_mutex);
+	if (cl->zsinit)
+		deflateEnd(&cl->zs);
+	cl->zsinit = 0;
+	free(cl->dirty);
+	free(cl->in.data);
+	free(cl->out.data);
+	cl->dirty = NULL;
+	cl->in.data = cl->out.data = NULL;
+	cl->in.len = cl->in.size = cl->out.len = cl->out.size = 0;
+}
+
+static void
+accept_client(void)
+{
+	RFBCLIENT *cl = NULL;
+	unsigned char *dirty;
+	int on = 1;
+	int fd, i;
+
+	if ((fd = accept(listen_fd, NULL, NULL)) < 0)
+		return;
+	for (i = 0; i < RFB_MAXCLIENTS; i++)
+		if (clients[i].fd < 0) {
+			cl = &clients[i];
+			break;
+		}
+	if (!cl) {
+		EPRINTF("RFB: too many clients\n");
+		close(fd);
+		return;
+	}
+	if ((dirty = malloc(tilesx * tilesy)) == NULL) {
+		close(fd);
+		return;
+	}
+
+	/* stalled client mustn't hang network thread*/
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	cl->state = RFB_VERSION;
+	cl->deadline = time(NULL) + RFB_TIMEOUT;
+	cl->skip = 0;
+	cl->outpos = 0;
+	cl->encoding = ENC_RAW;
+	cl->wantupdate = 0;
+	cl->zsinit = 0;
+	if (queue_output(cl, "RFB 003.008\n", 12) < 0) {
+		free(dirty);
+		close(fd);
+		return;
+	}
+
+	/* new client starts with every tile dirty*/
+	memset(dirty, 1, tilesx * tilesy);
+	pthread_mutex_lock(&rfb_mutex);
+	cl->dirty = dirty;
+	cl->fd = fd;
+	nclients++;
+	pthread_mutex_unlock(&rfb_mutex);
+	DPRINTF("RFB: client connected\n");
+}
+
+/* queue ServerInit and use server pixel format until client sets one*/
+static int
+server_init(RFBCLIENT *cl)
+{
+	static const char name[] = "Microwindows";
+	unsigned char buf[24 + sizeof(name)];
+
+	put16(&buf[0], fb_width);
+	put16(&buf[2], fb_height);
+	get_pixelformat(&buf[4]);
+	put32(&buf[20], sizeof(name) - 1);
+	memcpy(&buf[24], name, sizeof(name) - 1);
+	if (queue_output(cl, buf, 24 + sizeof(name) - 1) < 0)
+		return -1;
+
+	get_pixelformat(buf);
+	return set_pixelformat(cl, buf);
+}
+
+/*
+ * Process one handshake or client message from buffered input.
+ * Return bytes used, 0 if message incomplete, < 0 to drop client.
+ */
+static int
+client_message(RFBCLIENT *cl, unsigned char *buf, int len)
+{
+	unsigned char ev[6];
+	uint32_t key;
+	int i, n;
+
+	switch (cl->state) {
+	case RFB_VERSION:
+		if (len < 12)
+			return 0;
+		if (memcmp(buf, "RFB 003.", 8) != 0 || buf[11] != '\n' ||
+		    sscanf((char *)&buf[8], "%3d", &cl->minor) != 1)
+			return -1;
+
+		/* security type None*/
+		if (cl->minor >= 7) {
+			if (queue_output(cl, "\001\001", 2) < 0)
+				return -1;
+			cl->state = RFB_SECURITY;
+		} else {
+			put32(ev, 1);
+			if (queue_output(cl, ev, 4) < 0)
+				return -1;
+			cl->state = RFB_CLIENTINIT;
+		}
+		return 12;
+
+	case RFB_SECURITY:
+		if (buf[0] != 1)
+			return -1;
+		if (cl->minor >= 8) {
+			put32(ev, 0);		/* SecurityResult OK*/
+			if (queue_output(cl, ev, 4) < 0)
+				return -1;
+		}
+		cl->state = RFB_CLIENTINIT;
+		return 1;
+
+	case RFB_CLIENTINIT:
+		/* ClientInit shared flag ignored, all clients share*/
+		if (server_init(cl) < 0)
+			return -1;
+		cl->state = RFB_NORMAL;
+		return 1;
+	}
+
+	switch (buf[0]) {
+	case 0:				/* SetPixelFormat*/
+		if (len < 20)
+			return 0;
+		if (set_pixelformat(cl, &buf[4]) < 0)
+			return -1;
+		return 20;
+
+	case 2:				/* SetEncodings, use first we support*/
+		if (len < 4)
+			return 0;
+		n = (buf[2] << 8) | buf[3];
+		if (len < 4 + 4 * n)
+			return 0;
+		cl->encoding = ENC_RAW;
+		for (i = 0; i < n; i++) {
+			unsigned char *enc = &buf[4 + 4 * i];
+
+			if (enc[0] == 0 && enc[1] == 0 && enc[2] == 0 && enc[3] == ENC_ZRLE) {
+				cl->encoding = ENC_ZRLE;
+				break;
+			}
+			if (enc[0] == 0 && enc[1] == 0 && enc[2] == 0 && enc[3] == ENC_RAW)
+				break;
+		}
+		return 4 + 4 * n;
+
+	case 3:				/* FramebufferUpdateRequest*/
+		if (len < 10)
+			return 0;
+		cl->request.left = (buf[2] << 8) | buf[3];
+		cl->request.top = (buf[4] << 8) | buf[5];
+		cl->request.right = MWMIN(cl->request.left + ((buf[6] << 8) | buf[7]), fb_width);
+		cl->request.bottom = MWMIN(cl->request.top + ((buf[8] << 8) | buf[9]), fb_height);
+		if (cl->request.left >= cl->request.right || cl->request.top >= cl->request.bottom)
+			return 10;
+		if (!buf[1])
+			mark_dirty(cl, &cl->request);
+		cl->wantupdate = 1;
+		return 10;
+
+	case 4:				/* KeyEvent*/
+		if (len < 8)
+			return 0;
+		/* kbd_rfb record: 0xF5, down, keysym (little endian long)*/
+		key = ((uint32_t)buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+		ev[0] = 0xF5;
+		ev[1] = buf[1];
+		ev[2] = key;
+		ev[3] = key >> 8;
+		ev[4] = key >> 16;
+		ev[5] = key >> 24;
+		post_event(1, ev, 6);
+		return 8;
+
+	case 5:				/* PointerEvent*/
+		if (len < 6)
+			return 0;
+		/* mou_rfb record: 0xF4, RFB button mask, x, y (little endian short)*/
+		ev[0] = 0xF4;
+		ev[1] = buf[1];
+		ev[2] = buf[3];
+		ev[3] = buf[2];
+		ev[4] = buf[5];
+		ev[5] = buf[4];
+		post_event(0, ev, 6);
+		return 6;
+
+	case 6:				/* ClientCutText, discarded*/
+		if (len < 8)
+			return 0;
+		cl->skip = ((unsigned long)buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+		return 8;
+	}
+
+	EPRINTF("RFB: unknown client message %d\n", buf[0]);
+	return -1;
+}
+
+/* read available client input and process complete messages, return < 0 to drop client*/
+static int
+read_client(RFBCLIENT *cl)
+{
+	unsigned char *p;
+	int n, pos;
+
+	if ((p = buf_reserve(&cl->in, 4096)) == NULL)
+		return -1;
+	n = recv(cl->fd, p, cl->in.size - cl->in.len, MSG_DONTWAIT);
+	if (n == 0)
+		return -1;		/* closed*/
+	if (n < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)? 0: -1;
+	cl->in.len += n;
+
+	for (pos = 0; pos < cl->in.len; pos += n) {
+		if (cl->skip) {
+			n = (int)MWMIN(cl->skip, (unsigned long)(cl->in.len - pos));
+			cl->skip -= n;
+			continue;
+		}
+		if ((n = client_message(cl, cl->in.data + pos, cl->in.len - pos)) < 0)
+			return -1;
+		if (n == 0)
+			break;
+	}
+	cl->in.len -= pos;
+	memmove(cl->in.data, cl->in.data + pos, cl->in.len);
+	return 0;
+}
+
+static void *
+rfb_thread_main(void *arg)
+{
+	struct pollfd pfd[2 + RFB_MAXCLIENTS];
+	RFBCLIENT *cl;
+	char drain[64];
+	int i, n, timeout;
+
+	while (!rfb_quit) {
+		pfd[0].fd = listen_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = wake_fd[0];
+		pfd[1].events = POLLIN;
+		timeout = -1;
+		for (i = 0, cl = clients; i < RFB_MAXCLIENTS; i++, cl++) {
+			pfd[2+i].fd = cl->fd;	/* ignored when -1*/
+			pfd[2+i].events = POLLIN;
+			if (cl->fd < 0)
+				continue;
+			if (cl->outpos < cl->out.len)
+				pfd[2+i].events |= POLLOUT;
+			if (cl->state != RFB_NORMAL || cl->outpos < cl->out.len)
+				timeout = 1000;	/* check deadline*/
+		}
+		n = poll(pfd, 2 + RFB_MAXCLIENTS, timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			EPRINTF("RFB: poll failed: %m\n");
+			break;
+		}
+
+		if (pfd[1].revents & POLLIN)
+			while (read(wake_fd[0], drain, sizeof(drain)) > 0)
+				continue;
+		if (rfb_quit)
+			break;
+		if (pfd[0].revents & POLLIN)
+			accept_client();
+
+		for (i = 0, cl = clients; i < RFB_MAXCLIENTS; i++, cl++) {
+			if (cl->fd < 0 || pfd[2+i].fd != cl->fd)
+				continue;
+			if ((pfd[2+i].revents & (POLLIN|POLLHUP|POLLERR)) && read_client(cl) < 0) {
+				drop_client(cl);
+				continue;
+			}
+			if (cl->outpos < cl->out.len && flush_client(cl) < 0) {
+				drop_client(cl);
+				continue;
+			}
+
+			/* only start next update once previous one is sent*/
+			if (cl->state == RFB_NORMAL && cl->wantupdate && cl->out.len == 0 &&
+			    send_update(cl) < 0) {
+				drop_client(cl);
+				continue;
+			}
+			if ((cl->state != RFB_NORMAL || cl->outpos < cl->out.len) &&
+			    time(NULL) > cl->deadline) {
+				EPRINTF("RFB: client timed out\n");
+				drop_client(cl);
+			}
+		}
+	}
+	return NULL;
+}
@@ -41,7 +41,7 @@ SCREENDEVICE	scrdev = {
 	sdl_pollevents
 };
 
-static MWCOORD upminX, upminY, upmaxX, upmaxY;	/* sdl_preselect and sdl_update*/
+static UPDATERECTS sdl_updates;		/* sdl_preselect and sdl_update*/
 
 static SDL_Window *sdlWindow;
 static SDL_Renderer *sdlRenderer;
@@ -211,31 +211,60 @@ sdl_setpalette(PSD psd,int first,int count,MWPALENTRY *pal)
 
 /* update SDL from Microwindows framebuffer*/
 static void
-sdl_draw(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height)
+sdl_draw(PSD psd, const MWRECT *rects, int count)
 {
-//printf("draw %d,%d %d,%d\n", x, y, width, height);
+	SDL_Rect r[MAX_UPDATE_RECTS];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		r[i].x = rects[i].left;
+		r[i].y = rects[i].top;
+		r[i].w = rects[i].right - rects[i].left;
+		r[i].h = rects[i].bottom - rects[i].top;
+	}
 #if USE_SURFACE
+	{
+	MWIMGDATFMT format;
+
 	/* tell SDL we're going to write to window surface*/
 	if (SDL_MUSTLOCK(screen))
 		SDL_LockSurface(screen);
 
-	/* copy from Microwindows framebuffer to SDL*/
-	copy_framebuffer(psd, x, y, width, height, screen->pixels, screen->pitch);
+	/* copy from Microwindows framebuffer to SDL, converting if surface format differs*/
+	switch (screen->format->format) {
+	case SDL_PIXELFORMAT_ARGB8888:
+	case SDL_PIXELFORMAT_RGB888:
+		format = MWIF_BGRA8888;
+		break;
+	case SDL_PIXELFORMAT_ABGR8888:
+	case SDL_PIXELFORMAT_BGR888:
+		format = MWIF_RGBA8888;
+		break;
+	case SDL_PIXELFORMAT_BGR24:
+		format = MWIF_BGR888;
+		break;
+	case SDL_PIXELFORMAT_RGB565:
+		format = MWIF_RGB565;
+		break;
+	default:
+		format = psd->data_format;
+		break;
+	}
+	if (!copy_framebuffer_rects(psd, rects, count, screen->pixels, screen->pitch, format))
+		copy_framebuffer_rects(psd, rects, count, screen->pixels, screen->pitch,
+			psd->data_format);
 
 	/* flush buffer*/
 	if (SDL_MUSTLOCK(screen))
 		SDL_UnlockSurface(screen);
-	SDL_UpdateWindowSurface(sdlWindow);
+	SDL_UpdateWindowSurfaceRects(sdlWindow, r, count);
+	}
 #else
-	/* set region to update*/
-	SDL_Rect r;
-	r.x = x;
-	r.y = y;
-	r.w = width;
-	r.h = height;
-
-	unsigned char *pixels = psd->addr + y * psd->pitch + x * (psd->bpp >> 3);
-	SDL_UpdateTexture(sdlTexture, &r, pixels, psd->pitch);
+	/* update texture from each rectangle*/
+	for (i = 0; i < count; i++) {
+		unsigned char *pixels = psd->addr + r[i].y * psd->pitch + r[i].x * (psd->bpp >> 3);
+		SDL_UpdateTexture(sdlTexture, &r[i], pixels, psd->pitch);
+	}
 
 	/* copy texture to display*/
 	//SDL_SetRenderDrawColor(sdlRenderer, 0x00, 0x00, 0x00, 0x00);
@@ -249,14 +278,10 @@ sdl_draw(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height)
 static int
 sdl_preselect(PSD psd)
 {
-	/* perform single blit update of aggregate update region to SDL server*/
-	if ((psd->flags & PSF_DELAYUPDATE) && (upmaxX >= 0 || upmaxY >= 0)) {
-//printf("preselect %d,%d,%d,%d\n", upminX, upminY, upmaxX-upminX+1, upmaxY-upminY+1);
-		sdl_draw(psd, upminX, upminY, upmaxX-upminX+1, upmaxY-upminY+1);
-
-		/* reset update region*/
-		upminX = upminY = MAX_MWCOORD;
-		upmaxX = upmaxY = MIN_MWCOORD;
+	/* copy updated rectangles to SDL*/
+	if ((psd->flags & PSF_DELAYUPDATE) && sdl_updates.count) {
+		sdl_draw(psd, sdl_updates.rects, sdl_updates.count);
+		sdl_updates.count = 0;
 	}
 
 	/* return nonzero if SDL event available*/
@@ -267,13 +292,14 @@ static void
 sdl_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height)
 {
 	/* window moves require delaying updates until preselect for speed*/
-	if ((psd->flags & PSF_DELAYUPDATE)) {
-//printf("update %d,%d %d,%d\n", x, y, width, height);
-			/* calc aggregate update rectangle*/
-			upminX = MWMIN(x, upminX);
-			upminY = MWMIN(y, upminY);
-			upmaxX = MWMAX(upmaxX, x+width-1);
-			upmaxY = MWMAX(upmaxY, y+height-1);
-	} else
-		sdl_draw(psd, x, y, width, height);
+	if ((psd->flags & PSF_DELAYUPDATE))
+		add_update_rect(psd, &sdl_updates, x, y, width, height);
+	else {
+		UPDATERECTS up;
+
+		up.count = 0;
+		add_update_rect(psd, &up, x, y, width, height);
+		if (up.count)
+			sdl_draw(psd, up.rects, up.count);
+	}
 }
@@ -81,7 +81,10 @@ static int x11_colormap_installed = 0;
 static XColor x11_palette[256];
 static int x11_pal_max = 0;
 
-static MWCOORD upminX, upminY, upmaxX, upmaxY;
+static UPDATERECTS x11_updates;	/* areas to copy in X11_preselect*/
+static XImage *x11_img;			/* window sized image updated from framebuffer*/
+static MWIMGDATFMT x11_img_format;	/* x11_img format if converted by copy_framebuffer_rects*/
+
 /* called from mou_x11.c*/
 void x11_handle_event(XEvent * ev);
 int x11_setup_display(void);
@@ -587,6 +590,11 @@ X11_close(PSD psd)
 	/* free framebuffer memory */
 	free(psd->addr);
 
+	if (x11_img) {
+		XDestroyImage(x11_img);
+		x11_img = NULL;
+	}
+
 	XCloseDisplay(x11_dpy);
 }
 
@@ -627,23 +635,43 @@ X11_setpalette(PSD psd, int first, int count, MWPALENTRY * pal)
 		x11_pal_max = n;
 }
 
-static void
-update_from_savebits(PSD psd, unsigned int destx, unsigned int desty, int w, int h)
+/*
+ * Create window sized image that updated areas are converted into,
+ * and find whether its pixel format is handled by copy_framebuffer_rects.
+ */
+static XImage *
+create_update_image(PSD psd)
 {
 	XImage *img;
-	unsigned int x, y;
-	char *data;
 
-	/* allocate buffer */
-	if (x11_depth >= 24)
-		data = malloc(w * 4 * h);
-	else if (x11_depth > 8)	/* 15, 16 */
-		data = malloc(w * 2 * h);
-	else			/* 1,2,4,8 */
-		data = malloc((w * x11_depth + 7) / 8 * h);
+	img = XCreateImage(x11_dpy, x11_vis, x11_depth, ZPixmap, 0, NULL, psd->xres, psd->yres, 32, 0);
+	if (!img)
+		return NULL;
+	if ((img->data = malloc(img->bytes_per_line * img->height)) == NULL) {
+		XDestroyImage(img);
+		return NULL;
+	}
 
-	/* copy from offscreen to screen */
-	img = XCreateImage(x11_dpy, x11_vis, x11_depth, ZPixmap, 0, data, w, h, 8, 0);
+	x11_img_format = 0;
+	if (!x11_is_palette && img->byte_order == LSBFirst) {
+		if (img->bits_per_pixel == 32 && x11_r_mask == 0xff0000 && x11_g_mask == 0xff00 &&
+		    x11_b_mask == 0xff)
+			x11_img_format = MWIF_BGRA8888;
+		else if (img->bits_per_pixel == 32 && x11_r_mask == 0xff && x11_g_mask == 0xff00 &&
+		    x11_b_mask == 0xff0000)
+			x11_img_format = MWIF_RGBA8888;
+		else if (img->bits_per_pixel == 16 && x11_r_mask == 0xf800 && x11_g_mask == 0x07e0 &&
+		    x11_b_mask == 0x001f)
+			x11_img_format = MWIF_RGB565;
+	}
+	return img;
+}
+
+/* convert framebuffer area into image one pixel at a time*/
+static void
+convert_by_pixel(PSD psd, XImage *img, unsigned int destx, unsigned int desty, int w, int h)
+{
+	unsigned int x, y;
 
 	/* Use optimized loops for most common framebuffer modes */
 
@@ -654,7 +682,7 @@ update_from_savebits(PSD psd, unsigned int destx, unsigned int desty, int w, int
 			for (x = 0; x < w; x++) {
 				MWPIXELVAL c = addr[x];
 				unsigned long pixel = PIXELVAL_to_pixel(c);
-				XPutPixel(img, x, y, pixel);
+				XPutPixel(img, destx + x, desty + y, pixel);
 			}
 			addr += psd->pitch;
 		}
@@ -666,7 +694,7 @@ update_from_savebits(PSD psd, unsigned int destx, unsigned int desty, int w, int
 			for (x = 0; x < w; x++) {
 				MWPIXELVAL c = ((ADDR16)addr)[x];
 				unsigned long pixel = PIXELVAL_to_pixel(c);
-				XPutPixel(img, x, y, pixel);
+				XPutPixel(img, destx + x, desty + y, pixel);
 			}
 			addr += psd->pitch;
 		}
@@ -679,7 +707,7 @@ update_from_savebits(PSD psd, unsigned int destx, unsigned int desty, int w, int
 			for (x = 0; x < w; x++) {
 				MWPIXELVAL c = RGB2PIXEL888(addr[2], addr[1], addr[0]);
 				unsigned long pixel = PIXELVAL_to_pixel(c);
-				XPutPixel(img, x, y, pixel);
+				XPutPixel(img, destx + x, desty + y, pixel);
 				addr += 3;
 			}
 			addr += extra;
@@ -692,7 +720,7 @@ update_from_savebits(PSD psd, unsigned int destx, unsigned int desty, int w, int
 			for (x = 0; x < w; x++) {
 				MWPIXELVAL c = ((ADDR32)addr)[x];
 				unsigned long pixel = PIXELVAL_to_pixel(c);
-				XPutPixel(img, x, y, pixel);
+				XPutPixel(img, destx + x, desty + y, pixel);
 			}
 			addr += psd->pitch;
 		}
@@ -704,28 +732,46 @@ update_from_savebits(PSD psd, unsigned int destx, unsigned int desty, int w, int
 			for (x = 0; x < w; x++) {
 				MWPIXELVAL c = addr[x];
 				unsigned long pixel = PIXELVAL_to_pixel(c);
-				XPutPixel(img, x, y, pixel);
+				XPutPixel(img, destx + x, desty + y, pixel);
 			}
 			addr += psd->pitch;
 		}
 	}
 #endif
 
-	XPutImage(x11_dpy, x11_win, x11_gc, img, 0, 0, destx, desty, w, h);
-	XDestroyImage(img);
+}
+
+/* copy updated rectangles from framebuffer to X11 window*/
+static void
+update_from_savebits(PSD psd, const MWRECT *rects, int count)
+{
+	int i;
+
+	if (!x11_img && (x11_img = create_update_image(psd)) == NULL)
+		return;
+
+	/* convert whole rows at once when X11 uses a framebuffer pixel format*/
+	if (!x11_img_format || !copy_framebuffer_rects(psd, rects, count,
+	    (unsigned char *)x11_img->data, x11_img->bytes_per_line, x11_img_format)) {
+		for (i = 0; i < count; i++)
+			convert_by_pixel(psd, x11_img, rects[i].left, rects[i].top,
+				rects[i].right - rects[i].left, rects[i].bottom - rects[i].top);
+	}
+
+	for (i = 0; i < count; i++)
+		XPutImage(x11_dpy, x11_win, x11_gc, x11_img, rects[i].left, rects[i].top,
+			rects[i].left, rects[i].top, rects[i].right - rects[i].left,
+			rects[i].bottom - rects[i].top);
 }
 
 /* called before select(), returns # pending events*/
 static int
 X11_preselect(PSD psd)
 {
-	/* perform single blit update of aggregate update region to X11 server*/
-	if ((psd->flags & PSF_DELAYUPDATE) && (upmaxX >= 0 || upmaxY >= 0)) {
-		update_from_savebits(psd, upminX, upminY, upmaxX-upminX+1, upmaxY-upminY+1);
-
-		/* reset update region*/
-		upminX = upminY = MAX_MWCOORD;
-		upmaxX = upmaxY = MIN_MWCOORD;
+	/* copy updated rectangles to X11 server*/
+	if ((psd->flags & PSF_DELAYUPDATE) && x11_updates.count) {
+		update_from_savebits(psd, x11_updates.rects, x11_updates.count);
+		x11_updates.count = 0;
 	}
 
 	XFlush(x11_dpy);
@@ -736,12 +782,14 @@ static void
 X11_update(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height)
 {
 	/* window moves require delaying updates until preselect for speed*/
-	if ((psd->flags & PSF_DELAYUPDATE)) {
-			/* calc aggregate update rectangle*/
-			upminX = MWMIN(x, upminX);
-			upminY = MWMIN(y, upminY);
-			upmaxX = MWMAX(upmaxX, x+width-1);
-			upmaxY = MWMAX(upmaxY, y+height-1);
-	} else
-		update_from_savebits(psd, x, y, width, height);
+	if ((psd->flags & PSF_DELAYUPDATE))
+		add_update_rect(psd, &x11_updates, x, y, width, height);
+	else {
+		UPDATERECTS up;
+
+		up.count = 0;
+		add_update_rect(psd, &up, x, y, width, height);
+		if (up.count)
+			update_from_savebits(psd, up.rects, up.count);
+	}
 }
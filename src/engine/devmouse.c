@@ -15,6 +15,7 @@
  */
 #include <string.h>
 #include "device.h"
+#include "osdep.h"
 
 /*
  * The following define specifies whether returned mouse
@@ -37,6 +38,7 @@ static int	scale;		/* acceleration scale factor */
 static int	thresh;		/* acceleration threshhold */
 static int	buttons;	/* current state of buttons */
 static MWBOOL	changed;	/* mouse state has changed */
+static MWTIMEOUT mousetime;	/* driver time of last mouse data, 0 if none */
 
 static MWCOORD 	curminx;	/* minimum x value of cursor */
 static MWCOORD 	curminy;	/* minimum y value of cursor */
@@ -232,6 +234,9 @@ GdReadMouse(MWCOORD *px, MWCOORD *py, int *pb)
 	*py = ypos;
 	*pb = buttons;
 
+	/* no driver time unless this read gets data*/
+	mousetime = 0;
+
 	if (changed)
 	{
 		changed = FALSE;
@@ -308,6 +313,32 @@ GdReadMouse(MWCOORD *px, MWCOORD *py, int *pb)
 	return 1;
 }
 
+/**
+ * Set the time the data returned from the mouse driver Read was
+ * generated, for drivers that timestamp input.  Called from Read.
+ *
+ * @param time Tick count the data was generated, as GdGetTickCount().
+ */
+void
+GdSetMouseTime(MWTIMEOUT time)
+{
+	mousetime = time;
+}
+
+/**
+ * Return the time the mouse data being delivered was generated, or the
+ * current tick count if the driver doesn't timestamp its data or the
+ * event didn't come from the driver.  Cleared by the caller of
+ * GdReadMouse with GdSetMouseTime(0) once the data is delivered.
+ *
+ * @return Tick count of the current mouse data.
+ */
+MWTIMEOUT
+GdGetMouseTime(void)
+{
+	return mousetime? mousetime: GdGetTickCount();
+}
+
 /**
  * Set the cursor position.
  *
@@ -629,7 +660,7 @@ filter_relrotate(int state, int *xpos, int *ypos, int x, int y)
 	if (state == 3)
 		return 0;
 
-	switch (scrdev.portrait) {
+	switch (GdGetPortraitMode(&scrdev)) {
 	case MWPORTRAIT_RIGHT:
 		*xpos += y;
 		*ypos -= x;
@@ -662,20 +693,20 @@ filter_absrotate(int state, int *xpos, int *ypos)
 	if (state == 3)
 		return 0;
 
-	switch (scrdev.portrait) {
+	switch (GdGetPortraitMode(&scrdev)) {
 	case MWPORTRAIT_RIGHT:
 		*xpos = y;
-		*ypos = scrdev.xres - x - 1;
+		*ypos = scrdev.yvirtres - x - 1;
 		break;
 
 	case MWPORTRAIT_LEFT:
-		*xpos = scrdev.yres - y - 1;
+		*xpos = scrdev.xvirtres - y - 1;
 		*ypos = x;
 		break;
 
 	case MWPORTRAIT_DOWN:
-		*xpos = scrdev.xres - x - 1;
-		*ypos = scrdev.yres - y - 1;
+		*xpos = scrdev.xvirtres - x - 1;
+		*ypos = scrdev.yvirtres - y - 1;
 		break;
 
 	default:
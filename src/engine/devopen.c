@@ -191,7 +191,39 @@ GdSetPortraitMode(PSD psd, int portraitmode)
 	/* set portrait mode if supported*/
 	if (psd->SetPortrait)
 		psd->SetPortrait(psd, portraitmode);
-	return psd->portrait;
+	return GdGetPortraitMode(psd);
+}
+
+/**
+ * Get current screen portrait mode.
+ *
+ * @param psd Screen drawing surface.
+ * @return Portrait mode, whether drawn rotated or rotated from upright shadow.
+ */
+int
+GdGetPortraitMode(PSD psd)
+{
+	return psd->shadowportrait? psd->shadowportrait: psd->portrait;
+}
+
+/**
+ * Get unrotated hardware screen size, for scaling absolute input devices.
+ * The portrait shadow draws upright, so xres/yres are rotated while it's active.
+ *
+ * @param psd Screen drawing surface.
+ * @param xres Destination for physical x resolution.
+ * @param yres Destination for physical y resolution.
+ */
+void
+GdGetPhysicalSize(PSD psd, MWCOORD *xres, MWCOORD *yres)
+{
+	if (psd->shadowportrait & (MWPORTRAIT_LEFT|MWPORTRAIT_RIGHT)) {
+		*xres = psd->yres;
+		*yres = psd->xres;
+	} else {
+		*xres = psd->xres;
+		*yres = psd->yres;
+	}
 }
 
 /**
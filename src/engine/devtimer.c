@@ -44,6 +44,12 @@
  * with a timeout event). This function returns TRUE if the timeout specified in
  * the last GdGetNextTimeout() call has expired, or FALSE otherwise.
  *
+ * Timers are kept in a binary heap ordered by expiry time, so adding,
+ * destroying and expiring a timer are O(log n).  Expiry times use the
+ * monotonic clock when available, so are unaffected by system time changes.
+ * To reduce wakeups, timers due within a small slack time of each other
+ * are fired together by GdTimeout().
+ *
  * Note that no guarantees can be made as to when exactly the timer callback
  * will be called as it depends on how often the GdTimeout() function is
  * called and how long any other timeouts in the queue before you take to
@@ -52,48 +58,64 @@
  * timers may run late.
  */
 #include <stdlib.h>
+#include <limits.h>
+#include <time.h>
 #include "device.h"
 
 #if MW_FEATURE_TIMERS
 
-static MWTIMER *timerlist = NULL;
+#define MWTIMER_SLACK	10	/* max msecs a timer may fire early to coalesce wakeups*/
+#define MWTIMER_HEAPINC	16	/* timer heap growth increment*/
+
+static MWTIMER **timerheap = NULL;	/* binary min-heap ordered by expiry*/
+static int timercount = 0;
+static int timerheapsize = 0;
 static struct timeval mainloop_timeout;
 static struct timeval current_time;
 
+static void get_current_time(void);
 static void calculate_timeval(struct timeval *tv, MWTIMEOUT to); 
 static long time_to_expiry(struct timeval *t);
+static int heap_insert(MWTIMER *timer);
+static void heap_down(int i);
+static void heap_remove(MWTIMER *timer);
 
-/**
- * Create a new one-shot timer.
- *
- * @param timeout number of milliseconds before the timer should activate
- * @param callback Callback function to call when timer fires.
- * @param arg Opaque argument to pass to callback function.
- * @return Timer handle.  NOTE that this is automatically destroyed
- * after the callback function has been called.
- */
-MWTIMER *GdAddTimer(MWTIMEOUT timeout, MWTIMERCB callback, void *arg)
+static MWTIMER *
+add_timer(MWTIMEOUT timeout, MWTIMERCB callback, void *arg, int type)
 {
 	MWTIMER *newtimer;
 
 	if(!(newtimer = malloc(sizeof(MWTIMER)))) return NULL;
 
-	gettimeofday(&current_time, NULL);
-
-	if(timerlist) timerlist->prev = newtimer;
+	get_current_time();
 
 	calculate_timeval(&newtimer->timeout, timeout);
 	newtimer->callback = callback;
 	newtimer->arg = arg;
-	newtimer->next = timerlist;
-	newtimer->prev = NULL;
-	newtimer->type   = MWTIMER_ONESHOT;
+	newtimer->type = type;
 	newtimer->period = timeout;
-	timerlist = newtimer;
+	if (!heap_insert(newtimer)) {
+		free(newtimer);
+		return NULL;
+	}
 
 	return newtimer;
 }
 
+/**
+ * Create a new one-shot timer.
+ *
+ * @param timeout number of milliseconds before the timer should activate
+ * @param callback Callback function to call when timer fires.
+ * @param arg Opaque argument to pass to callback function.
+ * @return Timer handle.  NOTE that this is automatically destroyed
+ * after the callback function has been called.
+ */
+MWTIMER *GdAddTimer(MWTIMEOUT timeout, MWTIMERCB callback, void *arg)
+{
+	return add_timer(timeout, callback, arg, MWTIMER_ONESHOT);
+}
+
 /**
  * Create a new periodic (repeating) timer.
  *
@@ -104,39 +126,19 @@ MWTIMER *GdAddTimer(MWTIMEOUT timeout, MWTIMERCB callback, void *arg)
  */
 MWTIMER *GdAddPeriodicTimer(MWTIMEOUT timeout, MWTIMERCB callback, void *arg)
 {
-    MWTIMER *newtimer;
-
-    if(!(newtimer = malloc(sizeof(MWTIMER)))) return NULL;
-
-    gettimeofday (&current_time, NULL);
-    
-    if (timerlist) timerlist->prev = newtimer;
-    
-    calculate_timeval (&newtimer->timeout, timeout);
-    newtimer->callback = callback;
-    newtimer->arg      = arg;
-    newtimer->next     = timerlist;
-    newtimer->prev     = NULL;
-    newtimer->type     = MWTIMER_PERIODIC;
-    newtimer->period   = timeout;
-    timerlist          = newtimer;
-    
-    return newtimer;
+	return add_timer(timeout, callback, arg, MWTIMER_PERIODIC);
 }
 
 /**
- * Destroy a timer.
+ * Destroy a timer.  A periodic timer may destroy itself from
+ * its callback function.
  *
  * @param timer Timer to destroy.
  */
 void GdDestroyTimer(MWTIMER *timer)
 {
-	if(timer->next) timer->next->prev = timer->prev;
-	if(timer->prev) timer->prev->next = timer->next;
-	if(timer == timerlist) {
-		if(timer->next) timerlist = timer->next;
-		else timerlist = timer->prev;
-	}
+	if(timer->index >= 0)
+		heap_remove(timer);
 	free(timer);
 }
 
@@ -148,14 +150,13 @@ void GdDestroyTimer(MWTIMER *timer)
  */
 MWTIMER *GdFindTimer(void *arg)
 {
-	MWTIMER *t = timerlist;
+	int i;
 
-	while(t) {
-		if(t->arg == arg) break;
-		t = t->next;
-	}
+	for(i = 0; i < timercount; i++)
+		if(timerheap[i]->arg == arg)
+			return timerheap[i];
 
-	return t;
+	return NULL;
 }
 
 /**
@@ -168,29 +169,23 @@ MWTIMER *GdFindTimer(void *arg)
 MWBOOL GdGetNextTimeout(struct timeval *tv, MWTIMEOUT timeout)
 {
 	signed long i, lowest_timeout;
-	MWTIMER *t = timerlist;
 
-	if(!timeout && !timerlist) return FALSE;
+	if(!timeout && !timercount) return FALSE;
 
-	gettimeofday(&current_time, NULL);
+	get_current_time();
 
 	if(timeout) {
 		calculate_timeval(&mainloop_timeout, timeout);
 		lowest_timeout = time_to_expiry(&mainloop_timeout);
 	} else {
-		lowest_timeout = time_to_expiry(&t->timeout);
+		lowest_timeout = LONG_MAX;
 		mainloop_timeout.tv_sec = -1;
-		t = t->next;
 	}
 
-	while(t) {
-		i = time_to_expiry(&t->timeout);
-		if( i>0 && i>t->period ) {
-			calculate_timeval (&t->timeout, t->period);
-			i = t->period;
-		}
+	/* earliest timer is always at top of heap*/
+	if(timercount) {
+		i = time_to_expiry(&timerheap[0]->timeout);
 		if(i < lowest_timeout) lowest_timeout = i;
-		t = t->next;
 	}
 
 	if(lowest_timeout <= 0) {
@@ -209,25 +204,31 @@ MWBOOL GdGetNextTimeout(struct timeval *tv, MWTIMEOUT timeout)
  */
 MWBOOL GdTimeout(void)
 {
-	MWTIMER *n, *t = timerlist;
-	signed long tempTimeout = 0;
-
-	gettimeofday(&current_time, NULL);
-
-	while(t) {
-		n = t->next;
-		tempTimeout = time_to_expiry(&t->timeout);
-		if( tempTimeout<= 0) {
+	MWTIMER *t;
+	long slack;
+
+	get_current_time();
+
+	/* fire expired timers, and those due within their slack time*/
+	while(timercount) {
+		t = timerheap[0];
+		slack = t->period / 8;
+		if(slack > MWTIMER_SLACK)
+			slack = MWTIMER_SLACK;
+		if(time_to_expiry(&t->timeout) > slack)
+			break;
+
+		if (t->type == MWTIMER_ONESHOT) {
+			/* One shot timer, is finished delete it after callback*/
+			heap_remove(t);
 			t->callback(t->arg);
-			if (t->type == MWTIMER_ONESHOT)
-				GdDestroyTimer(t); 		/* One shot timer, is finished delete it now */
-			else
-				calculate_timeval (&t->timeout, t->period); /* Periodic timer needs to be reset */
+			free(t);
 		} else {
-			if( tempTimeout>0 && tempTimeout>t->period )
-				calculate_timeval (&t->timeout, t->period);
+			/* Periodic timer needs to be reset, before callback may destroy it*/
+			calculate_timeval(&t->timeout, t->period > 0? t->period: 1);
+			heap_down(t->index);
+			t->callback(t->arg);
 		}
-		t = n;
 	}
 
 	if(mainloop_timeout.tv_sec > 0 || mainloop_timeout.tv_usec > 0)
@@ -237,11 +238,25 @@ MWBOOL GdTimeout(void)
 	return FALSE;
 }
 
+/* get current time, monotonic if available so unaffected by clock changes*/
+static void get_current_time(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	current_time.tv_sec = ts.tv_sec;
+	current_time.tv_usec = ts.tv_nsec / 1000;
+#else
+	gettimeofday(&current_time, NULL);
+#endif
+}
+
 static void calculate_timeval(struct timeval *tv, MWTIMEOUT to)
 {
 	tv->tv_sec = current_time.tv_sec + (to / 1000);
 	tv->tv_usec = current_time.tv_usec + ((to % 1000) * 1000);
-	if(tv->tv_usec > 1000000) {
+	if(tv->tv_usec >= 1000000) {
 		tv->tv_sec++;
 		tv->tv_usec -= 1000000;
 	}
@@ -255,4 +270,83 @@ static long time_to_expiry(struct timeval *t)
 	return ret;
 }
 
+/* return TRUE if timer a expires before timer b*/
+static int heap_before(MWTIMER *a, MWTIMER *b)
+{
+	if(a->timeout.tv_sec != b->timeout.tv_sec)
+		return a->timeout.tv_sec < b->timeout.tv_sec;
+	return a->timeout.tv_usec < b->timeout.tv_usec;
+}
+
+/* store timer in heap slot*/
+static void heap_set(int i, MWTIMER *timer)
+{
+	timerheap[i] = timer;
+	timer->index = i;
+}
+
+/* move timer towards top of heap until ordered*/
+static void heap_up(int i)
+{
+	MWTIMER *timer = timerheap[i];
+	int parent;
+
+	while(i > 0) {
+		parent = (i - 1) / 2;
+		if(!heap_before(timer, timerheap[parent]))
+			break;
+		heap_set(i, timerheap[parent]);
+		i = parent;
+	}
+	heap_set(i, timer);
+}
+
+/* move timer towards bottom of heap until ordered*/
+static void heap_down(int i)
+{
+	MWTIMER *timer = timerheap[i];
+	int child;
+
+	while((child = 2 * i + 1) < timercount) {
+		if(child + 1 < timercount && heap_before(timerheap[child + 1], timerheap[child]))
+			child++;
+		if(!heap_before(timerheap[child], timer))
+			break;
+		heap_set(i, timerheap[child]);
+		i = child;
+	}
+	heap_set(i, timer);
+}
+
+static int heap_insert(MWTIMER *timer)
+{
+	MWTIMER **heap;
+
+	if(timercount >= timerheapsize) {
+		heap = realloc(timerheap, (timerheapsize + MWTIMER_HEAPINC) * sizeof(MWTIMER *));
+		if(!heap)
+			return 0;
+		timerheap = heap;
+		timerheapsize += MWTIMER_HEAPINC;
+	}
+	heap_set(timercount++, timer);
+	heap_up(timer->index);
+	return 1;
+}
+
+static void heap_remove(MWTIMER *timer)
+{
+	int i = timer->index;
+
+	timer->index = -1;
+	if(--timercount == i)
+		return;
+
+	/* move last timer into removed slot and reorder*/
+	heap_set(i, timerheap[timercount]);
+	if(i > 0 && heap_before(timerheap[i], timerheap[(i - 1) / 2]))
+		heap_up(i);
+	else heap_down(i);
+}
+
 #endif /* MW_FEATURE_TIMERS */
@@ -388,6 +388,195 @@ static hb_script_t get_hb_script(FT_Face ftf) {
     }
     return HB_SCRIPT_UNKNOWN;
 }
+
+/*
+ * HarfBuzz shaping result cache.
+ *
+ * Shaping is expensive and the same strings are typically measured
+ * and drawn over and over again, so the shaped glyph indices are kept
+ * in a small LRU cache keyed by HarfBuzz font and string.  Script and
+ * direction are guessed from the string, so needn't be part of the key.
+ * Measurement and drawing share the cache.
+ * Entries for a font are flushed when the font size or attributes change
+ * or when the font is destroyed.
+ */
+#define SHAPE_CACHE_MAX		64		/* max cached shaping results*/
+#define SHAPE_CACHE_HASHSIZE	128		/* hash buckets, must be power of 2*/
+#define SHAPE_CACHE_MAXTEXT	256		/* don't cache strings longer than this*/
+
+typedef struct shapeentry {
+	struct shapeentry *hnext;		/* hash bucket chain*/
+	struct shapeentry *prev;		/* LRU list, most recently used first*/
+	struct shapeentry *next;
+	hb_font_t *	font;				/* cache key*/
+	unsigned long	hash;
+	int		textlen;
+	unsigned short *text;
+	int		count;					/* cache value: # shaped glyphs*/
+	unsigned int *	glyphs;			/* glyph indices*/
+} SHAPEENTRY;
+
+static SHAPEENTRY *shape_hash[SHAPE_CACHE_HASHSIZE];
+static SHAPEENTRY *shape_lru_head;	/* most recently used*/
+static SHAPEENTRY *shape_lru_tail;	/* least recently used*/
+static int shape_count;
+static SHAPEENTRY *shape_scratch;	/* result for strings too long to cache*/
+
+static unsigned long
+freetype2_shape_hash(hb_font_t *font, const unsigned short *str, int cc)
+{
+	unsigned long hash = 2166136261UL;	/* FNV-1a*/
+	int i;
+
+	for (i = 0; i < cc; i++)
+		hash = (hash ^ str[i]) * 16777619UL;
+	hash ^= (unsigned long)(size_t)font >> 4;
+	return hash;
+}
+
+static void
+freetype2_shape_unlink(SHAPEENTRY *ep)
+{
+	SHAPEENTRY **pp = &shape_hash[ep->hash & (SHAPE_CACHE_HASHSIZE-1)];
+
+	while (*pp != ep)
+		pp = &(*pp)->hnext;
+	*pp = ep->hnext;
+
+	if (ep->prev)
+		ep->prev->next = ep->next;
+	else shape_lru_head = ep->next;
+	if (ep->next)
+		ep->next->prev = ep->prev;
+	else shape_lru_tail = ep->prev;
+	--shape_count;
+}
+
+/* allocate entry with room for text and shaped results in a single block*/
+static SHAPEENTRY *
+freetype2_shape_alloc(int textlen, int count)
+{
+	SHAPEENTRY *ep;
+
+	ep = malloc(sizeof(SHAPEENTRY) + count * sizeof(unsigned int)
+		+ textlen * sizeof(unsigned short));
+	if (!ep)
+		return NULL;
+	ep->glyphs = (unsigned int *)(ep + 1);
+	ep->text = (unsigned short *)(ep->glyphs + count);
+	ep->textlen = textlen;
+	ep->count = count;
+	return ep;
+}
+
+/**
+ * Flush shaping results from the cache.
+ *
+ * @param font HarfBuzz font whose entries are flushed, or NULL to flush all.
+ */
+static void
+freetype2_flush_shape_cache(hb_font_t *font)
+{
+	SHAPEENTRY *ep = shape_lru_head;
+
+	while (ep) {
+		SHAPEENTRY *next = ep->next;
+
+		if (!font || ep->font == font) {
+			freetype2_shape_unlink(ep);
+			free(ep);
+		}
+		ep = next;
+	}
+}
+
+/**
+ * Shape a string, returning a cached result if available.
+ * The returned entry is only valid until the next call.
+ *
+ * @param pf   The font to use.
+ * @param str  The string to shape, in 16-bit Unicode form.
+ * @param cc   The number of characters in str.
+ * @return     The shaped result, or NULL on allocation failure.
+ */
+static SHAPEENTRY *
+freetype2_shape(PMWFREETYPE2FONT pf, const unsigned short *str, int cc)
+{
+	unsigned long hash = 0;
+	SHAPEENTRY *ep;
+	hb_glyph_info_t *glyph_info;
+	unsigned int count, i;
+
+	if (cc <= SHAPE_CACHE_MAXTEXT) {
+		hash = freetype2_shape_hash(pf->hb_font, str, cc);
+		for (ep = shape_hash[hash & (SHAPE_CACHE_HASHSIZE-1)]; ep; ep = ep->hnext) {
+			if (ep->hash == hash && ep->font == pf->hb_font && ep->textlen == cc &&
+			    !memcmp(ep->text, str, cc * sizeof(unsigned short))) {
+				/* move to front of LRU list*/
+				if (ep != shape_lru_head) {
+					ep->prev->next = ep->next;
+					if (ep->next)
+						ep->next->prev = ep->prev;
+					else shape_lru_tail = ep->prev;
+					ep->prev = NULL;
+					ep->next = shape_lru_head;
+					shape_lru_head->prev = ep;
+					shape_lru_head = ep;
+				}
+				return ep;
+			}
+		}
+	}
+
+	/* cache miss, shape the text*/
+	hb_buffer_clear_contents(HB_buff);
+	hb_buffer_add_utf16(HB_buff, str, -1, 0, cc);
+	hb_buffer_guess_segment_properties(HB_buff);
+	hb_shape(pf->hb_font, HB_buff, NULL, 0);
+
+	glyph_info = hb_buffer_get_glyph_infos(HB_buff, &count);
+
+	if (cc > SHAPE_CACHE_MAXTEXT) {
+		/* too long to cache, reuse scratch entry*/
+		if (shape_scratch && shape_scratch->count < (int)count) {
+			free(shape_scratch);
+			shape_scratch = NULL;
+		}
+		if (!shape_scratch)
+			shape_scratch = freetype2_shape_alloc(0, count);
+		ep = shape_scratch;
+		if (!ep)
+			return NULL;
+	} else {
+		if (shape_count >= SHAPE_CACHE_MAX) {
+			SHAPEENTRY *old = shape_lru_tail;
+
+			freetype2_shape_unlink(old);
+			free(old);
+		}
+		ep = freetype2_shape_alloc(cc, count);
+		if (!ep)
+			return NULL;
+		ep->font = pf->hb_font;
+		ep->hash = hash;
+		memcpy(ep->text, str, cc * sizeof(unsigned short));
+
+		ep->hnext = shape_hash[hash & (SHAPE_CACHE_HASHSIZE-1)];
+		shape_hash[hash & (SHAPE_CACHE_HASHSIZE-1)] = ep;
+		ep->prev = NULL;
+		ep->next = shape_lru_head;
+		if (shape_lru_head)
+			shape_lru_head->prev = ep;
+		else shape_lru_tail = ep;
+		shape_lru_head = ep;
+		++shape_count;
+	}
+
+	ep->count = count;
+	for (i = 0; i < count; i++)
+		ep->glyphs[i] = glyph_info[i].codepoint;
+	return ep;
+}
 #endif // HAVE_HARFBUZZ_SUPPORT
 
 static long
@@ -747,6 +936,10 @@ freetype2_destroyfont(PMWFONT pfont)
 
 	assert(pf);
 
+#if HAVE_HARFBUZZ_SUPPORT
+	if (pf->hb_font)
+		freetype2_flush_shape_cache(pf->hb_font);
+#endif
 #if !HAVE_FREETYPE_2_CACHE
 	FT_Done_Face(pf->face);
 	if (pf->filename)
@@ -863,6 +1056,11 @@ freetype2_setfontsize(PMWFONT pfont, MWCOORD height, MWCOORD width)
 	/* We want real pixel sizes ... not points ... */
 	FT_Set_Pixel_Sizes(pf->face, pixel_width, pixel_height);
 #endif
+#if HAVE_HARFBUZZ_SUPPORT
+	/* shaped glyphs depend on font size*/
+	if (pf->hb_font)
+		freetype2_flush_shape_cache(pf->hb_font);
+#endif
 	
 	return oldsize;
 }
@@ -961,6 +1159,11 @@ freetype2_setfontattr(PMWFONT pfont, int setflags, int clrflags)
 #else
 	pf->imagedesc.type = (pf->fontattr & MWTF_ANTIALIAS)? ftc_image_grays: ftc_image_mono;
 #endif
+#if HAVE_HARFBUZZ_SUPPORT
+	/* attribute changes (cmap, kerning) invalidate shaping results*/
+	if (pf->hb_font)
+		freetype2_flush_shape_cache(pf->hb_font);
+#endif
 #endif
 
 	return oldattr;
@@ -1203,8 +1406,10 @@ freetype2_drawtext(PMWFONT pfont, PSD psd, MWCOORD ax, MWCOORD ay,
 	int drawantialias;
 	MWBLITPARMS parms;
 #if HAVE_HARFBUZZ_SUPPORT
-	hb_glyph_info_t *glyph_info = NULL;
+	SHAPEENTRY *shaped;
+	unsigned int *glyphs = NULL;
 #endif // HAVE_HARFBUZZ_SUPPORT
+	int textcc = cc;	/* cc may be replaced by shaped glyph count*/
 	
 	assert(pf);
 	assert(text);
@@ -1285,23 +1490,12 @@ freetype2_drawtext(PMWFONT pfont, PSD psd, MWCOORD ax, MWCOORD ay,
 
 #if HAVE_HARFBUZZ_SUPPORT
 	if(pf->use_harfbuzz) {
-		/* clean up the buffer */
-		hb_buffer_clear_contents(HB_buff);
-		/* layout the text */
-		hb_buffer_add_utf16(HB_buff, str, -1, 0, cc);
-
-	#if 1
-		hb_buffer_guess_segment_properties (HB_buff);
-	#else
-		hb_buffer_set_script(HB_buff, pf->hb_script);
-		hb_buffer_set_direction(HB_buff, HB_DIRECTION_LTR);
-		if(pf->hb_script==HB_SCRIPT_ARABIC)
-			hb_buffer_set_direction(HB_buff, HB_DIRECTION_RTL);
-	#endif
-		hb_shape(pf->hb_font, HB_buff, NULL, 0);
-
-		glyph_info = hb_buffer_get_glyph_infos(HB_buff, NULL);
-		cc = hb_buffer_get_length(HB_buff);
+		/* shape the text, or use cached result*/
+		shaped = freetype2_shape(pf, str, cc);
+		if (!shaped)
+			return;
+		glyphs = shaped->glyphs;
+		cc = shaped->count;
 	}
 #endif // HAVE_HARFBUZZ_SUPPORT
 
@@ -1338,7 +1532,7 @@ freetype2_drawtext(PMWFONT pfont, PSD psd, MWCOORD ax, MWCOORD ay,
 			MWPIXELVAL gr_save = gr_background;
 			gr_foreground = gr_background;
 #endif
-			pfont->fontprocs->GetTextSize(pfont, text, cc, flags, &fnt_w, &fnt_h, &fnt_b);
+			pfont->fontprocs->GetTextSize(pfont, text, textcc, flags, &fnt_w, &fnt_h, &fnt_b);
 			ay -= pos.y >> 6;
 			GdFillRect(psd, ax, ay-fnt_b, fnt_w, fnt_h);
 			ay += pos.y >> 6;
@@ -1354,7 +1548,7 @@ freetype2_drawtext(PMWFONT pfont, PSD psd, MWCOORD ax, MWCOORD ay,
 		for (i = 0; i < cc; i++) {
 #if HAVE_HARFBUZZ_SUPPORT
 			if(pf->use_harfbuzz)
-				curchar = glyph_info[i].codepoint;
+				curchar = glyphs[i];
 			else
 #endif // HAVE_HARFBUZZ_SUPPORT		  
 			curchar = LOOKUP_CHAR(pf, face, str[i]);
@@ -1442,7 +1636,7 @@ freetype2_drawtext(PMWFONT pfont, PSD psd, MWCOORD ax, MWCOORD ay,
 			MWPIXELVAL gr_save = gr_background;
 			gr_foreground = gr_background;
 #endif
-			pfont->fontprocs->GetTextSize(pfont, text, cc, flags, &fnt_w, &fnt_h, &fnt_b);
+			pfont->fontprocs->GetTextSize(pfont, text, textcc, flags, &fnt_w, &fnt_h, &fnt_b);
 			GdFillRect(psd, ax, ay-fnt_b, fnt_w, fnt_h);
 
 #if STANDALONE
@@ -1456,7 +1650,7 @@ freetype2_drawtext(PMWFONT pfont, PSD psd, MWCOORD ax, MWCOORD ay,
 		for (i = 0; i < cc; i++) {
 #if HAVE_HARFBUZZ_SUPPORT
 			if(pf->use_harfbuzz)
-				curchar = glyph_info[i].codepoint;
+				curchar = glyphs[i];
 			else
 #endif // HAVE_HARFBUZZ_SUPPORT		  
 			curchar = LOOKUP_CHAR(pf, face, str[i]);
@@ -1586,7 +1780,8 @@ freetype2_gettextsize_rotated(PMWFREETYPE2FONT pf, const void *text, int cc,
 	FT_BBox bbox;
 	FT_BBox glyph_bbox;
 #if HAVE_HARFBUZZ_SUPPORT
-	hb_glyph_info_t *glyph_info = NULL;
+	SHAPEENTRY *shaped;
+	unsigned int *glyphs = NULL;
 #endif
 	
 #if HAVE_FREETYPE_2_CACHE
@@ -1630,22 +1825,20 @@ freetype2_gettextsize_rotated(PMWFREETYPE2FONT pf, const void *text, int cc,
 	pos.y = 0;
 #if HAVE_HARFBUZZ_SUPPORT
 	if(pf->use_harfbuzz) {
-		/* clean up the buffer */
-		hb_buffer_clear_contents(HB_buff);
-		/* layout the text */
-		hb_buffer_add_utf16(HB_buff, str, -1, 0, cc);
-
-		hb_buffer_guess_segment_properties (HB_buff);
-		hb_shape(pf->hb_font, HB_buff, NULL, 0);
-
-		glyph_info = hb_buffer_get_glyph_infos(HB_buff, NULL);
-		cc = hb_buffer_get_length(HB_buff);
+		/* shape the text, or use cached result*/
+		shaped = freetype2_shape(pf, str, cc);
+		if (!shaped) {
+			*pwidth = *pheight = *pbase = 0;
+			return;
+		}
+		glyphs = shaped->glyphs;
+		cc = shaped->count;
 	}
 #endif
 	for (i = 0; i < cc; i++) {
 #if HAVE_HARFBUZZ_SUPPORT
 		if(pf->use_harfbuzz)
-			curchar = glyph_info[i].codepoint;
+			curchar = glyphs[i];
 		else
 #endif 
 		curchar = LOOKUP_CHAR(pf, face, str[i]);
@@ -1748,7 +1941,8 @@ freetype2_gettextsize_fast(PMWFREETYPE2FONT pf, const void *text, int char_count
 	int cur_glyph_code;
 	int last_glyph_code = 0;	/* Used for kerning */
 #if HAVE_HARFBUZZ_SUPPORT
-	hb_glyph_info_t *glyph_info = NULL;
+	SHAPEENTRY *shaped;
+	unsigned int *glyphs = NULL;
 #endif
 	
 #if HAVE_FREETYPE_2_CACHE
@@ -1790,23 +1984,21 @@ freetype2_gettextsize_fast(PMWFREETYPE2FONT pf, const void *text, int char_count
 
 #if HAVE_HARFBUZZ_SUPPORT
 	if(pf->use_harfbuzz) {
-		/* clean up the buffer */
-		hb_buffer_clear_contents(HB_buff);
-		/* layout the text */
-		hb_buffer_add_utf16(HB_buff, str, -1, 0, char_count);
-
-		hb_buffer_guess_segment_properties (HB_buff);
-		hb_shape(pf->hb_font, HB_buff, NULL, 0);
-
-		glyph_info = hb_buffer_get_glyph_infos(HB_buff, NULL);
-		char_count = hb_buffer_get_length(HB_buff);
+		/* shape the text, or use cached result*/
+		shaped = freetype2_shape(pf, str, char_count);
+		if (!shaped) {
+			*pwidth = *pheight = *pbase = 0;
+			return;
+		}
+		glyphs = shaped->glyphs;
+		char_count = shaped->count;
 	}
 #endif
 
 	for (char_index = 0; char_index < char_count; char_index++) {
 #if HAVE_HARFBUZZ_SUPPORT
 		if(pf->use_harfbuzz)
-			cur_glyph_code = glyph_info[char_index].codepoint;
+			cur_glyph_code = glyphs[char_index];
 		else
 #endif	  
 		cur_glyph_code = LOOKUP_CHAR(pf, face, str[char_index]);
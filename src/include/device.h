@@ -97,6 +97,7 @@ typedef struct _mwscreendevice {
 	void	(*Update)(PSD psd, MWCOORD x, MWCOORD y, MWCOORD width, MWCOORD height);
 	int		(*PreSelect)(PSD psd);
 	int	portrait;	 /* screen portrait mode*/
+	int	shadowportrait;	 /* portrait mode rotated from upright shadow on update*/
 	PSUBDRIVER orgsubdriver; /* original subdriver for portrait modes*/
 	PSUBDRIVER left_subdriver;
 	PSUBDRIVER right_subdriver;
@@ -197,6 +198,8 @@ PSD		GdOpenScreen(void);
 PSD		GdOpenScreenExt(MWBOOL clearflag);
 void	GdCloseScreen(PSD psd);
 int		GdSetPortraitMode(PSD psd, int portraitmode);
+int		GdGetPortraitMode(PSD psd);
+void	GdGetPhysicalSize(PSD psd, MWCOORD *xres, MWCOORD *yres);
 int		GdSetMode(int mode);
 MWBOOL	GdSetUseBackground(MWBOOL flag);
 MWPIXELVAL GdSetForegroundPixelVal(PSD psd, MWPIXELVAL fg);
@@ -336,6 +339,8 @@ void	GdRestrictMouse(MWCOORD newminx,MWCOORD newminy,MWCOORD newmaxx, MWCOORD ne
 void	GdSetAccelMouse(int newthresh, int newscale);
 void	GdMoveMouse(MWCOORD newx, MWCOORD newy);
 int		GdReadMouse(MWCOORD *px, MWCOORD *py, int *pb);
+void	GdSetMouseTime(MWTIMEOUT time);
+MWTIMEOUT GdGetMouseTime(void);
 void	GdMoveCursor(MWCOORD x, MWCOORD y);
 MWBOOL	GdGetCursorPos(MWCOORD *px, MWCOORD *py);
 void	GdSetCursor(PMWCURSOR pcursor);
@@ -438,8 +443,7 @@ struct mw_timer {
 	struct timeval	timeout;
 	MWTIMERCB	callback;
 	void		*arg;
-	MWTIMER		*next;
-	MWTIMER		*prev;
+	int		index;	  /* position in timer heap, -1 if not queued*/
     int         type;     /* MWTIMER_ONESHOT or MWTIMER_PERIODIC */
     MWTIMEOUT   period;
 };
@@ -110,6 +110,9 @@
 #ifndef MW_FEATURE_PORTRAIT
 #define MW_FEATURE_PORTRAIT 1	/* =1 for portrait support */
 #endif
+#ifndef MW_FEATURE_PORTRAIT_SHADOW
+#define MW_FEATURE_PORTRAIT_SHADOW MW_FEATURE_PORTRAIT	/* =1 to draw portrait upright, rotate on update*/
+#endif
 #ifndef MW_FEATURE_AREAS
 #define MW_FEATURE_AREAS 1      /* =1 for GrArea, GrReadArea, GrStretchArea */
 #endif
@@ -63,6 +63,7 @@ typedef uint32_t	GR_SERIALNO;	/* Selection request ID number */
 typedef unsigned short	GR_MIMETYPE;	/* Index into mime type list */
 typedef uint32_t	GR_LENGTH;	/* Length of a block of data */
 typedef unsigned int	GR_BUTTON;	/* mouse button value */
+typedef unsigned int	GR_COOKIE;	/* async request sequence number */
 
 /** Nano-X rectangle, different from MWRECT */
 typedef struct {
@@ -72,6 +73,42 @@ typedef struct {
 	GR_SIZE  height;	/**< rectangle height*/
 } GR_RECT;
 
+/** Line segment for GrSegments*/
+typedef struct {
+	GR_COORD x1;		/**< starting x coordinate*/
+	GR_COORD y1;		/**< starting y coordinate*/
+	GR_COORD x2;		/**< ending x coordinate*/
+	GR_COORD y2;		/**< ending y coordinate*/
+} GR_SEGMENT;
+
+/** Arc for GrArcs, same parameters as GrArcAngle*/
+typedef struct {
+	GR_COORD x;		/**< center x coordinate*/
+	GR_COORD y;		/**< center y coordinate*/
+	GR_SIZE  rx;		/**< x radius*/
+	GR_SIZE  ry;		/**< y radius*/
+	GR_COORD angle1;	/**< start angle in 1/64 degrees*/
+	GR_COORD angle2;	/**< end angle in 1/64 degrees*/
+	int	 type;		/**< GR_ARC, GR_ARCOUTLINE or GR_PIE*/
+} GR_ARC_ITEM;
+
+/** Text string for GrTexts*/
+typedef struct {
+	GR_COORD x;		/**< x coordinate*/
+	GR_COORD y;		/**< y coordinate*/
+	void *	 str;		/**< text string*/
+	GR_COUNT count;		/**< # characters, -1 for strlen if ascii*/
+} GR_TEXT_ITEM;
+
+/** Drawing primitive for GrDrawBatch*/
+typedef struct {
+	int	 type;		/**< GR_BATCH_xxx primitive type*/
+	GR_COORD x1;		/**< x, or center x for ellipses*/
+	GR_COORD y1;		/**< y, or center y for ellipses*/
+	GR_COORD x2;		/**< line end x, width, or x radius*/
+	GR_COORD y2;		/**< line end y, height, or y radius*/
+} GR_BATCH_ITEM;
+
 /* The root window id. */
 #define	GR_ROOT_WINDOW_ID	((GR_WINDOW_ID) 1)
 
@@ -143,6 +180,14 @@ typedef struct {
 #define GR_ARCOUTLINE		MWARCOUTLINE	/* arc + outline*/
 #define GR_PIE			MWPIE		/* pie (filled)*/
 
+/* GrDrawBatch primitive types*/
+#define GR_BATCH_POINT		1	/* GrPoint x1,y1*/
+#define GR_BATCH_LINE		2	/* GrLine x1,y1 to x2,y2*/
+#define GR_BATCH_RECT		3	/* GrRect x1,y1 width x2 height y2*/
+#define GR_BATCH_FILLRECT	4	/* GrFillRect x1,y1 width x2 height y2*/
+#define GR_BATCH_ELLIPSE	5	/* GrEllipse center x1,y1 radius x2,y2*/
+#define GR_BATCH_FILLELLIPSE	6	/* GrFillEllipse center x1,y1 radius x2,y2*/
+
 /* GrSetWindowRegion types*/
 #define GR_WINDOW_BOUNDING_MASK	0	/* outer border*/
 #define GR_WINDOW_CLIP_MASK	1	/* inner border*/
@@ -594,6 +639,33 @@ typedef union {
 
 typedef void (*GR_FNCALLBACKEVENT)(GR_EVENT *);
 
+/* GrSetEventQueueLimit() flags*/
+#define GR_EVENTQ_NOCOALESCE		0x01	/* queue every mouse motion event*/
+#define GR_EVENTQ_MOTION_HISTORY	0x02	/* keep coalesced motion in history*/
+
+/**
+ * Event queue statistics returned by GrGetEventQueueInfo().
+ */
+typedef struct {
+  int count;			/**< events currently queued */
+  int peak;			/**< most events ever queued */
+  int limit;			/**< queue limit, 0 if unlimited */
+  int flags;			/**< GR_EVENTQ_* flags */
+  unsigned long dropped;	/**< motion events dropped at limit */
+  unsigned long coalesced;	/**< motion events merged into queued event */
+} GR_EVENTQ_INFO;
+
+/**
+ * Mouse motion point merged away by event compression,
+ * returned by GrGetMotionHistory().
+ */
+typedef struct {
+  GR_WINDOW_ID wid;		/**< window id event was for */
+  GR_COORD rootx;		/**< root window x coordinate */
+  GR_COORD rooty;		/**< root window y coordinate */
+  GR_TIMEOUT time;		/**< tick count of motion */
+} GR_MOTION_POINT;
+
 /* GR_BITMAP macros*/
 /* size of GR_BITMAP image in words*/
 #define	GR_BITMAP_SIZE(width, height)	MWIMAGE_SIZE(width, height)
@@ -763,6 +835,8 @@ GR_WINDOW_ID	GrNewWindow(GR_WINDOW_ID parent, GR_COORD x, GR_COORD y,
 				GR_SIZE width, GR_SIZE height, GR_SIZE bordersize,
 				GR_COLOR background, GR_COLOR bordercolor);
 GR_WINDOW_ID    GrNewPixmapEx(GR_SIZE width, GR_SIZE height, int format, void *pixels);
+GR_WINDOW_ID	GrNewSharedPixmap(GR_SIZE width, GR_SIZE height, int format,
+			int shmid, unsigned long offset);
 GR_WINDOW_ID	GrNewInputWindow(GR_WINDOW_ID parent, GR_COORD x, GR_COORD y,
 				GR_SIZE width, GR_SIZE height);
 void		GrDestroyWindow(GR_WINDOW_ID wid);
@@ -795,6 +869,7 @@ void		GrMoveWindow(GR_WINDOW_ID wid, GR_COORD x, GR_COORD y);
 void		GrResizeWindow(GR_WINDOW_ID wid, GR_SIZE width, GR_SIZE height);
 void		GrReparentWindow(GR_WINDOW_ID wid, GR_WINDOW_ID pwid, GR_COORD x, GR_COORD y);
 void		GrGetWindowInfo(GR_WINDOW_ID wid, GR_WINDOW_INFO *infoptr);
+GR_COOKIE	GrGetWindowInfoAsync(GR_WINDOW_ID wid, GR_WINDOW_INFO *infoptr);
 void		GrSetWMProperties(GR_WINDOW_ID wid, GR_WM_PROPERTIES *props);
 void		GrGetWMProperties(GR_WINDOW_ID wid, GR_WM_PROPERTIES *props);
 
@@ -809,10 +884,13 @@ void		GrSetFontRotation(GR_FONT_ID fontid, int tenthsdegrees);
 void		GrSetFontAttr(GR_FONT_ID fontid, int setflags, int clrflags);
 void		GrDestroyFont(GR_FONT_ID fontid);
 void		GrGetFontInfo(GR_FONT_ID font, GR_FONT_INFO *fip);
+GR_COOKIE	GrGetFontInfoAsync(GR_FONT_ID font, GR_FONT_INFO *fip);
 GR_WINDOW_ID	GrGetFocus(void);
 void		GrSetFocus(GR_WINDOW_ID wid);
 void		GrClearArea(GR_WINDOW_ID wid, GR_COORD x, GR_COORD y,
 				GR_SIZE width, GR_SIZE height, int exposeflag);
+GR_COOKIE	GrDamageWindow(GR_WINDOW_ID wid, GR_COUNT count, GR_RECT *recttable,
+				GR_BOOL fence);
 void		GrSelectEvents(GR_WINDOW_ID wid, GR_EVENT_MASK eventmask);
 void		GrGetNextEvent(GR_EVENT *ep);
 int		GrGetTypedEvent(GR_WINDOW_ID wid, GR_EVENT_MASK mask, 
@@ -827,12 +905,18 @@ int		GrPeekEvent(GR_EVENT *ep);
 void		GrPeekWaitEvent(GR_EVENT *ep);
 void		GrCopyEvent(GR_EVENT *dst, GR_EVENT *src);
 void		GrFreeEvent(GR_EVENT *ev);
+void		GrSetEventQueueLimit(int maxevents, int flags);
+void		GrGetEventQueueInfo(GR_EVENTQ_INFO *info);
+int		GrGetMotionHistory(GR_MOTION_POINT *points, int maxpoints);
 void		GrLine(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x1, GR_COORD y1, GR_COORD x2, GR_COORD y2);
 void		GrPoint(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y);
 void		GrPoints(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_POINT *pointtable);
 void		GrRect(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y, GR_SIZE width, GR_SIZE height);
 void		GrFillRect(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y,
 				GR_SIZE width, GR_SIZE height);
+void		GrFillRects(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_RECT *recttable);
+void		GrSegments(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_SEGMENT *segtable);
+void		GrDrawBatch(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_BATCH_ITEM *items);
 void		GrPoly(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_POINT *pointtable);
 void		GrFillPoly(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_POINT *pointtable);
 void		GrEllipse(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y, GR_SIZE rx, GR_SIZE ry);
@@ -841,6 +925,7 @@ void		GrArc(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y, GR_SIZE rx, GR_S
 				GR_COORD ax, GR_COORD ay, GR_COORD bx, GR_COORD by, int type);
 void		GrArcAngle(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y, GR_SIZE rx, GR_SIZE ry,
 				GR_COORD angle1, GR_COORD angle2, int type); /* floating point required*/
+void		GrArcs(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_ARC_ITEM *arctable);
 void		GrSetGCForeground(GR_GC_ID gc, GR_COLOR foreground);
 void		GrSetGCForegroundPixelVal(GR_GC_ID gc, GR_PIXELVAL foreground);
 void		GrSetGCBackground(GR_GC_ID gc, GR_COLOR background);
@@ -857,6 +942,8 @@ void		GrSetGCGraphicsExposure(GR_GC_ID gc, GR_BOOL exposure);
 void		GrSetGCFont(GR_GC_ID gc, GR_FONT_ID font);
 void		GrGetGCTextSize(GR_GC_ID gc, void *str, int count, GR_TEXTFLAGS flags,
 				GR_SIZE *retwidth, GR_SIZE *retheight,GR_SIZE *retbase);
+GR_COOKIE	GrGetGCTextSizeAsync(GR_GC_ID gc, void *str, int count, GR_TEXTFLAGS flags,
+				GR_SIZE *retwidth, GR_SIZE *retheight,GR_SIZE *retbase);
 void		GrReadArea(GR_DRAW_ID id, GR_COORD x, GR_COORD y, GR_SIZE width, GR_SIZE height,
 				GR_PIXELVAL *pixels);
 void		GrArea(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y,
@@ -884,6 +971,8 @@ void		GrFreeImage(GR_IMAGE_ID id);
 void		GrGetImageInfo(GR_IMAGE_ID id, GR_IMAGE_INFO *iip);
 void		GrText(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y,
 				void *str, GR_COUNT count, GR_TEXTFLAGS flags);
+void		GrTexts(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_TEXT_ITEM *items,
+				GR_TEXTFLAGS flags);
 GR_CURSOR_ID GrNewCursor(GR_SIZE width, GR_SIZE height, GR_COORD hotx, GR_COORD hoty,
 				GR_COLOR foreground, GR_COLOR background, GR_BITMAP *fgbitmap, GR_BITMAP *bgbitmap);
 void		GrDestroyCursor(GR_CURSOR_ID cid);
@@ -908,7 +997,10 @@ void		GrSendClientData(GR_WINDOW_ID wid, GR_WINDOW_ID did,
 				GR_SERIALNO serial, GR_LENGTH len, GR_LENGTH thislen, void *data);
 void		GrBell(void);
 void		GrSetBackgroundPixmap(GR_WINDOW_ID wid, GR_WINDOW_ID pixmap, int flags);
+void		GrSetWindowOpacity(GR_WINDOW_ID wid, int opacity);
 void		GrQueryPointer(GR_WINDOW_ID *mwin, GR_COORD *x, GR_COORD *y, GR_BUTTON *bmask);
+GR_COOKIE	GrQueryPointerAsync(GR_WINDOW_ID *mwin, GR_COORD *x, GR_COORD *y, GR_BUTTON *bmask);
+int		GrWaitReply(GR_COOKIE cookie);
 void		GrQueryTree(GR_WINDOW_ID wid, GR_WINDOW_ID *parentid,
 				GR_WINDOW_ID **children, GR_COUNT *nchildren);
 GR_BOOL		GrGrabKey(GR_WINDOW_ID wid, GR_KEY key, int type);
@@ -1014,6 +1106,18 @@ struct event_list {
 	GR_EVENT	event;
 };
 
+/* client side async reply queue (client.c local)*/
+#define GR_REPLY_MAXFIELDS	4
+typedef struct reply_list REPLY_LIST;
+struct reply_list {
+	REPLY_LIST *	next;
+	GR_COOKIE	cookie;			/* request sequence number*/
+	short		type;			/* expected reply packet type*/
+	short		count;			/* number of reply fields*/
+	void *		ptr[GR_REPLY_MAXFIELDS];/* caller's reply destinations*/
+	int		size[GR_REPLY_MAXFIELDS];
+};
+
 /* queued request buffer (nxproto.c local)*/
 typedef struct {
 	unsigned char *bufptr;		/* next unused buffer location*/
@@ -1057,6 +1161,9 @@ typedef struct {                                /* Init to: */
     GR_FNCALLBACKEVENT  _GrErrorFunc;           /* GrDefaultErrorHandler */
     REQBUF              _reqbuf;
     EVENT_LIST          *_evlist;
+    REPLY_LIST          *_replyhead;
+    REPLY_LIST          *_replytail;
+    GR_COOKIE           _replyseq;
 } ecos_nanox_client_data;
 
 extern int     ecos_nanox_client_data_index;
@@ -1079,6 +1186,9 @@ extern int     ecos_nanox_client_data_index;
         dptr->_reqbuf.bufmax = NULL;                                            \
         dptr->_reqbuf.buffer = NULL;                                            \
         dptr->_evlist = NULL;                                                   \
+        dptr->_replyhead = NULL;                                                \
+        dptr->_replytail = NULL;                                                \
+        dptr->_replyseq = 0;                                                    \
         cyg_thread_set_data(ecos_nanox_client_data_index,(CYG_ADDRWORD)dptr);   \
     }
 
@@ -1091,6 +1201,9 @@ extern int     ecos_nanox_client_data_index;
 #define ErrorFunc               (data->_GrErrorFunc)
 #define reqbuf                  (data->_reqbuf)
 #define evlist                  (data->_evlist)
+#define replyhead               (data->_replyhead)
+#define replytail               (data->_replytail)
+#define replyseq                (data->_replyseq)
 
 #else
 #define ACCESS_PER_THREAD_DATA()
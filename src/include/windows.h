@@ -177,11 +177,17 @@ struct hwnd {
 	int		id;		/* window id */
 	LPTSTR		szTitle;	/* window title*/
 	int		gotPaintMsg;	/* window had WM_PAINT PostMessage*/
+	struct hwnd	*nextpaint;	/* next window in pending paint list*/
+	int		paintDepth;	/* z-order depth when added to paint list*/
+	BOOL		inPaintList;	/* window is on pending paint list*/
+	DWORD		mouseMsgSeq;	/* msg queue seq # of last WM_MOUSEMOVE*/
+	DWORD		timerMsgSeq;	/* msg queue seq # of last WM_TIMER*/
 	int		paintSerial;	/* experimental serial # for alphblend*/
 	int		paintNC;	/* experimental NC paint handling*/
 	int		nEraseBkGnd;	/* for InvalidateXX erase bkgnd flag */
 	HBRUSH		paintBrush;	/* brush created to paint some controls */
 	HPEN		paintPen;	/* pen created to paint some controls */
+	struct _mwpaintbuf *paintbuf;	/* WS_EX_COMPOSITED back buffer during BeginPaint*/
 	MWCLIPREGION *	update;		/* update region in screen coords*/
 	LONG_PTR		userdata;	/* setwindowlong user data*/
 	LONG_PTR		userdata2;	/* additional user data (will remove)*/
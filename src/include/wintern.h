@@ -12,11 +12,23 @@
 #define PAINT_NEEDSPAINT	1	/* WM_PAINT seen, paint when can*/
 #define PAINT_DELAYPAINT	2	/* WM_PAINT seen,paint after user move*/
 
+/* application message queue statistics*/
+typedef struct {
+	int	count;		/* msgs currently queued*/
+	int	size;		/* allocated msg slots*/
+	int	highwater;	/* max msgs ever queued*/
+	DWORD	posted;		/* total msgs queued*/
+	DWORD	coalesced;	/* msgs merged into an already queued msg*/
+	DWORD	dropped;	/* mouse moves and paints dropped with queue full*/
+} MWMSGQUEUESTATS;
+
 /* internal routines*/
 
 /* winuser.c*/
+void		MwGetMsgQueueStats(MWMSGQUEUESTATS *stats);
 PWNDCLASS 	MwFindClassByName(LPCSTR lpClassName);
 void		MwDestroyWindow(HWND hwnd,BOOL bSendMsg);
+void		MwSetNeedsPaint(HWND hwnd);
 HWND		MwGetTopWindow(HWND hwnd);
 void		MwCalcClientRect(HWND hwnd);
 void		MwSendSizeMove(HWND hwnd, BOOL bSize, BOOL bMove);
@@ -93,6 +105,7 @@ extern	HWND	focuswp;		/* focus window for keyboard */
 extern	HWND	mousewp;		/* window mouse is currently in */
 extern	HWND	capturewp;		/* capture window*/
 extern  HWND	dragwp;			/* window user is dragging*/
+extern	unsigned long mwwindowgen;	/* bumped on window position/visibility/zorder change*/
 extern	HCURSOR	curcursor;		/* currently enabled cursor */
 extern	MWCOORD	cursorx;		/* x position of cursor */
 extern	MWCOORD	cursory;		/* y position of cursor */
@@ -378,6 +378,7 @@ typedef NMHDR FAR * LPNMHDR;
 #define WS_EX_STATICEDGE        0x00020000L
 #define WS_EX_APPWINDOW         0x00040000L
 #define WS_EX_LAYERED		0x00080000L
+#define WS_EX_COMPOSITED	0x02000000L
 
 #define WS_EX_OVERLAPPEDWINDOW  (WS_EX_WINDOWEDGE | WS_EX_CLIENTEDGE)
 #define WS_EX_PALETTEWINDOW     (WS_EX_WINDOWEDGE | WS_EX_TOOLWINDOW | WS_EX_TOPMOST)
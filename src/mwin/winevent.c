@@ -605,14 +605,58 @@ void MwCheckCursor(void)
 	GdSetCursor(&cp->cursor);
 }
 
+/*
+ * Screen tile cache for MwFindVisibleWindow.  Each tile remembers the
+ * window found for all points within it, or NULL if the tile straddles
+ * a window edge, and is valid until mwwindowgen changes.
+ */
+#define HITTILE_SHIFT	5		/* 32x32 pixel tiles*/
+
+typedef struct {
+	HWND		wp;		/* window at every point in tile or NULL*/
+	unsigned long	gen;		/* mwwindowgen wp found at*/
+} MWHITTILE;
+
+static MWHITTILE *hittiles;
+static int hitcols, hitrows;
+
+/*
+ * Find the window which is visible at every point in the passed rectangle,
+ * using the same walk as MwFindVisibleWindowPoint.  Return NULL if
+ * different points in the rectangle would find different windows.
+ */
+static HWND
+MwFindVisibleWindowRect(MWCOORD x1, MWCOORD y1, MWCOORD x2, MWCOORD y2)
+{
+	HWND	wp;		/* current window */
+	HWND	retwp;		/* returned window */
+
+	wp = rootwp;
+	retwp = wp;
+	while (wp) {
+		if (!wp->unmapcount &&
+		    wp->winrect.left < x2 && wp->winrect.top < y2 &&
+		    wp->winrect.right > x1 && wp->winrect.bottom > y1) {
+			/* window must contain all of rectangle or none of it*/
+			if (wp->winrect.left > x1 || wp->winrect.top > y1 ||
+			    wp->winrect.right < x2 || wp->winrect.bottom < y2)
+				return NULL;
+			retwp = wp;
+			wp = wp->children;
+			continue;
+		}
+		wp = wp->siblings;
+	}
+	return retwp;
+}
+
 /*
  * Find the window which is currently visible for the specified coordinates.
  * This just walks down the window tree looking for the deepest mapped
- * window which contains the specified point.  If the coordinates are
- * off the screen, the root window is returned.
+ * window which contains the specified point.
  */
-HWND
-MwFindVisibleWindow(MWCOORD x, MWCOORD y)
+static HWND
+MwFindVisibleWindowPoint(MWCOORD x, MWCOORD y)
 {
 	HWND	wp;		/* current window */
 	HWND	retwp;		/* returned window */
@@ -632,6 +676,49 @@ MwFindVisibleWindow(MWCOORD x, MWCOORD y)
 	return retwp;
 }
 
+/*
+ * Find the window which is currently visible for the specified coordinates.
+ * If the coordinates are off the screen, the root window is returned.
+ * The screen tile containing the point is checked first, which
+ * avoids walking the window tree unless the tile straddles a window edge.
+ */
+HWND
+MwFindVisibleWindow(MWCOORD x, MWCOORD y)
+{
+	MWHITTILE *tp;
+	MWCOORD	tx, ty;
+	int	cols, rows;
+
+	if (x < 0 || y < 0 || x >= rootwp->winrect.right || y >= rootwp->winrect.bottom)
+		return MwFindVisibleWindowPoint(x, y);
+
+	/* (re)allocate tiles for current screen size*/
+	cols = (rootwp->winrect.right + (1 << HITTILE_SHIFT) - 1) >> HITTILE_SHIFT;
+	rows = (rootwp->winrect.bottom + (1 << HITTILE_SHIFT) - 1) >> HITTILE_SHIFT;
+	if (cols != hitcols || rows != hitrows) {
+		free(hittiles);
+		hittiles = (MWHITTILE *)calloc(cols * rows, sizeof(MWHITTILE));
+		hitcols = hittiles? cols: 0;
+		hitrows = hittiles? rows: 0;
+		if (!hittiles)
+			return MwFindVisibleWindowPoint(x, y);
+	}
+
+	tx = x >> HITTILE_SHIFT;
+	ty = y >> HITTILE_SHIFT;
+	tp = &hittiles[ty * hitcols + tx];
+	if (tp->gen != mwwindowgen) {
+		tx <<= HITTILE_SHIFT;
+		ty <<= HITTILE_SHIFT;
+		tp->wp = MwFindVisibleWindowRect(tx, ty, tx + (1 << HITTILE_SHIFT),
+			ty + (1 << HITTILE_SHIFT));
+		tp->gen = mwwindowgen;
+	}
+	if (tp->wp)
+		return tp->wp;
+	return MwFindVisibleWindowPoint(x, y);
+}
+
 /*
  * Check to see if the window the mouse is currently in has changed.
  */
@@ -49,6 +49,7 @@ MwHideWindow(HWND hwnd,BOOL bChangeFocus, BOOL bSendMsg)
 		SendMessage(wp, WM_SHOWWINDOW, FALSE, 0L);
 
 	wp->unmapcount++;
+	++mwwindowgen;
 
 	for (childwp = wp->children; childwp; childwp = childwp->siblings)
 		MwHideWindow(childwp, bChangeFocus, bSendMsg);
@@ -109,6 +110,7 @@ MwShowWindow(HWND hwnd, BOOL bSendMsg)
 
 	if (wp->unmapcount)
 		wp->unmapcount--;
+	++mwwindowgen;
 
 	if (wp->unmapcount == 0) {
 		SendMessage(wp, WM_SHOWWINDOW, TRUE, 0L);
@@ -176,6 +178,7 @@ MwRaiseWindow(HWND hwnd)
 	prevwp->siblings = wp->siblings;
 	wp->siblings = wp->parent->children;
 	wp->parent->children = wp;
+	++mwwindowgen;
 
 	/*
 	 * Finally redraw the window if necessary.
@@ -235,6 +238,7 @@ MwLowerWindow(HWND hwnd)
 	sibwp->siblings = wp;
 
 	wp->siblings = NULL;
+	++mwwindowgen;
 
 	/*
 	 * Finally redraw the sibling windows which this window covered
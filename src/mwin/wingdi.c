@@ -36,6 +36,20 @@ static MWPALOBJ default_palette = {
 	{OBJ_PAL, TRUE}, 0, 0
 };
 
+/* WS_EX_COMPOSITED paint back buffers, pooled by size class*/
+#define MW_PAINTBUF_MAX		4	/* # pooled back buffers*/
+#define MW_PAINTBUF_ROUND	64	/* back buffer size class granularity*/
+
+struct _mwpaintbuf {
+	PSD		psd;		/* memory device, NULL if slot unallocated*/
+	MWCOORD		w, h;		/* allocated size class*/
+	unsigned char *	bits;		/* allocated pixels*/
+	HDC		hdc;		/* BeginPaint dc drawing into buffer*/
+	RECT		rc;		/* screen rect being painted*/
+	BOOL		inuse;
+};
+static struct _mwpaintbuf paintbufs[MW_PAINTBUF_MAX];
+
 static BOOL MwExtTextOut(HDC hdc, int x, int y, UINT fuOptions,
 		CONST RECT *lprc, LPCVOID lpszString, UINT cbCount,
 		CONST INT *lpDx, int flags);
@@ -207,6 +221,194 @@ MwPaintNCArea(HWND hwnd)
 	MwPaintNCScrollbars(hwnd, NULL);
 }
 
+/*
+ * Get a free back buffer at least w x h from the pool.  The smallest
+ * fitting buffer is reused, otherwise an empty or too small slot is
+ * (re)allocated rounded up to the next size class.
+ */
+static struct _mwpaintbuf *
+MwGetPaintBuffer(MWCOORD w, MWCOORD h)
+{
+	struct _mwpaintbuf *pb;
+	struct _mwpaintbuf *fit = NULL;
+	struct _mwpaintbuf *spare = NULL;
+	unsigned int size, pitch;
+
+	for (pb = paintbufs; pb < &paintbufs[MW_PAINTBUF_MAX]; ++pb) {
+		if (pb->inuse)
+			continue;
+		if (pb->psd && pb->w >= w && pb->h >= h) {
+			if (!fit || pb->w * pb->h < fit->w * fit->h)
+				fit = pb;
+		} else if (!spare || !pb->psd)
+			spare = pb;
+	}
+	if (fit) {
+		fit->inuse = TRUE;
+		return fit;
+	}
+	if (!spare)
+		return NULL;
+
+	/* replace too small buffer with one of the next size class*/
+	if (spare->psd) {
+		if (spare->w > w)
+			w = spare->w;
+		if (spare->h > h)
+			h = spare->h;
+		spare->psd->FreeMemGC(spare->psd);
+		spare->psd = NULL;
+	}
+	w = (w + MW_PAINTBUF_ROUND - 1) & ~(MW_PAINTBUF_ROUND - 1);
+	h = (h + MW_PAINTBUF_ROUND - 1) & ~(MW_PAINTBUF_ROUND - 1);
+
+	pb = spare;
+	pb->psd = scrdev.AllocateMemGC(&scrdev);
+	if (!pb->psd)
+		return NULL;
+	GdCalcMemGCAlloc(pb->psd, w, h, 0, 0, &size, &pitch);
+	pb->bits = malloc(size);
+	if (!pb->bits) {
+		pb->psd->FreeMemGC(pb->psd);
+		pb->psd = NULL;
+		return NULL;
+	}
+	if (!pb->psd->MapMemGC(pb->psd, w, h, scrdev.planes, scrdev.bpp,
+	    scrdev.data_format, pitch, size, pb->bits)) {
+		free(pb->bits);
+		pb->bits = NULL;
+		pb->psd->FreeMemGC(pb->psd);
+		pb->psd = NULL;
+		return NULL;
+	}
+	pb->psd->flags |= PSF_ADDRMALLOC;
+	pb->w = w;
+	pb->h = h;
+	pb->inuse = TRUE;
+	return pb;
+}
+
+/*
+ * Position back buffer origin at screen rect prc.  Buffer pixel 0,0 is
+ * screen prc->left,prc->top, so the paint dc draws in screen coordinates
+ * like a window dc, and is clipped by its region to prc.
+ */
+static void
+MwOriginPaintBuffer(struct _mwpaintbuf *pb, LPRECT prc)
+{
+	PSD	psd = pb->psd;
+
+	pb->rc = *prc;
+	psd->addr = pb->bits - (prc->top * psd->pitch + prc->left * (psd->bpp >> 3));
+	psd->xres = psd->xvirtres = prc->left + pb->w;
+	psd->yres = psd->yvirtres = prc->top + pb->h;
+}
+
+/* return back buffer to pool with origin reset*/
+static void
+MwPutPaintBuffer(struct _mwpaintbuf *pb)
+{
+	PSD	psd = pb->psd;
+
+	psd->addr = pb->bits;
+	psd->xres = psd->xvirtres = pb->w;
+	psd->yres = psd->yvirtres = pb->h;
+	pb->hdc = NULL;
+	pb->inuse = FALSE;
+}
+
+/* return TRUE if hdc is a window's composited paint dc*/
+static BOOL
+MwIsPaintBufferDC(HDC hdc)
+{
+	return hdc->hwnd && hdc->hwnd->paintbuf && hdc->hwnd->paintbuf->hdc == hdc;
+}
+
+/*
+ * Start WS_EX_COMPOSITED painting: return a client dc drawing into
+ * a pooled back buffer covering the update rectangle, preloaded from
+ * the screen.  Return NULL to paint directly to the screen.
+ */
+static HDC
+MwBeginCompositedPaint(HWND hwnd)
+{
+	struct _mwpaintbuf *pb;
+	HDC	hdc;
+	RECT	rc;
+
+	/* sub-byte pixels and rotated screens aren't offset addressable*/
+	if (scrdev.bpp < 8 || scrdev.portrait != MWPORTRAIT_NONE)
+		return NULL;
+	if (hwnd->pClass && (hwnd->pClass->style & CS_OWNDC))
+		return NULL;
+
+	/* paint only the part of the update region on the screen*/
+#if UPDATEREGIONS
+	if (!IntersectRect(&rc, &hwnd->update->extents, &hwnd->clirect))
+		return NULL;
+#else
+	rc = hwnd->clirect;
+#endif
+	if (rc.left < 0)
+		rc.left = 0;
+	if (rc.top < 0)
+		rc.top = 0;
+	if (rc.right > scrdev.xvirtres)
+		rc.right = scrdev.xvirtres;
+	if (rc.bottom > scrdev.yvirtres)
+		rc.bottom = scrdev.yvirtres;
+	if (IsRectEmpty(&rc))
+		return NULL;
+
+	pb = MwGetPaintBuffer(rc.right - rc.left, rc.bottom - rc.top);
+	if (!pb)
+		return NULL;
+	MwOriginPaintBuffer(pb, &rc);
+
+	hdc = GetDCEx(hwnd, NULL, DCX_DEFAULTCLIP|DCX_EXCLUDEUPDATE);
+	if (!hdc) {
+		MwPutPaintBuffer(pb);
+		return NULL;
+	}
+	hdc->psd = pb->psd;
+	hdc->region = (MWRGNOBJ *)CreateRectRgnIndirect(&rc);
+	pb->hdc = hdc;
+	hwnd->paintbuf = pb;
+
+	/* start with current screen contents for partially painted areas*/
+	MwPrepareDC(hdc);
+	GdBlit(pb->psd, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top,
+		&scrdev, rc.left, rc.top, MWROP_COPY);
+	return hdc;
+}
+
+/* finish WS_EX_COMPOSITED painting with a single clipped blit to screen*/
+static void
+MwEndCompositedPaint(HWND hwnd)
+{
+	struct _mwpaintbuf *pb = hwnd->paintbuf;
+	HDC	hdc;
+	LPRECT	prc = &pb->rc;
+
+	hdc = GetDCEx(hwnd, NULL, DCX_DEFAULTCLIP|DCX_EXCLUDEUPDATE);
+	if (hdc) {
+		if (MwPrepareDC(hdc))
+			GdBlit(&scrdev, prc->left, prc->top, prc->right - prc->left,
+				prc->bottom - prc->top, pb->psd, prc->left, prc->top, MWROP_COPY);
+		ReleaseDC(hwnd, hdc);
+	}
+
+	/* release paint dc as a screen dc, the pool owns the memory device*/
+	hdc = pb->hdc;
+	if (hdc == cliphdc)
+		cliphdc = NULL;
+	hdc->psd = &scrdev;
+	ReleaseDC(hwnd, hdc);
+
+	hwnd->paintbuf = NULL;
+	MwPutPaintBuffer(pb);
+}
+
 HDC WINAPI 
 BeginPaint(HWND hwnd, LPPAINTSTRUCT lpPaint)
 {
@@ -231,8 +433,14 @@ BeginPaint(HWND hwnd, LPPAINTSTRUCT lpPaint)
 	} else {
 		HideCaret(hwnd);
 
+		/* double buffer WS_EX_COMPOSITED windows*/
+		hdc = NULL;
+		if (hwnd->exstyle & WS_EX_COMPOSITED)
+			hdc = MwBeginCompositedPaint(hwnd);
+
 		/* FIXME: mdemo requires update excluded or draw errors occur*/
-		hdc = GetDCEx(hwnd, NULL, DCX_DEFAULTCLIP
+		if (!hdc)
+			hdc = GetDCEx(hwnd, NULL, DCX_DEFAULTCLIP
 				|DCX_EXCLUDEUPDATE);	/* FIXME - bug*/
 
 		/* erase client background, always w/alpha blending*/
@@ -271,7 +479,10 @@ EndPaint(HWND hwnd, CONST PAINTSTRUCT *lpPaint)
 		DeleteObject ( hwnd->paintPen );
 		hwnd->paintPen = NULL;
 		}
-	ReleaseDC(hwnd, lpPaint->hdc);
+	if (hwnd->paintbuf && lpPaint->hdc == hwnd->paintbuf->hdc)
+		MwEndCompositedPaint(hwnd);
+	else
+		ReleaseDC(hwnd, lpPaint->hdc);
 #if UPDATEREGIONS
 	/* don't clear update region until done dragging*/
 	if(mwERASEMOVE && !dragwp)
@@ -403,45 +614,28 @@ MwPrepareDC(HDC hdc)
 	if(hdc != cliphdc) {
 		/* clip memory dc's to the bitmap size*/
 		if(hdc->psd->flags&PSF_MEMORY) {
-#if DYNAMICREGIONS
-			/* If hdc has a clip region, use it! */
-			if (hdc->region != NULL && hdc->region->rgn != NULL
-			    && hdc->region->rgn->size != 0) {
-				LPRECT rptr = &(hdc->region->rgn->extents);
-
-				/* Bound left,top to 0,0 if they are negative
-				 * to avoid an assertion later.
-				 */
-				MWCOORD left = (rptr->left <= 0) ? 0 : rptr->left;
-				MWCOORD top = (rptr->top <= 0) ? 0 : rptr->top;
-				GdSetClipRegion(hdc->psd,
-					GdAllocRectRegion(left, top, rptr->right, rptr->bottom));
-			} else {
-				GdSetClipRegion(hdc->psd,
-					GdAllocRectRegion(0, 0,
-						hdc->psd->xvirtres, hdc->psd->yvirtres));
-			}
-#else
+			RECT	rc;
+#if !DYNAMICREGIONS
 			static MWCLIPRECT crc = {0, 0, 0, 0};
+#endif
+
+			/* paint back buffers only have memory behind the painted rect*/
+			if (MwIsPaintBufferDC(hdc))
+				rc = hwnd->paintbuf->rc;
+			else SetRect(&rc, 0, 0, hdc->psd->xvirtres, hdc->psd->yvirtres);
 
 			/* If hdc has a clip region, use it! */
 			if (hdc->region != NULL && hdc->region->rgn != NULL
-			    && hdc->region->rgn->size != 0) {
-				LPRECT rptr = &(hdc->region->rgn->extents);
-
-				/* Bound left,top to 0,0 if they are negative
-				 * to avoid an assertion later.
-				 */
-				if (rptr->left > 0)
-					crc.x = rptr->left;
-				if (rptr->top > 0)
-					crc.y = rptr->top;
-				crc.width = rptr->right;
-				crc.height = rptr->bottom;
-			} else {
-				crc.width = hdc->psd->xvirtres;
-				crc.height = hdc->psd->yvirtres;
-			}
+			    && hdc->region->rgn->size != 0)
+				IntersectRect(&rc, &rc, &hdc->region->rgn->extents);
+#if DYNAMICREGIONS
+			GdSetClipRegion(hdc->psd,
+				GdAllocRectRegion(rc.left, rc.top, rc.right, rc.bottom));
+#else
+			crc.x = rc.left;
+			crc.y = rc.top;
+			crc.width = rc.right - rc.left;
+			crc.height = rc.bottom - rc.top;
 			GdSetClipRects(hdc->psd, 1, &crc);
 #endif
 		} else MwSetClipWindow(hdc);
@@ -1922,7 +2116,8 @@ StretchBlt(HDC hdcDest, int nXOriginDest, int nYOriginDest, int nWidthDest,
 
 	/* if src screen DC, convert coords*/
 	/* FIXME: src clipping doesn't check overlapped source window, only unmapped*/
-	if(!MwIsMemDC(hdcSrc)) {
+	/* composited paint dc's use screen coords like window dc's*/
+	if(!MwIsMemDC(hdcSrc) || MwIsPaintBufferDC(hdcSrc)) {
 		hwnd = hdcSrc->hwnd;
 		if (!hwnd || hwnd->unmapcount)
 			return FALSE;
@@ -1932,7 +2127,7 @@ StretchBlt(HDC hdcDest, int nXOriginDest, int nYOriginDest, int nWidthDest,
 
 	/* set dest clipping; if dst screen DC, convert coords*/
 	hwnd = MwPrepareDC(hdcDest);
-	if(!MwIsMemDC(hdcDest) && MwIsClientDC(hdcDest)) {
+	if((!MwIsMemDC(hdcDest) || MwIsPaintBufferDC(hdcDest)) && MwIsClientDC(hdcDest)) {
 		if (!hwnd)
 			return FALSE;
 		ClientToScreen(hwnd, &dst);
@@ -99,11 +99,32 @@ typedef struct _LISTBOXITEM
 	DWORD dwFlags;		/* item flags */
 	ULONG_PTR dwData;		/* item data */
 	ULONG_PTR dwAddData;		/* item additional data */
-	struct _LISTBOXITEM *next;	/* next item */
+	struct _LISTBOXITEM *next;	/* next item in free list */
 } LISTBOXITEM, *PLISTBOXITEM;
 
 #define DEF_LB_BUFFER_LEN       5
 
+/*
+ * Items are kept in order in a table of fixed size chunks, so positional
+ * access is a binary search over the chunk start indexes and inserts and
+ * deletes only move pointers within one chunk.
+ */
+#define LB_CHUNK_LEN		256	/* max items per chunk */
+#define LB_CHUNK_INC		16	/* chunk table growth increment */
+
+typedef struct _LISTBOXCHUNK
+{
+	int start;		/* index of first item in chunk */
+	int count;		/* items in chunk */
+	PLISTBOXITEM items[LB_CHUNK_LEN];
+} LISTBOXCHUNK, *PLISTBOXCHUNK;
+
+typedef struct _LISTBOXPOS
+{
+	int chunk;		/* chunk table index */
+	int off;		/* item offset in chunk */
+} LISTBOXPOS;
+
 #define LBF_FOCUS               0x0001
 #define LBF_NOTHINGSELECTED	0x0002
 #define LBF_FOCUSRECT		0x0004
@@ -125,7 +146,10 @@ typedef struct _LISTBOXDATA
 	int nTabStops;		/* count of tabstops */
 	LPINT pTabStops;	/* array of tabstops */
 
-	LISTBOXITEM *head;	/* items linked list head */
+	PLISTBOXCHUNK *chunks;	/* item chunk table */
+	int chunkCount;		/* chunks in use */
+	int chunkMax;		/* chunk table size */
+	int chunkStale;		/* first chunk with out of date start index */
 
 	int buffLen;		/* buffer length */
 	LISTBOXITEM *buffStart;	/* buffer start */
@@ -256,6 +280,231 @@ lstCalcHeight(HWND hwnd)
 		pData->dwFlags |= LBF_USERMEASURE;
 }
 
+static PLISTBOXITEM
+lstAllocItem(PLISTBOXDATA pData)
+{
+	PLISTBOXITEM plbi;
+
+	if (pData->freeList) {
+		plbi = pData->freeList;
+		pData->freeList = plbi->next;
+	} else
+		plbi = (PLISTBOXITEM) malloc(sizeof(LISTBOXITEM));
+
+	return plbi;
+}
+
+static void
+lstFreeItem(PLISTBOXDATA pData, PLISTBOXITEM plbi)
+{
+	if (plbi < pData->buffStart || plbi > pData->buffEnd)
+		free(plbi);
+	else {
+		plbi->next = pData->freeList;
+		pData->freeList = plbi;
+	}
+}
+
+/* recalc chunk start indexes from first stale chunk */
+static void
+lstUpdateChunks(PLISTBOXDATA pData)
+{
+	int i = pData->chunkStale;
+	int start = 0;
+
+	if (i > 0)
+		start = pData->chunks[i - 1]->start + pData->chunks[i - 1]->count;
+	for (; i < pData->chunkCount; i++) {
+		pData->chunks[i]->start = start;
+		start += pData->chunks[i]->count;
+	}
+	pData->chunkStale = pData->chunkCount;
+}
+
+static void
+lstMarkStale(PLISTBOXDATA pData, int chunk)
+{
+	if (chunk < pData->chunkStale)
+		pData->chunkStale = chunk;
+}
+
+/* find chunk and offset of item pos, pos == itemCount returns end of last chunk */
+static BOOL
+lstFindPos(PLISTBOXDATA pData, int pos, LISTBOXPOS *plp)
+{
+	int lo, hi, mid;
+
+	if (pos < 0 || pos > pData->itemCount || pData->chunkCount == 0)
+		return FALSE;
+
+	if (pData->chunkStale < pData->chunkCount)
+		lstUpdateChunks(pData);
+
+	lo = 0;
+	hi = pData->chunkCount - 1;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (pData->chunks[mid]->start <= pos)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	plp->chunk = lo;
+	plp->off = pos - pData->chunks[lo]->start;
+	return TRUE;
+}
+
+static PLISTBOXITEM
+lstFirstItem(PLISTBOXDATA pData, int pos, LISTBOXPOS *plp)
+{
+	if (pos < 0 || pos >= pData->itemCount || !lstFindPos(pData, pos, plp))
+		return NULL;
+
+	return pData->chunks[plp->chunk]->items[plp->off];
+}
+
+static PLISTBOXITEM
+lstNextItem(PLISTBOXDATA pData, LISTBOXPOS *plp)
+{
+	if (++plp->off >= pData->chunks[plp->chunk]->count) {
+		if (++plp->chunk >= pData->chunkCount)
+			return NULL;
+		plp->off = 0;
+	}
+
+	return pData->chunks[plp->chunk]->items[plp->off];
+}
+
+/* add an empty chunk at chunk table index */
+static PLISTBOXCHUNK
+lstInsertChunk(PLISTBOXDATA pData, int index)
+{
+	PLISTBOXCHUNK pc;
+
+	if (pData->chunkCount >= pData->chunkMax) {
+		PLISTBOXCHUNK *chunks;
+
+		chunks = realloc(pData->chunks,
+			(pData->chunkMax + LB_CHUNK_INC) * sizeof(PLISTBOXCHUNK));
+		if (!chunks)
+			return NULL;
+		pData->chunks = chunks;
+		pData->chunkMax += LB_CHUNK_INC;
+	}
+
+	if (!(pc = (PLISTBOXCHUNK) malloc(sizeof(LISTBOXCHUNK))))
+		return NULL;
+	pc->start = 0;
+	pc->count = 0;
+
+	memmove(&pData->chunks[index + 1], &pData->chunks[index],
+		(pData->chunkCount - index) * sizeof(PLISTBOXCHUNK));
+	pData->chunks[index] = pc;
+	pData->chunkCount++;
+	lstMarkStale(pData, index);
+
+	return pc;
+}
+
+/* insert item at pos, 0 <= pos <= itemCount */
+static BOOL
+lstInsertItemAt(PLISTBOXDATA pData, int pos, PLISTBOXITEM newItem)
+{
+	LISTBOXPOS lp;
+	PLISTBOXCHUNK pc, pn;
+	int half;
+
+	if (!pData->chunkCount && !lstInsertChunk(pData, 0))
+		return FALSE;
+
+	if (!lstFindPos(pData, pos, &lp))
+		return FALSE;
+	pc = pData->chunks[lp.chunk];
+
+	if (pc->count == LB_CHUNK_LEN) {
+		if (!(pn = lstInsertChunk(pData, lp.chunk + 1)))
+			return FALSE;
+
+		if (lp.off == LB_CHUNK_LEN) {
+			/* appending: start a new chunk rather than split */
+			lp.chunk++;
+			lp.off = 0;
+			pc = pn;
+		} else {
+			half = LB_CHUNK_LEN / 2;
+			memcpy(pn->items, &pc->items[half],
+				(LB_CHUNK_LEN - half) * sizeof(PLISTBOXITEM));
+			pn->count = LB_CHUNK_LEN - half;
+			pc->count = half;
+			if (lp.off > half) {
+				lp.chunk++;
+				lp.off -= half;
+				pc = pn;
+			}
+		}
+	}
+
+	memmove(&pc->items[lp.off + 1], &pc->items[lp.off],
+		(pc->count - lp.off) * sizeof(PLISTBOXITEM));
+	pc->items[lp.off] = newItem;
+	pc->count++;
+	lstMarkStale(pData, lp.chunk + 1);
+	pData->itemCount++;
+
+	return TRUE;
+}
+
+/* unlink item at pos, 0 <= pos < itemCount */
+static PLISTBOXITEM
+lstRemoveItemAt(PLISTBOXDATA pData, int pos)
+{
+	LISTBOXPOS lp;
+	PLISTBOXCHUNK pc;
+	PLISTBOXITEM plbi;
+
+	if (!lstFirstItem(pData, pos, &lp))
+		return NULL;
+
+	pc = pData->chunks[lp.chunk];
+	plbi = pc->items[lp.off];
+	memmove(&pc->items[lp.off], &pc->items[lp.off + 1],
+		(pc->count - lp.off - 1) * sizeof(PLISTBOXITEM));
+
+	if (--pc->count == 0) {
+		free(pc);
+		pData->chunkCount--;
+		memmove(&pData->chunks[lp.chunk], &pData->chunks[lp.chunk + 1],
+			(pData->chunkCount - lp.chunk) * sizeof(PLISTBOXCHUNK));
+		lstMarkStale(pData, lp.chunk);
+	} else
+		lstMarkStale(pData, lp.chunk + 1);
+	pData->itemCount--;
+
+	return plbi;
+}
+
+static void
+lstFreeAllItems(PLISTBOXDATA pData)
+{
+	int i, j;
+	PLISTBOXCHUNK pc;
+
+	for (i = 0; i < pData->chunkCount; i++) {
+		pc = pData->chunks[i];
+		for (j = 0; j < pc->count; j++) {
+			FreeFixStr(pc->items[j]->key);
+			lstFreeItem(pData, pc->items[j]);
+		}
+		free(pc);
+	}
+	free(pData->chunks);
+
+	pData->chunks = NULL;
+	pData->chunkCount = 0;
+	pData->chunkMax = 0;
+	pData->chunkStale = 0;
+}
+
 static BOOL
 lstInitListBoxData(HWND hwnd, LISTBOXDATA * pData, int len)
 {
@@ -293,18 +542,7 @@ lstInitListBoxData(HWND hwnd, LISTBOXDATA * pData, int len)
 static void
 lstListBoxCleanUp(LISTBOXDATA * pData)
 {
-	PLISTBOXITEM plbi;
-	PLISTBOXITEM next;
-
-	plbi = pData->head;
-	while (plbi) {
-		FreeFixStr(plbi->key);
-		next = plbi->next;
-		if (plbi < pData->buffStart || plbi > pData->buffEnd)
-			free(plbi);
-
-		plbi = next;
-	}
+	lstFreeAllItems(pData);
 
 	if (pData->pTabStops) {
 		free(pData->pTabStops);
@@ -318,7 +556,7 @@ static void
 lstResetListBoxContent(PLISTBOXDATA pData)
 {
 	int i;
-	PLISTBOXITEM plbi, next;
+	PLISTBOXITEM plbi;
 
 	pData->itemCount = 0;
 	pData->itemTop = 0;
@@ -327,17 +565,8 @@ lstResetListBoxContent(PLISTBOXDATA pData)
 	pData->itemVisibles = 0;
 #endif
 
-	plbi = pData->head;
-	while (plbi) {
-		FreeFixStr(plbi->key);
-		next = plbi->next;
-		if (plbi < pData->buffStart || plbi > pData->buffEnd)
-			free(plbi);
-
-		plbi = next;
-	}
+	lstFreeAllItems(pData);
 
-	pData->head = NULL;
 	pData->freeList = pData->buffStart;
 
 	plbi = pData->freeList;
@@ -348,153 +577,41 @@ lstResetListBoxContent(PLISTBOXDATA pData)
 	plbi->next = NULL;
 }
 
-static PLISTBOXITEM
-lstAllocItem(PLISTBOXDATA pData)
-{
-	PLISTBOXITEM plbi;
-
-	if (pData->freeList) {
-		plbi = pData->freeList;
-		pData->freeList = plbi->next;
-	} else
-		plbi = (PLISTBOXITEM) malloc(sizeof(LISTBOXITEM));
-
-	return plbi;
-}
-
-static void
-lstFreeItem(PLISTBOXDATA pData, PLISTBOXITEM plbi)
-{
-	if (plbi < pData->buffStart || plbi > pData->buffEnd)
-		free(plbi);
-	else {
-		plbi->next = pData->freeList;
-		pData->freeList = plbi;
-	}
-}
-
 static int
 lstAddNewItem(DWORD dwStyle,
 	      PLISTBOXDATA pData, PLISTBOXITEM newItem, int pos)
 {
-	PLISTBOXITEM plbi;
-	PLISTBOXITEM insPosItem = NULL;
-	int insPos = 0;
+	int lo, hi, mid;
 
 	newItem->next = NULL;
-	if (!pData->head)
-		insPosItem = NULL;
-	else if (dwStyle & LBS_SORT) {
-		plbi = pData->head;
-
-		if (strcmp(newItem->key, plbi->key) < 0) {
-			insPosItem = NULL;
-			insPos = 0;
-		} else {
-			while (plbi->next) {
-				if (strcmp(newItem->key, plbi->next->key) <= 0)
-					break;
-
-				plbi = plbi->next;
-				insPos++;
-			}
-			insPosItem = plbi;
-		}
-	} else {
-		plbi = pData->head;
-
-		if (pos < 0) {
-			while (plbi->next) {
-				plbi = plbi->next;
-				insPos++;
-			}
-			insPosItem = plbi;
-		} else if (pos > 0) {
-			int index = 0;
-
-			while (plbi->next) {
-				if (pos == index)
-					break;
-				plbi = plbi->next;
-				index++;
-				insPos++;
-			}
-			insPosItem = plbi;
+	if (dwStyle & LBS_SORT) {
+		/* insert before first item not less than new key */
+		lo = 0;
+		hi = pData->itemCount;
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (strcmp(newItem->key, lstGetItem(pData, mid)->key) <= 0)
+				hi = mid;
+			else
+				lo = mid + 1;
 		}
-	}
+		pos = lo;
+	} else if (pos < 0 || pos > pData->itemCount)
+		pos = pData->itemCount;
 
-	if (insPosItem) {
-		plbi = insPosItem->next;
-		insPosItem->next = newItem;
-		newItem->next = plbi;
+	if (!lstInsertItemAt(pData, pos, newItem))
+		return LB_ERRSPACE;
 
-		insPos++;
-	} else {
-		plbi = pData->head;
-		pData->head = newItem;
-		newItem->next = plbi;
-	}
-
-	pData->itemCount++;
-	return insPos;
+	return pos;
 }
 
 static PLISTBOXITEM
 lstRemoveItem(PLISTBOXDATA pData, int *pos)
 {
-	int index = 0;
-	PLISTBOXITEM plbi, prev;
+	if (*pos < 0 || *pos >= pData->itemCount)
+		*pos = pData->itemCount - 1;
 
-	if (!pData->head)
-		return NULL;
-
-	if (*pos < 0) {
-		prev = pData->head;
-		plbi = pData->head;
-		while (plbi->next) {
-			prev = plbi;
-			plbi = plbi->next;
-			index++;
-		}
-
-		if (plbi == pData->head) {
-			pData->head = pData->head->next;
-			*pos = 0;
-			return plbi;
-		} else {
-			prev->next = plbi->next;
-			*pos = index;
-			return plbi;
-		}
-	} else if (*pos == 0) {
-		plbi = pData->head;
-		pData->head = plbi->next;
-		return plbi;
-	} else {
-		index = 0;
-		prev = pData->head;
-		plbi = pData->head;
-		while (plbi->next) {
-			if (*pos == index)
-				break;
-
-			prev = plbi;
-			plbi = plbi->next;
-			index++;
-		}
-
-		if (plbi == pData->head) {
-			pData->head = pData->head->next;
-			*pos = 0;
-			return plbi;
-		} else {
-			prev->next = plbi->next;
-			*pos = index;
-			return plbi;
-		}
-	}
-
-	return NULL;
+	return lstRemoveItemAt(pData, *pos);
 }
 
 static void
@@ -565,30 +682,26 @@ lstInvalidateUnderItem(HWND hwnd, PLISTBOXDATA pData, int pos)
 static PLISTBOXITEM
 lstGetItem(PLISTBOXDATA pData, int pos)
 {
-	int i;
-	PLISTBOXITEM plbi;
-
-	plbi = pData->head;
-	for (i = 0; i < pos && plbi; i++)
-		plbi = plbi->next;
+	LISTBOXPOS lp;
 
-	return plbi;
+	return lstFirstItem(pData, pos, &lp);
 }
 
 static int
 lstFindItem(PLISTBOXDATA pData, int start, char *key, BOOL bExact)
 {
 	PLISTBOXITEM plbi;
+	LISTBOXPOS lp;
 	int keylen = strlen(key);
 
-	if (start >= (pData->itemCount - 1))
+	if (start < 0 || start >= (pData->itemCount - 1))
 		start = 0;
 
-	plbi = lstGetItem(pData, start);
+	plbi = lstFirstItem(pData, start, &lp);
 
 	while (plbi) {
 		if (bExact && (keylen != strlen(plbi->key))) {
-			plbi = plbi->next;
+			plbi = lstNextItem(pData, &lp);
 			start++;
 			continue;
 		}
@@ -596,7 +709,7 @@ lstFindItem(PLISTBOXDATA pData, int start, char *key, BOOL bExact)
 		if (strncasecmp(key, plbi->key, keylen) == 0)
 			return start;
 
-		plbi = plbi->next;
+		plbi = lstNextItem(pData, &lp);
 		start++;
 	}
 
@@ -608,6 +721,7 @@ lstOnDrawSListBoxItems(HWND hwnd, HDC hdc, DWORD dwStyle,
 		       PLISTBOXDATA pData, LPRECT pRcPaint)
 {
 	PLISTBOXITEM plbi;
+	LISTBOXPOS lp;
 	int i;
 	int x = 0, y = 0;
 	RECT rc;
@@ -617,7 +731,7 @@ lstOnDrawSListBoxItems(HWND hwnd, HDC hdc, DWORD dwStyle,
 	GetClientRect(hwnd, &rc);
 	width = rc.right - rc.left;
 
-	plbi = lstGetItem(pData, pData->itemTop);
+	plbi = lstFirstItem(pData, pData->itemTop, &lp);
 	SelectObject(hdc, GET_WND_FONT(hwnd));
 
 	for (i = 0; plbi && i < (pData->itemVisibles + 1); i++) {
@@ -704,7 +818,7 @@ lstOnDrawSListBoxItems(HWND hwnd, HDC hdc, DWORD dwStyle,
 		}
 
 		y += itemHeight;
-		plbi = plbi->next;
+		plbi = lstNextItem(pData, &lp);
 	}
 }
 
@@ -712,6 +826,7 @@ static int
 lstSelectItem(DWORD dwStyle, PLISTBOXDATA pData, int newSel)
 {
 	PLISTBOXITEM plbi, newItem;
+	LISTBOXPOS lp;
 	int index;
 
 	newItem = lstGetItem(pData, newSel);
@@ -731,7 +846,7 @@ lstSelectItem(DWORD dwStyle, PLISTBOXDATA pData, int newSel)
 	}
 
 	index = 0;
-	plbi = pData->head;
+	plbi = lstFirstItem(pData, 0, &lp);
 	while (plbi) {
 		if (plbi->dwFlags & LBIF_SELECTED) {
 			if (index != newSel) {
@@ -742,7 +857,7 @@ lstSelectItem(DWORD dwStyle, PLISTBOXDATA pData, int newSel)
 			break;
 		}
 
-		plbi = plbi->next;
+		plbi = lstNextItem(pData, &lp);
 		index++;
 	}
 
@@ -962,6 +1077,12 @@ ListboxCtrlProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 				pos = lstAddNewItem(dwStyle, pData, newItem, -1);
 			else
 				pos = lstAddNewItem(dwStyle, pData, newItem, (int) wParam);
+			if (pos < 0) {
+				FreeFixStr(newItem->key);
+				lstFreeItem(pData, newItem);
+				NotifyParent(hwnd, pCtrl->id, LBN_ERRSPACE);
+				return LB_ERRSPACE;
+			}
 
 			lstInvalidateUnderItem(hwnd, pData, pos);
 			if ((dwStyle & LBS_OWNERDRAWVARIABLE))
@@ -985,8 +1106,6 @@ ListboxCtrlProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 				FreeFixStr(removed->key);
 				lstFreeItem(pData, removed);
 
-				pData->itemCount--;
-
 				if (pData->itemTop != 0
 				    && pData->itemCount <=
 				    pData->itemVisibles) {
@@ -1108,19 +1227,20 @@ ListboxCtrlProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 	case LB_GETCURSEL:
 		{
 			PLISTBOXITEM plbi;
+			LISTBOXPOS lp;
 			int index = 0;
 
 			pData = (PLISTBOXDATA) pCtrl->userdata;
 			if (dwStyle & LBS_MULTIPLESEL)
 				return pData->itemHilighted;
 
-			plbi = pData->head;
+			plbi = lstFirstItem(pData, 0, &lp);
 			while (plbi) {
 				if (plbi->dwFlags & LBIF_SELECTED)
 					return index;
 
 				index++;
-				plbi = plbi->next;
+				plbi = lstNextItem(pData, &lp);
 			}
 
 			return LB_ERR;
@@ -1131,15 +1251,16 @@ ListboxCtrlProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 		{
 			int nSel;
 			PLISTBOXITEM plbi;
+			LISTBOXPOS lp;
 
 			pData = (PLISTBOXDATA) pCtrl->userdata;
 
 			nSel = 0;
-			plbi = pData->head;
+			plbi = lstFirstItem(pData, 0, &lp);
 			while (plbi) {
 				if (plbi->dwFlags & LBIF_SELECTED)
 					nSel++;
-				plbi = plbi->next;
+				plbi = lstNextItem(pData, &lp);
 			}
 
 			return nSel;
@@ -1352,12 +1473,13 @@ ListboxCtrlProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 			int index = 0;
 			int *pInt;
 			PLISTBOXITEM plbi;
+			LISTBOXPOS lp;
 
 			nItem = (int) wParam;
 			pInt = (int *) lParam;
 
 			pData = (PLISTBOXDATA) pCtrl->userdata;
-			plbi = pData->head;
+			plbi = lstFirstItem(pData, 0, &lp);
 			while (plbi) {
 
 				if (plbi->dwFlags & LBIF_SELECTED) {
@@ -1370,7 +1492,7 @@ ListboxCtrlProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 					nSel++;
 				}
 
-				plbi = plbi->next;
+				plbi = lstNextItem(pData, &lp);
 				index++;
 			}
 
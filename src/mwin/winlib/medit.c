@@ -67,8 +67,10 @@
 #define MARGIN_MEDIT_RIGHT       2
 #define MARGIN_MEDIT_BOTTOM      1
 
-#define LEN_MLEDIT_BUFFER       3000
+#define LEN_MLEDIT_BUFFER       3000	/* max line length */
 #define LEN_MLEDIT_UNDOBUFFER   1024
+#define LEN_MLEDIT_LINEINC      32	/* line buffer growth, power of 2 */
+#define LEN_MLEDIT_LINEINDEX    64	/* initial line index size */
 
 #define EST_FOCUSED     0x00000001L
 #define EST_MODIFY      0x00000002L
@@ -81,11 +83,9 @@
 #define MEDIT_OP_REPLACE 0x03
 
 typedef struct tagLINEDATA {
-	int     lineNO;	                  /* к */
-	int     dataEnd; 
-	struct  tagLINEDATA *previous;    /* ǰһ */
-	struct  tagLINEDATA *next;        /* һ */
-	char    buffer[LEN_MLEDIT_BUFFER+1];
+	int     dataEnd;		/* line length */
+	int     bufLen;			/* allocated buffer size */
+	char    *buffer;		/* line text, '\0' terminated */
 }LINEDATA;
 typedef    LINEDATA*     PLINEDATA;
 
@@ -130,8 +130,10 @@ typedef struct tagMLEDITDATA {
     int     undoBufferLen;  /* undo buffer len */
     char    undoBuffer [LEN_MLEDIT_UNDOBUFFER];
                             /* Undo buffer; */
-    PLINEDATA   head;       /* buffer */
-    PLINEDATA   tail;       /* ܲҪ */
+    PLINEDATA*  lineBuf;    /* line index, gap buffer of line pointers */
+    int     lineBufLen;     /* allocated line index entries */
+    int     gapStart;       /* first free entry in line index */
+    int     gapEnd;         /* first used entry after the gap */
 }MLEDITDATA;
 typedef MLEDITDATA* PMLEDITDATA;
 
@@ -512,63 +514,223 @@ static BOOL edtIsACCharFromBegin(const char* string,int len,int pos)
 	return FALSE;
 }
 
-static int GetRETURNPos(char *str)
+/* grow line text buffer to hold len chars plus terminator */
+static BOOL edtReserveLine (PLINEDATA pLineData, int len)
 {
-	int i;
-	for(i=0;i<strlen(str);i++)
-	{	
-		if(str[i]==10)
-			return i;
+	char *buffer;
+	int  bufLen;
+
+	if (len < pLineData->bufLen)
+		return TRUE;
+	bufLen = (len + LEN_MLEDIT_LINEINC) & ~(LEN_MLEDIT_LINEINC - 1);
+	if (!(buffer = realloc (pLineData->buffer, bufLen)))
+		return FALSE;
+	pLineData->buffer = buffer;
+	pLineData->bufLen = bufLen;
+	return TRUE;
+}
+
+static PLINEDATA edtNewLine (const char* text, int len)
+{
+	PLINEDATA pLineData;
+
+	if (!(pLineData = malloc (sizeof (LINEDATA))))
+		return NULL;
+	pLineData->buffer = NULL;
+	pLineData->bufLen = 0;
+	if (!edtReserveLine (pLineData, len)) {
+		free (pLineData);
+		return NULL;
 	}
-	return -1;
+	memcpy (pLineData->buffer, text, len);
+	pLineData->buffer[len] = '\0';
+	pLineData->dataEnd = len;
+	return pLineData;
 }
 
-static void MLEditInitBuffer (PMLEDITDATA pMLEditData,char *spcaption)
+static void edtFreeLine (PLINEDATA pLineData)
 {
-	char *caption=spcaption; 
-    int off1;
-	int lineNO=0;
-	PLINEDATA  pLineData;
-	if (!(pMLEditData->head = malloc (sizeof (LINEDATA)))) {
-		DPRINTF( "EDITLINE: malloc error!\n");
-		return ;
+	if (pLineData) {
+		free (pLineData->buffer);
+		free (pLineData);
 	}
-	pMLEditData->head->previous = NULL;
-	pLineData=pMLEditData->head;	
-	while ( (off1 = GetRETURNPos(caption)) != -1)
-	{
-		off1 = min(off1, LEN_MLEDIT_BUFFER);
-		memcpy(pLineData->buffer,caption,off1);
-		pLineData->buffer[off1] = '\0';
-		caption+=min(off1,LEN_MLEDIT_BUFFER)+1;
-		pLineData->lineNO  = lineNO;
-		pMLEditData->dispPos = 0;
-		pLineData->dataEnd = strlen(pLineData->buffer); 
-		pLineData->next    = malloc (sizeof (LINEDATA));
-		pLineData->next->previous = pLineData; 
-		pLineData = pLineData->next;
-		lineNO++;
-	}	
-	off1 = min(strlen(caption),LEN_MLEDIT_BUFFER);
-	memcpy(pLineData->buffer,caption,off1);
-	pLineData->buffer[off1] = '\0';
-	pLineData->lineNO  = lineNO++;
-	pMLEditData->dispPos = 0;
-	pLineData->dataEnd = strlen(pLineData->buffer); 
-	pLineData->next    = NULL; 
-	pMLEditData->lines      = lineNO ; 
+}
+
+/*
+ * The line index is a gap buffer of line pointers.  Line lookup is
+ * constant time and inserting or removing lines next to the previous
+ * edit only moves the gap, so line numbers never need renumbering.
+ */
+static void edtMoveGap (PMLEDITDATA pMLEditData, int lineNO)
+{
+	PLINEDATA* lineBuf = pMLEditData->lineBuf;
+	int n;
+
+	if (lineNO < pMLEditData->gapStart) {
+		n = pMLEditData->gapStart - lineNO;
+		memmove (&lineBuf[pMLEditData->gapEnd - n], &lineBuf[lineNO],
+			n * sizeof (PLINEDATA));
+		pMLEditData->gapStart -= n;
+		pMLEditData->gapEnd -= n;
+	}
+	else if (lineNO > pMLEditData->gapStart) {
+		n = lineNO - pMLEditData->gapStart;
+		memmove (&lineBuf[pMLEditData->gapStart], &lineBuf[pMLEditData->gapEnd],
+			n * sizeof (PLINEDATA));
+		pMLEditData->gapStart += n;
+		pMLEditData->gapEnd += n;
+	}
+}
+
+static BOOL edtInsertLine (PMLEDITDATA pMLEditData, int lineNO, PLINEDATA pLineData)
+{
+	if (pMLEditData->gapStart == pMLEditData->gapEnd) {
+		PLINEDATA* lineBuf;
+		int newLen = pMLEditData->lineBufLen * 2;
+		int tail = pMLEditData->lineBufLen - pMLEditData->gapEnd;
+
+		if (newLen < LEN_MLEDIT_LINEINDEX)
+			newLen = LEN_MLEDIT_LINEINDEX;
+		if (!(lineBuf = realloc (pMLEditData->lineBuf, newLen * sizeof (PLINEDATA))))
+			return FALSE;
+		memmove (&lineBuf[newLen - tail], &lineBuf[pMLEditData->gapEnd],
+			tail * sizeof (PLINEDATA));
+		pMLEditData->lineBuf = lineBuf;
+		pMLEditData->gapEnd = newLen - tail;
+		pMLEditData->lineBufLen = newLen;
+	}
+	edtMoveGap (pMLEditData, lineNO);
+	pMLEditData->lineBuf[pMLEditData->gapStart++] = pLineData;
+	pMLEditData->lines++;
+	return TRUE;
+}
+
+/* unlink line from index, caller frees it */
+static PLINEDATA edtRemoveLine (PMLEDITDATA pMLEditData, int lineNO)
+{
+	edtMoveGap (pMLEditData, lineNO);
+	pMLEditData->lines--;
+	return pMLEditData->lineBuf[pMLEditData->gapEnd++];
 }
 
 static PLINEDATA GetLineData(PMLEDITDATA pMLEditData,int lineNO)
 {
-	PLINEDATA pLineData=pMLEditData->head;
-	while(pLineData)
-	{
-		if(pLineData->lineNO==lineNO)
-			return pLineData;
-		pLineData = pLineData->next;
+	if (lineNO < 0 || lineNO >= pMLEditData->lines)
+		return NULL;
+	if (lineNO >= pMLEditData->gapStart)
+		lineNO += pMLEditData->gapEnd - pMLEditData->gapStart;
+	return pMLEditData->lineBuf[lineNO];
+}
+
+static void edtFreeLines (PMLEDITDATA pMLEditData)
+{
+	int i;
+
+	for (i = 0; i < pMLEditData->lines; i++)
+		edtFreeLine (GetLineData (pMLEditData, i));
+	free (pMLEditData->lineBuf);
+	pMLEditData->lineBuf = NULL;
+	pMLEditData->lineBufLen = 0;
+	pMLEditData->gapStart = pMLEditData->gapEnd = 0;
+	pMLEditData->lines = 0;
+}
+
+static BOOL MLEditInitBuffer (PMLEDITDATA pMLEditData,char *spcaption)
+{
+	char *caption = spcaption;
+	char *eol;
+	int len;
+	PLINEDATA  pLineData;
+
+	pMLEditData->lineBuf = NULL;
+	pMLEditData->lineBufLen = 0;
+	pMLEditData->gapStart = pMLEditData->gapEnd = 0;
+	pMLEditData->lines = 0;
+	pMLEditData->dispPos = 0;
+	do {
+		eol = strchr (caption, '\n');
+		len = eol? eol - caption: strlen (caption);
+		pLineData = edtNewLine (caption, min (len, LEN_MLEDIT_BUFFER));
+		if (!pLineData || !edtInsertLine (pMLEditData, pMLEditData->lines, pLineData)) {
+			DPRINTF( "EDITLINE: malloc error!\n");
+			edtFreeLine (pLineData);
+			edtFreeLines (pMLEditData);
+			return FALSE;
+		}
+		caption += len + 1;
+	} while (eol);
+	return TRUE;
+}
+
+/* invalidate displayed lines first through last, last < 0 for all below first */
+static void edtInvalidateLines (HWND hWnd, PMLEDITDATA pMLEditData, int first, int last)
+{
+	RECT rc;
+	int  h = GetSysCharHeight (hWnd);
+
+	GetClientRect (hWnd, &rc);
+	if (first < pMLEditData->StartlineDisp)
+		first = pMLEditData->StartlineDisp;
+	rc.top = (first - pMLEditData->StartlineDisp) * h + pMLEditData->topMargin;
+	if (last >= 0)
+		rc.bottom = min (rc.bottom,
+			(last - pMLEditData->StartlineDisp + 1) * h + pMLEditData->topMargin);
+	if (rc.top < rc.bottom)
+		InvalidateRect (hWnd, &rc, FALSE);
+}
+
+/* blit text for a vertical scroll from oldStart and invalidate the exposed strip */
+static void edtScrollLines (HWND hWnd, PMLEDITDATA pMLEditData, int oldStart)
+{
+	RECT rc;
+	HDC  hdc;
+	int  h = GetSysCharHeight (hWnd);
+	int  dy = (oldStart - pMLEditData->StartlineDisp) * h;
+	int  height;
+
+	if (dy == 0)
+		return;
+	GetClientRect (hWnd, &rc);
+	rc.top = pMLEditData->topMargin;
+	rc.bottom = min (rc.bottom, rc.top + pMLEditData->MaxlinesDisp * h);
+	height = rc.bottom - rc.top - abs (dy);
+
+	/* pending updates would be left at the old place, repaint everything */
+	if (height <= 0 || !IsWindowVisible (hWnd) || GetUpdateRect (hWnd, NULL, FALSE)) {
+		InvalidateRect (hWnd, NULL, FALSE);
+		return;
 	}
-	return NULL;
+
+	HideCaret (hWnd);
+	hdc = GetDC (hWnd);
+	if (dy < 0)
+		BitBlt (hdc, 0, rc.top, rc.right, height, hdc, 0, rc.top - dy, SRCCOPY);
+	else
+		BitBlt (hdc, 0, rc.top + dy, rc.right, height, hdc, 0, rc.top, SRCCOPY);
+	ReleaseDC (hWnd, hdc);
+	ShowCaret (hWnd);
+
+	if (dy < 0)
+		rc.top += height;
+	else
+		rc.bottom = rc.top + dy;
+	InvalidateRect (hWnd, &rc, FALSE);
+}
+
+/*
+ * Repaint after a key: horizontal scrolling moves every line so repaints
+ * all, otherwise blit any vertical scroll and repaint the changed lines.
+ */
+static void edtRefresh (HWND hWnd, PMLEDITDATA pMLEditData, int oldStart, int oldDispPos,
+	int first, int last)
+{
+	if (pMLEditData->dispPos != oldDispPos) {
+		InvalidateRect (hWnd, NULL, FALSE);
+		return;
+	}
+	edtScrollLines (hWnd, pMLEditData, oldStart);
+	if (first >= 0)
+		edtInvalidateLines (hWnd, pMLEditData, first, last);
 }
 
 int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lParam)
@@ -595,7 +757,10 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
             pMLEditData->editLine       = 0;
             pMLEditData->caretPos       = 0;
 
-	    MLEditInitBuffer(pMLEditData,GetWindowCaption(hWnd));	
+	    if (!MLEditInitBuffer(pMLEditData,GetWindowCaption(hWnd))) {
+		free(pMLEditData);
+		return -1;
+	    }
 
 	    GetClientRect(hWnd,&clientRect);            
 	    pMLEditData->MaxlinesDisp   = (clientRect.bottom-clientRect.top)/GetSysCharHeight(hWnd);
@@ -625,17 +790,9 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 	}
         case WM_DESTROY:
         {
-		PLINEDATA temp;
 		pMLEditData = GET_WND_DATA(hWnd);
 	    	DestroyCaret ();
-		pLineData = pMLEditData->head;	
-		while(pLineData)
-		{
-			/*DPRINTF("delete lineNO = %d,buffer=%s\n",pLineData->lineNO,pLineData->buffer);*/
-			temp = pLineData->next;
-			free(pLineData);
-			pLineData = temp;
-		}		
+		edtFreeLines(pMLEditData);
             	free(pMLEditData); 
 	}
         break;
@@ -751,8 +908,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 
         case WM_PAINT:
         {
-            int     dispLen,i;
-            char*   dispBuffer;
+            int     dispLen,i,first,last;
             RECT    rect,rc;
 	    PAINTSTRUCT ps;
 #ifdef USE_BIG5	    
@@ -777,9 +933,19 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
             SetTextColor (hdc, BLACK/*PIXEL_black*/);
 
             pMLEditData = GET_WND_DATA(hWnd);
-			for(i = pMLEditData->StartlineDisp; i <= pMLEditData->EndlineDisp; i++)
+
+            /* only draw lines within the invalidated area */
+            first = pMLEditData->StartlineDisp + (ps.rcPaint.top - pMLEditData->topMargin)
+                    / GetSysCharHeight(hWnd);
+            last = pMLEditData->StartlineDisp + (ps.rcPaint.bottom - pMLEditData->topMargin - 1)
+                    / GetSysCharHeight(hWnd);
+            first = max(first, pMLEditData->StartlineDisp);
+            last = min(last, pMLEditData->EndlineDisp);
+			for(i = first; i <= last; i++)
 			{
 				pLineData= GetLineData(pMLEditData,i);
+				if (!pLineData)
+					break;
             	dispLen = edtGetDispLen (hWnd,pLineData);
          	    if (dispLen == 0 && pMLEditData->EndlineDisp >= pMLEditData->lines) {
                 	continue;
@@ -790,22 +956,13 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
         	        DPRINTF( "ASSERT failure: %s.\n", "Edit Paint");
 #endif
             
-                dispBuffer = alloca (LEN_MLEDIT_BUFFER+1);
-
-                if (dwStyle & ES_PASSWORD)
-                    memset (dispBuffer, '*', pLineData->dataEnd);
-				    memcpy (dispBuffer, 
-                   	    pLineData->buffer,	/* +pMLEditData->dispPos, */
-						pLineData->dataEnd);	/* - pMLEditData->dispPos); */
-               		dispBuffer[pLineData->dataEnd] = '\0';
-
             /* only implemented ES_LEFT align format for single line edit. */
                 rect.left = pMLEditData->leftMargin;
                 rect.top = pMLEditData->topMargin ;
                 rect.right = pMLEditData->rightMargin;
                 rect.bottom = pMLEditData->bottomMargin;
 #if 0
-		DPRINTF("lineNO=%d,lines=%d,editLine=%d\n",pLineData->lineNO,pMLEditData->lines,
+		DPRINTF("lineNO=%d,lines=%d,editLine=%d\n",i,pMLEditData->lines,
 			pMLEditData->editLine);
 		DPRINTF("--dispBuffer=%s--\n",dispBuffer);
                 ClipRectIntersect (hdc, &rect);	/* fix: no ClipRectIntersect() */
@@ -819,9 +976,9 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 #endif
                 TextOut (hdc, 
 				pMLEditData->leftMargin - pMLEditData->dispPos * GetSysCharWidth(hWnd) ,
-				GetSysCharHeight(hWnd)*(pLineData->lineNO - pMLEditData->StartlineDisp) 
+				GetSysCharHeight(hWnd)*(i - pMLEditData->StartlineDisp) 
 					+ pMLEditData->topMargin,
-				dispBuffer,-1);
+				pLineData->buffer,pLineData->dataEnd);
 			}
 #ifdef USE_BIG5	    
     	    DeleteObject(SelectObject(hdc,oldfont));
@@ -835,10 +992,12 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
             BOOL    bChange = FALSE;
             int     i;
             int     deleted;
+            int     oldStart, oldDispPos;
 			PLINEDATA temp = NULL;
-			char *  tempP = NULL;
 
             pMLEditData = GET_WND_DATA(hWnd);
+            oldStart = pMLEditData->StartlineDisp;
+            oldDispPos = pMLEditData->dispPos;
         
             switch (LOWORD (wParam))
             {
@@ -846,34 +1005,15 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
                 case VK_RETURN: 	/* SCANCODE_ENTER: */
 				{
 					pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
-					if (pMLEditData->editPos < pLineData->dataEnd)
-						tempP = pLineData->buffer + pMLEditData->editPos;
-				    temp = pLineData->next;
-					pLineData->next = malloc( sizeof(LINEDATA) );
-					pLineData->next->previous = pLineData;
-					pLineData->next->next = temp;
-					if(temp)
-					{
-						temp->previous = pLineData->next;
-					}
-					temp = pLineData->next;
-					temp->lineNO  = pMLEditData->editLine + 1;
-					if(tempP)
+					temp = edtNewLine(pLineData->buffer + pMLEditData->editPos,
+						pLineData->dataEnd - pMLEditData->editPos);
+					if (!temp || !edtInsertLine(pMLEditData, pMLEditData->editLine + 1, temp))
 					{
-						memcpy(temp->buffer,tempP,strlen(tempP));
-						temp->dataEnd = strlen(tempP);
+						edtFreeLine(temp);
+						return 0;
 					}
-					else
-						temp->dataEnd = 0;
-					temp->buffer[temp->dataEnd] = '\0'; 
 					pLineData->dataEnd = pMLEditData->editPos;
 					pLineData->buffer[pLineData->dataEnd]='\0';
-					temp = temp->next;
-					while (temp)
-					{
-						temp->lineNO++;
-						temp = temp->next;
-					}
 					pMLEditData->editPos = 0;
 					pMLEditData->caretPos= 0;
 					pMLEditData->dispPos = 0;
@@ -888,12 +1028,12 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 						pMLEditData->EndlineDisp++;
 					}
 					pMLEditData->editLine++;
-					pMLEditData->lines++;
                     SetCaretPos (pMLEditData->caretPos * GetSysCharWidth (hWnd) 
                             + pMLEditData->leftMargin, 
                         (pMLEditData->editLine - pMLEditData->StartlineDisp) * GetSysCharHeight(hWnd)
 							+pMLEditData->topMargin);
-    	            InvalidateRect (hWnd, NULL, FALSE);
+					edtRefresh(hWnd, pMLEditData, oldStart, oldDispPos,
+						pMLEditData->editLine - 1, -1);
         	        return 0;
 				}
                 case VK_HOME: 	/* SCANCODE_HOME: */
@@ -946,7 +1086,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 					pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
                     if (pMLEditData->editPos == 0 )
 					{
-						temp = pLineData->previous;
+						temp = GetLineData(pMLEditData,pMLEditData->editLine - 1);
 						if(temp && pMLEditData->editLine > pMLEditData->StartlineDisp)
 						{
 							pMLEditData->editLine --;						
@@ -1015,7 +1155,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 					pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
                     if (pMLEditData->editPos == pLineData->dataEnd)
 					{
-						temp = pLineData->next;
+						temp = GetLineData(pMLEditData,pMLEditData->editLine + 1);
 						if(temp)
 						{
 							pMLEditData->editLine++;
@@ -1095,7 +1235,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
                     int  newStartPos;
 					PLINEDATA temp;
 					pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
-					temp = pLineData->previous; 
+					temp = GetLineData(pMLEditData,pMLEditData->editLine - 1);
 					if(pMLEditData->editLine == 0)
 						return 0;
 					else if (pMLEditData->editLine == pMLEditData->StartlineDisp)
@@ -1137,7 +1277,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 					    (pMLEditData->editLine - pMLEditData->StartlineDisp) * GetSysCharHeight(hWnd)
                             + pMLEditData->topMargin);
 					if(bScroll)
-						InvalidateRect(hWnd,NULL,FALSE);	
+						edtRefresh(hWnd, pMLEditData, oldStart, oldDispPos, -1, -1);
 				}
 				break;
 		case VK_DOWN: /* SCANCODE_CURSORBLOCKDOWN: */
@@ -1146,7 +1286,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
                     int  newStartPos;
 					PLINEDATA temp;
 					pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
-					temp = pLineData->next; 
+					temp = GetLineData(pMLEditData,pMLEditData->editLine + 1);
 					if(pMLEditData->editLine == pMLEditData->lines-1)
 						return 0;
 					else if (pMLEditData->editLine == pMLEditData->EndlineDisp)
@@ -1188,7 +1328,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 					    (pMLEditData->editLine - pMLEditData->StartlineDisp) * GetSysCharHeight(hWnd)
                             + pMLEditData->topMargin);
 					if(bScroll)
-						InvalidateRect(hWnd,NULL,FALSE);	
+						edtRefresh(hWnd, pMLEditData, oldStart, oldDispPos, -1, -1);
 		
 				}
 				break;
@@ -1202,6 +1342,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 				{
 					PLINEDATA temp;
 					int leftLen;
+					int lastLine = pMLEditData->editLine;
 					pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
                     if ((GetWindowAdditionalData(hWnd) & EST_READONLY) ){
 #if 0	/* fix: no ping() */
@@ -1209,28 +1350,18 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 #endif
                         return 0;
                     }
-                   	temp = pLineData->next; 
+                   	temp = GetLineData(pMLEditData,pMLEditData->editLine + 1);
 					if (pLineData->dataEnd == pMLEditData->editPos && temp)
 					{
+						lastLine = -1;
+						if (!edtReserveLine(pLineData, min(pLineData->dataEnd + temp->dataEnd,
+								LEN_MLEDIT_BUFFER)))
+							return 0;
 						if(pLineData->dataEnd + temp->dataEnd <= LEN_MLEDIT_BUFFER)
 						{
 							memcpy(pLineData->buffer+pLineData->dataEnd,temp->buffer,temp->dataEnd);	
 							pLineData->dataEnd += temp->dataEnd;
 							pLineData->buffer[pLineData->dataEnd] = '\0';
-							if(temp->next)
-							{
-							    pLineData->next = temp->next;
-								temp->next->previous = pLineData;	
-							}
-							else
-								pLineData->next = NULL;
-							free(temp);
-							temp = pLineData->next;
-							while (temp)
-							{
-								temp->lineNO--;
-								temp = temp->next;
-							}
 							if(pMLEditData->lines <= pMLEditData->MaxlinesDisp)
 							{
 								pMLEditData->EndlineDisp--;
@@ -1244,7 +1375,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 								else
 									pMLEditData->linesDisp--;
 							}
-							pMLEditData->lines--;
+							edtFreeLine(edtRemoveLine(pMLEditData, pMLEditData->editLine + 1));
 						}
 						else if (temp->dataEnd > 0)
 						{
@@ -1276,7 +1407,8 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 						pLineData->buffer[pLineData->dataEnd] = '\0';
 					}
                 	bChange = TRUE;
-                    InvalidateRect (hWnd, NULL,FALSE);
+					edtRefresh(hWnd, pMLEditData, oldStart, oldDispPos,
+						pMLEditData->editLine, lastLine);
 				}
                 break;
 
@@ -1284,6 +1416,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 				{
 					PLINEDATA temp;
 					int leftLen,tempEnd;
+					int lastLine = pMLEditData->editLine;
                     if ((GetWindowAdditionalData(hWnd) & EST_READONLY) ){
 #if 0	 /* fix: no Ping() */
                         Ping ();
@@ -1291,30 +1424,19 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
                         return 0;
                     }
 					pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
-					temp = pLineData->previous;	
+					temp = GetLineData(pMLEditData,pMLEditData->editLine - 1);
 					if (pMLEditData->editPos == 0 && temp)
 					{
+						lastLine = -1;
 						tempEnd = temp->dataEnd;
+						if (!edtReserveLine(temp, min(pLineData->dataEnd + temp->dataEnd,
+								LEN_MLEDIT_BUFFER)))
+							return 0;
 						if(pLineData->dataEnd + temp->dataEnd <= LEN_MLEDIT_BUFFER)	
 						{
 							memcpy(temp->buffer+temp->dataEnd,pLineData->buffer,pLineData->dataEnd);	
 							temp->dataEnd +=pLineData->dataEnd;
 							temp->buffer[temp->dataEnd] = '\0';
-							if(pLineData->next)
-							{
-							    temp->next = pLineData->next;
-								pLineData->next->previous = temp;
-							}
-							else
-								temp->next = NULL;
-							free(pLineData);
-							pLineData = temp;
-							temp = temp->next;
-							while(temp)
-							{
-								temp->lineNO--;
-								temp = temp->next;
-							}
 							if(pMLEditData->StartlineDisp == pMLEditData->editLine
 									&& pMLEditData->StartlineDisp != 0)
 							{
@@ -1327,7 +1449,8 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 								pMLEditData->linesDisp--;
 								pMLEditData->EndlineDisp--;
 							}
-							pMLEditData->lines--;
+							edtFreeLine(edtRemoveLine(pMLEditData, pMLEditData->editLine));
+							pLineData = temp;
 						}
 						else if (pLineData->dataEnd > 0)
 						{
@@ -1399,7 +1522,8 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
                             + pMLEditData->leftMargin, 
 					    (pMLEditData->editLine - pMLEditData->StartlineDisp) * GetSysCharHeight(hWnd)
                             + pMLEditData->topMargin);
-                    InvalidateRect (hWnd, NULL, FALSE);
+					edtRefresh(hWnd, pMLEditData, oldStart, oldDispPos,
+						pMLEditData->editLine, lastLine);
 				}
                 break;
 
@@ -1418,8 +1542,10 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
         {
             char charBuffer [2];
             int  i, chars, scrollStep, inserting;
+            int  oldDispPos;
 	
             pMLEditData = GET_WND_DATA(hWnd);
+            oldDispPos = pMLEditData->dispPos;
 
 			pLineData = GetLineData(pMLEditData,pMLEditData->editLine);
 
@@ -1496,6 +1622,8 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
                             (LPARAM) hWnd);
                 return 0;
             }
+            if (!edtReserveLine (pLineData, pLineData->dataEnd + max (inserting, chars)))
+                return 0;
             if (inserting == -1) {
                 for (i = pMLEditData->editPos; i < pLineData->dataEnd-1; i++)
                     pLineData->buffer [i] = pLineData->buffer [i + 1];
@@ -1545,7 +1673,8 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
                             + pMLEditData->leftMargin, 
 					    (pMLEditData->editLine - pMLEditData->StartlineDisp) * GetSysCharHeight(hWnd)
                             + pMLEditData->topMargin);
-            InvalidateRect (hWnd, NULL,FALSE);
+            edtRefresh (hWnd, pMLEditData, pMLEditData->StartlineDisp, oldDispPos,
+                pMLEditData->editLine, pMLEditData->editLine);
 			//format = DT_NOPREFIX;
             SendMessage (GetParent (hWnd), WM_COMMAND,
                     (WPARAM) MAKELONG (GetDlgCtrlID(hWnd), EN_CHANGE),
@@ -1558,28 +1687,23 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
 			PLINEDATA temp;
 			int    lineNO = (int)wParam;
             pMLEditData = GET_WND_DATA(hWnd);
-			temp = pMLEditData->head;
-			while(temp)
-			{
-				if (temp->lineNO == lineNO)
-					return  temp->dataEnd;
-				temp = temp->next;
-			}
+			temp = GetLineData(pMLEditData,lineNO);
+			if (temp)
+				return  temp->dataEnd;
         return -1;
         }
 		case WM_GETTEXT:
 		{
 			PLINEDATA temp;
-			int len,total = 0;
+			int i,len,total = 0;
 			char * buffer = (char*)lParam;
             pMLEditData = GET_WND_DATA(hWnd);
 			len = (int)wParam;
-			temp = pMLEditData->head;
-			while (temp && total + temp->dataEnd < len)  
+			for (i = 0; (temp = GetLineData(pMLEditData,i)) != NULL
+					&& total + temp->dataEnd < len; i++)
 			{
 				memcpy(buffer+total,temp->buffer,temp->dataEnd);
 				total += temp->dataEnd;
-				temp = temp->next;
 			}	
 					
 		}
@@ -1625,19 +1749,15 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
             
             len = strlen ((char*)lParam);
 			lineNO = (int)wParam;
-			temp = pMLEditData->head;
+			temp = GetLineData(pMLEditData,lineNO);
             len = min (len, pMLEditData->totalLen);
             
             if (pMLEditData->hardLimit >= 0)
                 len = min (len, pMLEditData->hardLimit);
-          	while (temp)
+          	if (temp && edtReserveLine (temp, len))
 			{
-				if(temp->lineNO == lineNO)
-				{
      		        temp->dataEnd = len;
             	    memcpy (temp->buffer, (char*)lParam, len);
-				}
-				temp = temp->next;
 			}
             pMLEditData->editPos        = 0;
             pMLEditData->caretPos       = 0;
@@ -1671,7 +1791,7 @@ int CALLBACK MLEditCtrlProc (HWND hWnd, int message, WPARAM wParam, LPARAM lPara
    	        		newOff = edtGetOffset (hWnd,pMLEditData,temp, LOWORD(lParam)+GetSysCharWidth(hWnd)/2);
 				}
     	        if (newOff != pMLEditData->caretPos || lineNO != pMLEditData->editLine) {
-					pMLEditData->editLine = temp->lineNO;
+					pMLEditData->editLine = lineNO;
    	        	    pMLEditData->editPos = newOff +pMLEditData->dispPos;
         	        pMLEditData->caretPos = newOff;
    	        	    SetCaretPos (pMLEditData->caretPos * GetSysCharWidth (hWnd) 
@@ -43,6 +43,7 @@ typedef struct {
 
 /* Missing defines WINUSER.H */
 #define LBS_DISABLENOSCROLL 4096
+#define LBS_NODATA	0x2000	/* owner data, requires LBS_OWNERDRAWFIXED*/
 
 /* Start of hack section -------------------------------- */
 
@@ -84,6 +85,7 @@ typedef struct
     INT         height;         /* Window height */
     LB_ITEMDATA  *items;          /* Array of items */
     INT         nb_items;       /* Number of items */
+    INT         max_items;      /* Allocated size of items array */
     INT         top_item;       /* Top visible item */
     INT         selected_item;  /* Selected item */
     INT         focus_item;     /* Item that has the focus */
@@ -112,6 +114,10 @@ typedef struct
 #define HAS_STRINGS(descr) \
     (!IS_OWNERDRAW(descr) || ((descr)->style & LBS_HASSTRINGS))
 
+/* owner data listbox: rows are drawn by the owner, only count and selection kept */
+#define IS_NODATA(descr) \
+    ((descr)->style & LBS_NODATA)
+
 
 #define IS_MULTISELECT(descr) \
     ((descr)->style & LBS_MULTIPLESEL || ((descr)->style & LBS_EXTENDEDSEL))
@@ -734,21 +740,40 @@ static void LISTBOX_RepaintItem( HWND hwnd, LB_DESCR *descr, INT index,
 
 
 /***********************************************************************
- *           LISTBOX_InitStorage
+ *           LISTBOX_GrowStorage
+ *
+ * Make room for at least 'nb_items' items, growing the array by half
+ * its size so that filling a listbox doesn't realloc on every insert.
  */
-static LRESULT LISTBOX_InitStorage( HWND hwnd, LB_DESCR *descr, INT nb_items )
+static BOOL LISTBOX_GrowStorage( LB_DESCR *descr, INT nb_items )
 {
     LB_ITEMDATA *item;
+    INT max_items;
+
+    if (nb_items <= descr->max_items) return TRUE;
+    max_items = descr->max_items + descr->max_items / 2;
+    if (max_items < nb_items) max_items = nb_items;
+    max_items += LB_ARRAY_GRANULARITY - 1;
+    max_items -= (max_items % LB_ARRAY_GRANULARITY);
+    if (!(item = realloc ( descr->items, max_items * sizeof(LB_ITEMDATA) )))
+        return FALSE;
+    descr->items = item;
+    descr->max_items = max_items;
+    return TRUE;
+}
+
 
-    nb_items += LB_ARRAY_GRANULARITY - 1;
-    nb_items -= (nb_items % LB_ARRAY_GRANULARITY);
-    if (descr->items) nb_items++;
-    if (!(item = realloc ( descr->items, nb_items * sizeof(LB_ITEMDATA) )))
+/***********************************************************************
+ *           LISTBOX_InitStorage
+ */
+static LRESULT LISTBOX_InitStorage( HWND hwnd, LB_DESCR *descr, INT nb_items )
+{
+    if (nb_items < 0) return LB_ERR;
+    if (!LISTBOX_GrowStorage( descr, descr->nb_items + nb_items ))
     {
         SEND_NOTIFICATION( hwnd, descr, LBN_ERRSPACE );
         return LB_ERRSPACE;
     }
-    descr->items = item;
     return LB_OKAY;
 }
 
@@ -907,6 +932,7 @@ static INT LISTBOX_FindString( HWND hwnd, LB_DESCR *descr, INT start,
     INT i;
     LB_ITEMDATA *item;
 
+    if (IS_NODATA(descr)) return LB_ERR;
     if (start >= descr->nb_items) start = -1;
     item = descr->items + start + 1;
     if (HAS_STRINGS(descr))
@@ -1460,7 +1486,6 @@ static LRESULT LISTBOX_InsertItem( HWND hwnd, LB_DESCR *descr, INT index,
                                    LPCSTR str, ULONG_PTR data )
 {
     LB_ITEMDATA *item;
-    INT max_items;
     INT oldfocus = descr->focus_item;
 
     if (index == -1)
@@ -1468,28 +1493,10 @@ static LRESULT LISTBOX_InsertItem( HWND hwnd, LB_DESCR *descr, INT index,
     else if ((index < 0) || (index > descr->nb_items))
 		return LB_ERR;
 
-    if (!descr->items)
-		max_items = 0;
-    else
-		max_items = descr->nb_items;
-
-    if (descr->nb_items == max_items)
+    if (!LISTBOX_GrowStorage( descr, descr->nb_items + 1 ))
     {
-        /* We need to grow the array */
-        max_items += LB_ARRAY_GRANULARITY;
-
-		if (descr->items&&!(item = realloc ( descr->items, max_items * sizeof(LB_ITEMDATA) )))
-        {
-            SEND_NOTIFICATION( hwnd, descr, LBN_ERRSPACE );
-            return LB_ERRSPACE;
-        }
-		else if((!descr->items)&&!(item = malloc( max_items * sizeof(LB_ITEMDATA) )))
-        {
-            SEND_NOTIFICATION( hwnd, descr, LBN_ERRSPACE );
-            return LB_ERRSPACE;
-        }
-
-        descr->items = item;
+        SEND_NOTIFICATION( hwnd, descr, LBN_ERRSPACE );
+        return LB_ERRSPACE;
     }
 
     /* Insert the item structure */
@@ -1557,6 +1564,7 @@ static LRESULT LISTBOX_InsertString( HWND hwnd, LB_DESCR *descr, INT index,
     ULONG_PTR data = 0;
     LRESULT ret;
 
+    if (IS_NODATA(descr)) return LB_ERR;
     if (HAS_STRINGS(descr))
     {
         if (!str) str = "";
@@ -1591,7 +1599,9 @@ static void LISTBOX_DeleteItem( HWND hwnd, LB_DESCR *descr, INT index )
      *       while Win95 sends it for all items with user data.
      *       It's probably better to send it too often than not
      *       often enough, so this is what we do here.
+     *       Owner data items have nothing to delete.
      */
+    if (IS_NODATA(descr)) return;
     if (IS_OWNERDRAW(descr) || descr->items[index].data)
     {
         DELETEITEMSTRUCT dis;
@@ -1638,12 +1648,16 @@ static LRESULT LISTBOX_RemoveItem( HWND hwnd, LB_DESCR *descr, INT index )
 
     /* Shrink the item array if possible */
 
-    max_items = descr->nb_items;
-    if (descr->nb_items < max_items - 2*LB_ARRAY_GRANULARITY)
+    max_items = descr->max_items;
+    if (descr->nb_items < max_items / 2 && max_items > LB_ARRAY_GRANULARITY)
     {
-        max_items -= LB_ARRAY_GRANULARITY;
+        max_items /= 2;
         item = realloc ( descr->items, max_items * sizeof(LB_ITEMDATA) );
-        if (item) descr->items = item;
+        if (item)
+        {
+            descr->items = item;
+            descr->max_items = max_items;
+        }
     }
     /* Repaint the items */
 
@@ -1690,6 +1704,7 @@ static void LISTBOX_ResetContent( HWND hwnd, LB_DESCR *descr )
     descr->focus_item    = 0;
     descr->anchor_item   = -1;
     descr->items         = NULL;
+    descr->max_items     = 0;
 }
 
 
@@ -1700,7 +1715,31 @@ static LRESULT LISTBOX_SetCount( HWND hwnd, LB_DESCR *descr, INT count )
 {
     LRESULT ret;
 
-    if (HAS_STRINGS(descr)) return LB_ERR;
+    if (HAS_STRINGS(descr) || count < 0) return LB_ERR;
+    if (IS_NODATA(descr))
+    {
+        /* owner data: just resize, rows are asked for when painted */
+        if (count > descr->nb_items)
+        {
+            if (!LISTBOX_GrowStorage( descr, count ))
+            {
+                SEND_NOTIFICATION( hwnd, descr, LBN_ERRSPACE );
+                return LB_ERRSPACE;
+            }
+            memset( &descr->items[descr->nb_items], 0,
+                    (count - descr->nb_items) * sizeof(LB_ITEMDATA) );
+        }
+        descr->nb_items = count;
+        if (descr->selected_item >= count) descr->selected_item = -1;
+        if (descr->anchor_item >= count) descr->anchor_item = count - 1;
+        if (descr->focus_item >= count)
+            descr->focus_item = count ? count - 1 : 0;
+        if (descr->top_item > LISTBOX_GetMaxTopIndex( descr ))
+            descr->top_item = LISTBOX_GetMaxTopIndex( descr );
+        LISTBOX_UpdateScroll( hwnd, descr );
+        InvalidateRect( hwnd, NULL, TRUE );
+        return LB_OKAY;
+    }
     /* FIXME: this is far from optimal... */
     if (count > descr->nb_items)
     {
@@ -2422,6 +2461,7 @@ static BOOL LISTBOX_Create( HWND hwnd, LPHEADCOMBO lphc )
     descr->height        = rect.bottom - rect.top;
     descr->items         = NULL;
     descr->nb_items      = 0;
+    descr->max_items     = 0;
     descr->top_item      = 0;
     descr->selected_item = -1;
     descr->focus_item    = 0;
@@ -2464,6 +2504,8 @@ static BOOL LISTBOX_Create( HWND hwnd, LPHEADCOMBO lphc )
 /*    if (wnd->dwExStyle & WS_EX_NOPARENTNOTIFY) descr->style &= ~LBS_NOTIFY;
  */
     if (descr->style & LBS_EXTENDEDSEL) descr->style |= LBS_MULTIPLESEL;
+    if ((descr->style & (LBS_OWNERDRAWFIXED | LBS_HASSTRINGS | LBS_SORT)) != LBS_OWNERDRAWFIXED)
+        descr->style &= ~LBS_NODATA;
     if (descr->style & LBS_MULTICOLUMN) descr->style &= ~LBS_OWNERDRAWVARIABLE;
     if (descr->style & LBS_OWNERDRAWVARIABLE) descr->style |= LBS_NOINTEGRALHEIGHT;
     descr->item_height = LISTBOX_SetFont( hwnd, descr, 0 );
@@ -2591,6 +2633,7 @@ static LRESULT CALLBACK ListBoxWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
     case LB_SETITEMDATA:
         if (((INT)wParam < 0) || ((INT)wParam >= descr->nb_items))
             return LB_ERR;
+        if (IS_NODATA(descr)) return LB_ERR;
         descr->items[wParam].data = (ULONG_PTR)lParam;
         return LB_OKAY;
 
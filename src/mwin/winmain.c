@@ -35,6 +35,7 @@ HWND		focuswp;		/* focus window for keyboard */
 HWND		mousewp;		/* window mouse is currently in */
 HWND		capturewp;		/* capture window*/
 HWND		dragwp;			/* window user is dragging*/
+unsigned long	mwwindowgen = 1;	/* bumped on window position/visibility/zorder change*/
 HCURSOR		curcursor;		/* currently enabled cursor */
 MWCOORD		cursorx;		/* current x position of cursor */
 MWCOORD		cursory;		/* current y position of cursor */
@@ -28,8 +28,26 @@
 
 #define PAINTONCE	1	/* =1 to queue paint msgs only once*/
 #define MOUSETEST	1
+#define TIMERTEST	1	/* =1 to queue timer msgs only once per timer*/
+
+#define MSGQ_CHUNK	64	/* msg queue growth increment*/
+#define MSGQ_MAX	8192	/* queued msgs above which mouse moves and paints are dropped*/
+
+/* application msg queue, ring buffer grown in chunks*/
+static struct {
+	MSG *	msgs;		/* ring buffer*/
+	int	size;		/* allocated msg slots*/
+	int	head;		/* index of first queued msg*/
+	int	count;		/* number of queued msgs*/
+	DWORD	headseq;	/* sequence # of first queued msg*/
+	BOOL	quit;		/* WM_QUIT pending, returned once queue empties*/
+	int	exitcode;	/* WM_QUIT wParam*/
+	MWMSGQUEUESTATS stats;
+} msgq;
+
+/* address of nth queued msg*/
+#define MSGQ_ADDR(n)	(&msgq.msgs[(msgq.head + (n)) % msgq.size])
 
-MWLISTHEAD mwMsgHead;		/* application msg queue*/
 MWLISTHEAD mwClassHead;		/* register class list*/
 MWLISTHEAD mwHotkeyHead={0};/* Hotkey table list */
 
@@ -53,13 +71,20 @@ struct timer {			/* private timer structure*/
 	HWND	hwnd;		/* window associated with timer, NULL if none*/
 	UINT	idTimer;	/* id for timer*/
 	UINT	uTimeout;	/* timeout value, in msecs*/
+#if MW_FEATURE_TIMERS
+	MWTIMER *timer;		/* periodic timer on engine timer queue*/
+#else
 	DWORD	dwClockExpires;	/* GetTickCount timer expiration value*/
-	TIMERPROC lpTimerFunc;	/* callback function*/
 	BOOL   bRemove;		/* Remove timer entry on next run */
+#endif
+	TIMERPROC lpTimerFunc;	/* callback function*/
 	struct timer *next;
 };
 static struct timer *timerList = NULL;	/* global timer list*/
 
+static HWND	paintList;		/* windows needing paint, by z-order depth*/
+static HWND	paintListTail;
+
 /* property */
 typedef struct {
 	MWLIST link;
@@ -97,38 +122,185 @@ SendMessage(HWND hwnd, UINT Msg,WPARAM wParam,LPARAM lParam)
 	return 0;
 }
 
+/*
+ * Mark window as needing painting and add it to the pending paint list.
+ * The list is kept sorted by z-order depth so that PeekMessage paints
+ * parents before children without scanning every window.  Entries are
+ * removed lazily by PeekMessage once no longer needing painting.
+ */
+void
+MwSetNeedsPaint(HWND hwnd)
+{
+	HWND	wp;
+	HWND	prevwp;
+	int	depth;
+
+	hwnd->gotPaintMsg = PAINT_NEEDSPAINT;
+	if(hwnd->inPaintList)
+		return;
+
+	depth = 0;
+	for(wp=hwnd->parent; wp; wp=wp->parent)
+		++depth;
+	hwnd->paintDepth = depth;
+	hwnd->inPaintList = TRUE;
+
+	/* usual case: append after windows of same or lower depth*/
+	if(!paintListTail || paintListTail->paintDepth <= depth) {
+		hwnd->nextpaint = NULL;
+		if(paintListTail)
+			paintListTail->nextpaint = hwnd;
+		else paintList = hwnd;
+		paintListTail = hwnd;
+		return;
+	}
+
+	/* insert before first window of greater depth*/
+	prevwp = NULL;
+	for(wp=paintList; wp->paintDepth <= depth; wp=wp->nextpaint)
+		prevwp = wp;
+	hwnd->nextpaint = wp;
+	if(prevwp)
+		prevwp->nextpaint = hwnd;
+	else paintList = hwnd;
+}
+
+/* remove window from pending paint list*/
+static void
+MwRemovePaintList(HWND hwnd)
+{
+	HWND	wp;
+	HWND	prevwp = NULL;
+
+	if(!hwnd->inPaintList)
+		return;
+	for(wp=paintList; wp; wp=wp->nextpaint) {
+		if(wp == hwnd) {
+			if(prevwp)
+				prevwp->nextpaint = wp->nextpaint;
+			else paintList = wp->nextpaint;
+			if(paintListTail == wp)
+				paintListTail = prevwp;
+			break;
+		}
+		prevwp = wp;
+	}
+	hwnd->nextpaint = NULL;
+	hwnd->inPaintList = FALSE;
+}
+
+/* grow msg queue by one chunk, unwrapping ring buffer*/
+static BOOL
+MwGrowMsgQueue(void)
+{
+	MSG *	msgs;
+	int	size;
+	int	i;
+
+	size = msgq.size + MSGQ_CHUNK;
+	msgs = malloc(size * sizeof(MSG));
+	if(!msgs)
+		return FALSE;
+	for(i=0; i<msgq.count; i++)
+		msgs[i] = *MSGQ_ADDR(i);
+	if(msgq.msgs)
+		free(msgq.msgs);
+	msgq.msgs = msgs;
+	msgq.size = size;
+	msgq.head = 0;
+	return TRUE;
+}
+
+/* return queued msg with sequence # seq if it's still queued for hwnd*/
+static MSG *
+MwFindQueuedMsg(DWORD seq, HWND hwnd, UINT Msg)
+{
+	MSG *	pMsg;
+
+	if((DWORD)(seq - msgq.headseq) >= (DWORD)msgq.count)
+		return NULL;
+	pMsg = MSGQ_ADDR(seq - msgq.headseq);
+	if(pMsg->hwnd != hwnd || pMsg->message != Msg)
+		return NULL;
+	return pMsg;
+}
+
+/* remove all queued msgs for window*/
+static void
+MwRemoveQueuedMsgs(HWND hwnd)
+{
+	MSG *	pMsg;
+	int	i;
+	int	n = 0;
+
+	for(i=0; i<msgq.count; i++) {
+		pMsg = MSGQ_ADDR(i);
+		if(pMsg->hwnd != hwnd) {
+			if(n != i)
+				*MSGQ_ADDR(n) = *pMsg;
+			n++;
+		}
+	}
+	msgq.count = n;
+}
+
+/* return application msg queue statistics*/
+void
+MwGetMsgQueueStats(MWMSGQUEUESTATS *stats)
+{
+	*stats = msgq.stats;
+	stats->count = msgq.count;
+	stats->size = msgq.size;
+}
+
 BOOL WINAPI
 PostMessage(HWND hwnd, UINT Msg, WPARAM wParam, LPARAM lParam)
 {
 	MSG *	pMsg;
+	DWORD	seq;
+
+	/* quit is a flag, like Win32, so it's never lost with queue full*/
+	if(Msg == WM_QUIT) {
+		msgq.quit = TRUE;
+		msgq.exitcode = (int)wParam;
+		return TRUE;
+	}
 
 #if PAINTONCE
 	/* don't queue paint msgs, set window paint status instead*/
 	if(Msg == WM_PAINT) {
-		hwnd->gotPaintMsg = PAINT_NEEDSPAINT;
+		MwSetNeedsPaint(hwnd);
 		return TRUE;
 	}
 #endif
 #if MOUSETEST
 	/* replace multiple mouse messages with one for better mouse handling*/
-	if(Msg == WM_MOUSEMOVE) {
-		PMWLIST	p;
-		for(p=mwMsgHead.head; p; p=p->next) {
-			pMsg = MwItemAddr(p, MSG, link);
-			if(pMsg->hwnd == hwnd && pMsg->message == Msg) {
-				pMsg->wParam = wParam;
-				pMsg->lParam = lParam;
-				pMsg->time = GetTickCount();
-				pMsg->pt.x = cursorx;
-				pMsg->pt.y = cursory;
-				return TRUE;
-			}
-		}
+	if(Msg == WM_MOUSEMOVE && hwnd) {
+		pMsg = MwFindQueuedMsg(hwnd->mouseMsgSeq, hwnd, Msg);
+		if(pMsg)
+			goto replace;
+	}
+#endif
+#if TIMERTEST
+	/* replace multiple timer messages for the same timer with one*/
+	if(Msg == WM_TIMER && hwnd) {
+		pMsg = MwFindQueuedMsg(hwnd->timerMsgSeq, hwnd, Msg);
+		if(pMsg && pMsg->wParam == wParam)
+			goto replace;
 	}
 #endif
-	pMsg = GdItemNew(MSG);
-	if(!pMsg)
+
+	/* when backed up, drop only msgs a later one supersedes*/
+	if(msgq.count >= MSGQ_MAX && (Msg == WM_MOUSEMOVE || Msg == WM_PAINT)) {
+		msgq.stats.dropped++;
 		return FALSE;
+	}
+	if(msgq.count >= msgq.size && !MwGrowMsgQueue()) {
+		msgq.stats.dropped++;
+		return FALSE;
+	}
+	seq = msgq.headseq + msgq.count;
+	pMsg = MSGQ_ADDR(msgq.count);
 	pMsg->hwnd = hwnd;
 	pMsg->message = Msg;
 	pMsg->wParam = wParam;
@@ -136,8 +308,29 @@ PostMessage(HWND hwnd, UINT Msg, WPARAM wParam, LPARAM lParam)
 	pMsg->time = GetTickCount();
 	pMsg->pt.x = cursorx;
 	pMsg->pt.y = cursory;
-	GdListAdd(&mwMsgHead, &pMsg->link);
+	if(++msgq.count > msgq.stats.highwater)
+		msgq.stats.highwater = msgq.count;
+	msgq.stats.posted++;
+
+	/* remember slot for replacing coalesced messages*/
+	if(hwnd) {
+		if(Msg == WM_MOUSEMOVE)
+			hwnd->mouseMsgSeq = seq;
+		else if(Msg == WM_TIMER)
+			hwnd->timerMsgSeq = seq;
+	}
+	return TRUE;
+
+#if MOUSETEST || TIMERTEST
+replace:
+	pMsg->wParam = wParam;
+	pMsg->lParam = lParam;
+	pMsg->time = GetTickCount();
+	pMsg->pt.x = cursorx;
+	pMsg->pt.y = cursory;
+	msgq.stats.coalesced++;
 	return TRUE;
+#endif
 }
 
 /* currently, we post to the single message queue, regardless of thread*/
@@ -178,7 +371,7 @@ chkPaintMsg(HWND wp, LPMSG lpMsg)
 			 * event input first, then allow repaint.
 			 */
 			MwSelect(FALSE);
-			if(mwMsgHead.head == NULL)
+			if(msgq.count == 0)
 				goto paint;
 		}
 	return FALSE;
@@ -189,37 +382,51 @@ PeekMessage(LPMSG lpMsg, HWND hwnd, UINT uMsgFilterMin, UINT uMsgFilterMax,
 	UINT wRemoveMsg)
 {
 	HWND	wp;
-	PMSG	pNxtMsg;
+	HWND	nextwp;
 
 	/* check if no messages in queue*/
-	if(mwMsgHead.head == NULL) {
+	if(msgq.count == 0) {
+		/* pending quit comes after posted msgs, before paints*/
+		if(msgq.quit) {
+			lpMsg->hwnd = NULL;
+			lpMsg->message = WM_QUIT;
+			lpMsg->wParam = msgq.exitcode;
+			lpMsg->lParam = 0;
+			lpMsg->time = GetTickCount();
+			lpMsg->pt.x = cursorx;
+			lpMsg->pt.y = cursory;
+			if(wRemoveMsg & PM_REMOVE)
+				msgq.quit = FALSE;
+			return TRUE;
+		}
 #if PAINTONCE
-		/* check all windows for pending paint messages*/
-		for(wp=listwp; wp; wp=wp->next) {
-			if(!(wp->style & WS_CHILD)) {
-				if(chkPaintMsg(wp, lpMsg))
-					return TRUE;
+		/* check windows on pending paint list, parents before children*/
+		for(wp=paintList; wp; wp=nextwp) {
+			if(wp->gotPaintMsg != PAINT_NEEDSPAINT) {
+				/* painted or validated since queued*/
+				nextwp = wp->nextpaint;
+				MwRemovePaintList(wp);
+				continue;
 			}
-		}
-		for(wp=listwp; wp; wp=wp->next) {
-			if(wp->style & WS_CHILD) {
-				if(chkPaintMsg(wp, lpMsg))
-					return TRUE;
+			if(chkPaintMsg(wp, lpMsg)) {
+				MwRemovePaintList(wp);
+				return TRUE;
 			}
+			nextwp = wp->nextpaint;
 		}
 #endif
 		MwSelect(FALSE);
 	}
 
-	if(mwMsgHead.head == NULL)
+	if(msgq.count == 0)
 		return FALSE;
 
-	pNxtMsg = (PMSG)mwMsgHead.head;
-	if(wRemoveMsg & PM_REMOVE)
-		GdListRemove(&mwMsgHead, &pNxtMsg->link);
-	*lpMsg = *pNxtMsg;
-	if(wRemoveMsg & PM_REMOVE)
-		GdItemFree(pNxtMsg);
+	*lpMsg = *MSGQ_ADDR(0);
+	if(wRemoveMsg & PM_REMOVE) {
+		msgq.head = (msgq.head + 1) % msgq.size;
+		msgq.headseq++;
+		msgq.count--;
+	}
 	return TRUE;
 }
 
@@ -514,6 +721,7 @@ CreateWindowEx(DWORD dwExStyle, LPCSTR lpClassName, LPCSTR lpWindowName,
 	wp->nEraseBkGnd = 1;
 	wp->paintBrush = NULL;
 	wp->paintPen = NULL;
+	wp->paintbuf = NULL;
 
 	/* calculate client area*/
 	MwCalcClientRect(wp);
@@ -564,7 +772,6 @@ MwDestroyWindow(HWND hwnd,BOOL bSendMsg)
 	HWND	wp = hwnd;
 	HWND	prevwp;
 	PMWLIST	p;
-	PMSG	pmsg;
 
 	if (wp == rootwp || !IsWindow (hwnd))
 		return;
@@ -578,6 +785,8 @@ MwDestroyWindow(HWND hwnd,BOOL bSendMsg)
 	if(bSendMsg)
 		SendMessage(hwnd, WM_DESTROY, 0, 0L);
 
+	MwRemovePaintList(wp);
+
 	/*
 	 * Remove from timers
 	 */
@@ -622,6 +831,7 @@ MwDestroyWindow(HWND hwnd,BOOL bSendMsg)
 		if (prevwp) prevwp->siblings = wp->siblings;
 	}
 	wp->siblings = NULL;
+	++mwwindowgen;
 
 	/*
 	 * Remove this window from the complete list of windows.
@@ -642,15 +852,7 @@ MwDestroyWindow(HWND hwnd,BOOL bSendMsg)
 	 */
 
 	/* Remove all messages from msg queue for this window*/
-	for(p=mwMsgHead.head; p; ) {
-		pmsg = MwItemAddr(p, MSG, link);
-		if(pmsg->hwnd == wp) {
-			p = p->next;
-			GdListRemove(&mwMsgHead, &pmsg->link);
-			GdItemFree(pmsg);
-		} else
-			p = p->next;
-	}
+	MwRemoveQueuedMsgs(wp);
 
 	/*
 	 * Remove all properties from this window.
@@ -781,7 +983,7 @@ InvalidateRect(HWND hwnd, CONST RECT *lpRect, BOOL bErase)
 #endif
 
 			if(hwnd->gotPaintMsg == PAINT_PAINTED)
-				hwnd->gotPaintMsg = PAINT_NEEDSPAINT;
+				MwSetNeedsPaint(hwnd);
 		if( bErase )
 			hwnd->nEraseBkGnd++;
 	}
@@ -809,7 +1011,7 @@ InvalidateRgn(HWND hwnd, HRGN hrgn, BOOL bErase)
 		/* if update region not empty, mark as needing painting*/
 		if(hwnd->update->numRects != 0)
 			if(hwnd->gotPaintMsg == PAINT_PAINTED)
-				hwnd->gotPaintMsg = PAINT_NEEDSPAINT;
+				MwSetNeedsPaint(hwnd);
 		if( bErase )
 			hwnd->nEraseBkGnd++;
 	}
@@ -1058,6 +1260,7 @@ SetParent(HWND hwnd, HWND parent)
 	ScreenToClient(hwnd->parent, &pt);
 
 	hwnd->parent = parent;
+	++mwwindowgen;
 
 	if (parent == GetDesktopWindow() && !(hwnd->style & WS_CLIPSIBLINGS))
 		hwnd->style |= WS_CLIPSIBLINGS;
@@ -1688,6 +1891,8 @@ SetWindowPos(HWND hwnd, HWND hwndInsertAfter, int x, int y, int cx, int cy, UINT
 	}
 	if(bMove)
 		MwOffsetChildren(hwnd, offx, offy);
+	if(bMove || bSize)
+		++mwwindowgen;
 
 	if(bMove || bSize) {
 		MwCalcClientRect(hwnd);
@@ -1919,6 +2124,96 @@ HWND WindowFromPoint(POINT pt)
 	return wp1;
 }
 
+#if MW_FEATURE_TIMERS
+/*
+ * Timers are periodic engine timers, sharing the ordered
+ * timer queue used to compute the select loop timeout.
+ */
+
+/* engine timer callback: call timer function or post timer message*/
+static void
+MwTimerCallback(void *arg)
+{
+	struct timer *tm = arg;
+
+	/* tm may be freed by KillTimer in TimerProc, don't reference after*/
+	if (tm->lpTimerFunc)
+		tm->lpTimerFunc(tm->hwnd, WM_TIMER, tm->idTimer, 0);
+	else
+		PostMessage (tm->hwnd, WM_TIMER, tm->idTimer, 0);
+}
+
+UINT WINAPI
+SetTimer(HWND hwnd, UINT idTimer, UINT uTimeout, TIMERPROC lpTimerFunc)
+{
+	struct timer *tm = (struct timer *) malloc ( sizeof(struct timer) );
+	static UINT nextID = 0;	/* next ID when hwnd is NULL*/
+
+	/* assign timer id based on valid window handle*/
+	if( tm == NULL )
+		return 0;
+	
+	tm->hwnd = hwnd;
+	tm->idTimer = hwnd? idTimer: ++nextID;
+	tm->uTimeout = uTimeout;
+	tm->lpTimerFunc = lpTimerFunc;
+	tm->timer = GdAddPeriodicTimer(uTimeout, MwTimerCallback, tm);
+	if( tm->timer == NULL ) {
+		free(tm);
+		return 0;
+	}
+	tm->next = timerList;
+	timerList = tm;
+
+	return tm->idTimer;
+}
+
+BOOL WINAPI
+KillTimer(HWND hwnd, UINT idTimer)
+{
+	struct timer *tm;
+	struct timer *ltm = NULL;
+
+	/* engine timers can be destroyed immediately, even from TimerProc*/
+	for (tm=timerList; tm != NULL; tm = tm->next) {
+		if( (tm->hwnd == hwnd) && (tm->idTimer == idTimer) ) {
+			if(ltm != NULL)
+				ltm->next = tm->next;
+			else
+				timerList = tm->next;
+			GdDestroyTimer(tm->timer);
+			free(tm);
+			return TRUE;
+		}
+		ltm = tm;
+	}
+	return FALSE;
+}
+
+/*
+ * Return the next timeout value in msecs
+ */
+UINT
+MwGetNextTimeoutValue(void)
+{
+	struct timeval tv;
+
+	if (!GdGetNextTimeout(&tv, 0))
+		return -1;
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*
+ * Service expired timers
+ */
+void
+MwHandleTimers(void)
+{
+	GdTimeout();
+}
+
+#else /* !MW_FEATURE_TIMERS*/
+
 UINT WINAPI
 SetTimer(HWND hwnd, UINT idTimer, UINT uTimeout, TIMERPROC lpTimerFunc)
 {
@@ -2018,6 +2313,7 @@ MwHandleTimers(void)
 		}
 	}
 }
+#endif /* MW_FEATURE_TIMERS*/
 
 /*
  *  Check in timers list if hwnd is present and remove it.
@@ -91,6 +91,9 @@ const char *nxErrorStrings[] = {
 };
 
 static EVENT_LIST *	evlist;
+static REPLY_LIST *	replyhead;	/* outstanding async replies, in request order*/
+static REPLY_LIST *	replytail;
+static GR_COOKIE	replyseq;	/* last async request cookie issued*/
 
 /*
  * The following is the user defined function for handling errors.
@@ -109,6 +112,7 @@ int ecos_nanox_client_data_index = CYGNUM_KERNEL_THREADS_DATA_MAX;
 #endif
 
 static void QueueEvent(GR_EVENT *ep);
+static void ReadQueuedReply(short packettype);
 static void GetNextQueuedEvent(GR_EVENT *ep);
 static void _GrGetNextEventTimeout(GR_EVENT *ep, GR_TIMEOUT timeout);
 
@@ -218,7 +222,8 @@ CheckBlockType(short packettype)
 	GR_EVENT	event;
 
 	while (ReadBlock(&b,sizeof(b)) != -1) {
-		if (b == packettype)
+		/* replies to earlier async requests are always sent first*/
+		if (b == packettype && (!replyhead || b == GrNumGetNextEvent))
 			return b;
 
 		if (b == GrNumGetNextEvent) {
@@ -229,6 +234,9 @@ CheckBlockType(short packettype)
 			ReadBlock(&event, sizeof(event));
 			CheckForClientData(&event);
 			QueueEvent(&event);
+		} else if (replyhead) {
+			/* read reply into async request's destination*/
+			ReadQueuedReply(b);
 		} else {
 			EPRINTF("nxclient %d: Wrong packet type %d (expected %d)\n",
 				getpid(),b, packettype);
@@ -261,6 +269,153 @@ TypedReadBlock(void *b, int n, int type)
 	return ReadBlock(b, n);
 }
 
+/**
+ * Read a typed reply for code outside this file, such as the
+ * shared memory request buffer flush in nxproto.c.
+ *
+ * @param b    Destination for read data.
+ * @param n    Number of bytes to read.
+ * @param type The required packet type.
+ * @return     0 on success or -1 on failure.
+ *
+ * @internal
+ */
+int
+nxReadReply(void *b, int n, int type)
+{
+	return TypedReadBlock(b, n, type);
+}
+
+/**
+ * Queue an async request whose reply will be read later, either by
+ * GrWaitReply or when a subsequent reply is read by CheckBlockType.
+ * The server replies in request order, so the queue is a simple FIFO.
+ * Must be called with nxGlobalLock held.
+ *
+ * @param type The expected reply packet type.
+ * @return     The queued reply entry or NULL if out of memory.
+ *
+ * @internal
+ */
+static REPLY_LIST *
+QueueReply(short type)
+{
+	REPLY_LIST *	rp;
+        ACCESS_PER_THREAD_DATA()
+
+	rp = malloc(sizeof(REPLY_LIST));
+	if (rp) {
+		rp->next = NULL;
+		rp->type = type;
+		rp->count = 0;
+
+		/* cookie 0 is reserved for already completed requests*/
+		if (++replyseq == 0)
+			++replyseq;
+		rp->cookie = replyseq;
+
+		/* add as last entry on list*/
+		if (replytail)
+			replytail->next = rp;
+		else replyhead = rp;
+		replytail = rp;
+	}
+	return rp;
+}
+
+/**
+ * Add a destination for the next field of an async request's reply.
+ *
+ * @param rp   The queued reply entry.
+ * @param ptr  Destination for the reply data.
+ * @param size Size of the reply data.
+ *
+ * @internal
+ */
+static void
+AddReplyField(REPLY_LIST *rp, void *ptr, int size)
+{
+	rp->ptr[rp->count] = ptr;
+	rp->size[rp->count] = size;
+	rp->count++;
+}
+
+/**
+ * Read the reply for the oldest outstanding async request, after its
+ * packet type has been read.  The connection can't be resynchronized
+ * after a wrong or short reply, so that is fatal like a lost connection.
+ *
+ * @param packettype The packet type read from the server.
+ *
+ * @internal
+ */
+static void
+ReadQueuedReply(short packettype)
+{
+	REPLY_LIST *	rp;
+	int		i;
+        ACCESS_PER_THREAD_DATA()
+
+	rp = replyhead;
+	if (!rp || rp->type != packettype) {
+		EPRINTF("nxclient %d: Wrong packet type %d (expected reply %d)\n",
+			getpid(), packettype, rp? rp->type: -1);
+		exit(1);
+	}
+
+	/* remove from list before reading its data*/
+	replyhead = rp->next;
+	if (!replyhead)
+		replytail = NULL;
+
+	for (i=0; i<rp->count; i++)
+		if (ReadBlock(rp->ptr[i], rp->size[i]) == -1) {
+			EPRINTF("nxclient %d: Can't read reply %d\n", getpid(), packettype);
+			exit(1);
+		}
+	free(rp);
+}
+
+/**
+ * Wait for the reply to an async request, such as GrGetWindowInfoAsync.
+ * The reply data is stored in the destinations passed to the async call
+ * when the request was made, which must remain valid until this
+ * returns. Replies to all earlier async requests are read as well, and
+ * any events received while waiting are queued. Requests queued with the
+ * async functions are not flushed until a reply is required, so many
+ * requests can be issued and their replies collected with a single
+ * round trip by waiting for the last cookie.
+ *
+ * @param cookie The value returned from the async request.
+ * @return       0 on success or -1 on failure.
+ *
+ * @ingroup nanox_general
+ */
+int
+GrWaitReply(GR_COOKIE cookie)
+{
+	short		b;
+	GR_EVENT	event;
+	int		ret = 0;
+        ACCESS_PER_THREAD_DATA()
+
+	LOCK(&nxGlobalLock);
+	/* cookies wrap, so compare as distance from oldest outstanding*/
+	while (cookie && replyhead && (int)(cookie - replyhead->cookie) >= 0) {
+		if ((ret = ReadBlock(&b, sizeof(b))) == -1)
+			break;
+
+		if (b == GrNumGetNextEvent) {
+			/* read event and queue it for later processing*/
+			ReadBlock(&event, sizeof(event));
+			CheckForClientData(&event);
+			QueueEvent(&event);
+		} else ReadQueuedReply(b);
+	}
+	UNLOCK(&nxGlobalLock);
+	return ret;
+}
+
 /**
  * Check if the passed event is an error event, and call the error handler if
  * there is one. After calling the handler (if it returns), the event type is
@@ -441,6 +596,14 @@ GrClose(void)
 #endif
 	close(nxSocket);
 	nxSocket = -1;
+
+	/* discard replies never waited for*/
+	while (replyhead) {
+		REPLY_LIST *rp = replyhead;
+		replyhead = rp->next;
+		free(rp);
+	}
+	replytail = NULL;
 	LOCK_FREE(&nxGlobalLock);
 #if ELKS
 	GrDelay(200); /* partial raw terminal fix, allow nano-X to run to reset terminal */
@@ -593,6 +756,35 @@ GrGetFontInfo(GR_FONT_ID font, GR_FONT_INFO *fip)
 	UNLOCK(&nxGlobalLock);
 }
 
+/**
+ * Async version of GrGetFontInfo. The request is queued and the
+ * GR_FONT_INFO structure is filled in when GrWaitReply is called
+ * with the returned cookie.
+ *
+ * @param font The font ID to query.
+ * @param fip  Pointer to the GR_FONT_INFO structure to store the result.
+ * @return     Cookie to pass to GrWaitReply.
+ *
+ * @ingroup nanox_font
+ */
+GR_COOKIE
+GrGetFontInfoAsync(GR_FONT_ID font, GR_FONT_INFO *fip)
+{
+	nxGetFontInfoReq *req;
+	REPLY_LIST *rp;
+	GR_COOKIE cookie = 0;
+
+	LOCK(&nxGlobalLock);
+	req = AllocReq(GetFontInfo);
+	req->fontid = font;
+	if ((rp = QueueReply(GrNumGetFontInfo)) != NULL) {
+		AddReplyField(rp, fip, sizeof(GR_FONT_INFO));
+		cookie = rp->cookie;
+	} else TypedReadBlock(fip, sizeof(GR_FONT_INFO),GrNumGetFontInfo);
+	UNLOCK(&nxGlobalLock);
+	return cookie;
+}
+
 /**
  * Fills in the specified GR_GC_INFO structure with information regarding the
  * specified graphics context.
@@ -654,6 +846,57 @@ GrGetGCTextSize(GR_GC_ID gc, void *str, int count, GR_TEXTFLAGS flags,
 	UNLOCK(&nxGlobalLock);
 }
 
+/**
+ * Async version of GrGetGCTextSize. The request is queued and the
+ * return values are stored when GrWaitReply is called with the
+ * returned cookie.
+ *
+ * @param gc        The graphics context.
+ * @param str       Pointer to a text string.
+ * @param count     The length of the string.
+ * @param flags     Text rendering flags. (GR_TF*).
+ * @param retwidth  Pointer to the variable the width will be returned in.
+ * @param retheight Pointer to the variable the height will be returned in.
+ * @param retbase   Pointer to the variable the baseline height will be returned in.
+ * @return          Cookie to pass to GrWaitReply.
+ *
+ * @ingroup nanox_font
+ */
+GR_COOKIE
+GrGetGCTextSizeAsync(GR_GC_ID gc, void *str, int count, GR_TEXTFLAGS flags,
+	GR_SIZE *retwidth, GR_SIZE *retheight, GR_SIZE *retbase)
+{
+	nxGetGCTextSizeReq *req;
+	REPLY_LIST *rp;
+	GR_COOKIE cookie = 0;
+	int size;
+
+	/* use strlen as char count when ascii or dbcs*/
+	if(count == -1 && (flags&MWTF_PACKMASK) == MWTF_ASCII)
+		count = strlen((char *)str);
+
+	size = nxCalcStringBytes(str, count, flags);
+
+	LOCK(&nxGlobalLock);
+	req = AllocReqExtra(GetGCTextSize, size);
+	req->gcid = gc;
+	req->flags = flags;
+	req->charcount = count;
+	memcpy(GetReqData(req), str, size);
+	if ((rp = QueueReply(GrNumGetGCTextSize)) != NULL) {
+		AddReplyField(rp, retwidth, sizeof(*retwidth));
+		AddReplyField(rp, retheight, sizeof(*retheight));
+		AddReplyField(rp, retbase, sizeof(*retbase));
+		cookie = rp->cookie;
+	} else {
+		TypedReadBlock(retwidth, sizeof(*retwidth),GrNumGetGCTextSize);
+		ReadBlock(retheight, sizeof(*retheight));
+		ReadBlock(retbase, sizeof(*retbase));
+	}
+	UNLOCK(&nxGlobalLock);
+	return cookie;
+}
+
 /**
  * Register an extra file descriptor to monitor in the main select() call.
  * An event will be returned when the fd has data waiting to be read if that
@@ -1142,6 +1385,79 @@ GrCheckNextEvent(GR_EVENT *ep)
 	UNLOCK(&nxGlobalLock);
 }
 
+/**
+ * Sets the maximum number of events the server will queue for this
+ * client and how mouse motion events are queued.  By default a motion
+ * event for a window is merged into one already queued for it that
+ * the client hasn't read yet, so a busy client only sees the latest
+ * pointer position.  When maxevents events are queued, the oldest
+ * queued motion event is dropped to make room.
+ *
+ * @param maxevents The maximum number of queued events, 0 for no limit.
+ * @param flags     GR_EVENTQ_NOCOALESCE to queue every motion event,
+ *                  GR_EVENTQ_MOTION_HISTORY to save merged and dropped
+ *                  motion points for GrGetMotionHistory().
+ *
+ * @ingroup nanox_event
+ */
+void
+GrSetEventQueueLimit(int maxevents, int flags)
+{
+	nxSetEventQueueLimitReq *req;
+
+	LOCK(&nxGlobalLock);
+	req = AllocReq(SetEventQueueLimit);
+	req->maxevents = maxevents;
+	req->flags = flags;
+	UNLOCK(&nxGlobalLock);
+}
+
+/**
+ * Returns the server event queue statistics for this client, including
+ * the number of motion events merged and dropped.
+ *
+ * @param info Pointer to the GR_EVENTQ_INFO structure to return the info in.
+ *
+ * @ingroup nanox_event
+ */
+void
+GrGetEventQueueInfo(GR_EVENTQ_INFO *info)
+{
+	LOCK(&nxGlobalLock);
+	AllocReq(GetEventQueueInfo);
+	if (TypedReadBlock(info, sizeof(*info), GrNumGetEventQueueInfo) == -1)
+		memset(info, 0, sizeof(*info));
+	UNLOCK(&nxGlobalLock);
+}
+
+/**
+ * Returns the most recent mouse motion points that were merged into a
+ * later motion event or dropped, oldest first, and clears them from the
+ * server's history.  History must be enabled with GrSetEventQueueLimit().
+ *
+ * @param points    Array to return the motion points in.
+ * @param maxpoints The number of entries in points.
+ * @return          The number of points returned.
+ *
+ * @ingroup nanox_event
+ */
+int
+GrGetMotionHistory(GR_MOTION_POINT *points, int maxpoints)
+{
+	nxGetMotionHistoryReq *req;
+	int	count;
+
+	LOCK(&nxGlobalLock);
+	req = AllocReq(GetMotionHistory);
+	req->maxpoints = maxpoints;
+	if (TypedReadBlock(&count, sizeof(count), GrNumGetMotionHistory) == -1)
+		count = 0;
+	if (count > 0)
+		ReadBlock(points, count * sizeof(GR_MOTION_POINT));
+	UNLOCK(&nxGlobalLock);
+	return count;
+}
+
 /* builtin callback function for GrGetTypedEvent*/
 static GR_BOOL
 GetTypedEventCallback(GR_WINDOW_ID wid, GR_EVENT_MASK mask, GR_UPDATE_TYPE update,
@@ -1351,6 +1667,42 @@ GrNewPixmapEx(GR_SIZE width, GR_SIZE height, int format, void *pixels)
 	return wid;
 }
 
+/**
+ * Create a new pixmap whose pixels are kept in a System V shared memory
+ * segment created by the client, at the given byte offset.  Pixels
+ * written by the client are seen directly by the server, so images
+ * can be drawn with GrCopyArea without sending them over the connection.
+ * Rows are DWORD aligned as for any pixmap of the format.
+ *
+ * @param width  The width of the pixmap.
+ * @param height The height of the pixmap.
+ * @param format The MWIF image format for the pixmap, 0 for screen format.
+ * @param shmid  The shmget() ID of the segment holding the pixels.
+ * @param offset The byte offset of the pixels within the segment.
+ * @return       The ID of the new pixmap, or 0 if shared memory is unsupported.
+ *
+ * @ingroup nanox_window
+ */
+GR_WINDOW_ID
+GrNewSharedPixmap(GR_SIZE width, GR_SIZE height, int format, int shmid,
+	unsigned long offset)
+{
+	nxNewSharedPixmapReq *req;
+	GR_WINDOW_ID 	wid;
+
+	LOCK(&nxGlobalLock);
+	req = AllocReq(NewSharedPixmap);
+	req->width = width;
+	req->height = height;
+	req->format = format;
+	req->shmid = shmid;
+	req->offset = offset;
+	if(TypedReadBlock(&wid, sizeof(wid), GrNumNewSharedPixmap) == -1)
+		wid = 0;
+	UNLOCK(&nxGlobalLock);
+	return wid;
+}
+
 /**
  * Create a new input-only window with the specified dimensions which is a
  * child of the specified parent window.
@@ -1425,6 +1777,35 @@ GrGetWindowInfo(GR_WINDOW_ID wid, GR_WINDOW_INFO *infoptr)
 	UNLOCK(&nxGlobalLock);
 }
 
+/**
+ * Async version of GrGetWindowInfo. The request is queued and the
+ * GR_WINDOW_INFO structure is filled in when GrWaitReply is called
+ * with the returned cookie.
+ *
+ * @param wid     The ID of the window to retrieve information about.
+ * @param infoptr Pointer to a GR_WINDOW_INFO structure to return the information in.
+ * @return        Cookie to pass to GrWaitReply.
+ *
+ * @ingroup nanox_window
+ */
+GR_COOKIE
+GrGetWindowInfoAsync(GR_WINDOW_ID wid, GR_WINDOW_INFO *infoptr)
+{
+	nxGetWindowInfoReq *req;
+	REPLY_LIST *rp;
+	GR_COOKIE cookie = 0;
+
+	LOCK(&nxGlobalLock);
+	req = AllocReq(GetWindowInfo);
+	req->windowid = wid;
+	if ((rp = QueueReply(GrNumGetWindowInfo)) != NULL) {
+		AddReplyField(rp, infoptr, sizeof(GR_WINDOW_INFO));
+		cookie = rp->cookie;
+	} else TypedReadBlock(infoptr, sizeof(GR_WINDOW_INFO), GrNumGetWindowInfo);
+	UNLOCK(&nxGlobalLock);
+	return cookie;
+}
+
 /**
  * Creates a new graphics context structure. The structure is initialised
  * with a set of default parameters.
@@ -2109,6 +2490,58 @@ GrClearArea(GR_WINDOW_ID wid, GR_COORD x, GR_COORD y, GR_SIZE width,
 	UNLOCK(&nxGlobalLock);
 }
 
+/**
+ * Copies damaged areas of a buffered window to the screen.  Used instead
+ * of GrFlushWindow by clients drawing directly into a GR_WM_PROPS_BUFFER_MMAP
+ * window buffer, so that only the changed areas are copied and passed
+ * to the screen driver update.  Like GrFlushWindow, marks the window
+ * buffer ready for display.
+ *
+ * If fence is set, the server replies once the areas have been copied,
+ * and the returned cookie can be passed to GrWaitReply to wait until the
+ * damaged areas of the buffer may be drawn into again.
+ *
+ * @param wid  the ID of the buffered window
+ * @param count  the number of rectangles, or 0 for the entire window
+ * @param recttable  pointer to a GR_RECT array of window relative damaged areas
+ * @param fence  GR_TRUE to request a reply when the copy is complete
+ * @return cookie for GrWaitReply, or 0 if no fence requested
+ *
+ * @ingroup nanox_window
+ */
+GR_COOKIE
+GrDamageWindow(GR_WINDOW_ID wid, GR_COUNT count, GR_RECT *recttable,
+	GR_BOOL fence)
+{
+	nxDamageWindowReq *req;
+	REPLY_LIST *rp;
+	GR_COOKIE cookie = 0;
+	int	   chunk;
+	int32_t	   size;
+
+	LOCK(&nxGlobalLock);
+	do {
+		chunk = (MAXREQUESTSZ - sizeof(nxDamageWindowReq)) / sizeof(GR_RECT);
+		if (chunk > count)
+			chunk = count;
+		size = (int32_t)chunk * sizeof(GR_RECT);
+		req = AllocReqExtra(DamageWindow, size);
+		req->windowid = wid;
+		count -= chunk;
+		req->fence = (count <= 0)? fence: 0;	/* fence last packet only*/
+		memcpy(GetReqData(req), recttable, size);
+		recttable += chunk;
+	} while (count > 0);
+
+	if (fence) {
+		if ((rp = QueueReply(GrNumDamageWindow)) != NULL)
+			cookie = rp->cookie;
+		else CheckBlockType(GrNumDamageWindow);
+	}
+	UNLOCK(&nxGlobalLock);
+	return cookie;
+}
+
 /**
  * Returns the ID of the window which currently has the keyboard focus.
  *
@@ -2847,6 +3280,92 @@ GrFillRect(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y,
 	UNLOCK(&nxGlobalLock);
 }
 
+/*
+ * Send a table of fixed size drawing items, splitting it into
+ * MAXREQUESTSZ size packets.  All table requests share the
+ * nxFillRectsReq layout.
+ */
+static void
+nxDrawTable(int type, GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, void *table,
+	int itemsize)
+{
+	nxFillRectsReq *req;
+	char *	   p = table;
+	int	   chunk;
+	int32_t	   size;
+
+	LOCK(&nxGlobalLock);
+	while (count > 0) {
+		chunk = (MAXREQUESTSZ - sizeof(nxFillRectsReq)) / itemsize;
+		if (chunk > count)
+			chunk = count;
+		size = (int32_t)chunk * itemsize;
+		req = nxAllocReq(type, sizeof(nxFillRectsReq), size);
+		req->drawid = id;
+		req->gcid = gc;
+		memcpy(GetReqData(req), p, size);
+		p += size;
+		count -= chunk;
+	}
+	UNLOCK(&nxGlobalLock);
+}
+
+/**
+ * Draws multiple filled rectangles on the specified drawable using the
+ * specified graphics context.  The server prepares the drawable and
+ * graphics context once for the entire table, making this much faster
+ * than calling GrFillRect for each rectangle.
+ *
+ * @param id  the ID of the drawable to draw the rectangles on
+ * @param gc  the ID of the graphics context to use when drawing the rectangles
+ * @param count  the number of rectangles in the rectangle table
+ * @param recttable  pointer to a GR_RECT array of rectangles to fill
+ *
+ * @ingroup nanox_draw
+ */
+void
+GrFillRects(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_RECT *recttable)
+{
+	nxDrawTable(GrNumFillRects, id, gc, count, recttable, sizeof(GR_RECT));
+}
+
+/**
+ * Draws multiple unconnected line segments on the specified drawable
+ * using the specified graphics context, preparing the drawable and
+ * graphics context once for the entire table.
+ *
+ * @param id  the ID of the drawable to draw the lines on
+ * @param gc  the ID of the graphics context to use when drawing the lines
+ * @param count  the number of segments in the segment table
+ * @param segtable  pointer to a GR_SEGMENT array of lines to draw
+ *
+ * @ingroup nanox_draw
+ */
+void
+GrSegments(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_SEGMENT *segtable)
+{
+	nxDrawTable(GrNumSegments, id, gc, count, segtable, sizeof(GR_SEGMENT));
+}
+
+/**
+ * Draws a batch of mixed primitives (points, lines, rectangles and
+ * ellipses) on the specified drawable using the specified graphics
+ * context.  The server prepares the drawable and graphics context once
+ * for the entire batch.
+ *
+ * @param id  the ID of the drawable to draw on
+ * @param gc  the ID of the graphics context to use when drawing
+ * @param count  the number of items in the batch
+ * @param items  pointer to a GR_BATCH_ITEM array of primitives to draw
+ *
+ * @ingroup nanox_draw
+ */
+void
+GrDrawBatch(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_BATCH_ITEM *items)
+{
+	nxDrawTable(GrNumDrawBatch, id, gc, count, items, sizeof(GR_BATCH_ITEM));
+}
+
 /**
  * Draws the boundary of ellipse at the specified position using the specified
  * dimensions and graphics context on the specified drawable.
@@ -2989,6 +3508,25 @@ GrArcAngle(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y,
 	req->type = type;
 	UNLOCK(&nxGlobalLock);
 }
+
+/**
+ * Draws multiple arcs or pies on the specified drawable using the
+ * specified graphics context, preparing the drawable and graphics
+ * context once for the entire table.  Each item takes the same
+ * parameters as GrArcAngle.
+ *
+ * @param id  the ID of the drawable to draw the arcs on
+ * @param gc  the ID of the graphics context to use when drawing the arcs
+ * @param count  the number of arcs in the arc table
+ * @param arctable  pointer to a GR_ARC_ITEM array of arcs to draw
+ *
+ * @ingroup nanox_draw
+ */
+void
+GrArcs(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_ARC_ITEM *arctable)
+{
+	nxDrawTable(GrNumArcs, id, gc, count, arctable, sizeof(GR_ARC_ITEM));
+}
 #endif
 
 #if MW_FEATURE_BITMAPS
@@ -3773,6 +4311,68 @@ GrText(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y, void *str,
 	UNLOCK(&nxGlobalLock);
 }
 
+/**
+ * Draws multiple text strings on the specified drawable using the
+ * specified graphics context and flags.  The server prepares the
+ * drawable and graphics context once for each packet of strings.
+ *
+ * @param id  the ID of the drawable to draw the text strings onto
+ * @param gc  the ID of the graphics context to use when drawing the strings
+ * @param count  the number of strings in the item table
+ * @param items  pointer to a GR_TEXT_ITEM array of strings and positions
+ * @param flags  flags specifying text encoding, alignment, etc.
+ *
+ * @ingroup nanox_font
+ */
+void
+GrTexts(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_TEXT_ITEM *items,
+	GR_TEXTFLAGS flags)
+{
+	nxTextsReq *req;
+	nxTextItem *tp;
+	char *	    p;
+	int	    i, n, cc, nbytes, itemsize;
+	int32_t	    size;
+
+	LOCK(&nxGlobalLock);
+	while (count > 0) {
+		/* calc # items that fit in one packet*/
+		size = 0;
+		for (n = 0; n < count; n++) {
+			cc = items[n].count;
+			if(cc == -1 && (flags&MWTF_PACKMASK) == MWTF_ASCII)
+				cc = strlen((char *)items[n].str);
+			nbytes = nxCalcStringBytes(items[n].str, cc, flags);
+			itemsize = (sizeof(nxTextItem) + nbytes + (ALIGNSZ-1)) & ~(ALIGNSZ-1);
+			if (n && sizeof(nxTextsReq) + size + itemsize > MAXREQUESTSZ)
+				break;
+			size += itemsize;
+		}
+
+		req = AllocReqExtra(Texts, size);
+		req->drawid = id;
+		req->gcid = gc;
+		req->flags = flags;
+		p = GetReqData(req);
+		for (i = 0; i < n; i++) {
+			cc = items[i].count;
+			if(cc == -1 && (flags&MWTF_PACKMASK) == MWTF_ASCII)
+				cc = strlen((char *)items[i].str);
+			nbytes = nxCalcStringBytes(items[i].str, cc, flags);
+			tp = (nxTextItem *)p;
+			tp->x = items[i].x;
+			tp->y = items[i].y;
+			tp->count = cc;
+			tp->nbytes = nbytes;
+			memcpy(p + sizeof(nxTextItem), items[i].str, nbytes);
+			p += (sizeof(nxTextItem) + nbytes + (ALIGNSZ-1)) & ~(ALIGNSZ-1);
+		}
+		items += n;
+		count -= n;
+	}
+	UNLOCK(&nxGlobalLock);
+}
+
 
 /**
  * Retrieves the system palette and places it in the specified palette
@@ -3872,7 +4472,8 @@ GrReqShmCmds(long shmsize)
 	req.size = shmsize;
 
 	nxWriteSocket((char *)&req,sizeof(req));
-	ReadBlock(&key,sizeof(key));
+	if (TypedReadBlock(&key, sizeof(key), GrNumReqShmCmds) == -1)
+		key = 0;
 
 	if (!key) {
 		EPRINTF("nxclient: no shared memory support on server\n");
@@ -4303,6 +4904,28 @@ GrSetBackgroundPixmap(GR_WINDOW_ID wid, GR_WINDOW_ID pixmap, int flags)
 }
 #endif
 
+/**
+ * Sets the opacity of a buffered window.  When the server is run with
+ * compositing enabled (-C), the window's buffer is blended over the
+ * windows underneath it, otherwise the opacity is ignored.
+ *
+ * @param wid      ID of the window.
+ * @param opacity  0 (transparent) to 255 (opaque).
+ *
+ * @ingroup nanox_window
+ */
+void
+GrSetWindowOpacity(GR_WINDOW_ID wid, int opacity)
+{
+	nxSetWindowOpacityReq *req;
+
+	LOCK(&nxGlobalLock);
+	req = AllocReq(SetWindowOpacity);
+	req->wid = wid;
+	req->opacity = opacity;
+	UNLOCK(&nxGlobalLock);
+}
+
 /**
  * Destroys the specified server-based cursor and
  * reclaims the memory used by it.
@@ -4485,6 +5108,43 @@ GrQueryPointer(GR_WINDOW_ID *mwin, GR_COORD *x, GR_COORD *y, GR_BUTTON *bmask)
 	ReadBlock(bmask, sizeof(*bmask));
 	UNLOCK(&nxGlobalLock);
 }
+
+/**
+ * Async version of GrQueryPointer. The request is queued and the
+ * return values are stored when GrWaitReply is called with the
+ * returned cookie.
+ *
+ * @param mwin  Pointer to the variable the window ID will be returned in.
+ * @param x     Pointer to the variable the x coordinate will be returned in.
+ * @param y     Pointer to the variable the y coordinate will be returned in.
+ * @param bmask Pointer to the variable the button mask will be returned in.
+ * @return      Cookie to pass to GrWaitReply.
+ *
+ * @ingroup nanox_misc
+ */
+GR_COOKIE
+GrQueryPointerAsync(GR_WINDOW_ID *mwin, GR_COORD *x, GR_COORD *y, GR_BUTTON *bmask)
+{
+	REPLY_LIST *rp;
+	GR_COOKIE cookie = 0;
+
+	LOCK(&nxGlobalLock);
+	AllocReq(QueryPointer);
+	if ((rp = QueueReply(GrNumQueryPointer)) != NULL) {
+		AddReplyField(rp, mwin, sizeof(*mwin));
+		AddReplyField(rp, x, sizeof(*x));
+		AddReplyField(rp, y, sizeof(*y));
+		AddReplyField(rp, bmask, sizeof(*bmask));
+		cookie = rp->cookie;
+	} else {
+		TypedReadBlock(mwin, sizeof(*mwin), GrNumQueryPointer);
+		ReadBlock(x, sizeof(*x));
+		ReadBlock(y, sizeof(*y));
+		ReadBlock(bmask, sizeof(*bmask));
+	}
+	UNLOCK(&nxGlobalLock);
+	return cookie;
+}
 #endif
 
 /**
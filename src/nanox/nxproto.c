@@ -154,12 +154,11 @@ nxFlushReq(unsigned long newsize, int reply_needed)
 			req.reply = reply_needed;
 
 			nxWriteSocket((char *)&req,sizeof(req));
+			reqbuf.bufptr = reqbuf.buffer;
 
+			/* typed ack, replies to queued async requests come first*/
 			if ( reply_needed )
-				while ( read(nxSocket, &c, 1) != 1 )
-					;
-
-			reqbuf.bufptr = reqbuf.buffer;
+				nxReadReply(&c, 1, GrNumShmCmdsFlush);
 
 			if ( reqbuf.buffer + newsize > reqbuf.bufmax ) {
 				/* Shared memory too small, critical */
@@ -90,6 +90,7 @@ void * 	nxAllocReq(int type, unsigned long size, long extra);
 void	nxFlushReq(unsigned long newsize, int reply_needed);
 void 	nxAssignReqbuffer(char *buffer, unsigned long size);
 void 	nxWriteSocket(char *buf, int todo);
+int	nxReadReply(void *b, int n, int type);
 int	nxCalcStringBytes(void *str, int count, GR_TEXTFLAGS flags);
 
 #if notyet
@@ -1397,4 +1398,120 @@ typedef struct {
 	IDTYPE	imageid;
 } nxDrawImagePartToFitReq;
 
-#define GrTotalNumCalls         126
+#define GrNumFillRects          126
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	IDTYPE	drawid;
+	IDTYPE	gcid;
+	/*GR_RECT recttable[];*/
+} nxFillRectsReq;
+
+#define GrNumSegments           127
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	IDTYPE	drawid;
+	IDTYPE	gcid;
+	/*GR_SEGMENT segtable[];*/
+} nxSegmentsReq;
+
+#define GrNumArcs               128
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	IDTYPE	drawid;
+	IDTYPE	gcid;
+	/*GR_ARC_ITEM arctable[];*/
+} nxArcsReq;
+
+#define GrNumTexts              129
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	IDTYPE	drawid;
+	IDTYPE	gcid;
+	UINT32	flags;
+	/*nxTextItem items[];*/
+} nxTextsReq;
+
+/* GrTexts item header, followed by string padded to ALIGNSZ*/
+typedef struct {
+	INT16	x;
+	INT16	y;
+	INT16	count;
+	UINT16	nbytes;
+	/*BYTE8 str[];*/
+} nxTextItem;
+
+#define GrNumDrawBatch          130
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	IDTYPE	drawid;
+	IDTYPE	gcid;
+	/*GR_BATCH_ITEM items[];*/
+} nxDrawBatchReq;
+
+#define GrNumDamageWindow       131
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	IDTYPE	windowid;
+	UINT32	fence;		/* nonzero to reply when copied to screen*/
+	/*GR_RECT recttable[];*/
+} nxDamageWindowReq;
+
+#define GrNumNewSharedPixmap    132
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	INT16	width;
+	INT16	height;
+	UINT32	format;
+	UINT32	shmid;
+	UINT32	offset;		/* byte offset of pixels in segment*/
+} nxNewSharedPixmapReq;
+
+#define GrNumSetEventQueueLimit 133
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	UINT32	maxevents;	/* 0 for no limit*/
+	UINT32	flags;
+} nxSetEventQueueLimitReq;
+
+#define GrNumGetEventQueueInfo  134
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+} nxGetEventQueueInfoReq;
+
+#define GrNumGetMotionHistory   135
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	UINT32	maxpoints;
+} nxGetMotionHistoryReq;
+
+#define GrNumSetWindowOpacity   136
+typedef struct {
+	BYTE8	reqType;
+	BYTE8	hilength;
+	UINT16	length;
+	IDTYPE	wid;
+	UINT16	opacity;	/* 0 transparent to 255 opaque*/
+	UINT16	pad;
+} nxSetWindowOpacityReq;
+
+#define GrTotalNumCalls         137
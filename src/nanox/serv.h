@@ -19,6 +19,7 @@
  */
 #define nxErrorStrings		SVR_nxErrorStrings
 #define GrArcAngle              SVR_GrArcAngle
+#define GrArcs                  SVR_GrArcs
 #define GrArc                   SVR_GrArc
 #define GrArea                  SVR_GrArea
 #define GrBell                  SVR_GrBell
@@ -28,7 +29,14 @@
 #define GrClose                 SVR_GrClose
 #define GrCloseWindow           SVR_GrCloseWindow
 #define GrCopyArea              SVR_GrCopyArea
+#define GrDrawBatch             SVR_GrDrawBatch
 #define GrCopyGC                SVR_GrCopyGC
+#define GrDamageWindow          SVR_GrDamageWindow
+#define GrNewSharedPixmap       SVR_GrNewSharedPixmap
+#define GrSetEventQueueLimit    SVR_GrSetEventQueueLimit
+#define GrGetEventQueueInfo     SVR_GrGetEventQueueInfo
+#define GrGetMotionHistory      SVR_GrGetMotionHistory
+#define GrSetWindowOpacity      SVR_GrSetWindowOpacity
 #define GrCreateFont            SVR_GrCreateFont
 #define GrCreateTimer		SVR_GrCreateTimer        
 #define GrDelay			SVR_GrDelay
@@ -48,6 +56,7 @@
 #define GrFillEllipse           SVR_GrFillEllipse
 #define GrFillPoly              SVR_GrFillPoly
 #define GrFillRect              SVR_GrFillRect
+#define GrFillRects             SVR_GrFillRects
 #define GrFindColor             SVR_GrFindColor
 #define GrFreeFontList		SVR_GrFreeFontList       
 #define GrFreeImage             SVR_GrFreeImage
@@ -97,6 +106,7 @@
 #define GrRequestClientData     SVR_GrRequestClientData
 #define GrResizeWindow          SVR_GrResizeWindow
 #define GrSelectEvents          SVR_GrSelectEvents
+#define GrSegments              SVR_GrSegments
 #define GrSendClientData        SVR_GrSendClientData
 #define GrSetBackgroundPixmap   SVR_GrSetBackgroundPixmap
 #define GrSetCursor             SVR_GrSetCursor
@@ -120,6 +130,7 @@
 #define GrSetWMProperties       SVR_GrSetWMProperties
 #define GrSubtractRegion        SVR_GrSubtractRegion
 #define GrText                  SVR_GrText
+#define GrTexts                 SVR_GrTexts
 #define GrUnionRectWithRegion   SVR_GrUnionRectWithRegion
 #define GrUnionRegion           SVR_GrUnionRegion
 #define GrUnmapWindow           SVR_GrUnmapWindow
@@ -170,6 +181,7 @@ typedef	int	GR_DRAW_TYPE;
 typedef	struct gr_event_list GR_EVENT_LIST;
 struct gr_event_list {
 	GR_EVENT_LIST	*next;		/* next element in list */
+	GR_TIMEOUT	time;		/* tick count when queued or coalesced*/
 	GR_EVENT	event;		/* event */
 };
 
@@ -188,8 +200,32 @@ struct gr_client {
 	int		shm_cmds_size;
 	int		shm_cmds_shmid;
 	int		processid;	/* client process id*/
+	char		*inbuf;		/* buffered request data from client*/
+	int		incount;	/* # bytes in inbuf*/
+	char		*outbuf;	/* buffered reply data to client*/
+	int		outcount;	/* # bytes pending in outbuf*/
+	int		outsize;	/* allocated size of outbuf*/
+	int		eventcount;	/* # events in event chain*/
+	int		eventpeak;	/* most events ever in event chain*/
+	int		eventlimit;	/* max events before motion dropped, 0 for none*/
+	int		eventflags;	/* GR_EVENTQ_* flags*/
+	unsigned long	eventsdropped;	/* motion events dropped at eventlimit*/
+	unsigned long	eventscoalesced; /* motion events merged into queued event*/
+	GR_MOTION_POINT	*history;	/* coalesced motion ring or NULL*/
+	int		historyhead;	/* next history slot to write*/
+	int		historycount;	/* # points in history*/
 };
 
+/* default per-client event queue limit, 0 for unlimited*/
+#ifndef GR_EVENTQ_DEFAULT_LIMIT
+#define GR_EVENTQ_DEFAULT_LIMIT	0
+#endif
+
+/* size of per-client motion history ring for GR_EVENTQ_MOTION_HISTORY*/
+#ifndef GR_MOTION_HISTORY_SIZE
+#define GR_MOTION_HISTORY_SIZE	256
+#endif
+
 /*
  * Structure to remember clients associated with events.
  */
@@ -344,6 +380,11 @@ struct gr_window {
 	char		*title;		/* window title*/
 	MWCLIPREGION*clipregion;/* window clipping region */
 	GR_PIXMAP	*buffer;	/* window buffer pixmap*/
+	int		opacity;	/* buffer opacity when compositing, 0-255*/
+	MWCLIPREGION*visregion;	/* cached visible region (DYNAMICREGIONS)*/
+	unsigned long	visgen;		/* clip generation visregion calculated at*/
+	int		visflags;	/* GR_MODE_EXCLUDECHILDREN if visregion excludes children*/
+	unsigned long	clipgen;	/* clip generation this subtree last changed at*/
 };
 
 /*
@@ -361,6 +402,7 @@ struct gr_pixmap {
 
 	GR_PIXMAP	*next;		/* next pixmap in list */
 	GR_CLIENT	*owner;		/* client that created it */
+	void		*shmaddr;	/* attached shared memory segment or NULL*/
 };
 
 /**
@@ -415,6 +457,7 @@ void		GsInitWindowBuffer(GR_WINDOW *wp, GR_SIZE width, GR_SIZE height);
 void		GsFreeWindowBuffer(GR_WINDOW *wp);
 void		GsClearWindow(GR_WINDOW *wp, GR_COORD x, GR_COORD y,
 				GR_SIZE width, GR_SIZE height, int exposeflag);
+void		GsDamageWindow(GR_WINDOW *wp, GR_COUNT count, GR_RECT *rects);
 void		GsUnrealizeWindow(GR_WINDOW *wp, GR_BOOL temp_unmap);
 void		GsRealizeWindow(GR_WINDOW *wp, GR_BOOL temp);
 void		GsDestroyWindow(GR_WINDOW *wp);
@@ -422,7 +465,15 @@ GR_WINDOW_ID	GsNewPixmap(GR_SIZE width, GR_SIZE height, int format, void *pixels
 void		GsDestroyPixmap(GR_PIXMAP *pp);
 void		GsSetPortraitMode(int mode);
 void		GsSetPortraitModeFromXY(GR_COORD rootx, GR_COORD rooty);
+#define GS_CLIP_NOCACHE	0x8000		/* GsSetClipWindow flag, don't use cached visible region*/
 void		GsSetClipWindow(GR_WINDOW *wp, MWCLIPREGION *userregion, int flags);
+void		GsInvalidateClip(GR_WINDOW *wp);
+/* DYNAMICREGIONS only*/
+MWCLIPREGION *	GsWindowVisibleArea(GR_WINDOW *wp);
+void		GsExposeRegion(GR_WINDOW *wp, MWCLIPREGION *rgn, GR_WINDOW *stopwp);
+void		GsCompositeDamage(GR_COORD x, GR_COORD y, GR_SIZE width, GR_SIZE height);
+void		GsCompositeDamageWindow(GR_WINDOW *wp);
+void		GsCompositeFlush(void);
 void		GsHandleMouseStatus(GR_COORD newx, GR_COORD newy, int newbuttons);
 void		GsFreePositionEvent(GR_CLIENT *client, GR_WINDOW_ID wid, GR_WINDOW_ID subwid);
 void		GsDeliverButtonEvent(GR_EVENT_TYPE type, int buttons, int changebuttons, int modifiers);
@@ -471,8 +522,8 @@ int		GsPutCh(int fd, unsigned char c);
 GR_CLIENT	*GsFindClient(int fd);
 void		GsDestroyClientResources(GR_CLIENT * client);
 void		GsDropClient(int fd);
-int		GsRead(int fd, void *buf, int c);
 int		GsWrite(int fd, void *buf, int c);
+int		GsFlushClient(GR_CLIENT *client);
 void		GsHandleClient(int fd);
 void		GsResetScreenSaver(void);
 void		GsActivateScreenSaver(void *arg);
@@ -498,6 +549,7 @@ extern	GR_WINDOW	*listwp;		/* list of all windows */
 extern	GR_PIXMAP	*listpp;		/* list of all pixmaps */
 extern	GR_WINDOW	*rootwp;		/* root window pointer */
 extern	GR_WINDOW	*clipwp;		/* window clipping is set for */
+extern	unsigned long	windowgeneration;	/* bumped on any window configuration change */
 extern	GR_WINDOW	*focuswp;		/* focus window for keyboard */
 extern	GR_WINDOW	*mousewp;		/* window mouse is currently in */
 extern	GR_WINDOW	*grabbuttonwp;		/* window grabbed by button */
@@ -523,6 +575,7 @@ extern  GR_GRABBED_KEY  *list_grabbed_keys;
 extern	GR_BOOL		screensaver_active;	/* screensaver is active */
 extern	GR_SELECTIONOWNER selection_owner;	/* the selection owner */
 extern  int		autoportrait;		/* auto portrait mode switching*/
+extern  int		gr_composite;		/* composite buffered windows (DYNAMICREGIONS)*/
 extern  MWCOORD		nxres;			/* requested server x res*/
 extern  MWCOORD		nyres;			/* requested server y res*/
 
@@ -14,6 +14,17 @@
 static GR_COUNT	GsSplitClipRect(MWCLIPRECT *srcrect, MWCLIPRECT *destrect,
 			GR_COORD minx, GR_COORD miny, GR_COORD maxx,
 			GR_COORD maxy);
+/*
+ * Invalidate clipping after a window change.  Clip rectangles
+ * aren't cached per window without DYNAMICREGIONS.
+ */
+void
+GsInvalidateClip(GR_WINDOW *wp)
+{
+	++windowgeneration;
+	clipwp = NULL;
+}
+
 /*
  * Set the clip rectangles for a window taking into account other
  * windows that may be obscuring it.  The windows that may be obscuring
@@ -8,15 +8,59 @@
 #include "serv.h"
 
 /*
- * Set the clip rectangles for a window taking into account other
+ * Visible regions are cached in each window and stamped with
+ * clipgeneration.  Changing a window's geometry, stacking, mapping or
+ * shape can only change the visible region of its parent, its siblings
+ * and their descendants, so GsInvalidateClip stamps just the parent with
+ * a new generation.  A cached region is valid if no ancestor has been
+ * stamped since it was calculated.
+ */
+static unsigned long clipgeneration;
+
+#define CLIP_WITHBORDER	0x10000		/* CalcVisRegion flag, include window border*/
+
+/*
+ * Invalidate cached visible regions affected by a change to
+ * the window's position, size, stacking order, mapping or shape.
+ */
+void
+GsInvalidateClip(GR_WINDOW *wp)
+{
+	GR_WINDOW *pwp = wp->parent? wp->parent: wp;
+
+	pwp->clipgen = ++clipgeneration;
+	++windowgeneration;
+	clipwp = NULL;
+
+	/* area may now show different windows*/
+	if (gr_composite)
+		GsCompositeDamageWindow(wp);
+}
+
+/* check if window's cached visible region is up to date*/
+static GR_BOOL
+ClipCacheValid(GR_WINDOW *wp, int flags)
+{
+	GR_WINDOW *pwp;
+
+	if (!wp->visregion || wp->visflags != (flags & GR_MODE_EXCLUDECHILDREN))
+		return GR_FALSE;
+
+	for (pwp = wp; pwp; pwp = pwp->parent)
+		if (pwp->clipgen > wp->visgen)
+			return GR_FALSE;
+	return GR_TRUE;
+}
+
+/*
+ * Calculate the visible region for a window taking into account other
  * windows that may be obscuring it.  The windows that may be obscuring
  * this one are the siblings of each direct ancestor which are higher
  * in priority than those ancestors.  Also, each parent limits the visible
- * area of the window.  The clipping is not done if it is already up to
- * date of if the window is not outputtable.
+ * area of the window.
  */
-void
-GsSetClipWindow(GR_WINDOW *wp, MWCLIPREGION *userregion, int flags)
+static MWCLIPREGION *
+CalcVisRegion(GR_WINDOW *wp, int flags)
 {
 	GR_WINDOW	*orgwp;		/* original window pointer */
 	GR_WINDOW	*pwp;		/* parent window */
@@ -30,19 +74,15 @@ GsSetClipWindow(GR_WINDOW *wp, MWCLIPREGION *userregion, int flags)
 	GR_COORD	x, y, width, height;
 	MWCLIPREGION	*vis, *r;
 
-	if (!wp->realized || !wp->output)
-		return;
-
-	clipwp = wp;
-
 	/*
 	 * Start with the rectangle for the complete window.
 	 * We will then cut pieces out of it as needed.
 	 */
-	x = wp->x;
-	y = wp->y;
-	width = wp->width;
-	height = wp->height;
+	bs = (flags & CLIP_WITHBORDER)? wp->bordersize: 0;
+	x = wp->x - bs;
+	y = wp->y - bs;
+	width = wp->width + bs * 2;
+	height = wp->height + bs * 2;
 
 	/*
 	 * First walk upwards through all parent windows,
@@ -78,10 +118,8 @@ GsSetClipWindow(GR_WINDOW *wp, MWCLIPREGION *userregion, int flags)
 	 * If the window is completely clipped out of view, then
 	 * set the clipping region to indicate that.
 	 */
-	if (width <= 0 || height <= 0) {
-		GdSetClipRegion(clipwp->psd, NULL);
-		return;
-	}
+	if (width <= 0 || height <= 0)
+		return GdAllocRegion();
 
 	/*
 	 * Allocate region to clipped size of window,
@@ -183,6 +221,113 @@ GsSetClipWindow(GR_WINDOW *wp, MWCLIPREGION *userregion, int flags)
 		}
 	}
 
+	/*
+	 * Destroy temp region
+	 */
+	GdDestroyRegion(r);
+
+	return vis;
+}
+
+/* return window's cached visible region, recalculating it if out of date*/
+static MWCLIPREGION *
+GetVisRegion(GR_WINDOW *wp, int flags)
+{
+	if (!ClipCacheValid(wp, flags)) {
+		if (wp->visregion)
+			GdDestroyRegion(wp->visregion);
+		wp->visregion = CalcVisRegion(wp, flags & GR_MODE_EXCLUDECHILDREN);
+		wp->visgen = clipgeneration;
+		wp->visflags = flags & GR_MODE_EXCLUDECHILDREN;
+	}
+	return wp->visregion;
+}
+
+/*
+ * Return newly allocated region of the screen showing a window and its
+ * children, including border, that is, the window area not obscured
+ * by higher windows or clipped by its parents.
+ */
+MWCLIPREGION *
+GsWindowVisibleArea(GR_WINDOW *wp)
+{
+	if (!wp->realized || !wp->output)
+		return GdAllocRegion();
+	return CalcVisRegion(wp, CLIP_WITHBORDER | GR_MODE_EXCLUDECHILDREN);
+}
+
+/*
+ * Redraw the parts of a window and its children within the passed
+ * screen region, sending exposure events only for rectangles that are
+ * actually visible.  Window stopwp and its children aren't exposed,
+ * windows stacked below it still are.
+ */
+void
+GsExposeRegion(GR_WINDOW *wp, MWCLIPREGION *rgn, GR_WINDOW *stopwp)
+{
+	MWCLIPREGION	*r;
+	MWRECT		*rp;
+	GR_SIZE		bs;
+	int		i;
+
+	if (!wp->realized || wp == stopwp || !wp->output)
+		return;
+
+	/*
+	 * First see if the region overlaps the window including the border.
+	 * If not, then there is nothing more to do.
+	 */
+	bs = wp->bordersize;
+	if ((rgn->extents.left >= wp->x + wp->width + bs) ||
+		(rgn->extents.top >= wp->y + wp->height + bs) ||
+		(rgn->extents.right <= wp->x - bs) ||
+		(rgn->extents.bottom <= wp->y - bs) ||
+		rgn->numRects == 0)
+			return;
+
+	/* redraw border if region overlaps it*/
+	if (rgn->extents.left < wp->x || rgn->extents.top < wp->y ||
+		rgn->extents.right > wp->x + wp->width ||
+		rgn->extents.bottom > wp->y + wp->height)
+			GsDrawBorder(wp);
+
+	/* clear and expose only the visible part of the region*/
+	r = GdAllocRegion();
+	GdIntersectRegion(r, rgn, GetVisRegion(wp, 0));
+	for (i = 0, rp = r->rects; i < r->numRects; i++, rp++)
+		GsClearWindow(wp, rp->left - wp->x, rp->top - wp->y,
+			rp->right - rp->left, rp->bottom - rp->top, 1);
+	GdDestroyRegion(r);
+
+	/*
+	 * Now do the same for all the children.
+	 */
+	for (wp = wp->children; wp; wp = wp->siblings)
+		GsExposeRegion(wp, rgn, stopwp);
+}
+
+/*
+ * Set the clip region for a window from its visible region, recalculating
+ * it only if the cached one is out of date, and intersect with user region.
+ * The clipping is not done if the window is not outputtable.
+ */
+void
+GsSetClipWindow(GR_WINDOW *wp, MWCLIPREGION *userregion, int flags)
+{
+	MWCLIPREGION	*vis;
+
+	if (!wp->realized || !wp->output)
+		return;
+
+	clipwp = wp;
+
+	if (flags & GS_CLIP_NOCACHE)
+		vis = CalcVisRegion(wp, flags & GR_MODE_EXCLUDECHILDREN);
+	else {
+		vis = GdAllocRegion();
+		GdCopyRegion(vis, GetVisRegion(wp, flags));
+	}
+
 	/*
 	 * Intersect with user region, if set.
 	 */
@@ -196,10 +341,292 @@ GsSetClipWindow(GR_WINDOW *wp, MWCLIPREGION *userregion, int flags)
 	/*
 	 * Set the clip region (later destroy handled by GdSetClipRegion)
 	 */
-	GdSetClipRegion(clipwp->psd, vis);
+	GdSetClipRegion(wp->psd, vis);
+}
 
-	/*
-	 * Destroy temp region
-	 */
-	GdDestroyRegion(r);
+/*
+ * Compositing of buffered windows, enabled with the server -C option.
+ *
+ * Drawing to buffered windows, exposures, and changes to window geometry,
+ * stacking and mapping only add screen damage.  Before the server waits
+ * for input, the damaged areas whose topmost window is buffered are rebuilt
+ * bottom to top from the window buffers, blending windows with an opacity
+ * less than 255 over the windows underneath with MWROP_SRC_OVER.  Windows
+ * can be moved, raised and made translucent without client repaints.
+ * Unbuffered windows seen through translucent windows show only their
+ * border and background.
+ */
+typedef struct {
+	GR_WINDOW *	wp;
+	MWCLIPREGION *	clip;		/* screen area window is painted in*/
+} GR_LAYER;
+
+static MWCLIPREGION *compositedamage;	/* screen area to recomposite*/
+static GR_LAYER	*layers;		/* windows to paint, top to bottom*/
+static int	numlayers;
+static int	maxlayers;
+static unsigned char *blendbuf;		/* RGBA conversion buffer*/
+static int	blendsize;
+
+/* check if window is drawn from its buffer*/
+static GR_BOOL
+IsComposited(GR_WINDOW *wp)
+{
+	return wp->buffer && (wp->props & GR_WM_PROPS_BUFFERED) &&
+		(wp->props & GR_WM_PROPS_DRAWING_DONE);
+}
+
+/* check if window is blended with the windows underneath*/
+static GR_BOOL
+IsTranslucent(GR_WINDOW *wp)
+{
+	if (wp->opacity >= 255 || !IsComposited(wp))
+		return GR_FALSE;
+	return wp->buffer->psd->data_format == MWIF_RGBA8888 ||
+		wp->buffer->psd->data_format == MWIF_BGRA8888;
+}
+
+/*
+ * Add a screen rectangle to the area recomposited by GsCompositeFlush.
+ */
+void
+GsCompositeDamage(GR_COORD x, GR_COORD y, GR_SIZE width, GR_SIZE height)
+{
+	MWRECT	rc;
+
+	if (width <= 0 || height <= 0)
+		return;
+	if (!compositedamage && (compositedamage = GdAllocRegion()) == NULL)
+		return;
+
+	rc.left = x;
+	rc.top = y;
+	rc.right = x + width;
+	rc.bottom = y + height;
+	GdUnionRectWithRegion(&rc, compositedamage);
+}
+
+/* damage window including its border*/
+void
+GsCompositeDamageWindow(GR_WINDOW *wp)
+{
+	GR_SIZE bs = wp->bordersize;
+
+	GsCompositeDamage(wp->x - bs, wp->y - bs, wp->width + bs * 2,
+		wp->height + bs * 2);
+}
+
+static void
+AddLayer(GR_WINDOW *wp, MWCLIPREGION *clip)
+{
+	if (numlayers >= maxlayers) {
+		int n = maxlayers? maxlayers * 2: 32;
+		GR_LAYER *lp = realloc(layers, n * sizeof(GR_LAYER));
+
+		if (!lp) {
+			GdDestroyRegion(clip);
+			return;
+		}
+		layers = lp;
+		maxlayers = n;
+	}
+	layers[numlayers].wp = wp;
+	layers[numlayers].clip = clip;
+	numlayers++;
+}
+
+/*
+ * Walk windows top to bottom, children before their parent, removing
+ * the area each window covers from remain.  If out is set, the
+ * areas where composited windows are topmost are collected into it,
+ * otherwise each window is added as a layer clipped to the remaining
+ * area, and translucent windows leave their area in remain so the
+ * windows underneath are painted too.
+ */
+static void
+WalkLayers(GR_WINDOW *wp, MWRECT *bound, MWCLIPREGION *remain, MWCLIPREGION *out)
+{
+	MWCLIPREGION	*r;
+	MWRECT		rc, inner;
+	GR_SIZE		bs;
+
+	for (; wp && remain->numRects; wp = wp->siblings) {
+		if (!wp->realized || !wp->output)
+			continue;
+
+		bs = wp->bordersize;
+		rc.left = MWMAX(wp->x - bs, bound->left);
+		rc.top = MWMAX(wp->y - bs, bound->top);
+		rc.right = MWMIN(wp->x + wp->width + bs, bound->right);
+		rc.bottom = MWMIN(wp->y + wp->height + bs, bound->bottom);
+		if (rc.left >= rc.right || rc.top >= rc.bottom)
+			continue;
+
+		/* children are above their parent and clipped by it*/
+		if (wp->children) {
+			inner.left = MWMAX(wp->x, bound->left);
+			inner.top = MWMAX(wp->y, bound->top);
+			inner.right = MWMIN(wp->x + wp->width, bound->right);
+			inner.bottom = MWMIN(wp->y + wp->height, bound->bottom);
+			if (inner.left < inner.right && inner.top < inner.bottom)
+				WalkLayers(wp->children, &inner, remain, out);
+		}
+
+		r = GdAllocRectRegionIndirect(&rc);
+		GdIntersectRegion(r, r, remain);
+		if (!r->numRects) {
+			GdDestroyRegion(r);
+			continue;
+		}
+
+		if (out) {
+			if (IsComposited(wp))
+				GdUnionRegion(out, out, r);
+			GdSubtractRegion(remain, remain, r);
+			GdDestroyRegion(r);
+		} else {
+			if (!IsTranslucent(wp))
+				GdSubtractRegion(remain, remain, r);
+			AddLayer(wp, r);
+		}
+	}
+}
+
+/* blend translucent window buffer within clip region using its opacity*/
+static void
+BlendLayer(GR_WINDOW *wp, MWCLIPREGION *clip)
+{
+	PSD		bpsd = wp->buffer->psd;
+	MWBLITPARMS	parms;
+	MWRECT		*rp;
+	unsigned char	*src, *dst;
+	int		i, x, y, w, h, row, col, bgra;
+
+	bgra = (bpsd->data_format == MWIF_BGRA8888);
+	for (i = 0, rp = clip->rects; i < clip->numRects; i++, rp++) {
+		x = MWMAX(rp->left, wp->x);
+		y = MWMAX(rp->top, wp->y);
+		w = MWMIN(rp->right, wp->x + wp->width) - x;
+		h = MWMIN(rp->bottom, wp->y + wp->height) - y;
+		if (w <= 0 || h <= 0)
+			continue;
+
+		if (w * h * 4 > blendsize) {
+			unsigned char *p = realloc(blendbuf, w * h * 4);
+			if (!p)
+				return;
+			blendbuf = p;
+			blendsize = w * h * 4;
+		}
+
+		/* copy to RGBA scaling alpha by window opacity*/
+		dst = blendbuf;
+		for (row = 0; row < h; row++) {
+			src = (unsigned char *)bpsd->addr + (y - wp->y + row) * bpsd->pitch +
+				(x - wp->x) * 4;
+			for (col = 0; col < w; col++) {
+				dst[0] = src[bgra? 2: 0];
+				dst[1] = src[1];
+				dst[2] = src[bgra? 0: 2];
+				dst[3] = (src[3] * wp->opacity + 127) / 255;
+				src += 4;
+				dst += 4;
+			}
+		}
+
+		parms.op = MWROP_SRC_OVER;
+		parms.data_format = MWIF_RGBA8888;
+		parms.width = w;
+		parms.height = h;
+		parms.dstx = x;
+		parms.dsty = y;
+		parms.srcx = 0;
+		parms.srcy = 0;
+		parms.src_pitch = w * 4;
+		parms.data = blendbuf;
+		GdConversionBlit(wp->psd, &parms);
+	}
+}
+
+/* paint window border and contents within clip region, clip is freed*/
+static void
+PaintLayer(GR_WINDOW *wp, MWCLIPREGION *clip)
+{
+	PSD	psd = wp->psd;
+	GR_SIZE	bs = wp->bordersize;
+
+	GdSetClipRegion(psd, clip);
+	clipwp = NULL;
+	curgcp = NULL;
+	GdSetFillMode(GR_FILL_SOLID);
+	GdSetMode(GR_MODE_COPY);
+
+	/* border is drawn as four strips so translucent contents don't show it*/
+	if (bs > 0) {
+		GdSetForegroundColor(psd, wp->bordercolor);
+		GdFillRect(psd, wp->x - bs, wp->y - bs, wp->width + bs * 2, bs);
+		GdFillRect(psd, wp->x - bs, wp->y + wp->height, wp->width + bs * 2, bs);
+		GdFillRect(psd, wp->x - bs, wp->y, bs, wp->height);
+		GdFillRect(psd, wp->x + wp->width, wp->y, bs, wp->height);
+	}
+
+	if (IsComposited(wp)) {
+		if (IsTranslucent(wp))
+			BlendLayer(wp, clip);
+		else GdBlit(psd, wp->x, wp->y, wp->width, wp->height, wp->buffer->psd,
+			0, 0, MWROP_COPY);
+	} else if (!(wp->props & GR_WM_PROPS_NOBACKGROUND)) {
+		GdSetForegroundColor(psd, wp->background);
+		GdFillRect(psd, wp->x, wp->y, wp->width, wp->height);
+#if MW_FEATURE_AREAS
+		if (wp->bgpixmap)
+			GsDrawBackgroundPixmap(wp, wp->bgpixmap, 0, 0, wp->width, wp->height);
+#endif
+	}
+}
+
+/*
+ * Recomposite damaged screen areas whose topmost window is buffered,
+ * painting only the windows that can be seen there, bottom to top.
+ */
+void
+GsCompositeFlush(void)
+{
+	MWCLIPREGION	*remain, *out;
+	MWRECT		bound;
+
+	if (!compositedamage || !compositedamage->numRects)
+		return;
+
+	bound.left = rootwp->x;
+	bound.top = rootwp->y;
+	bound.right = rootwp->x + rootwp->width;
+	bound.bottom = rootwp->y + rootwp->height;
+	remain = compositedamage;
+	compositedamage = NULL;
+	out = GdAllocRegion();
+	WalkLayers(rootwp->children, &bound, remain, out);
+
+	if (out->numRects) {
+		/* must hide cursor first or GdFixCursor() will show it*/
+		GdHideCursor(rootwp->psd);
+
+		GdCopyRegion(remain, out);
+		numlayers = 0;
+		WalkLayers(rootwp->children, &bound, remain, NULL);
+
+		/* root shows through translucent windows not over other windows*/
+		if (remain->numRects) {
+			PaintLayer(rootwp, remain);
+			remain = NULL;
+		}
+		while (numlayers > 0) {
+			--numlayers;
+			PaintLayer(layers[numlayers].wp, layers[numlayers].clip);
+		}
+		GdShowCursor(rootwp->psd);
+	}
+	if (remain)
+		GdDestroyRegion(remain);
+	GdDestroyRegion(out);
 }
@@ -58,17 +58,106 @@ void GsError(GR_ERROR code, GR_ID id)
 	ep->id = id;
 }
 
+/*
+ * Save a mouse motion point that is being merged into a later one
+ * or dropped in the client's motion history ring, if enabled.
+ */
+static void
+GsSaveMotionHistory(GR_CLIENT *client, GR_EVENT_LIST *elp)
+{
+	GR_MOTION_POINT *pp;
+
+	if (!client->history || elp->event.type != GR_EVENT_TYPE_MOUSE_MOTION)
+		return;
+
+	pp = &client->history[client->historyhead];
+	pp->wid = elp->event.mouse.wid;
+	pp->rootx = elp->event.mouse.rootx;
+	pp->rooty = elp->event.mouse.rooty;
+	pp->time = elp->time;
+	if (++client->historyhead >= GR_MOTION_HISTORY_SIZE)
+		client->historyhead = 0;
+	if (client->historycount < GR_MOTION_HISTORY_SIZE)
+		client->historycount++;
+}
+
+/*
+ * Remove the oldest mouse motion or position event from the client's
+ * event queue to make room when the queue limit is reached.  Other
+ * events carry state the client can't recover, so they're never dropped.
+ */
+static void
+GsDropMotionEvent(GR_CLIENT *client)
+{
+	GR_EVENT_LIST	*elp;		/* current element list */
+	GR_EVENT_LIST	*prevelp;	/* previous element list */
+
+	prevelp = NULL;
+	for (elp = client->eventhead; elp; prevelp = elp, elp = elp->next) {
+		if (elp->event.type != GR_EVENT_TYPE_MOUSE_MOTION &&
+		    elp->event.type != GR_EVENT_TYPE_MOUSE_POSITION)
+			continue;
+
+		if (prevelp)
+			prevelp->next = elp->next;
+		else
+			client->eventhead = elp->next;
+		if (client->eventtail == elp)
+			client->eventtail = prevelp;
+		--client->eventcount;
+		client->eventsdropped++;
+
+		GsSaveMotionHistory(client, elp);
+		elp->next = eventfree;
+		eventfree = elp;
+		return;
+	}
+}
+
+/*
+ * Find the queued mouse motion event that a new motion event for the
+ * same window and button state can be merged into.  Only motion and
+ * position events may follow it in the queue, so merging never moves
+ * motion past a button, key or other event.
+ */
+static GR_EVENT_LIST *
+GsFindMotionEvent(GR_CLIENT *client, GR_WINDOW_ID wid, GR_WINDOW_ID subwid,
+	int buttons, MWKEYMOD modifiers)
+{
+	GR_EVENT_LIST	*elp;		/* current element list */
+	GR_EVENT_LIST	*found = NULL;
+
+	for (elp = client->eventhead; elp; elp = elp->next) {
+		if (elp->event.type == GR_EVENT_TYPE_MOUSE_POSITION)
+			continue;
+		if (elp->event.type != GR_EVENT_TYPE_MOUSE_MOTION) {
+			found = NULL;
+			continue;
+		}
+		if (elp->event.mouse.wid == wid &&
+		    elp->event.mouse.subwid == subwid &&
+		    elp->event.mouse.buttons == buttons &&
+		    elp->event.mouse.modifiers == modifiers)
+			found = elp;
+	}
+	return found;
+}
+
 /*
  * Allocate an event to be passed back to the specified client.
  * The event is already chained onto the event queue, and only
  * needs filling out.  Returns NULL with an error generated if
- * the event cannot be allocated.
+ * the event cannot be allocated.  If the client's queue limit
+ * is reached, the oldest queued mouse motion event is dropped.
  */
 GR_EVENT *GsAllocEvent(GR_CLIENT *client)
 {
 	GR_EVENT_LIST	*elp;		/* current element list */
 	GR_CLIENT	*oldcurclient;	/* old current client */
 
+	if (client->eventlimit && client->eventcount >= client->eventlimit)
+		GsDropMotionEvent(client);
+
 	/*
 	 * Get a new event structure from the free list, or else
 	 * allocate it using malloc.
@@ -97,8 +186,11 @@ GR_EVENT *GsAllocEvent(GR_CLIENT *client)
 	if (client->eventtail)
 		client->eventtail->next = elp;
 	client->eventtail = elp;
+	if (++client->eventcount > client->eventpeak)
+		client->eventpeak = client->eventcount;
 
 	elp->next = NULL;
+	elp->time = GdGetTickCount();
 	elp->event.type = GR_EVENT_TYPE_NONE;
 
 	EVENT_UNLOCK(&eventMutex);
@@ -124,6 +216,7 @@ GR_BOOL GsCheckMouseEvent(void)
 	mousestatus = GdReadMouse(&rootx, &rooty, &newbuttons);
 	if (mousestatus <= 0)
 	{
+		GdSetMouseTime(0);
 		if (mousestatus == MOUSE_FAIL)
 			GsError(GR_ERROR_MOUSE_ERROR, 0);
 		return FALSE;
@@ -132,6 +225,9 @@ GR_BOOL GsCheckMouseEvent(void)
 	/* Deliver events as appropriate*/
 	GsHandleMouseStatus(rootx, rooty, newbuttons);
 
+	/* later injected events aren't stamped with this read's time*/
+	GdSetMouseTime(0);
+
 	/* possibly reset portrait mode based on mouse position*/
 	if (autoportrait)
 		GsSetPortraitModeFromXY(rootx, rooty);
@@ -346,7 +442,7 @@ void GsDeliverButtonEvent(GR_EVENT_TYPE type, int buttons, int changebuttons,
 			ep->buttons = buttons;
 			ep->changebuttons = changebuttons;
 			ep->modifiers = modifiers;
-			ep->time = GdGetTickCount();
+			ep->time = GdGetMouseTime();
 		}
 
 		/*
@@ -392,6 +488,7 @@ void GsDeliverMotionEvent(GR_EVENT_TYPE type, int buttons, MWKEYMOD modifiers)
 	GR_CLIENT	*client;	/* current client */
 	GR_WINDOW_ID	subwid;		/* subwindow id event is for */
 	GR_EVENT_MASK	eventmask;	/* event mask */
+	GR_EVENT_LIST	*elp;		/* queued motion event */
 
 	eventmask = GR_EVENTMASK(type);
 	if (eventmask == 0)
@@ -421,9 +518,24 @@ void GsDeliverMotionEvent(GR_EVENT_TYPE type, int buttons, MWKEYMOD modifiers)
 			 * If the event is for just the latest position,
 			 * then search the event queue for an existing
 			 * event of this type (if any), and free it.
+			 * If the client hasn't yet read a motion event
+			 * for this window, move it to the new position
+			 * rather than queueing a backlog of stale points.
 			 */
 			if (type == GR_EVENT_TYPE_MOUSE_POSITION)
 				GsFreePositionEvent(client, wp->id, subwid);
+			else if (!(client->eventflags & GR_EVENTQ_NOCOALESCE) &&
+			    (elp = GsFindMotionEvent(client, wp->id, subwid,
+			     buttons, modifiers)) != NULL) {
+				GsSaveMotionHistory(client, elp);
+				elp->time = GdGetMouseTime();
+				elp->event.mouse.rootx = cursorx;
+				elp->event.mouse.rooty = cursory;
+				elp->event.mouse.x = cursorx - wp->x;
+				elp->event.mouse.y = cursory - wp->y;
+				client->eventscoalesced++;
+				continue;
+			}
 
 			ep = (GR_EVENT_MOUSE *) GsAllocEvent(client);
 			if (ep == NULL)
@@ -676,6 +788,7 @@ GsFreeExposureEvent(GR_CLIENT *client, GR_WINDOW_ID wid, GR_COORD x,
 			client->eventhead = elp->next;
 		if (client->eventtail == elp)
 			client->eventtail = prevelp;
+		--client->eventcount;
 
 		elp->next = eventfree;
 		eventfree = elp;
@@ -941,6 +1054,7 @@ GsFreePositionEvent(GR_CLIENT *client, GR_WINDOW_ID wid, GR_WINDOW_ID subwid)
 			client->eventhead = elp->next;
 		if (client->eventtail == elp)
 			client->eventtail = prevelp;
+		--client->eventcount;
 
 		elp->next = eventfree;
 		eventfree = elp;
@@ -1068,7 +1182,7 @@ GsDeliverRawMouseEvent(GR_COORD rx, GR_COORD ry, int buttons, int modifiers)
 			gp->buttons = buttons;
 			gp->changebuttons = cbuttons;
 			gp->modifiers = modifiers;
-			gp->time = GdGetTickCount();
+			gp->time = GdGetMouseTime();
 
 			if ((wp == rootwp) || (wp->nopropmask & GR_EVENTMASK(etype)))
 				break;
@@ -4,6 +4,9 @@
  * Copyright (c) 2000 Alex Holden <alex@linuxhacker.org>
  * Copyright (c) 1991 David I. Bell
  */
+#if HAVE_SHAREDMEM_SUPPORT
+#define _GNU_SOURCE 1		/* struct ucred*/
+#endif
 #include <stdlib.h>
 #include <string.h>
 #define MWINCLUDECOLORS
@@ -12,6 +15,12 @@
 #include "nanowm.h"
 #include "osdep.h"
 #include "../drivers/genmem.h"
+#if HAVE_SHAREDMEM_SUPPORT
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#endif
 
 static int	nextid = GR_ROOT_WINDOW_ID + 1;
 
@@ -95,6 +104,7 @@ GsCheckNextEvent(GR_EVENT *ep, GR_BOOL doCheckEvent)
 	curclient->eventhead = elp->next;
 	if (curclient->eventtail == elp)
 		curclient->eventtail = NULL;
+	--curclient->eventcount;
 	elp->next = eventfree;
 	eventfree = elp;
 
@@ -138,6 +148,84 @@ GrPeekEvent(GR_EVENT *ep)
 	return 1;
 }
 
+/*
+ * Set the maximum number of events queued for the current client,
+ * 0 for no limit.  At the limit the oldest queued mouse motion event
+ * is dropped.  Flags control motion event coalescing and whether
+ * coalesced motion points are kept for GrGetMotionHistory.
+ */
+void
+GrSetEventQueueLimit(int maxevents, int flags)
+{
+	SERVER_LOCK();
+	curclient->eventlimit = (maxevents > 0)? maxevents: 0;
+	curclient->eventflags = flags;
+
+	if ((flags & GR_EVENTQ_MOTION_HISTORY) && !(flags & GR_EVENTQ_NOCOALESCE)) {
+		if (!curclient->history) {
+			curclient->history = malloc(GR_MOTION_HISTORY_SIZE * sizeof(GR_MOTION_POINT));
+			if (!curclient->history) {
+				curclient->eventflags &= ~GR_EVENTQ_MOTION_HISTORY;
+				GsError(GR_ERROR_MALLOC_FAILED, 0);
+			}
+		}
+	} else {
+		free(curclient->history);
+		curclient->history = NULL;
+		curclient->eventflags &= ~GR_EVENTQ_MOTION_HISTORY;
+	}
+	curclient->historyhead = 0;
+	curclient->historycount = 0;
+	SERVER_UNLOCK();
+}
+
+/*
+ * Return event queue statistics for the current client.
+ */
+void
+GrGetEventQueueInfo(GR_EVENTQ_INFO *info)
+{
+	SERVER_LOCK();
+	info->count = curclient->eventcount;
+	info->peak = curclient->eventpeak;
+	info->limit = curclient->eventlimit;
+	info->flags = curclient->eventflags;
+	info->dropped = curclient->eventsdropped;
+	info->coalesced = curclient->eventscoalesced;
+	SERVER_UNLOCK();
+}
+
+/*
+ * Return up to maxpoints of the most recent mouse motion points that
+ * were coalesced or dropped, oldest first, and remove them from the
+ * current client's motion history.  Returns the number of points.
+ */
+int
+GrGetMotionHistory(GR_MOTION_POINT *points, int maxpoints)
+{
+	int	count, first, i;
+
+	SERVER_LOCK();
+	count = curclient->historycount;
+	if (count > maxpoints)
+		count = maxpoints;
+	if (count <= 0) {
+		SERVER_UNLOCK();
+		return 0;
+	}
+
+	/* copy newest count points from ring, oldest first*/
+	first = curclient->historyhead - count;
+	if (first < 0)
+		first += GR_MOTION_HISTORY_SIZE;
+	for (i = 0; i < count; i++)
+		points[i] = curclient->history[(first + i) % GR_MOTION_HISTORY_SIZE];
+
+	curclient->historycount = 0;
+	SERVER_UNLOCK();
+	return count;
+}
+
 /*
  * Return information about a window id.
  */
@@ -245,6 +333,9 @@ GrRaiseWindow(GR_WINDOW_ID wid)
 	GR_WINDOW	*wp;		/* window structure */
 	GR_WINDOW	*prevwp;	/* previous window pointer */
 	GR_BOOL		overlap;	/* TRUE if there was overlap */
+#if DYNAMICREGIONS
+	MWCLIPREGION	*oldvis = NULL;	/* visible area before raise */
+#endif
 
 	SERVER_LOCK();
 
@@ -275,6 +366,11 @@ GrRaiseWindow(GR_WINDOW_ID wid)
 	}
 	overlap |= GsCheckOverlap(prevwp, wp);
 
+#if DYNAMICREGIONS
+	if (overlap)
+		oldvis = GsWindowVisibleArea(wp);
+#endif
+
 	/*
 	 * Now unlink the window and relink it in at the front of the
 	 * sibling chain.
@@ -282,13 +378,24 @@ GrRaiseWindow(GR_WINDOW_ID wid)
 	prevwp->siblings = wp->siblings;
 	wp->siblings = wp->parent->children;
 	wp->parent->children = wp;
+	GsInvalidateClip(wp);
 
 	/*
 	 * Finally redraw the window if necessary.
 	 */
 	if (overlap) {
+#if DYNAMICREGIONS
+		/* redraw only the parts of the window that were covered*/
+		MWCLIPREGION *newvis = GsWindowVisibleArea(wp);
+
+		GdSubtractRegion(newvis, newvis, oldvis);
+		GsExposeRegion(wp, newvis, NULL);
+		GdDestroyRegion(newvis);
+		GdDestroyRegion(oldvis);
+#else
 		GsDrawBorder(wp);
 		GsExposeArea(wp, wp->x, wp->y, wp->width, wp->height, NULL);
+#endif
 	}
 
 	SERVER_UNLOCK();
@@ -304,6 +411,9 @@ GrLowerWindow(GR_WINDOW_ID wid)
 	GR_WINDOW	*prevwp;	/* previous window pointer */
 	GR_WINDOW	*sibwp;		/* sibling window */
 	GR_WINDOW	*expwp;		/* siblings being exposed */
+#if DYNAMICREGIONS
+	MWCLIPREGION	*oldvis, *newvis;	/* visible area before and after lower */
+#endif
 
 	SERVER_LOCK();
 
@@ -335,6 +445,9 @@ GrLowerWindow(GR_WINDOW_ID wid)
 	sibwp = wp;
 	while (sibwp->siblings)
 		sibwp = sibwp->siblings;
+#if DYNAMICREGIONS
+	oldvis = GsWindowVisibleArea(wp);
+#endif
 
 	/*
 	 * Now unlink the window and relink it in at the end of the
@@ -347,11 +460,21 @@ GrLowerWindow(GR_WINDOW_ID wid)
 	sibwp->siblings = wp;
 
 	wp->siblings = NULL;
+	GsInvalidateClip(wp);
 
 	/*
 	 * Finally redraw the sibling windows which this window covered
 	 * if they overlapped our window.
 	 */
+#if DYNAMICREGIONS
+	/* only the area of the window now covered by siblings needs redrawing*/
+	newvis = GsWindowVisibleArea(wp);
+	GdSubtractRegion(oldvis, oldvis, newvis);
+	for (; expwp && expwp != wp; expwp = expwp->siblings)
+		GsExposeRegion(expwp, oldvis, NULL);
+	GdDestroyRegion(newvis);
+	GdDestroyRegion(oldvis);
+#else
 	while (expwp && (expwp != wp)) {
 		if (GsCheckOverlap(wp, expwp)) {
 			GsExposeArea(expwp, wp->x - wp->bordersize,
@@ -361,6 +484,7 @@ GrLowerWindow(GR_WINDOW_ID wid)
 		}
 		expwp = expwp->siblings;
 	}
+#endif
 
 	SERVER_UNLOCK();
 }
@@ -373,6 +497,7 @@ OffsetWindow(GR_WINDOW *wp, GR_COORD offx, GR_COORD offy)
 
 	wp->x += offx;
 	wp->y += offy;
+	GsInvalidateClip(wp);
 	for(cp=wp->children; cp; cp=cp->siblings)
 		OffsetWindow(cp, offx, offy);
 }
@@ -390,7 +515,90 @@ DeliverUpdateMoveEventAndChildren(GR_WINDOW *wp)
 		DeliverUpdateMoveEventAndChildren(childwp);
 }
 
-#if !(SWIEROS | ELKS)
+#if DYNAMICREGIONS
+/*
+ * Copy the rectangles of a screen region from offset -dx,-dy.
+ * Bands are copied bottom up when moving down and rectangles right to
+ * left when moving right, so no source is overwritten before it's copied.
+ */
+static void
+BlitRegion(PSD psd, MWCLIPREGION *rgn, GR_COORD dx, GR_COORD dy)
+{
+	MWRECT	*rp;
+	int	*band;
+	int	nbands, i, j, b;
+
+	if (!(band = malloc((rgn->numRects + 1) * sizeof(int))))
+		return;
+
+	/* find first rectangle of each y band*/
+	for (i = 0, nbands = 0; i < rgn->numRects; i++)
+		if (i == 0 || rgn->rects[i].top != rgn->rects[i-1].top)
+			band[nbands++] = i;
+	band[nbands] = rgn->numRects;
+
+	for (j = 0; j < nbands; j++) {
+		b = (dy > 0)? nbands - 1 - j: j;
+		for (i = band[b]; i < band[b+1]; i++) {
+			rp = &rgn->rects[(dx > 0)? band[b] + band[b+1] - 1 - i: i];
+			GdBlit(psd, rp->left, rp->top, rp->right - rp->left, rp->bottom - rp->top,
+				psd, rp->left - dx, rp->top - dy, MWROP_COPY);
+		}
+	}
+	free(band);
+}
+
+/*
+ * Move a realized window by blitting the parts of it that were and still
+ * are visible, then redraw only the uncovered areas of the windows
+ * underneath and the newly visible areas of the moved window.
+ */
+static void
+MoveWindowRegion(GR_WINDOW *wp, GR_COORD offx, GR_COORD offy)
+{
+	MWCLIPREGION	*oldvis, *newvis, *blit, *clip;
+
+	/* translucent windows may show the old position*/
+	if (gr_composite)
+		GsCompositeDamageWindow(wp);
+
+	oldvis = GsWindowVisibleArea(wp);
+	OffsetWindow(wp, offx, offy);
+	newvis = GsWindowVisibleArea(wp);
+
+	/* pixels visible both before and after the move can be copied*/
+	blit = GdAllocRegion();
+	GdOffsetRegion(oldvis, offx, offy);
+	GdIntersectRegion(blit, oldvis, newvis);
+	GdOffsetRegion(oldvis, -offx, -offy);
+
+	/* must hide cursor first or GdFixCursor() will show it*/
+	GdHideCursor(rootwp->psd);
+
+	if (blit->numRects) {
+		clip = GdAllocRegion();
+		GdCopyRegion(clip, blit);
+		GdSetClipRegion(wp->psd, clip);
+		clipwp = NULL;
+		BlitRegion(wp->psd, blit, offx, offy);
+	}
+
+	/* uncovered areas can only show the parent and its other children*/
+	GdSubtractRegion(oldvis, oldvis, newvis);
+	GsExposeRegion(wp->parent, oldvis, wp);
+
+	/* areas of the window that weren't visible before*/
+	GdSubtractRegion(newvis, newvis, blit);
+	GsExposeRegion(wp, newvis, NULL);
+
+	GdShowCursor(rootwp->psd);
+	GdDestroyRegion(blit);
+	GdDestroyRegion(newvis);
+	GdDestroyRegion(oldvis);
+}
+#endif /* DYNAMICREGIONS*/
+
+#if !DYNAMICREGIONS && !(SWIEROS | ELKS)
 static int
 IsUnobscuredBySiblings(GR_WINDOW *wp)
 {
@@ -449,7 +657,16 @@ GrMoveWindow(GR_WINDOW_ID wid, GR_COORD x, GR_COORD y)
 	 * move algorithms not requiring unmap/map
 	 */
 
-#if 1 && !(SWIEROS | ELKS)
+#if DYNAMICREGIONS
+	/* blit still visible parts, expose only uncovered areas*/
+	if (wp->realized && wp->output) {
+		MoveWindowRegion(wp, offx, offy);
+		DeliverUpdateMoveEventAndChildren(wp);
+		SERVER_UNLOCK();
+		return;
+	}
+#endif
+#if !DYNAMICREGIONS && !(SWIEROS | ELKS)
 	/* perform screen blit if topmost and mapped - no flicker!*/
 	if (wp->mapped && IsUnobscuredBySiblings(wp)
 		/* temp don't blit in portrait mode, still buggy*/
@@ -670,6 +887,7 @@ GrResizeWindow(GR_WINDOW_ID wid, GR_SIZE width, GR_SIZE height)
 	if (wp->props & GR_WM_PROPS_BUFFERED)
 		GsInitWindowBuffer(wp, width, height); /* allocate buffer and fill background*/
 
+	GsInvalidateClip(wp);
 	if (!wp->realized || !wp->output) {
 		wp->width = width;
 		wp->height = height;
@@ -1790,6 +2008,11 @@ NewWindow(GR_WINDOW *pwp, GR_COORD x, GR_COORD y, GR_SIZE width, GR_SIZE height,
 	wp->title = NULL;
 	wp->clipregion = NULL;
 	wp->buffer = NULL;
+	wp->opacity = 255;
+	wp->visregion = NULL;
+	wp->visgen = 0;
+	wp->visflags = 0;
+	wp->clipgen = 0;
 
 	pwp->children = wp;
 	listwp = wp;
@@ -1913,12 +2136,84 @@ GsNewPixmap(GR_SIZE width, GR_SIZE height, int format, void *pixels)
 	pp->width = width;
 	pp->height = height;
 	pp->owner = curclient;
+	pp->shmaddr = NULL;
 	pp->next = listpp;
 	listpp = pp;
 
 	return pp->id;
 }
 
+#if HAVE_SHAREDMEM_SUPPORT
+/* return TRUE if the current client's user owns or created segment*/
+static GR_BOOL
+GsClientOwnsSegment(struct shmid_ds *ds)
+{
+#if NONETWORK
+	return GR_TRUE;			/* client is this process*/
+#elif defined(SO_PEERCRED)
+	struct ucred	cred;
+	socklen_t	len = sizeof(cred);
+
+	if (getsockopt(curclient->id, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+		return GR_FALSE;
+	return cred.uid == ds->shm_perm.uid || cred.uid == ds->shm_perm.cuid;
+#else
+	return GR_FALSE;		/* can't check client credentials*/
+#endif
+}
+#endif /* HAVE_SHAREDMEM_SUPPORT*/
+
+/*
+ * Allocate a pixmap whose pixels are in the shared memory segment shmid
+ * at byte offset, so clients can draw into it without copying through
+ * the server connection.  The segment must belong to the client's user.
+ * The segment is detached when the pixmap is destroyed.  Returns 0 if
+ * shared memory isn't supported, the segment isn't the client's or the
+ * segment is too small.
+ */
+GR_WINDOW_ID
+GrNewSharedPixmap(GR_SIZE width, GR_SIZE height, int format, int shmid,
+	unsigned long offset)
+{
+	GR_WINDOW_ID id = 0;
+#if HAVE_SHAREDMEM_SUPPORT
+	GR_PIXMAP	*pp;
+	struct shmid_ds	ds;
+	unsigned int	size;
+	char		*addr;
+
+	SERVER_LOCK();
+
+	if (shmctl(shmid, IPC_STAT, &ds) < 0 || !GsClientOwnsSegment(&ds)) {
+		DPRINTF("GrNewSharedPixmap: segment %d not client's\n", shmid);
+		SERVER_UNLOCK();
+		return 0;
+	}
+	size = GdPixmapSize(rootwp->psd, width, height, format);
+	if (!size || offset > ds.shm_segsz || size > ds.shm_segsz - offset) {
+		DPRINTF("GrNewSharedPixmap: segment %d too small\n", shmid);
+		SERVER_UNLOCK();
+		return 0;
+	}
+	addr = shmat(shmid, 0, 0);
+	if (addr == (char *)-1) {
+		SERVER_UNLOCK();
+		return 0;
+	}
+
+	id = GsNewPixmap(width, height, format, addr + offset);
+	pp = id? GsFindPixmap(id): NULL;
+	if (!pp) {
+		shmdt(addr);
+		id = 0;
+	} else
+		pp->shmaddr = addr;
+
+	SERVER_UNLOCK();
+#endif /* HAVE_SHAREDMEM_SUPPORT*/
+	return id;
+}
+
 /*
  * Map the window to make it (and possibly its children) visible on the screen.
  */
@@ -1989,6 +2284,26 @@ GrClearArea(GR_WINDOW_ID wid, GR_COORD x, GR_COORD y, GR_SIZE width, GR_SIZE hei
 	SERVER_UNLOCK();
 }
 
+/**
+ * Copy damaged areas of a buffered window to the screen and mark
+ * the window buffer ready for display.  A count of 0 copies the
+ * entire window.  The copy is complete on return.
+ */
+GR_COOKIE
+GrDamageWindow(GR_WINDOW_ID wid, GR_COUNT count, GR_RECT *recttable, GR_BOOL fence)
+{
+	GR_WINDOW		*wp;	/* window structure */
+
+	SERVER_LOCK();
+
+	wp = GsPrepareWindow(wid);
+	if (wp)
+		GsDamageWindow(wp, count, recttable);
+
+	SERVER_UNLOCK();
+	return 0;
+}
+
 /* Return window with keyboard focus.*/
 GR_WINDOW_ID
 GrGetFocus(void)
@@ -2657,6 +2972,106 @@ GrFillRect(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y,
 	SERVER_UNLOCK();
 }
 
+/*
+ * Fill multiple rectangles in the specified drawable using the specified
+ * graphics context.  The drawable and GC are prepared once for all rectangles.
+ */
+void
+GrFillRects(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_RECT *recttable)
+{
+	GR_DRAWABLE	*dp;
+	GR_RECT		*rp;
+
+	SERVER_LOCK();
+
+	switch (GsPrepareDrawing(id, gc, &dp)) {
+	case GR_DRAW_TYPE_WINDOW:
+	case GR_DRAW_TYPE_PIXMAP:
+		for (rp = recttable; count-- > 0; rp++)
+			GdFillRect(dp->psd, dp->x + rp->x, dp->y + rp->y, rp->width, rp->height);
+		break;
+	}
+
+	SERVER_UNLOCK();
+}
+
+/*
+ * Draw multiple line segments in the specified drawable using the specified
+ * graphics context.  The drawable and GC are prepared once for all segments.
+ */
+void
+GrSegments(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_SEGMENT *segtable)
+{
+	GR_DRAWABLE	*dp;
+	GR_SEGMENT	*sp;
+
+	SERVER_LOCK();
+
+	switch (GsPrepareDrawing(id, gc, &dp)) {
+	case GR_DRAW_TYPE_WINDOW:
+	case GR_DRAW_TYPE_PIXMAP:
+		for (sp = segtable; count-- > 0; sp++)
+			GdLine(dp->psd, dp->x + sp->x1, dp->y + sp->y1,
+				dp->x + sp->x2, dp->y + sp->y2, TRUE);
+		break;
+	}
+
+	SERVER_UNLOCK();
+}
+
+/*
+ * Draw a batch of mixed primitives in the specified drawable using the
+ * specified graphics context.  The drawable and GC are prepared once for
+ * the entire batch.
+ */
+void
+GrDrawBatch(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_BATCH_ITEM *items)
+{
+	GR_DRAWABLE	*dp;
+	GR_BATCH_ITEM	*ip;
+	PSD		psd;
+	GR_COORD	x, y;
+
+	SERVER_LOCK();
+
+	switch (GsPrepareDrawing(id, gc, &dp)) {
+	case GR_DRAW_TYPE_WINDOW:
+	case GR_DRAW_TYPE_PIXMAP:
+		psd = dp->psd;
+		break;
+	default:
+		SERVER_UNLOCK();
+		return;
+	}
+
+	for (ip = items; count-- > 0; ip++) {
+		x = dp->x + ip->x1;
+		y = dp->y + ip->y1;
+		switch (ip->type) {
+		case GR_BATCH_POINT:
+			GdPoint(psd, x, y);
+			break;
+		case GR_BATCH_LINE:
+			GdLine(psd, x, y, dp->x + ip->x2, dp->y + ip->y2, TRUE);
+			break;
+		case GR_BATCH_RECT:
+			GdRect(psd, x, y, ip->x2, ip->y2);
+			break;
+		case GR_BATCH_FILLRECT:
+			GdFillRect(psd, x, y, ip->x2, ip->y2);
+			break;
+		case GR_BATCH_ELLIPSE:
+			GdEllipse(psd, x, y, ip->x2, ip->y2, FALSE);
+			break;
+		case GR_BATCH_FILLELLIPSE:
+			GdEllipse(psd, x, y, ip->x2, ip->y2, TRUE);
+			break;
+		}
+	}
+
+	SERVER_UNLOCK();
+}
+
 /*
  * Draw the boundary of an ellipse in the specified drawable with
  * the specified graphics context.  Integer only.
@@ -2746,6 +3161,30 @@ GrArcAngle(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y,
 
 	SERVER_UNLOCK();
 }
+
+/*
+ * Draw multiple arcs or pies in the specified drawable using the
+ * specified graphics context.  Requires floating point.
+ */
+void
+GrArcs(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_ARC_ITEM *arctable)
+{
+	GR_DRAWABLE	*dp;
+	GR_ARC_ITEM	*ap;
+
+	SERVER_LOCK();
+
+	switch (GsPrepareDrawing(id, gc, &dp)) {
+	case GR_DRAW_TYPE_WINDOW:
+	case GR_DRAW_TYPE_PIXMAP:
+		for (ap = arctable; count-- > 0; ap++)
+			GdArcAngle(dp->psd, dp->x + ap->x, dp->y + ap->y, ap->rx, ap->ry,
+				ap->angle1, ap->angle2, ap->type);
+		break;
+	}
+
+	SERVER_UNLOCK();
+}
 #endif /* MW_FEATURE_SHAPES*/
 
 #if MW_FEATURE_BITMAPS
@@ -2847,6 +3286,7 @@ GrLoadImageFromFile(char *path, int flags)
 	pp->width = pmd->xvirtres;
 	pp->height = pmd->yvirtres;
 	pp->owner = curclient;
+	pp->shmaddr = NULL;
 	pp->next = listpp;
 	listpp = pp;
 
@@ -2906,6 +3346,7 @@ GrLoadImageFromBuffer(void *buffer, int size, int flags)
 	pp->width = pmd->xvirtres;
 	pp->height = pmd->yvirtres;
 	pp->owner = curclient;
+	pp->shmaddr = NULL;
 	pp->next = listpp;
 	listpp = pp;
 
@@ -3333,6 +3774,42 @@ GrText(GR_DRAW_ID id, GR_GC_ID gc, GR_COORD x, GR_COORD y, void *str,
 	SERVER_UNLOCK();
 }
 
+/*
+ * Draw multiple text strings in the specified drawable using the
+ * specified graphics context.  The drawable, GC and font are
+ * looked up once for all strings.
+ */
+void
+GrTexts(GR_DRAW_ID id, GR_GC_ID gc, GR_COUNT count, GR_TEXT_ITEM *items,
+	GR_TEXTFLAGS flags)
+{
+	GR_DRAWABLE	*dp;
+	GR_GC		*gcp;
+	GR_FONT		*fontp;
+	PMWFONT		pf;
+	GR_TEXT_ITEM	*ip;
+
+	SERVER_LOCK();
+
+	/* default to baseline alignment if none specified*/
+	if((flags&(MWTF_TOP|MWTF_BASELINE|MWTF_BOTTOM)) == 0)
+		flags |= MWTF_BASELINE;
+
+	switch (GsPrepareDrawing(id, gc, &dp)) {
+	case GR_DRAW_TYPE_WINDOW:
+	case GR_DRAW_TYPE_PIXMAP:
+		gcp = GsFindGC(gc);
+		fontp = gcp? GsFindFont(gcp->fontid): NULL;
+		pf = fontp? fontp->pfont: stdfont;
+		for (ip = items; count-- > 0; ip++)
+			GdText(dp->psd, pf, dp->x + ip->x, dp->y + ip->y, ip->str,
+				ip->count, flags);
+		break;
+	}
+
+	SERVER_UNLOCK();
+}
+
 /* Return the system palette entries*/
 void
 GrGetSystemPalette(GR_PALETTE *pal)
@@ -3493,6 +3970,7 @@ GrSetWMProperties(GR_WINDOW_ID wid, GR_WM_PROPERTIES *props)
 			/* FIXME: check if this works if not already realized*/
 			GsUnrealizeWindow(wp, GR_TRUE);
 			wp->bordersize = props->bordersize;
+			GsInvalidateClip(wp);
 			GsRealizeWindow(wp, GR_TRUE);
 		}
 	}
@@ -3715,6 +4193,38 @@ GrSetBackgroundPixmap(GR_WINDOW_ID wid, GR_WINDOW_ID pixmap, int flags)
 }
 #endif
 
+/*
+ * Set the opacity a buffered window is composited with, 0-255.
+ * Ignored unless the server is compositing (-C option).
+ */
+void
+GrSetWindowOpacity(GR_WINDOW_ID wid, int opacity)
+{
+	GR_WINDOW *wp;
+
+	SERVER_LOCK();
+
+	if (!(wp = GsFindWindow(wid))) {
+		GsError(GR_ERROR_BAD_WINDOW_ID, wid);
+		SERVER_UNLOCK();
+		return;
+	}
+
+	if (opacity < 0)
+		opacity = 0;
+	if (opacity > 255)
+		opacity = 255;
+	if (wp->opacity != opacity) {
+		wp->opacity = opacity;
+#if DYNAMICREGIONS
+		if (gr_composite && wp->realized)
+			GsCompositeDamageWindow(wp);
+#endif
+	}
+
+	SERVER_UNLOCK();
+}
+
 #if MW_FEATURE_CLIENTDATA
 void
 GrGetFontList(GR_FONTLIST ***fonts, int *numfonts)
@@ -4108,6 +4618,7 @@ GrSetWindowRegion(GR_WINDOW_ID wid, GR_REGION_ID rid, int type)
 	if (wp->clipregion)
 		GdDestroyRegion(wp->clipregion);
 	wp->clipregion = newregion;
+	GsInvalidateClip(wp);
 
 	SERVER_UNLOCK();
 #endif
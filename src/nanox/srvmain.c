@@ -40,6 +40,7 @@ GR_CURSOR	*listcursorp;		/* list of all cursors */
 GR_CURSOR	*stdcursor;		/* root window cursor */
 GR_GC		*curgcp;		/* currently enabled gc */
 GR_WINDOW	*clipwp;		/* window clipping is set for */
+unsigned long	windowgeneration = 1;	/* bumped on any window configuration change */
 GR_WINDOW	*focuswp;		/* focus window for keyboard */
 GR_WINDOW	*mousewp;		/* window mouse is currently in */
 GR_WINDOW	*grabbuttonwp;		/* window grabbed by button */
@@ -64,6 +65,7 @@ char		*curfunc;		/* the name of the current server func*/
 GR_BOOL		screensaver_active;	/* time before screensaver activates */
 GR_SELECTIONOWNER selection_owner;	/* the selection owner and typelist */
 int		autoportrait = FALSE;	/* auto portrait mode switching*/
+int		gr_composite = FALSE;	/* composite buffered windows*/
 GR_GRABBED_KEY  *list_grabbed_keys = NULL;     /* list of all grabbed keys */
 
 #if MW_FEATURE_TIMERS
@@ -95,7 +97,7 @@ int		un_sock;		/* the server socket descriptor */
 static void
 usage(void)
 {
-	EPRINTF("Usage: %s [-p] [-A] [-NLRD] [-x #] [-y #] ...]\n", progname);
+	EPRINTF("Usage: %s [-p] [-A] [-C] [-NLRD] [-x #] [-y #] ...]\n", progname);
 	exit(1);
 }
 
@@ -131,6 +133,13 @@ MAIN(int argc, char **argv)			/* ALLEGRO=real_main(), main() otherwise*/
 			++t;
 			continue;
 		}
+#if DYNAMICREGIONS
+		if ( !strcmp("-C",argv[t]) ) {
+			gr_composite = TRUE;
+			++t;
+			continue;
+		}
+#endif
 		if ( !strcmp("-N",argv[t]) ) {
 			portraitmode = MWPORTRAIT_NONE;
 			++t;
@@ -214,6 +223,20 @@ GsAcceptClientFd(int i)
 	client->prev = NULL;
 	client->waiting_for_event = FALSE;
 	client->shm_cmds = 0;
+	client->inbuf = NULL;
+	client->incount = 0;
+	client->outbuf = NULL;
+	client->outcount = 0;
+	client->outsize = 0;
+	client->eventcount = 0;
+	client->eventpeak = 0;
+	client->eventlimit = GR_EVENTQ_DEFAULT_LIMIT;
+	client->eventflags = 0;
+	client->eventsdropped = 0;
+	client->eventscoalesced = 0;
+	client->history = NULL;
+	client->historyhead = 0;
+	client->historycount = 0;
 
 	if(connectcount++ == 0)
 		root_client = client;
@@ -365,6 +388,7 @@ void
 GsSelect(GR_TIMEOUT timeout)
 {
 	fd_set	rfds;
+	fd_set	wfds;
 	int 	e;
 	int	setsize = 0;
 	struct timeval tout;
@@ -379,6 +403,11 @@ GsSelect(GR_TIMEOUT timeout)
 		GsCheckMouseEvent();
 		return;
 	}
+#endif
+#if DYNAMICREGIONS
+	/* composite buffered windows damaged since last select*/
+	if (gr_composite)
+		GsCompositeFlush();
 #endif
 	/* X11/SDL perform single update of aggregate screen update region*/
 	if (scrdev.PreSelect)
@@ -413,6 +442,7 @@ GsSelect(GR_TIMEOUT timeout)
 
 	/* Set up the FDs for use in the main select(): */
 	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
 	if(mouse_fd >= 0)
 	{
 		FD_SET(mouse_fd, &rfds);
@@ -448,6 +478,9 @@ GsSelect(GR_TIMEOUT timeout)
 			return;
 		}
 		FD_SET(curclient->id, &rfds);
+		/* wait for slow client to accept pending replies*/
+		if(curclient->outcount)
+			FD_SET(curclient->id, &wfds);
 		if(curclient->id > setsize) setsize = curclient->id;
 		curclient = curclient->next;
 	}
@@ -500,7 +533,7 @@ GsSelect(GR_TIMEOUT timeout)
 again:
 	SERVER_UNLOCK();	        /* allow other threads to run*/
 #endif
-	e = select(setsize+1, &rfds, NULL, NULL, to);
+	e = select(setsize+1, &rfds, &wfds, NULL, to);
 #if NONETWORK
 	SERVER_LOCK();
 #endif
@@ -545,6 +578,12 @@ again:
 
 			/* curclient may be freed in GsDropClient*/
 			curclient_next = curclient->next;
+			if(FD_ISSET(curclient->id, &wfds)) {
+				if (GsFlushClient(curclient) < 0) {
+					curclient = curclient_next;
+					continue;
+				}
+			}
 			if(FD_ISSET(curclient->id, &rfds))
 				GsHandleClient(curclient->id);
 			curclient = curclient_next;
@@ -601,6 +640,10 @@ GsSelect (GR_TIMEOUT timeout)
 	struct timeval tout;
 #endif
 
+#if DYNAMICREGIONS
+	if (gr_composite)
+		GsCompositeFlush();
+#endif
 	/* perform pre-select duties, if any*/
 	if (scrdev.PreSelect)
 		scrdev.PreSelect(&scrdev);
@@ -695,6 +738,10 @@ GsSelect(GR_TIMEOUT timeout)
 	/* input gathering loop */
 	while (1)
 	{
+#if DYNAMICREGIONS
+		if (gr_composite)
+			GsCompositeFlush();
+#endif
 		/* perform single update of aggregate screen update region*/
 		if(scrdev.PreSelect)
 			scrdev.PreSelect(&scrdev);
@@ -844,6 +891,7 @@ GrServiceSelect(void *rfdset, GR_FNCALLBACKEVENT fncb)
 		curclient->eventhead = elp->next;
 		if (curclient->eventtail == elp)
 			curclient->eventtail = NULL;
+		--curclient->eventcount;
 
 		elp->next = eventfree;
 		eventfree = elp;
@@ -1038,7 +1086,12 @@ GsInitialize(void)
 	wp->props = 0;
 	wp->title = NULL;
 	wp->clipregion = NULL;
+	wp->visregion = NULL;
+	wp->visgen = 0;
+	wp->visflags = 0;
+	wp->clipgen = 0;
 	wp->buffer = NULL;
+	wp->opacity = 255;
 
 	listpp = NULL;
 	listwp = wp;
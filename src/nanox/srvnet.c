@@ -16,7 +16,9 @@
 #include "uni_std.h"
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #if HAVE_SHAREDMEM_SUPPORT
 #include <sys/types.h>
 #include <sys/ipc.h>
@@ -40,6 +42,17 @@ extern	int		un_sock;
 extern	GR_CLIENT	*root_client;
 extern	int		current_fd;
 
+/*
+ * Per-client request and reply buffering.  Client sockets are non-blocking,
+ * all available request data is read with a single read() and every
+ * complete request in the input buffer is dispatched.  Replies are
+ * buffered and sent with a single write, or gathered with writev()
+ * for large replies.  Reply data a slow client can't yet accept is kept
+ * in the output buffer and flushed when the socket becomes writable.
+ */
+#define SZCLIENTINBUF	(MAXREQUESTSZ * 2)	/* client input buffer size*/
+#define SZCLIENTOUTBUF	4096			/* initial client output buffer size*/
+
 static int GsWriteType(int,short);
 
 /*
@@ -116,6 +129,58 @@ GrNewPixmapExWrapper(void *r)
 	GsWrite(current_fd, &wid, sizeof(wid));
 }
 
+static void
+GrNewSharedPixmapWrapper(void *r)
+{
+	nxNewSharedPixmapReq *req = r;
+	GR_WINDOW_ID	wid;
+
+	wid = GrNewSharedPixmap(req->width, req->height, req->format,
+		req->shmid, req->offset);
+
+	GsWriteType(current_fd,GrNumNewSharedPixmap);
+	GsWrite(current_fd, &wid, sizeof(wid));
+}
+
+static void
+GrSetEventQueueLimitWrapper(void *r)
+{
+	nxSetEventQueueLimitReq *req = r;
+
+	GrSetEventQueueLimit((int)req->maxevents, req->flags);
+}
+
+static void
+GrGetEventQueueInfoWrapper(void *r)
+{
+	GR_EVENTQ_INFO	info;
+
+	GrGetEventQueueInfo(&info);
+
+	GsWriteType(current_fd,GrNumGetEventQueueInfo);
+	GsWrite(current_fd, &info, sizeof(info));
+}
+
+static void
+GrGetMotionHistoryWrapper(void *r)
+{
+	nxGetMotionHistoryReq *req = r;
+	GR_MOTION_POINT	points[GR_MOTION_HISTORY_SIZE];
+	long		maxpoints = (long)req->maxpoints;	/* client passed an int*/
+	int		count;
+
+	if (maxpoints < 0)
+		maxpoints = 0;
+	if (maxpoints > GR_MOTION_HISTORY_SIZE)
+		maxpoints = GR_MOTION_HISTORY_SIZE;
+	count = GrGetMotionHistory(points, (int)maxpoints);
+
+	GsWriteType(current_fd,GrNumGetMotionHistory);
+	GsWrite(current_fd, &count, sizeof(count));
+	if (count > 0)
+		GsWrite(current_fd, points, count * sizeof(GR_MOTION_POINT));
+}
+
 static void
 GrNewInputWindowWrapper(void *r)
 {
@@ -438,6 +503,18 @@ GrGetWindowInfoWrapper(void *r)
 	GsWrite(current_fd, &wi, sizeof(wi));
 }
 
+static void
+GrDamageWindowWrapper(void *r)
+{
+	nxDamageWindowReq *req = r;
+	int        count;
+
+	count = GetReqVarLen(req) / sizeof(GR_RECT);
+	GrDamageWindow(req->windowid, count, (GR_RECT *)GetReqData(req), req->fence != 0);
+	if (req->fence)
+		GsWriteType(current_fd,GrNumDamageWindow);
+}
+
 static void
 GrGetFontInfoWrapper(void *r)
 {
@@ -524,6 +601,7 @@ GrGetNextEventWrapperFinish(int fd)
 {
 	GR_EVENT evt;
 	GR_EVENT_CLIENT_DATA *cde;
+	GR_CLIENT *client;
 
 	/* get the event and pass it to client*/
 	/* this will never be GR_EVENT_TYPE_NONE*/
@@ -538,6 +616,10 @@ GrGetNextEventWrapperFinish(int fd)
 			free(cde->data);
 		} cde->datalen = 0;
 	}
+
+	/* called outside GsHandleClient, send event now*/
+	if ((client = GsFindClient(fd)) != NULL)
+		GsFlushClient(client);
 }
 
 static void
@@ -630,6 +712,48 @@ GrFillRectWrapper(void *r)
 		req->height);
 }
 
+static void
+GrFillRectsWrapper(void *r)
+{
+	nxFillRectsReq *req = r;
+	int        count;
+
+	count = GetReqVarLen(req) / sizeof(GR_RECT);
+	GrFillRects(req->drawid, req->gcid, count, (GR_RECT *)GetReqData(req));
+}
+
+static void
+GrSegmentsWrapper(void *r)
+{
+	nxSegmentsReq *req = r;
+	int        count;
+
+	count = GetReqVarLen(req) / sizeof(GR_SEGMENT);
+	GrSegments(req->drawid, req->gcid, count, (GR_SEGMENT *)GetReqData(req));
+}
+
+static void
+GrDrawBatchWrapper(void *r)
+{
+	nxDrawBatchReq *req = r;
+	int        count;
+
+	count = GetReqVarLen(req) / sizeof(GR_BATCH_ITEM);
+	GrDrawBatch(req->drawid, req->gcid, count, (GR_BATCH_ITEM *)GetReqData(req));
+}
+
+static void
+GrArcsWrapper(void *r)
+{
+#if MW_FEATURE_SHAPES
+	nxArcsReq *req = r;
+	int        count;
+
+	count = GetReqVarLen(req) / sizeof(GR_ARC_ITEM);
+	GrArcs(req->drawid, req->gcid, count, (GR_ARC_ITEM *)GetReqData(req));
+#endif
+}
+
 static void
 GrPolyWrapper(void *r)
 {
@@ -980,6 +1104,67 @@ GrTextWrapper(void *r)
 		req->count, req->flags);
 }
 
+/* return padded size of GrTexts item at p, or 0 if it doesn't fit before end*/
+static int
+TextItemSize(char *p, char *end, GR_TEXTFLAGS flags)
+{
+	nxTextItem *tp = (nxTextItem *)p;
+	int	    nbytes;
+
+	if (end - p < (int)sizeof(nxTextItem))
+		return 0;
+	if (tp->count < 0 || tp->nbytes > end - p - (int)sizeof(nxTextItem))
+		return 0;
+
+	/* string must hold count characters*/
+	if (flags & (MWTF_UC16|MWTF_XCHAR2B))
+		nbytes = tp->count * 2;
+	else if (flags & MWTF_UC32)
+		nbytes = tp->count * 4;
+	else
+		nbytes = tp->count;
+	if (nbytes > tp->nbytes)
+		return 0;
+
+	return (sizeof(nxTextItem) + tp->nbytes + (ALIGNSZ-1)) & ~(ALIGNSZ-1);
+}
+
+static void
+GrTextsWrapper(void *r)
+{
+	nxTextsReq *req = r;
+	nxTextItem *tp;
+	GR_TEXT_ITEM *items;
+	char *	    p, *end;
+	int	    count, i, size;
+
+	/* count items up to first bad one, then convert to GR_TEXT_ITEM table*/
+	p = GetReqData(req);
+	end = p + GetReqVarLen(req);
+	for (count = 0; p < end; count++) {
+		if ((size = TextItemSize(p, end, req->flags)) == 0)
+			break;
+		p += size;
+	}
+	if (count == 0)
+		return;
+
+	items = malloc(count * sizeof(GR_TEXT_ITEM));
+	if (!items)
+		return;
+	p = GetReqData(req);
+	for (i = 0; i < count; i++) {
+		tp = (nxTextItem *)p;
+		items[i].x = tp->x;
+		items[i].y = tp->y;
+		items[i].count = tp->count;
+		items[i].str = p + sizeof(nxTextItem);
+		p += (sizeof(nxTextItem) + tp->nbytes + (ALIGNSZ-1)) & ~(ALIGNSZ-1);
+	}
+	GrTexts(req->drawid, req->gcid, count, items, req->flags);
+	free(items);
+}
+
 static void
 GrNewCursorWrapper(void *r)
 {
@@ -1249,6 +1434,14 @@ GrSetBackgroundPixmapWrapper(void *r)
 #endif
 }
 
+static void
+GrSetWindowOpacityWrapper(void *r)
+{
+	nxSetWindowOpacityReq *req = r;
+
+	GrSetWindowOpacity(req->wid, req->opacity);
+}
+
 static void
 GrDestroyCursorWrapper(void *r)
 {
@@ -1512,10 +1705,12 @@ GrReqShmCmdsWrapper(void *r)
 
  finish:
 	DPRINTF("Shm: Request key granted=%d\n",key);
+	GsWriteType(current_fd, GrNumReqShmCmds);
 	GsWrite(current_fd, &key, sizeof(key));
 #else
 	/* return no shared memory support*/
 	int key = 0;
+	GsWriteType(current_fd, GrNumReqShmCmds);
 	GsWrite(current_fd, &key, sizeof(key));
 #endif /* HAVE_SHAREDMEM_SUPPORT*/
 }
@@ -1801,6 +1996,17 @@ static const struct GrFunction GrFunctions[] = {
 	/* 123 */ {GrCreateFontFromBufferWrapper, "GrCreateFontFromBuffer"},
 	/* 124 */ {GrCopyFontWrapper, "GrCopyFont"},
 	/* 125 */ {GrDrawImagePartToFitWrapper, "GrDrawImagePartToFit"},
+	/* 126 */ {GrFillRectsWrapper, "GrFillRects"},
+	/* 127 */ {GrSegmentsWrapper, "GrSegments"},
+	/* 128 */ {GrArcsWrapper, "GrArcs"},
+	/* 129 */ {GrTextsWrapper, "GrTexts"},
+	/* 130 */ {GrDrawBatchWrapper, "GrDrawBatch"},
+	/* 131 */ {GrDamageWindowWrapper, "GrDamageWindow"},
+	/* 132 */ {GrNewSharedPixmapWrapper, "GrNewSharedPixmap"},
+	/* 133 */ {GrSetEventQueueLimitWrapper, "GrSetEventQueueLimit"},
+	/* 134 */ {GrGetEventQueueInfoWrapper, "GrGetEventQueueInfo"},
+	/* 135 */ {GrGetMotionHistoryWrapper, "GrGetMotionHistory"},
+	/* 136 */ {GrSetWindowOpacityWrapper, "GrSetWindowOpacity"},
 };
 
 void
@@ -1818,6 +2024,7 @@ GrShmCmdsFlushWrapper(void *r)
 		EPRINTF("nano-X: Ill behaved client assumes shm ok\n");
 		if ( req->reply ) {
 			reply = 0;
+			GsWriteType(current_fd, GrNumShmCmdsFlush);
 			GsWrite(current_fd, &reply, 1);
 		}
 		return;
@@ -1839,12 +2046,14 @@ GrShmCmdsFlushWrapper(void *r)
 
 	if ( req->reply ) {
 		reply = 1;
+		GsWriteType(current_fd, GrNumShmCmdsFlush);
 		GsWrite(current_fd, &reply, 1);
 	}
 #else
 	/* no shared memory support*/
 	if ( req->reply ) {
 		reply = 0;
+		GsWriteType(current_fd, GrNumShmCmdsFlush);
 		GsWrite(current_fd, &reply, 1);
 	}
 #endif /* HAVE_SHAREDMEM_SUPPORT*/
@@ -1905,6 +2114,8 @@ GsAcceptClient(void)
 		EPRINTF("nano-X: Error accept failed (%d)\n", errno);
 		return;
 	}
+	/* non-blocking so a slow client can't stall the server*/
+	fcntl(i, F_SETFL, fcntl(i, F_GETFL) | O_NONBLOCK);
 	GsAcceptClientFd(i);
 }
 
@@ -2063,6 +2274,7 @@ again:
 		evp = client->eventhead;
 	}
 	client->eventtail = NULL;
+	client->eventcount = 0;
 }
 
 /*
@@ -2146,6 +2358,9 @@ GsDropClient(int fd)
 #endif
 		GsPrintResources();
 
+		free(client->inbuf);
+		free(client->outbuf);
+		free(client->history);
 		if (curclient == client)
 			curclient = root_client;
 		free(client);	/* Free the structure */
@@ -2156,51 +2371,130 @@ GsDropClient(int fd)
 }
 
 /*
- * This is a wrapper to read() which handles error conditions, and
- * returns 0 for both error conditions and no data.
+ * Find client from socket descriptor, checking current client first.
  */
-int
-GsRead(int fd, void *buf, int c)
+static GR_CLIENT *
+GsFindClientFd(int fd)
 {
-	int e, n;
+	if (curclient && curclient->id == fd)
+		return curclient;
+	return GsFindClient(fd);
+}
 
-	n = 0;
+/*
+ * Append data to client output buffer, growing it if required.
+ * The client is dropped if the buffer can't grow, as a lost reply
+ * would desynchronize it.  Returns -1 if client was dropped.
+ */
+static int
+GsBufferOutput(GR_CLIENT *client, void *buf, int c)
+{
+	if (client->outcount + c > client->outsize) {
+		int newsize = client->outsize? client->outsize: SZCLIENTOUTBUF;
+		char *newbuf;
+
+		while (newsize < client->outcount + c)
+			newsize *= 2;
+		newbuf = realloc(client->outbuf, newsize);
+		if (!newbuf) {
+			EPRINTF("nano-X: can't buffer reply for client %d\n", client->id);
+			GsClose(client->id);
+			return -1;
+		}
+		client->outbuf = newbuf;
+		client->outsize = newsize;
+	}
+	memcpy(client->outbuf + client->outcount, buf, c);
+	client->outcount += c;
+	return 0;
+}
 
-	while(n < c) {
-		e = read(fd, ((char *)buf) + n, c - n);
-		if(e <= 0) {
-			if (e == 0)
-				EPRINTF("nano-X: client closed socket: %d\n", fd);
-			else EPRINTF("nano-X: GsRead failed %d %d: %d\r\n", e, n, errno);
-			GsClose(fd);
+/*
+ * Send pending output to client.  Returns -1 if client was dropped,
+ * otherwise the number of bytes still pending.
+ */
+int
+GsFlushClient(GR_CLIENT *client)
+{
+	int e;
+
+	while (client->outcount > 0) {
+		e = write(client->id, client->outbuf, client->outcount);
+		if (e < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;		/* flushed later when writable*/
+		}
+		if (e <= 0) {
+			/*EPRINTF("nano-X: GsFlushClient failed %d\n", client->id);*/
+			GsClose(client->id);
 			return -1;
 		}
-		n += e;
+		client->outcount -= e;
+		if (client->outcount)
+			memmove(client->outbuf, client->outbuf + e, client->outcount);
 	}
 
-	return 0;
+	/* reduce memory after large replies*/
+	if (client->outcount == 0 && client->outsize > SZCLIENTOUTBUF) {
+		free(client->outbuf);
+		client->outbuf = NULL;
+		client->outsize = 0;
+	}
+	return client->outcount;
 }
 
 /*
- * This is a wrapper to write().
+ * This is a wrapper to write(), which buffers reply data for the client.
+ * Large replies are gathered with any buffered data and sent with writev(),
+ * what the client doesn't take now is buffered and sent when writable.
  */
 int GsWrite(int fd, void *buf, int c)
 {
-	int e, n;
+	GR_CLIENT *client;
+	struct iovec iov[2];
+	int e, total;
 
-	n = 0;
+	client = GsFindClientFd(fd);
+	if (!client)
+		return -1;
 
-	while(n < c) {
-		e = write(fd, ((char *) buf + n), (c - n));
-		if(e <= 0) {
-			/*EPRINTF("nano-X: GsWrite failed %d\n", fd);*/
+	/* small replies are buffered and sent when the request batch completes*/
+	if (client->outcount + c <= SZCLIENTOUTBUF)
+		return GsBufferOutput(client, buf, c);
+
+	/* gather buffered output and reply data into single write*/
+	total = client->outcount + c;
+	iov[0].iov_base = client->outbuf;
+	iov[0].iov_len = client->outcount;
+	iov[1].iov_base = buf;
+	iov[1].iov_len = c;
+	do {
+		e = writev(fd, iov, 2);
+	} while (e < 0 && errno == EINTR);
+	if (e < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
 			GsClose(fd);
 			return -1;
 		}
-		n += e;
+		e = 0;
+	}
+	if (e == total) {
+		client->outcount = 0;
+		return 0;
 	}
 
-	return 0;
+	/* keep unwritten data for later flush*/
+	if (e < client->outcount) {
+		client->outcount -= e;
+		memmove(client->outbuf, client->outbuf + e, client->outcount);
+		e = 0;
+	} else {
+		e -= client->outcount;
+		client->outcount = 0;
+	}
+	return GsBufferOutput(client, (char *)buf + e, c - e);
 }
 
 int GsWriteType(int fd, short type)
@@ -2210,44 +2504,81 @@ int GsWriteType(int fd, short type)
 
 /*
  * This function is used to parse and dispatch requests from the clients.
- * Note that the maximum request size is allocated from the stack
- * in this function.
+ * All available data is read at once, then every complete request
+ * in the client input buffer is dispatched.
  */
 void
 GsHandleClient(int fd)
 {
+	GR_CLIENT *client;
 	nxReq *	req;
 	long	len;
-	char	buf[MAXREQUESTSZ];
+	int	n, pos;
 
+	client = GsFindClientFd(fd);
+	if (!client)
+		return;
 	current_fd = fd;
 #if HAVE_SHAREDMEM_SUPPORT
-	current_shm_cmds = curclient->shm_cmds;
-	current_shm_cmds_size = curclient->shm_cmds_size;
+	current_shm_cmds = client->shm_cmds;
+	current_shm_cmds_size = client->shm_cmds_size;
 #endif
-	/* read request header*/
-	if(GsRead(fd, buf, sizeof(nxReq)))
+	if (!client->inbuf) {
+		client->inbuf = malloc(SZCLIENTINBUF);
+		if (!client->inbuf) {
+			EPRINTF("nano-X: GsHandleClient can't allocate input buffer\n");
+			return;
+		}
+	}
+
+	/* read all available request data*/
+	n = read(fd, client->inbuf + client->incount, SZCLIENTINBUF - client->incount);
+	if (n <= 0) {
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			return;
+		if (n == 0)
+			EPRINTF("nano-X: client closed socket: %d\n", fd);
+		else EPRINTF("nano-X: GsHandleClient read failed %d: %d\r\n", n, errno);
+		GsClose(fd);
 		return;
+	}
+	client->incount += n;
 
+	/* dispatch all complete requests*/
+	pos = 0;
+	while (client->incount - pos >= (int)sizeof(nxReq)) {
+		req = (nxReq *)(client->inbuf + pos);
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
-	len = GetReqAlignedLen((nxReq *)&buf[0]);
-	if(len > sizeof(nxReq)) {
-		if(len > MAXREQUESTSZ) {
-			EPRINTF("nano-X: GsHandleClient request too large: %ld > %d\n",
-				len, MAXREQUESTSZ);
-			exit(1);
+		len = GetReqAlignedLen(req);
+		if(len < (long)sizeof(nxReq) || len > MAXREQUESTSZ) {
+			/* malformed request, can't resynchronize with client*/
+			EPRINTF("nano-X: GsHandleClient bad request length %ld from client %d\n",
+				len, fd);
+			GsClose(fd);
+			return;
+		}
+		if (client->incount - pos < len)
+			break;			/* wait for rest of request*/
+		pos += len;
+
+		if(req->reqType < GrTotalNumCalls) {
+			curfunc = (char *)GrFunctions[req->reqType].name;
+			/*DPRINTF("HandleClient %s\n", curfunc);*/
+			GrFunctions[req->reqType].func(req);
+		} else {
+			EPRINTF("nano-X: GsHandleClient bad function\n");
 		}
-		/* read additional request data*/
-		if(GsRead(fd, &buf[sizeof(nxReq)], len-sizeof(nxReq)))
+
+		/* client may have been dropped by request*/
+		if (GsFindClient(fd) != client)
 			return;
 	}
-	req = (nxReq *)&buf[0];
 
-	if(req->reqType < GrTotalNumCalls) {
-		curfunc = (char *)GrFunctions[req->reqType].name;
-		/*DPRINTF("HandleClient %s\n", curfunc);*/
-		GrFunctions[req->reqType].func(req);
-	} else {
-		EPRINTF("nano-X: GsHandleClient bad function\n");
-	}
+	/* save partial request at start of buffer*/
+	client->incount -= pos;
+	if (pos && client->incount)
+		memmove(client->inbuf, client->inbuf + pos, client->incount);
+
+	/* send all replies for this batch*/
+	GsFlushClient(client);
 }
@@ -41,6 +41,47 @@ GrReqShmCmds(long shmsize)
 	/* no action required, no client/server*/
 }
 
+/*
+ * Async query requests.  With the application linked into the server
+ * there is no round trip to pipeline, so the query is performed
+ * immediately and a completed cookie is returned.
+ */
+GR_COOKIE
+GrGetWindowInfoAsync(GR_WINDOW_ID wid, GR_WINDOW_INFO *infoptr)
+{
+	GrGetWindowInfo(wid, infoptr);
+	return 0;
+}
+
+GR_COOKIE
+GrGetFontInfoAsync(GR_FONT_ID font, GR_FONT_INFO *fip)
+{
+	GrGetFontInfo(font, fip);
+	return 0;
+}
+
+GR_COOKIE
+GrGetGCTextSizeAsync(GR_GC_ID gc, void *str, int count, GR_TEXTFLAGS flags,
+	GR_SIZE *retwidth, GR_SIZE *retheight, GR_SIZE *retbase)
+{
+	GrGetGCTextSize(gc, str, count, flags, retwidth, retheight, retbase);
+	return 0;
+}
+
+GR_COOKIE
+GrQueryPointerAsync(GR_WINDOW_ID *mwin, GR_COORD *x, GR_COORD *y, GR_BUTTON *bmask)
+{
+	GrQueryPointer(mwin, x, y, bmask);
+	return 0;
+}
+
+int
+GrWaitReply(GR_COOKIE cookie)
+{
+	/* replies are always complete*/
+	return 0;
+}
+
 /*
  * Return the next waiting event for a client, or wait for one if there
  * is none yet.  The event is copied into the specified structure, and
@@ -199,6 +240,7 @@ getevent:
 			else prevelp->next = elp->next;
 			if (curclient->eventtail == elp)
 				curclient->eventtail = prevelp;
+			--curclient->eventcount;
 			elp->next = eventfree;
 			eventfree = elp;
 
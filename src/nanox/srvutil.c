@@ -15,6 +15,11 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #endif
+#if HAVE_SHAREDMEM_SUPPORT
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
 
 /*
  * Redraw the screen completely.
@@ -87,6 +92,7 @@ GsUnrealizeWindow(GR_WINDOW *wp, GR_BOOL temp_unmap)
 
 	/* set window invisible flag*/
 	wp->realized = GR_FALSE;
+	GsInvalidateClip(wp);
 
 	for (childwp = wp->children; childwp; childwp = childwp->siblings)
 		GsUnrealizeWindow(childwp, temp_unmap);
@@ -188,6 +194,7 @@ wp->id, wp->mapped, wp->realized, wp->parent->realized);*/
 
 	/* set window visible flag*/
 	wp->realized = GR_TRUE;
+	GsInvalidateClip(wp);
 
 	if (!temp) {
 		GsCheckMouseWindow();
@@ -283,6 +290,7 @@ GsDestroyWindow(GR_WINDOW *wp)
 		prevwp->siblings = wp->siblings;
 	}
 	wp->siblings = NULL;
+	GsInvalidateClip(wp);
 
 	/*
 	 * Remove this window from the complete list of windows.
@@ -329,6 +337,8 @@ GsDestroyWindow(GR_WINDOW *wp)
 #if DYNAMICREGIONS
 	if (wp->clipregion)
 		GdDestroyRegion(wp->clipregion);
+	if (wp->visregion)
+		GdDestroyRegion(wp->visregion);
 #endif
 
 	/* Remove any grabbed keys for this window. */
@@ -358,6 +368,10 @@ GsDestroyPixmap(GR_PIXMAP *pp)
 
 	/* deallocate mem gc*/
 	psd->FreeMemGC(psd);
+#if HAVE_SHAREDMEM_SUPPORT
+	if (pp->shmaddr)
+		shmdt(pp->shmaddr);
+#endif
 
 	/*
 	 * Remove this pixmap from the complete list of pixmaps.
@@ -742,6 +756,14 @@ GsClearWindow(GR_WINDOW *wp, GR_COORD x, GR_COORD y, GR_SIZE width, GR_SIZE  hei
 		if (!(wp->props & GR_WM_PROPS_DRAWING_DONE))
 			return;
 
+#if DYNAMICREGIONS
+		/* composited from window buffer before next select*/
+		if (gr_composite) {
+			GsCompositeDamage(wp->x + x, wp->y + y, width, height);
+			return;
+		}
+#endif
+
 		/* prepare clipping to window boundaries*/
 		GsSetClipWindow(wp, NULL, 0);
 		clipwp = NULL;		/* reset clip cache since no user regions used*/
@@ -809,6 +831,68 @@ usleep(500000);
 		GsDeliverExposureEvent(wp, x, y, width, height);
 }
 
+/*
+ * Copy damaged areas of a buffered window from its window buffer to the
+ * screen, setting the clip region once for all rectangles.  Used by clients
+ * drawing directly into a GR_WM_PROPS_BUFFER_MMAP window buffer, instead
+ * of copying the entire buffer with GsClearWindow(..., 2).
+ */
+void
+GsDamageWindow(GR_WINDOW *wp, GR_COUNT count, GR_RECT *rects)
+{
+	GR_COORD	x, y;
+	GR_SIZE		width, height;
+
+	if (!wp->realized || !wp->output || !wp->buffer)
+		return;
+
+	/* mark drawing finalized*/
+	wp->props |= GR_WM_PROPS_DRAWING_DONE;
+
+	if (count <= 0) {
+		GsClearWindow(wp, 0, 0, wp->width, wp->height, 2);
+		return;
+	}
+
+#if DYNAMICREGIONS
+	if (gr_composite) {
+		for (; count > 0; --count, ++rects)
+			GsClearWindow(wp, rects->x, rects->y, rects->width, rects->height, 0);
+		return;
+	}
+#endif
+
+	/* prepare clipping to window boundaries*/
+	GsSetClipWindow(wp, NULL, 0);
+	clipwp = NULL;		/* reset clip cache since no user regions used*/
+
+	for (; count > 0; --count, ++rects) {
+		x = rects->x;
+		y = rects->y;
+		width = rects->width;
+		height = rects->height;
+
+		/* reduce the area so that it lies within the window*/
+		if (x < 0) {
+			width += x;
+			x = 0;
+		}
+		if (y < 0) {
+			height += y;
+			y = 0;
+		}
+		if (x + width > wp->width)
+			width = wp->width - x;
+		if (y + height > wp->height)
+			height = wp->height - y;
+		if (x >= wp->width || y >= wp->height || width <= 0 || height <= 0)
+			continue;
+
+		/* copy window pixmap buffer to window*/
+		GdBlit(wp->psd, wp->x + x, wp->y + y, width, height, wp->buffer->psd, x, y, MWROP_COPY);
+	}
+}
+
 /*
  * Handle the exposing of the specified absolute region of the screen,
  * starting with the specified window.  That window and all of its
@@ -893,7 +977,7 @@ GsDrawBorder(GR_WINDOW *wp)
 
 	clipwp = NULL;
 	/* FIXME: window clipregion will fail here */
-	GsSetClipWindow(wp, NULL, 0);
+	GsSetClipWindow(wp, NULL, GS_CLIP_NOCACHE);
 	curgcp = NULL;
 	GdSetMode(GR_MODE_COPY);
 	GdSetForegroundColor(wp->psd, wp->bordercolor);
@@ -1292,14 +1376,77 @@ GsPrepareWindow(GR_WINDOW_ID wid)
 	return wp;
 }
 
+/*
+ * Screen tile cache for GsFindVisibleWindow.  Each tile remembers the
+ * window found for all points within it, or NULL if the tile straddles
+ * a window edge, and is valid until the window configuration changes.
+ */
+#define HITTILE_SHIFT	5		/* 32x32 pixel tiles*/
+
+typedef struct {
+	GR_WINDOW *	wp;		/* window at every point in tile or NULL*/
+	unsigned long	gen;		/* windowgeneration wp found at*/
+} GR_HITTILE;
+
+static GR_HITTILE *hittiles;
+static int hitcols, hitrows;
+
+/*
+ * Find the window which is visible at every point in the passed rectangle,
+ * using the same walk as FindVisibleWindowPoint.  Return NULL if
+ * different points in the rectangle would find different windows.
+ */
+static GR_WINDOW *
+FindVisibleWindowRect(GR_COORD x1, GR_COORD y1, GR_COORD x2, GR_COORD y2)
+{
+	GR_WINDOW	*wp;		/* current window */
+	GR_WINDOW	*retwp;		/* returned window */
+
+	wp = rootwp;
+	retwp = wp;
+	while (wp) {
+		if (wp->realized && (wp->x < x2) && (wp->y < y2) &&
+		    (wp->x + wp->width > x1) && (wp->y + wp->height > y1)) {
+			/* window must contain all of rectangle or none of it*/
+			if ((wp->x > x1) || (wp->y > y1) ||
+			    (wp->x + wp->width < x2) || (wp->y + wp->height < y2))
+				return NULL;
+
+			if (wp->clipregion) {
+#if DYNAMICREGIONS
+				MWRECT	rc;
+
+				rc.left = x1 - wp->x;
+				rc.top = y1 - wp->y;
+				rc.right = x2 - wp->x;
+				rc.bottom = y2 - wp->y;
+				switch (GdRectInRegion(wp->clipregion, &rc)) {
+				case MWRECT_OUT:
+					wp = wp->siblings;
+					continue;
+				case MWRECT_PARTIN:
+					return NULL;
+				}
+#else
+				return NULL;
+#endif
+			}
+			retwp = wp;
+			wp = wp->children;
+			continue;
+		}
+		wp = wp->siblings;
+	}
+	return retwp;
+}
+
 /*
  * Find the window which is currently visible for the specified coordinates.
  * This just walks down the window tree looking for the deepest mapped
- * window which contains the specified point.  If the coordinates are
- * off the screen, the root window is returned.
+ * window which contains the specified point.
  */
-GR_WINDOW *
-GsFindVisibleWindow(GR_COORD x, GR_COORD y)
+static GR_WINDOW *
+FindVisibleWindowPoint(GR_COORD x, GR_COORD y)
 {
 	GR_WINDOW	*wp;		/* current window */
 	GR_WINDOW	*retwp;		/* returned window */
@@ -1323,6 +1470,49 @@ GsFindVisibleWindow(GR_COORD x, GR_COORD y)
 	return retwp;
 }
 
+/*
+ * Find the window which is currently visible for the specified coordinates.
+ * If the coordinates are off the screen, the root window is returned.
+ * The screen tile containing the point is checked first, which
+ * avoids walking the window tree unless the tile straddles a window edge.
+ */
+GR_WINDOW *
+GsFindVisibleWindow(GR_COORD x, GR_COORD y)
+{
+	GR_HITTILE	*tp;
+	GR_COORD	tx, ty;
+	int		cols, rows;
+
+	if (x < 0 || y < 0 || x >= rootwp->width || y >= rootwp->height)
+		return FindVisibleWindowPoint(x, y);
+
+	/* (re)allocate tiles for current screen size*/
+	cols = (rootwp->width + (1 << HITTILE_SHIFT) - 1) >> HITTILE_SHIFT;
+	rows = (rootwp->height + (1 << HITTILE_SHIFT) - 1) >> HITTILE_SHIFT;
+	if (cols != hitcols || rows != hitrows) {
+		free(hittiles);
+		hittiles = (GR_HITTILE *)calloc(cols * rows, sizeof(GR_HITTILE));
+		hitcols = hittiles? cols: 0;
+		hitrows = hittiles? rows: 0;
+		if (!hittiles)
+			return FindVisibleWindowPoint(x, y);
+	}
+
+	tx = x >> HITTILE_SHIFT;
+	ty = y >> HITTILE_SHIFT;
+	tp = &hittiles[ty * hitcols + tx];
+	if (tp->gen != windowgeneration) {
+		tx <<= HITTILE_SHIFT;
+		ty <<= HITTILE_SHIFT;
+		tp->wp = FindVisibleWindowRect(tx, ty, tx + (1 << HITTILE_SHIFT),
+			ty + (1 << HITTILE_SHIFT));
+		tp->gen = windowgeneration;
+	}
+	if (tp->wp)
+		return tp->wp;
+	return FindVisibleWindowPoint(x, y);
+}
+
 /*
  * Check to see if the cursor shape is the correct shape for its current
  * location.  If not, its shape is changed.
@@ -1488,9 +1678,9 @@ GsSetPortraitMode(int mode)
 	GdRestrictMouse(0, 0, scrdev.xvirtres - 1, scrdev.yvirtres - 1);
 
 	/* reset clip and root window size*/
-	clipwp = NULL;
 	rootwp->width = scrdev.xvirtres;
 	rootwp->height = scrdev.yvirtres;
+	GsInvalidateClip(rootwp);
 
 	/* deliver portrait changed event to all windows selecting it*/
 	GsDeliverPortraitChangedEvent();
@@ -1510,7 +1700,7 @@ GsSetPortraitModeFromXY(GR_COORD rootx, GR_COORD rooty)
 
 	if (rootx == 0) {
 		/* rotate left*/
-		switch (scrdev.portrait) {
+		switch (GdGetPortraitMode(&scrdev)) {
 		case MWPORTRAIT_NONE:
 		default:
 			newmode = MWPORTRAIT_LEFT;
@@ -1530,7 +1720,7 @@ GsSetPortraitModeFromXY(GR_COORD rootx, GR_COORD rooty)
 		GdMoveMouse(5, rooty);
 	} else if (rootx == scrdev.xvirtres-1) {
 		/* rotate right*/
-		switch (scrdev.portrait) {
+		switch (GdGetPortraitMode(&scrdev)) {
 		case MWPORTRAIT_NONE:
 		default:
 			newmode = MWPORTRAIT_RIGHT;
@@ -9,6 +9,7 @@ XCopyArea(Display * display, Drawable src, Drawable dest, GC gc,
 	int rop = _nxConvertROP(vp->function);
 
 	// FIXME - use GC fg/bg for depth == 1 pixmaps
+	_nxFlushGC(gc);
 	GrCopyArea(dest, gc->gid, dest_x, dest_y, width, height, src, src_x,
 		   src_y, rop);
 	return 1;
@@ -51,6 +52,7 @@ XCopyPlane(Display * display, Drawable src, Drawable dest, GC gc,
 	free(bitmap);
 	}
 #else
+	_nxFlushGC(gc);
 	GrCopyArea(dest, gc->gid, dest_x, dest_y, width, height, src, src_x,
 		   src_y, rop);
 #endif
@@ -13,6 +13,10 @@
  * This also means that this library shouldn't call XSetGCxxx
  * routines to get work done, since the GC save value will
  * be incorrect.
+ *
+ * Simple Nano-X GC state is not sent immediately, but recorded
+ * in the nxGC and sent by _nxFlushGC before the next drawing
+ * request, only if it differs from the server's copy.
  */
 
 /* FIXME if these differ from NX defaults, must set at create time*/
@@ -80,7 +84,7 @@ setupGC(Display * dpy, GC gc, unsigned long valuemask, XGCValues * values)
 		    values->line_style, values->cap_style, values->join_style);
 
 	if (valuemask & GCFillRule)
-		XSetFillStyle(dpy, gc, values->fill_rule);
+		((XGCValues *)gc->ext_data)->fill_rule = values->fill_rule;
 
 	if (valuemask & GCTile)
 		XSetTile(dpy, gc, values->tile);
@@ -107,25 +111,40 @@ setupGC(Display * dpy, GC gc, unsigned long valuemask, XGCValues * values)
 		DPRINTF("XCreateGC: GCArcMode not implemented\n");
 }
 
+/* Nano-X GrNewGC defaults*/
+static nxGCState initial_NXGC = {
+	GR_MODE_COPY,		/* mode */
+	WHITE,			/* foreground */
+	BLACK,			/* background */
+	GR_TRUE,		/* usebackground */
+	GR_FILL_SOLID,		/* fillmode */
+	0,			/* font */
+	GR_TRUE,		/* exposure */
+	GR_LINE_SOLID		/* linestyle */
+};
+
 /* note: unused Drawable d */
 GC
 XCreateGC(Display *dpy, Drawable d, unsigned long valuemask, XGCValues *values)
 {
 	GC gc;
-	XGCValues *vp;
+	nxGC *gp;
 
 	if ((gc = (GC) Xmalloc(sizeof(struct _XGC))) == NULL)
 		return NULL;
-	if ((vp = (XGCValues *)Xmalloc(sizeof(XGCValues))) == NULL) {
+	if ((gp = (nxGC *)Xmalloc(sizeof(nxGC))) == NULL) {
 		Xfree(gc);
 		return NULL;
 	}
-	gc->ext_data = (XExtData *)vp;
-	memcpy(vp, &initial_GC, sizeof(initial_GC));
+	gc->ext_data = (XExtData *)gp;
+	memcpy(&gp->values, &initial_GC, sizeof(initial_GC));
+	gp->sent = initial_NXGC;
+	gp->want = initial_NXGC;
+	gp->dirty = 0;
 	gc->gid = GrNewGC();
 
 	/* X11 doesn't draw background, must set on all GrNewGC's*/
-	GrSetGCUseBackground(gc->gid, GR_FALSE);
+	_nxSetGCUseBackground(gc, GR_FALSE);
 
 	/* X11 defaults to fg=black, bg=white, NX is opposite...*/
 	if (!(valuemask & GCForeground))
@@ -147,7 +166,52 @@ XChangeGC(Display *display, GC gc, unsigned long valuemask, XGCValues *values)
 void
 XFlushGC(Display * dpy, GC gc)
 {
-	DPRINTF("XFlushGC called, not synced\n");
+	_nxFlushGC(gc);
+}
+
+/*
+ * Send GC state changed since the last drawing request.
+ * Called before each Nano-X drawing request using gc, so
+ * repeated or overridden XSetGCxxx calls send nothing.
+ */
+void
+_nxFlushGC(GC gc)
+{
+	nxGC *gp = _nxGC(gc);
+	nxGCState *want = &gp->want;
+	nxGCState *sent = &gp->sent;
+
+	if (!gp->dirty)
+		return;
+	gp->dirty = 0;
+
+	if (want->mode != sent->mode)
+		GrSetGCMode(gc->gid, want->mode);
+	if (want->foreground != sent->foreground)
+		GrSetGCForeground(gc->gid, want->foreground);
+	if (want->background != sent->background)
+		GrSetGCBackground(gc->gid, want->background);
+	if (want->usebackground != sent->usebackground)
+		GrSetGCUseBackground(gc->gid, want->usebackground);
+	if (want->fillmode != sent->fillmode)
+		GrSetGCFillMode(gc->gid, want->fillmode);
+	if (want->font != sent->font)
+		GrSetGCFont(gc->gid, want->font);
+	if (want->exposure != sent->exposure)
+		GrSetGCGraphicsExposure(gc->gid, want->exposure);
+	if (want->linestyle != sent->linestyle)
+		GrSetGCLineAttributes(gc->gid, want->linestyle);
+	*sent = *want;
+}
+
+/* set background drawing for next drawing request*/
+void
+_nxSetGCUseBackground(GC gc, GR_BOOL flag)
+{
+	nxGC *gp = _nxGC(gc);
+
+	gp->want.usebackground = flag;
+	gp->dirty |= GCnxUseBackground;
 }
 
 GContext
@@ -207,7 +271,8 @@ XSetFunction(Display *dpy, GC gc, int function)
 	if (vp->subwindow_mode == IncludeInferiors)
 		mode |= GR_MODE_EXCLUDECHILDREN;
 
-	GrSetGCMode(gc->gid, mode);
+	_nxGC(gc)->want.mode = mode;
+	_nxGC(gc)->dirty |= GCFunction;
 	return 1;
 }
 
@@ -223,7 +288,8 @@ XSetSubwindowMode(Display *dpy, GC gc, int subwindow_mode)
 	/* must OR in draw mode when GrSetGCMode called*/
 	mode |= _nxConvertROP(vp->function);
 
-	GrSetGCMode(gc->gid, mode);
+	_nxGC(gc)->want.mode = mode;
+	_nxGC(gc)->dirty |= GCSubwindowMode;
 	return 1;
 }
 
@@ -234,7 +300,8 @@ XSetForeground(Display *dpy, GC gc, unsigned long foreground)
 	GR_COLOR c = _nxColorvalFromPixelval(dpy, foreground);
 
 	vp->foreground = foreground;
-	GrSetGCForeground(gc->gid, c);
+	_nxGC(gc)->want.foreground = c;
+	_nxGC(gc)->dirty |= GCForeground;
 
 //DPRINTF("XSetForeground clr %x pix %x\n", (int)c, (int)foreground);
 	return 1;
@@ -247,20 +314,26 @@ XSetBackground(Display *dpy, GC gc, unsigned long background)
 	GR_COLOR c = _nxColorvalFromPixelval(dpy, background);
 
 	vp->background = background;
-	GrSetGCBackground(gc->gid, c);
+	_nxGC(gc)->want.background = c;
+	_nxGC(gc)->dirty |= GCBackground;
 	return 1;
 }
 
 int
 XSetFont(Display *dpy, GC gc, Font font)
 {
-	GrSetGCFont(gc->gid, font);
+	nxGC *gp = _nxGC(gc);
+
+	gp->values.font = font;
+	gp->want.font = font;
+	gp->dirty |= GCFont;
 	return 1;
 }
 
 int
 XSetFillStyle(Display * dpy, GC gc, int fill_style)
 {
+	nxGC *gp = _nxGC(gc);
 	unsigned long mode = 0;
 
 	switch (fill_style) {
@@ -281,14 +354,20 @@ XSetFillStyle(Display * dpy, GC gc, int fill_style)
 		break;
 	}
 
-	GrSetGCFillMode(gc->gid, mode);
+	gp->values.fill_style = fill_style;
+	gp->want.fillmode = mode;
+	gp->dirty |= GCFillStyle;
 	return 1;
 }
 
 int
 XSetGraphicsExposures(Display * display, GC gc, int graphics)
 {
-	GrSetGCGraphicsExposure(gc->gid, graphics);
+	nxGC *gp = _nxGC(gc);
+
+	gp->values.graphics_exposures = graphics;
+	gp->want.exposure = graphics;
+	gp->dirty |= GCGraphicsExposures;
 	return 1;
 }
 
@@ -1,10 +1,14 @@
 #include "nxlib.h"
 
 #define FULLCIRCLE (360 * 64)
+#define MAXARCS		256	/* arcs converted per request*/
 
-/* X11 angle1=start, angle2=distance (negative=clockwise)*/
-static void
-drawArc(Drawable d, GC gc, int x, int y, int width, int height,
+/*
+ * Convert X11 arc to Nano-X arc, returns FALSE if nothing to draw.
+ * X11 angle1=start, angle2=distance (negative=clockwise)
+ */
+static int
+convertArc(GR_ARC_ITEM *ap, int x, int y, int width, int height,
 	int angle1, int angle2, int mode)
 {
 	int rx, ry;
@@ -12,7 +16,7 @@ drawArc(Drawable d, GC gc, int x, int y, int width, int height,
 
 	/* don't draw anything if no arc requested*/
 	if (angle2 == 0)
-		return;
+		return 0;
 
 #if 0
 	/*
@@ -57,7 +61,47 @@ drawArc(Drawable d, GC gc, int x, int y, int width, int height,
 		if (endAngle >= FULLCIRCLE)
 			endAngle = endAngle % FULLCIRCLE;
 	}
-	GrArcAngle(d, gc->gid, x+rx, y+ry, rx, ry, startAngle, endAngle, mode);
+	ap->x = x + rx;
+	ap->y = y + ry;
+	ap->rx = rx;
+	ap->ry = ry;
+	ap->angle1 = startAngle;
+	ap->angle2 = endAngle;
+	ap->type = mode;
+	return 1;
+}
+
+static void
+drawArc(Drawable d, GC gc, int x, int y, int width, int height,
+	int angle1, int angle2, int mode)
+{
+	GR_ARC_ITEM arc;
+
+	if (convertArc(&arc, x, y, width, height, angle1, angle2, mode)) {
+		_nxFlushGC(gc);
+		GrArcAngle(d, gc->gid, arc.x, arc.y, arc.rx, arc.ry, arc.angle1,
+			arc.angle2, arc.type);
+	}
+}
+
+/* draw multiple arcs using a request per MAXARCS*/
+static void
+drawArcs(Drawable d, GC gc, XArc *arcs, int narcs, int mode)
+{
+	int n = 0;
+	GR_ARC_ITEM gr_arcs[MAXARCS];
+
+	for (; narcs > 0; narcs--, arcs++) {
+		/* X11 width/height is one less than Nano-X width/height*/
+		if (convertArc(&gr_arcs[n], arcs->x, arcs->y, arcs->width+1,
+		    arcs->height+1, arcs->angle1, arcs->angle2, mode))
+			n++;
+		if (n == MAXARCS || (n && narcs == 1)) {
+			_nxFlushGC(gc);
+			GrArcs(d, gc->gid, n, gr_arcs);
+			n = 0;
+		}
+	}
 }
 
 int
@@ -73,15 +117,7 @@ XDrawArc(Display *display, Drawable d, GC gc, int x, int y,
 int
 XDrawArcs(Display *display, Drawable d, GC gc, XArc *arcs, int narcs)
 {
-	int i;
-
-	for (i = 0; i < narcs; i++) {
-		/* X11 width/height is one less than Nano-X width/height*/
-		drawArc(d, gc, arcs->x, arcs->y,
-			arcs->width+1, arcs->height+1, arcs->angle1,
-			arcs->angle2, GR_ARC);
-		++arcs;
-	}
+	drawArcs(d, gc, arcs, narcs, GR_ARC);
 	return 1;
 }
 
@@ -96,12 +132,6 @@ XFillArc(Display *display, Drawable d, GC gc, int x, int y,
 int
 XFillArcs(Display *display, Drawable d, GC gc, XArc *arcs, int narcs)
 {
-	int i;
-
-	for (i = 0; i < narcs; i++) {
-		drawArc(d, gc, arcs->x, arcs->y, arcs->width+1, arcs->height+1,
-			arcs->angle1, arcs->angle2, GR_PIE);
-		++arcs;
-	}
+	drawArcs(d, gc, arcs, narcs, GR_PIE);
 	return 1;
 }
@@ -1,14 +1,34 @@
+#include <stdlib.h>
+#include "uni_std.h"
 #include "nxlib.h"
 
+#define MAXSEGS		256	/* segments converted per request*/
+
 int
 XDrawSegments(Display * dpy,
 	      Drawable d, GC gc, XSegment * segments, int nsegments)
 {
-	int i;
+	int i, n;
+	GR_SEGMENT gr_segs[MAXSEGS];
+
+	if (nsegments <= 0)
+		return 1;
+
+	/* one request per chunk, server prepares drawable and gc once each*/
+	_nxFlushGC(gc);
+	while (nsegments > 0) {
+		n = nsegments < MAXSEGS? nsegments: MAXSEGS;
 
-	for (i = 0; i < nsegments; i++) {
-		GrLine(d, gc->gid, segments[i].x1, segments[i].y1,
-			segments[i].x2, segments[i].y2);
+		/* must copy since X segments are shorts, Nano-X are MWCOORDs (int) */
+		for (i = 0; i < n; i++) {
+			gr_segs[i].x1 = segments[i].x1;
+			gr_segs[i].y1 = segments[i].y1;
+			gr_segs[i].x2 = segments[i].x2;
+			gr_segs[i].y2 = segments[i].y2;
+		}
+		GrSegments(d, gc->gid, n, gr_segs);
+		segments += n;
+		nsegments -= n;
 	}
 
 	return 1;
@@ -22,6 +42,7 @@ XDrawLines(Display * dpy, Drawable d, GC gc, XPoint * points, int npoints,
 
 	if (npoints < 1)
 		return 1;
+	_nxFlushGC(gc);
 	if (npoints == 1) {
 		GrPoint(d, gc->gid, points->x, points->y);
 		return 1;
@@ -3,6 +3,7 @@
 int
 XDrawPoint(Display * display, Drawable d, GC gc, int x, int y)
 {
+	_nxFlushGC(gc);
 	GrPoint(d, gc->gid, x, y);
 	return 1;
 }
@@ -14,6 +15,7 @@ XDrawPoints(Display * display, Drawable d, GC gc,
 
 	int i;
 
+	_nxFlushGC(gc);
 	if (mode == CoordModeOrigin) {
 		for (i = 0; i < npoints; i++) {
 			GrPoint(d, gc->gid, points->x, points->y);
@@ -19,6 +19,9 @@ typedef struct _EXT_Manage {
 } EXT_Manage;
 EXT_Manage exmanage[] = {
 	{ SHAPENAME, SHAPE_MAJOR_VERSION, LASTEvent+1, 0, },
+#if HAVE_SHAREDMEM_SUPPORT
+	{ "MIT-SHM", 1, LASTEvent+2, 0, },	/* ShmCompletion only, see Shm.c*/
+#endif
 	{ NULL, 0, 0, 0 }
 };
 
@@ -117,11 +120,6 @@ Bool XSyncQueryExtension(Display *dpy, int *event_base, int *error_base)
 	//*event_base = *error_base = 0; //segfault
 	return 0;
 }
-Bool XShmQueryExtension(Display *dpy, int *event_base, int *error_base)
-{
-	DPRINTF("XShmQueryExtension called\n");
-	return 0;
-}
 // required for qt4
 Bool XkbQueryExtension(Display *dpy, int *event_base, int *error_base)
 {
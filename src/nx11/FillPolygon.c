@@ -31,6 +31,7 @@ XFillPolygon(Display * display, Drawable d, GC gc,
 //	if (shape == Complex || shape == Convex)
 //		DPRINTF("XFillPolygon: Complex/Convex\n");
 
+	_nxFlushGC(gc);
 	GrFillPoly(d, gc->gid, npoints, gr_points);
 
 	FREEA(gr_points);
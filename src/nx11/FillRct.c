@@ -1,23 +1,42 @@
-#include "nxlib.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include "uni_std.h"
+#include "nxlib.h"
+
+#define MAXRECTS	256	/* rectangles converted per request*/
 
 int
 XFillRectangle(Display *xdpy, Drawable d, GC gc, int x, int y,
 	unsigned int width, unsigned int height)
 {
-  
+	_nxFlushGC(gc);
 	GrFillRect(d, gc->gid, x, y, width, height);
 	return 1;
 }
 
 int 
 XFillRectangles(Display *dpy, Drawable d, GC gc, XRectangle *rects, int nrects) {
-	int i;
+	int i, n;
+	GR_RECT gr_rects[MAXRECTS];
+
+	if (nrects <= 0)
+		return 1;
+
+	/* one request per chunk, server prepares drawable and gc once each*/
+	_nxFlushGC(gc);
+	while (nrects > 0) {
+		n = nrects < MAXRECTS? nrects: MAXRECTS;
 
-	for(i = 0; i < nrects; i++) {
-		XFillRectangle(dpy, d, gc, rects->x, rects->y,
-				rects->width, rects->height);
-		++rects;
+		/* must copy since X rects are shorts, Nano-X are MWCOORDs (int) */
+		for(i = 0; i < n; i++) {
+			gr_rects[i].x = rects[i].x;
+			gr_rects[i].y = rects[i].y;
+			gr_rects[i].width = rects[i].width;
+			gr_rects[i].height = rects[i].height;
+		}
+		GrFillRects(d, gc->gid, n, gr_rects);
+		rects += n;
+		nrects -= n;
 	}
 
 	return 1;
@@ -533,7 +533,8 @@ DPRINTF("putTrueColorImage depth %d pixtype %d src %d,%d wxh %d,%d dst %d,%d\n",
 	       image->depth, pixtype, src_x, src_y, width, height, dest_x, dest_y);
 
 	/* X11 draws backgrounds on pixmaps but not text*/
-	GrSetGCUseBackground(gc->gid, GR_TRUE);
+	_nxSetGCUseBackground(gc, GR_TRUE);
+	_nxFlushGC(gc);
 
 	/*
 	 * We can only do a direct GrArea if the width is the same as the width
@@ -559,8 +560,8 @@ DPRINTF("putTrueColorImage depth %d pixtype %d src %d,%d wxh %d,%d dst %d,%d\n",
 			&srect, &drect, src, pixtype, pad);
 	}
 
-	/* turn background drawing back off... */
-	GrSetGCUseBackground(gc->gid, GR_FALSE);
+	/* turn background drawing back off, sent only if next request needs it*/
+	_nxSetGCUseBackground(gc, GR_FALSE);
 
 	return 1;
 }
@@ -645,6 +646,7 @@ putImage(Display * display, Drawable d, GC gc, XImage * image,
 		}
 	}
 
+	_nxFlushGC(gc);
 	GrArea((GR_WINDOW_ID) d, (GR_GC_ID) gc->gid, dest_x, dest_y, width, height, buffer, MWPF_RGB);
 
 	FREEA(buffer);
@@ -357,17 +357,59 @@ translateNXEvent(Display *dpy, GR_EVENT * ev, XEvent * event)
 	}
 }
 
-static XEvent saved_event;
-static int saved = 0;
+/* events generated within nxlib by XPutBackEvent and extensions*/
+typedef struct _nxLocalEvent {
+	struct _nxLocalEvent *next;
+	XEvent	event;
+} nxLocalEvent;
+
+static nxLocalEvent *localq;		/* returned before server events*/
+static int localcount;
+
+/* add event to local queue, at front for XPutBackEvent*/
 int
-XPutBackEvent(Display *display, XEvent *event)
+_nxQueueEvent(Display *display, XEvent *event, int front)
 {
-	if (saved) {
-		DPRINTF("XPutBackEvent: lost event\n");
+	nxLocalEvent *lp, **lpp;
+
+	lp = (nxLocalEvent *)Xcalloc(1, sizeof(nxLocalEvent));
+	if (!lp)
 		return 0;
+	lp->event = *event;
+
+	lpp = &localq;
+	if (!front)
+		while (*lpp)
+			lpp = &(*lpp)->next;
+	lp->next = *lpp;
+	*lpp = lp;
+	localcount++;
+	return 1;
+}
+
+/* remove local event matching type and window (0 for any), return True if found*/
+static Bool
+getLocalEvent(int type, Window w, XEvent *event)
+{
+	nxLocalEvent *lp, **lpp;
+
+	for (lpp = &localq; (lp = *lpp) != NULL; lpp = &lp->next) {
+		if ((type == 0 || lp->event.type == type) &&
+		    (w == 0 || lp->event.xany.window == w)) {
+			*lpp = lp->next;
+			*event = lp->event;
+			Xfree(lp);
+			localcount--;
+			return True;
+		}
 	}
-	saved = 1;
-	saved_event = *event;
+	return False;
+}
+
+int
+XPutBackEvent(Display *display, XEvent *event)
+{
+	_nxQueueEvent(display, event, 1);
 	return 0;
 }
 
@@ -380,9 +422,9 @@ XEventsQueued(Display * display, int mode)
 	FUNC_ENTER;
 	ret = GrQueueLength();
 
-	/* check hack for local saved event*/
-	if (saved)
-		return ret+1;
+	/* events queued locally*/
+	if (localcount)
+		return ret + localcount;
 
 	if (!ret && mode != QueuedAlready) {
 		if (mode == QueuedAfterFlush)
@@ -430,10 +472,7 @@ XNextEvent(Display * dpy, XEvent * event)
 	GR_EVENT ev;
 
 	FUNC_ENTER;
-	if (saved) {
-		*event = saved_event;
-		saved = 0;
-	} else {
+	if (!getLocalEvent(0, 0, event)) {
 		GrGetNextEvent(&ev);
 		translateNXEvent(dpy, &ev, event);
 	}
@@ -447,8 +486,8 @@ XPeekEvent(Display * dpy, XEvent * event)
 	GR_EVENT ev;
 
 	FUNC_ENTER;
-	if (saved) {
-		*event = saved_event;
+	if (localq) {
+		*event = localq->event;
 	} else {
 		GrPeekWaitEvent(&ev);
 		translateNXEvent(dpy, &ev, event);
@@ -488,12 +527,24 @@ _XIfEvent(Display * display, XEvent * ev, PredFunc predicate, XPointer arg, int
 	XIfEventParm p;
 	GR_EVENT event;
 
+	nxLocalEvent *lp, **lpp;
+
 	p.display = display;
 	p.event = ev;
 	p.func = predicate;
 	p.arg = arg;
 
 	FUNC_ENTER;
+	for (lpp = &localq; (lp = *lpp) != NULL; lpp = &lp->next) {
+		*ev = lp->event;
+		if ((*predicate)(display, ev, arg)) {
+			*lpp = lp->next;
+			Xfree(lp);
+			localcount--;
+			return True;
+		}
+	}
+
 	/* note: event not returned directly but translated in callback routine*/
 	return GrGetTypedEventPred(0, 0, 0, &event, block, _XIfEventCallback, &p);
 }
@@ -550,6 +601,8 @@ XCheckTypedEvent(Display * display, int event_type, XEvent * ev)
 	GR_EVENT event;
 
 	FUNC_ENTER;
+	if (getLocalEvent(event_type, 0, ev))
+		return True;
 	if (GrGetTypedEvent(0, translateXEventType(event_type),
 	    translateSubtype(event_type), &event, GR_FALSE)) {
 		translateNXEvent(display, &event, ev);
@@ -566,6 +619,8 @@ XCheckTypedWindowEvent(Display * display, Window w, int event_type, XEvent * ev)
 	GR_EVENT event;
 
 	FUNC_ENTER;
+	if (getLocalEvent(event_type, w, ev))
+		return True;
 	if (GrGetTypedEvent(w, translateXEventType(event_type),
 			    translateSubtype(event_type), &event, GR_FALSE)) {
 		translateNXEvent(display, &event, ev);
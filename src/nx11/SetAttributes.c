@@ -54,6 +54,7 @@ int
 XSetLineAttributes(Display * display, GC gc, unsigned int line_width,
 		   int line_style, int cap_style, int join_style)
 {
+	XGCValues *vp = (XGCValues *)gc->ext_data;
 	unsigned long ls;
 
 	switch (line_style) {
@@ -73,6 +74,11 @@ XSetLineAttributes(Display * display, GC gc, unsigned int line_width,
 	if (join_style != JoinMiter)
 		DPRINTF("XSetLineAttributes: We don't support join style yet\n");
 
-	GrSetGCLineAttributes(gc->gid, ls);
+	vp->line_width = line_width;
+	vp->line_style = line_style;
+	vp->cap_style = cap_style;
+	vp->join_style = join_style;
+	_nxGC(gc)->want.linestyle = ls;
+	_nxGC(gc)->dirty |= GCLineStyle;
 	return 1;
 }
@@ -0,0 +1,288 @@
+/*
+ * MIT-SHM extension emulation using Nano-X shared memory pixmaps
+ *
+ * Shared images are drawn from a server pixmap mapped over the image
+ * data in the client's shared memory segment, so XShmPutImage and
+ * XShmGetImage are a GrCopyArea rather than a copy through the
+ * connection.  Images that aren't in screen pixel format fall
+ * back to XPutImage.
+ */
+#include "nxlib.h"
+#include <stdlib.h>
+#include <string.h>
+#include "X11/Xutil.h"
+#include "X11/extensions/XShm.h"
+#if HAVE_SHAREDMEM_SUPPORT
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+#define SHMNAME	"MIT-SHM"
+
+// from /usr/include/X11/extensions/shm.h
+#ifndef X_ShmPutImage
+#define X_ShmPutImage	3
+#endif
+
+/* shared pixmap kept for each shared image*/
+typedef struct _nxShmImage {
+	struct _nxShmImage *next;
+	XImage *	image;
+	XShmSegmentInfo *shminfo;
+	char *		data;		/* image->data when pixmap created*/
+	GR_WINDOW_ID	pixmap;		/* pixmap over image data, 0 if not shareable*/
+} nxShmImage;
+
+static nxShmImage *shmimages;
+static ShmSeg shmseg;
+
+static void
+freeShmPixmap(nxShmImage *sp)
+{
+	if (sp->pixmap)
+		GrDestroyWindow(sp->pixmap);
+	sp->pixmap = 0;
+	sp->data = NULL;
+}
+
+static int
+destroyShmImage(XImage *image)
+{
+	nxShmImage **spp, *sp;
+
+	for (spp = &shmimages; (sp = *spp) != NULL; spp = &sp->next) {
+		if (sp->image == image) {
+			*spp = sp->next;
+			freeShmPixmap(sp);
+			Xfree(sp);
+			break;
+		}
+	}
+
+	/* image data belongs to the shared segment*/
+	Xfree(image);
+	return 1;
+}
+
+/*
+ * Return shared pixmap for image, creating it on first use or
+ * when the image data pointer has been moved within the segment.
+ * Return 0 if image must be sent with XPutImage.
+ */
+static GR_WINDOW_ID
+findShmPixmap(Display *dpy, XImage *image)
+{
+	XShmSegmentInfo *shminfo = (XShmSegmentInfo *)image->obdata;
+	nxShmImage *sp;
+	int pitch;
+
+	if (!shminfo || !shminfo->shmseg || !image->data)
+		return 0;
+
+	for (sp = shmimages; sp; sp = sp->next)
+		if (sp->image == image)
+			break;
+	if (!sp)
+		return 0;
+	if (sp->pixmap && sp->data == image->data)
+		return sp->pixmap;
+	freeShmPixmap(sp);
+
+	/* only screen format images with pixmap row alignment are shared*/
+	pitch = ((image->width * image->bits_per_pixel / 8) + 3) & ~3;
+	if (dpy->screens[0].root_visual->class != TrueColor ||
+	    image->format != ZPixmap || image->bits_per_pixel < 8 ||
+	    image->bits_per_pixel != dpy->screens[0].root_depth ||
+	    image->bytes_per_line != pitch)
+		return 0;
+
+	sp->pixmap = GrNewSharedPixmap(image->width, image->height, 0,
+		shminfo->shmid, image->data - shminfo->shmaddr);
+	if (sp->pixmap)
+		sp->data = image->data;
+	else DPRINTF("XShm: shared pixmap failed, using XPutImage\n");
+	return sp->pixmap;
+}
+
+Bool
+XShmQueryExtension(Display *dpy)
+{
+#if HAVE_SHAREDMEM_SUPPORT
+	return True;
+#else
+	return False;
+#endif
+}
+
+int
+XShmGetEventBase(Display *dpy)
+{
+	int event_base;
+
+	if (!XQueryExtension(dpy, SHMNAME, NULL, &event_base, NULL))
+		return -1;
+	return event_base;
+}
+
+Bool
+XShmQueryVersion(Display *dpy, int *majorVersion, int *minorVersion,
+	Bool *sharedPixmaps)
+{
+	if (!XShmQueryExtension(dpy))
+		return False;
+	*majorVersion = 1;
+	*minorVersion = 1;
+	*sharedPixmaps = True;
+	return True;
+}
+
+int
+XShmPixmapFormat(Display *dpy)
+{
+	return ZPixmap;
+}
+
+Bool
+XShmAttach(Display *dpy, XShmSegmentInfo *shminfo)
+{
+#if HAVE_SHAREDMEM_SUPPORT
+	struct shmid_ds ds;
+
+	if (shmctl(shminfo->shmid, IPC_STAT, &ds) < 0) {
+		DPRINTF("XShmAttach: bad shmid %d\n", shminfo->shmid);
+		return False;
+	}
+	shminfo->shmseg = ++shmseg;
+	return True;
+#else
+	return False;
+#endif
+}
+
+Bool
+XShmDetach(Display *dpy, XShmSegmentInfo *shminfo)
+{
+	nxShmImage *sp;
+
+	/* server detaches segment when pixmaps are destroyed*/
+	for (sp = shmimages; sp; sp = sp->next)
+		if (sp->shminfo == shminfo)
+			freeShmPixmap(sp);
+	shminfo->shmseg = 0;
+	return True;
+}
+
+XImage *
+XShmCreateImage(Display *dpy, Visual *visual, unsigned int depth, int format,
+	char *data, XShmSegmentInfo *shminfo, unsigned int width, unsigned int height)
+{
+	XImage *image;
+	nxShmImage *sp;
+
+	sp = (nxShmImage *)Xcalloc(1, sizeof(nxShmImage));
+	if (!sp)
+		return NULL;
+	image = XCreateImage(dpy, visual, depth, format, 0, data, width, height, 32, 0);
+	if (!image) {
+		Xfree(sp);
+		return NULL;
+	}
+	image->obdata = (XPointer)shminfo;
+	image->f.destroy_image = destroyShmImage;
+
+	sp->image = image;
+	sp->shminfo = shminfo;
+	sp->next = shmimages;
+	shmimages = sp;
+	return image;
+}
+
+Bool
+XShmPutImage(Display *dpy, Drawable d, GC gc, XImage *image, int src_x, int src_y,
+	int dst_x, int dst_y, unsigned int src_width, unsigned int src_height,
+	Bool send_event)
+{
+	GR_WINDOW_ID pixmap = findShmPixmap(dpy, image);
+
+	if (pixmap) {
+		XGCValues *vp = (XGCValues *)gc->ext_data;
+
+		_nxFlushGC(gc);
+		GrCopyArea(d, gc->gid, dst_x, dst_y, src_width, src_height,
+			pixmap, src_x, src_y, _nxConvertROP(vp->function));
+	} else
+		XPutImage(dpy, d, gc, image, src_x, src_y, dst_x, dst_y,
+			src_width, src_height);
+
+	if (send_event) {
+		XEvent event;
+		XShmCompletionEvent *ev = (XShmCompletionEvent *)&event;
+		XShmSegmentInfo *shminfo = (XShmSegmentInfo *)image->obdata;
+
+		/* round trip so server is done with segment before completion*/
+		if (pixmap) {
+			GR_WINDOW_INFO winfo;
+			GrGetWindowInfo(pixmap, &winfo);
+		}
+
+		memset(&event, 0, sizeof(event));
+		ev->type = XShmGetEventBase(dpy) + ShmCompletion;
+		ev->send_event = False;
+		ev->display = dpy;
+		ev->drawable = d;
+		ev->major_code = 0;
+		ev->minor_code = X_ShmPutImage;
+		ev->shmseg = shminfo? shminfo->shmseg: 0;
+		ev->offset = shminfo? image->data - shminfo->shmaddr: 0;
+		_nxQueueEvent(dpy, &event, 0);
+	}
+	return True;
+}
+
+Bool
+XShmGetImage(Display *dpy, Drawable d, XImage *image, int x, int y,
+	unsigned long plane_mask)
+{
+	static GR_GC_ID gc;
+	GR_WINDOW_ID pixmap;
+	GR_WINDOW_INFO winfo;
+	XImage *tmp;
+
+	GrGetWindowInfo(d, &winfo);
+	if (x < 0 || x + image->width > winfo.width ||
+	    y < 0 || y + image->height > winfo.height) {
+		DPRINTF("XShmGetImage: Image out of bounds\n");
+		return False;
+	}
+
+	pixmap = findShmPixmap(dpy, image);
+	if (pixmap) {
+		if (!gc)
+			gc = GrNewGC();
+		GrCopyArea(pixmap, gc, 0, 0, image->width, image->height,
+			d, x, y, MWROP_COPY);
+
+		/* round trip so pixels are in the segment on return*/
+		GrGetWindowInfo(pixmap, &winfo);
+		return True;
+	}
+
+	/* not shareable, copy through connection*/
+	tmp = XGetImage(dpy, d, x, y, image->width, image->height, plane_mask, ZPixmap);
+	if (!tmp)
+		return False;
+	_XSetImage(tmp, image, 0, 0);
+	XDestroyImage(tmp);
+	return True;
+}
+
+Pixmap
+XShmCreatePixmap(Display *dpy, Drawable d, char *data, XShmSegmentInfo *shminfo,
+	unsigned int width, unsigned int height, unsigned int depth)
+{
+	if (!shminfo->shmseg)
+		return 0;
+	return GrNewSharedPixmap(width, height, 0, shminfo->shmid,
+		data - shminfo->shmaddr);
+}
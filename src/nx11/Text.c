@@ -6,7 +6,8 @@ XDrawString(Display *dpy, Drawable d, GC gc, int x, int y,
 {   
 	if (length > 0)
 	{
-		GrSetGCUseBackground(gc->gid, GR_FALSE);
+		_nxSetGCUseBackground(gc, GR_FALSE);
+		_nxFlushGC(gc);
 		GrText(d, gc->gid, x, y, (char *)string, length,
 		       GR_TFASCII|GR_TFBASELINE);
 	}
@@ -18,10 +19,11 @@ XDrawImageString(Display *dpy, Drawable d, GC gc, int x, int y,
 	_Xconst char *string, int length)
 {
 	if (length > 0) {
-		GrSetGCUseBackground(gc->gid, GR_TRUE);
+		_nxSetGCUseBackground(gc, GR_TRUE);
+		_nxFlushGC(gc);
 		GrText(d, gc->gid, x, y, (char *)string, length,
 		       GR_TFASCII|GR_TFBASELINE);
-		GrSetGCUseBackground(gc->gid, GR_FALSE);
+		_nxSetGCUseBackground(gc, GR_FALSE);
 	}
 	return 0;
 }
@@ -5,9 +5,11 @@ XDrawString16(Display *dpy, Drawable d, GC gc, int x, int y,
 	_Xconst XChar2b *string, int length)
 {   
 	/*DPRINTF("XDrawString16 %d %x %x\n", length, string->byte1, string->byte2);*/
-	if (length > 0)
+	if (length > 0) {
+		_nxFlushGC(gc);
 		GrText(d, gc->gid, x, y, (void *)string, length, 
 		       GR_TFXCHAR2B|GR_TFBASELINE);
+	}
 	return 0;
 }
 
@@ -16,10 +18,11 @@ XDrawImageString16(Display *dpy, Drawable d, GC gc, int x, int y,
 	_Xconst XChar2b *string, int length)
 {
 	if (length > 0) {
-		GrSetGCUseBackground(gc->gid, GR_TRUE);
+		_nxSetGCUseBackground(gc, GR_TRUE);
+		_nxFlushGC(gc);
 		GrText(d, gc->gid, x, y, (void *)string, length, 
 		       GR_TFXCHAR2B|GR_TFBASELINE);
-		GrSetGCUseBackground(gc->gid, GR_FALSE);
+		_nxSetGCUseBackground(gc, GR_FALSE);
 	}
 	return 0;
 }
@@ -204,6 +204,9 @@ typedef struct _XrmHashBucketRec {
 #endif
 } XrmHashBucketRec;
 
+/* bumped on any database change, invalidates the XrmQGetResource cache */
+static unsigned long xrmSerial;
+
 /* closure used in get/put resource */
 typedef struct _VClosure {
     XrmRepresentation	*type;		/* type of value */
@@ -770,6 +773,7 @@ void XrmCombineDatabase(from, into, override)
     if (!*into) {
 	*into = from;
     } else if (from) {
+	xrmSerial++;
 	_XLockMutex(&from->linfo);
 	_XLockMutex(&(*into)->linfo);
 	if ((ftable = from->table)) {
@@ -854,6 +858,7 @@ static void PutEntry(db, bindings, quarks, type, value)
 
     if (!db || !*quarks)
 	return;
+    xrmSerial++;
     table = *(prev = &db->table);
     /* if already at leaf, bump to the leaf table */
     if (!quarks[1] && table && !table->leaf)
@@ -2552,6 +2557,57 @@ static Bool GetNEntry(table, names, classes, closure)
     return False;
 }
 
+/*
+ * Search list for the most recent XrmQGetResource name/class prefix.
+ * Toolkits fetch many resources of the same widget in a row, these
+ * differ only in the last component, and XrmQGetSearchResource on the
+ * prefix search list gives the same result as a full XrmQGetResource.
+ */
+#define SEARCHCACHELEN	100
+
+static struct {
+    XrmDatabase		db;
+    unsigned long	serial;		/* xrmSerial when list built */
+    int			depth;		/* # prefix components, 0 if invalid */
+    XrmQuark		names[MAXDBDEPTH+1];
+    XrmQuark		classes[MAXDBDEPTH+1];
+    XrmHashTable	list[SEARCHCACHELEN];
+} searchCache;
+
+static XrmHashTable *GetCachedSearchList(db, names, classes, depth)
+    XrmDatabase		db;
+    XrmNameList		names;
+    XrmClassList	classes;
+    int			depth;
+{
+    int i;
+
+    if (searchCache.depth == depth && searchCache.db == db &&
+	searchCache.serial == xrmSerial) {
+	for (i = 0; i < depth; i++)
+	    if (searchCache.names[i] != names[i] ||
+		searchCache.classes[i] != classes[i])
+		break;
+	if (i == depth)
+	    return searchCache.list;
+    }
+
+    for (i = 0; i < depth; i++) {
+	searchCache.names[i] = names[i];
+	searchCache.classes[i] = classes[i];
+    }
+    searchCache.names[depth] = NULLQUARK;
+    searchCache.classes[depth] = NULLQUARK;
+    searchCache.db = db;
+    searchCache.serial = xrmSerial;
+    searchCache.depth = 0;
+    if (!XrmQGetSearchList(db, searchCache.names, searchCache.classes,
+			   searchCache.list, SEARCHCACHELEN))
+	return (XrmHashTable *)NULL;	/* too deep, use full search */
+    searchCache.depth = depth;
+    return searchCache.list;
+}
+
 Bool XrmQGetResource(db, names, classes, pType, pValue)
     XrmDatabase         db;
     XrmNameList		names;
@@ -2561,6 +2617,18 @@ Bool XrmQGetResource(db, names, classes, pType, pValue)
 {
     register NTable table;
     VClosureRec closure;
+    XrmHashTable *list;
+    int depth;
+
+    if (db && *names && names[1]) {
+	for (depth = 1; names[depth + 1]; depth++)
+	    if (depth >= MAXDBDEPTH)
+		break;
+	if (!names[depth + 1] && classes[depth] &&
+	    (list = GetCachedSearchList(db, names, classes, depth)))
+	    return XrmQGetSearchResource(list, names[depth], classes[depth],
+					 pType, pValue);
+    }
 
     if (db && *names) {
 	_XLockMutex(&db->linfo);
@@ -2679,6 +2747,7 @@ void XrmDestroyDatabase(db)
     register NTable table, next;
 
     if (db) {
+	xrmSerial++;
 	_XLockMutex(&db->linfo);
 	for (next = db->table; (table = next); ) {
 	    next = table->next;
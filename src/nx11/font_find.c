@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include "uni_std.h"
 #include "nxlib.h"
 #include "X11/Xatom.h"
@@ -27,9 +28,59 @@ static void _nxSetDefaultFontDir(void);
 static void _nxSetFontDir(char **directories, int ndirs);
 static void _nxFreeFontDir(char ***list);
 
+/* fonts.dir entry, XLFD fields pre-split for indexed searching*/
+typedef struct {
+	char *	file;		/* font filename, first fonts.dir field*/
+	char *	xlfd;		/* XLFD, second fonts.dir field*/
+	char *	family;		/* XLFD family, "" if not 14 dash XLFD*/
+	char *	weight;		/* XLFD weight, "" if not 14 dash XLFD*/
+	int	pixelsize;	/* XLFD pixel size, -1 if not plain decimal*/
+	int	dashes;		/* dashcount(xlfd)*/
+	int	line;		/* fonts.dir line number*/
+} nxFontEntry;
+
+/* fonts.alias entry*/
+typedef struct {
+	char *	name;
+	char *	alias;
+	int	line;		/* fonts.alias line number*/
+} nxFontAlias;
+
+/*
+ * Per font directory catalog of fonts.dir and fonts.alias, read once
+ * and reloaded when the directory or either file modification time changes.
+ * Entries [0, nindexed) are 14 dash XLFDs sorted by family, weight and
+ * pixel size, the remainder are in fonts.dir order.
+ */
+typedef struct {
+	int		loaded;
+	time_t		mtime;		/* newest directory, fonts.dir or fonts.alias mtime*/
+	int		hasfontsdir;	/* fonts.dir exists*/
+	int		count;
+	int		nindexed;
+	nxFontEntry *	fonts;
+	int		naliases;	/* aliases sorted by name*/
+	nxFontAlias *	aliases;
+} nxFontCatalog;
+
+/* literal XLFD fields of a pattern, used to narrow catalog searches*/
+typedef struct {
+	int	indexed;	/* pattern is 14 dash XLFD, fields below valid*/
+	char *	family;		/* NULL if wildcarded*/
+	char *	weight;		/* NULL if wildcarded*/
+	int	pixelsize;	/* -1 if wildcarded*/
+	char	buf[256];
+} nxFontKey;
+
+#define XLFD_DASHES	14
+
+static void freecatalog(nxFontCatalog *cat);
+static int any(int c, const char *str);
+
 /* nxlib font.c*/
 static char **_nxfontlist = NULL;
 static int _nxfontcount = 0;
+static nxFontCatalog *_nxfontcat = NULL;	/* catalog for each _nxfontlist dir*/
 
 static FILE *
 _nxOpenFontDir(char *str)
@@ -79,6 +130,7 @@ _nxSetFontDir(char **directories, int ndirs)
 	_nxfontlist = (char **)calloc(ndirs+1, sizeof(char *));
 	for (i = 0; i < ndirs; i++)
 		_nxfontlist[i] = strdup(directories[i]);
+	_nxfontcat = (nxFontCatalog *)calloc(ndirs+1, sizeof(nxFontCatalog));
 
 	_nxfontcount = ndirs;
 }
@@ -89,6 +141,13 @@ _nxFreeFontDir(char ***addrlist)
 	char **list = *addrlist;
 	int i;
 
+	if (addrlist == &_nxfontlist && _nxfontcat) {
+		for (i = 0; i < _nxfontcount; i++)
+			freecatalog(&_nxfontcat[i]);
+		free(_nxfontcat);
+		_nxfontcat = NULL;
+	}
+
 	if (list) {
 		for (i = 0; list[i]; i++)
 			free(list[i]);
@@ -263,10 +322,336 @@ patternmatch(char *pat, int patdashes, char *string, int stringdashes)
 	}
 }
 
+/* split XLFD in place at dashes, fields[n] is field following dash n+1*/
+static void
+xlfdfields(char *xlfd, char **fields)
+{
+	int n = 0;
+
+	while (*xlfd) {
+		if (*xlfd++ == '-') {
+			xlfd[-1] = '\0';
+			if (n < XLFD_DASHES)
+				fields[n++] = xlfd;
+		}
+	}
+}
+
+/* return value of plain decimal XLFD field, -1 if wildcarded or not decimal*/
+static int
+xlfdnumber(const char *s)
+{
+	int n = 0;
+
+	if (!*s || (s[0] == '0' && s[1]))
+		return -1;
+	for (; *s; s++) {
+		if (*s < '0' || *s > '9')
+			return -1;
+		n = n * 10 + (*s - '0');
+	}
+	return n;
+}
+
+/* strip trailing newline from fgets buffer*/
+static void
+chopline(char *buffer)
+{
+	int len = strlen(buffer);
+
+	while (len > 0 && (buffer[len-1] == '\n' || buffer[len-1] == '\r'))
+		buffer[--len] = '\0';
+}
+
+static int
+fontentrycmp(const void *a, const void *b)
+{
+	const nxFontEntry *ea = (const nxFontEntry *)a;
+	const nxFontEntry *eb = (const nxFontEntry *)b;
+	int r;
+
+	/* indexed 14 dash XLFDs first*/
+	if ((ea->dashes == XLFD_DASHES) != (eb->dashes == XLFD_DASHES))
+		return (ea->dashes == XLFD_DASHES)? -1: 1;
+	if (ea->dashes == XLFD_DASHES) {
+		if ((r = strcmp(ea->family, eb->family)) != 0)
+			return r;
+		if ((r = strcmp(ea->weight, eb->weight)) != 0)
+			return r;
+		if ((r = ea->pixelsize - eb->pixelsize) != 0)
+			return r;
+	}
+	return ea->line - eb->line;
+}
+
+static int
+fontaliascmp(const void *a, const void *b)
+{
+	const nxFontAlias *aa = (const nxFontAlias *)a;
+	const nxFontAlias *ab = (const nxFontAlias *)b;
+	int r = strcmp(aa->name, ab->name);
+
+	return r? r: aa->line - ab->line;
+}
+
+static void
+freecatalog(nxFontCatalog *cat)
+{
+	int i;
+
+	for (i = 0; i < cat->count; i++)
+		free(cat->fonts[i].file);
+	for (i = 0; i < cat->naliases; i++)
+		free(cat->aliases[i].name);
+	free(cat->fonts);
+	free(cat->aliases);
+	memset(cat, 0, sizeof(nxFontCatalog));
+}
+
+/* return newest modification time of font directory, fonts.dir and fonts.alias*/
+static time_t
+catalogtime(char *dir)
+{
+	static const char *files[] = { "", "/fonts.dir", "/fonts.alias", "/fonts.ali", NULL };
+	struct stat st;
+	time_t mtime = 0;
+	int i;
+	char path[256];
+
+	for (i = 0; files[i]; i++) {
+		sprintf(path, "%s%s", dir, files[i]);
+		if (stat(path, &st) == 0 && st.st_mtime > mtime)
+			mtime = st.st_mtime;
+	}
+	return mtime;
+}
+
+/* read fonts.dir and fonts.alias into catalog and build indexes*/
+static void
+loadcatalog(nxFontCatalog *cat, char *dir)
+{
+	FILE *fp;
+	int i, fcount = 0;
+	char buffer[256];
+
+	DPRINTF("loadcatalog: %s\n", dir);
+	if ((fp = _nxOpenFontDir(dir)) != NULL) {
+		cat->hasfontsdir = 1;
+
+		/* get fonts.dir linecount*/
+		if (fgets(buffer, sizeof(buffer), fp) && (fcount = atoi(buffer)) > 0)
+			cat->fonts = (nxFontEntry *)calloc(fcount, sizeof(nxFontEntry));
+
+		for (i = 0; cat->fonts && i < fcount; i++) {
+			nxFontEntry *e = &cat->fonts[cat->count];
+			char *xlfd, *fields[XLFD_DASHES];
+			int flen, xlen;
+
+			if (!fgets(buffer, sizeof(buffer), fp))
+				break;
+			chopline(buffer);
+
+			/* font filename is first field, XLFD is second field*/
+			xlfd = strchr(buffer, ' ');
+			if (!xlfd)
+				continue;
+			*xlfd++ = '\0';
+
+			/* filename, XLFD and XLFD copy split into fields*/
+			flen = strlen(buffer) + 1;
+			xlen = strlen(xlfd) + 1;
+			if (!(e->file = malloc(flen + xlen + xlen)))
+				break;
+			memcpy(e->file, buffer, flen);
+			e->xlfd = e->file + flen;
+			memcpy(e->xlfd, xlfd, xlen);
+			e->dashes = dashcount(xlfd);
+			e->line = i;
+			e->family = e->weight = "";
+			e->pixelsize = -1;
+			if (e->dashes == XLFD_DASHES) {
+				memcpy(e->xlfd + xlen, xlfd, xlen);
+				xlfdfields(e->xlfd + xlen, fields);
+				e->family = fields[1];
+				e->weight = fields[2];
+				e->pixelsize = xlfdnumber(fields[6]);
+			}
+			cat->count++;
+		}
+		fclose(fp);
+
+		qsort(cat->fonts, cat->count, sizeof(nxFontEntry), fontentrycmp);
+		for (i = 0; i < cat->count && cat->fonts[i].dashes == XLFD_DASHES; i++)
+			continue;
+		cat->nindexed = i;
+	}
+
+	if ((fp = openfontalias(dir)) != NULL) {
+		int alloc = 0;
+
+		for (i = 0; fgets(buffer, sizeof(buffer), fp); i++) {
+			nxFontAlias *a;
+			char *p;
+
+			chopline(buffer);
+
+			/* ignore blank and ! comments*/
+			if (buffer[0] == '\0' || buffer[0] == '!')
+				continue;
+
+			/* fontname is first space separated field*/
+			/* check for tab first as filename may have spaces*/
+			p = strchr(buffer, '\t');
+			if (!p)
+				p = strchr(buffer, ' ');
+			if (!p)
+				continue;
+			*p = '\0';
+
+			/* alias is second space separated field*/
+			do ++p; while (*p == ' ' || *p == '\t');
+
+			if (cat->naliases == alloc) {
+				nxFontAlias *aliases = realloc(cat->aliases, (alloc + 32) * sizeof(nxFontAlias));
+				if (!aliases)
+					break;
+				cat->aliases = aliases;
+				alloc += 32;
+			}
+			a = &cat->aliases[cat->naliases];
+			if (!(a->name = malloc(strlen(buffer) + strlen(p) + 2)))
+				break;
+			strcpy(a->name, buffer);
+			a->alias = a->name + strlen(buffer) + 1;
+			strcpy(a->alias, p);
+			a->line = i;
+			cat->naliases++;
+		}
+		fclose(fp);
+
+		qsort(cat->aliases, cat->naliases, sizeof(nxFontAlias), fontaliascmp);
+	}
+	DPRINTF("loadcatalog: %d fonts (%d indexed), %d aliases\n",
+		cat->count, cat->nindexed, cat->naliases);
+}
+
+/* return catalog for font directory index, reloading if directory changed*/
+static nxFontCatalog *
+findcatalog(int index)
+{
+	nxFontCatalog *cat = &_nxfontcat[index];
+	time_t mtime = catalogtime(_nxfontlist[index]);
+
+	if (!cat->loaded || cat->mtime != mtime) {
+		freecatalog(cat);
+		loadcatalog(cat, _nxfontlist[index]);
+		cat->loaded = 1;
+		cat->mtime = mtime;
+	}
+	return cat;
+}
+
+/* extract literal family, weight and pixel size from XLFD pattern*/
+static void
+fontkey(const char *pattern, nxFontKey *key)
+{
+	char *fields[XLFD_DASHES];
+
+	key->indexed = 0;
+	key->family = key->weight = NULL;
+	key->pixelsize = -1;
+
+	/*
+	 * Fields can only be compared individually when pattern and XLFD
+	 * have the same number of dashes, as patternmatch won't then let
+	 * a wildcard match across a dash.
+	 */
+	if (strlen(pattern) >= sizeof(key->buf) || dashcount((char *)pattern) != XLFD_DASHES)
+		return;
+	strcpy(key->buf, pattern);
+	xlfdfields(key->buf, fields);
+	key->indexed = 1;
+	if (!any('*', fields[1]) && !any('?', fields[1]))
+		key->family = fields[1];
+	if (!any('*', fields[2]) && !any('?', fields[2]))
+		key->weight = fields[2];
+	key->pixelsize = xlfdnumber(fields[6]);
+}
+
+static int
+fontkeycmp(nxFontEntry *e, nxFontKey *key)
+{
+	int r = strcmp(e->family, key->family);
+
+	if (r || !key->weight)
+		return r;
+	if ((r = strcmp(e->weight, key->weight)) != 0 || key->pixelsize < 0)
+		return r;
+	return e->pixelsize - key->pixelsize;
+}
+
+/*
+ * Return first and last+1 indexed catalog entries that can match key.
+ * Entries from nindexed on must always be checked.
+ */
+static void
+catalogrange(nxFontCatalog *cat, nxFontKey *key, int *first, int *last)
+{
+	int lo, hi, mid;
+
+	if (!key->indexed || !key->family) {
+		*first = 0;
+		*last = cat->nindexed;
+		return;
+	}
+
+	/* binary search for lower and upper bound of key*/
+	lo = 0;
+	hi = cat->nindexed;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (fontkeycmp(&cat->fonts[mid], key) < 0)
+			lo = mid + 1;
+		else hi = mid;
+	}
+	*first = lo;
+	hi = cat->nindexed;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (fontkeycmp(&cat->fonts[mid], key) <= 0)
+			lo = mid + 1;
+		else hi = mid;
+	}
+	*last = lo;
+}
+
+/* return first catalog entry index to search*/
+static int
+catalogfirst(nxFontCatalog *cat, int first, int last)
+{
+	return (first < last)? first: cat->nindexed;
+}
+
+/* return next catalog entry index to search, skipping to unindexed entries after range*/
+static int
+catalognext(nxFontCatalog *cat, int i, int last)
+{
+	return (++i == last)? cat->nindexed: i;
+}
+
+/* quick check of indexed entry against literal key fields*/
 static int
-match(char *pat, char *string)
+fontkeyreject(nxFontCatalog *cat, int i, nxFontKey *key)
 {
-	return patternmatch(pat, dashcount(pat), string, dashcount(string));
+	nxFontEntry *e = &cat->fonts[i];
+
+	if (!key->indexed || i >= cat->nindexed)
+		return 0;
+	if (key->family && strcmp(e->family, key->family))
+		return 1;
+	if (key->weight && strcmp(e->weight, key->weight))
+		return 1;
+	return key->pixelsize >= 0 && e->pixelsize != key->pixelsize;
 }
 
 /*
@@ -277,46 +662,32 @@ static void
 findfont_wildcard(char *pattern, int maxnames, struct _list *fontlist)
 {
 	int f, i;
+	int patdashes = dashcount(pattern);
+	nxFontKey key;
 
 	DPRINTF("findfont_wildcard: '%s' maxnames %d\n", pattern, maxnames);
-	/* loop through each font dir and read fonts.dir*/
-	for (f = 0; f < _nxfontcount; f++) {
-		FILE *fontdir = _nxOpenFontDir(_nxfontlist[f]);
-		int fcount;
-		char buffer[128];
+	fontkey(pattern, &key);
 
-		DPRINTF("nxopenfontdir %s\n", _nxfontlist[f]);
-		if (!fontdir)
-			continue;
-
-		/* get fonts.dir linecount*/
-		if (!fgets(buffer, sizeof(buffer), fontdir) || !(fcount = atoi(buffer))) {
-			fclose(fontdir);
-			continue;
-		}
-
-		/* read XLFD and add to list if matches wildcard pattern*/
-		for (i = 0; i < fcount; i++) {
-			char *xlfd;
+	/* loop through each font dir catalog*/
+	for (f = 0; f < _nxfontcount; f++) {
+		nxFontCatalog *cat = findcatalog(f);
+		int first, last;
 
-			if (!(fgets(buffer, sizeof(buffer), fontdir)))
-				continue;
-			buffer[strlen(buffer) - 1] = '\0';
+		/* check XLFDs that may match literal fields, add to list if matches wildcard pattern*/
+		catalogrange(cat, &key, &first, &last);
+		for (i = catalogfirst(cat, first, last); i < cat->count; i = catalognext(cat, i, last)) {
+			nxFontEntry *e = &cat->fonts[i];
 
-			/* XLFD is second field*/
-			xlfd = strchr(buffer, ' ');
-			if (!xlfd)
+			if (fontkeyreject(cat, i, &key))
 				continue;
-			*xlfd++ = '\0';
 
 			/* if XLFD matches pattern, add to fontlist*/
-			if (match(pattern, xlfd)) {
-				DPRINTF("enumfont add: %s\n", xlfd);
-				if (_addFontToList(fontlist, xlfd) == maxnames)
-					break;
+			if (patternmatch(pattern, patdashes, e->xlfd, e->dashes)) {
+				DPRINTF("enumfont add: %s\n", e->xlfd);
+				if (_addFontToList(fontlist, e->xlfd) == maxnames)
+					return;
 			}
 		}
-		fclose(fontdir);
 	}
 
 #if ANDROID // FIXME broken, segfaults in strlen code below
@@ -436,48 +807,25 @@ any(int c, const char *str)
 int
 font_findalias(int index, const char *fontspec, char *alias)
 {
-	FILE *aliasfile;
-	int match = 0;
-	char *p;
-	char buffer[256];
+	nxFontCatalog *cat = findcatalog(index);
+	int lo = 0, hi = cat->naliases;
 
-	/* loop through each line in the fonts.alias file for match*/
-	aliasfile = openfontalias(_nxfontlist[index]);
-	if (aliasfile) {
-		for (;;) {
-			if (!fgets(buffer, sizeof(buffer), aliasfile))
-				break;
-			buffer[strlen(buffer) - 1] = '\0';
+	/* binary search for first fonts.alias entry for fontspec*/
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
 
-			/* ignore blank and ! comments*/
-			if (buffer[0] == '\0' || buffer[0] == '!')
-				continue;
-
-			/* fontname is first space separated field*/
-			/* check for tab first as filename may have spaces*/
-			p = strchr(buffer, '\t');
-			if (!p)
-				p = strchr(buffer, ' ');
-			if (!p)
-				continue;
-			*p = '\0';
-
-			/* check exact match*/
-			if (strcmp(fontspec, buffer) == 0) {
-
-				/* alias is second space separated field*/
-				do ++p; while (*p == ' ' || *p == '\t');
-
-				strcpy(alias, p);
-				DPRINTF("font_findalias: replacing %s with %s\n", fontspec, alias);
-				match = 1;
-				break;
-			}
-		}
-		fclose(aliasfile);
+		if (strcmp(cat->aliases[mid].name, fontspec) < 0)
+			lo = mid + 1;
+		else hi = mid;
 	}
 
-	return match;
+	/* check exact match*/
+	if (lo < cat->naliases && strcmp(cat->aliases[lo].name, fontspec) == 0) {
+		strcpy(alias, cat->aliases[lo].alias);
+		DPRINTF("font_findalias: replacing %s with %s\n", fontspec, alias);
+		return 1;
+	}
+	return 0;
 }
 
 /* return height component of XLFD: ...--height-...*/
@@ -499,6 +847,47 @@ xlfdheight(const char *xlfd)
 	return height;
 }
 
+/*
+ * Check for scaleable font match with passed pixel size, that is:
+ *     match XLFD  "...normal--0-0-0-0-0-..."
+ * with passed     "...normal--12-0-0-0-0-..."
+ * for height 12.
+ */
+static int
+scalematch(const char *xlfd, const char *fontspec)
+{
+	int j;
+	int dashcount = 0;
+	int len;
+
+	/* no exact match, check for match with -0- height*/
+	if (xlfdheight(xlfd) != 0)
+		return 0;		/* not scaleable*/
+
+	len = MWMIN(strlen(xlfd), strlen(fontspec));
+
+	/* match before and after height at '--0-' in XLFD string*/
+	for (j = 0; j < len && dashcount < 8; j++) {
+		if (xlfd[j] == '-')
+			dashcount++;
+		if (xlfd[j] != fontspec[j]) {
+			if (dashcount == 7 && xlfd[j] == '0') {
+				int st = j;
+
+				/* pass over passed height*/
+				while (fontspec[j] >= '0' && fontspec[j] <= '9')
+					j++;
+
+				/* and check that rest of XLFD line matches*/
+				if (strcmp(&fontspec[j], &xlfd[st+1]) == 0)
+					return 1;
+			}
+			break;
+		}
+	}
+	return 0;
+}
+
 /*
  * Search font directory fonts.dir files and return full font pathname matching
  * fontspec, no wildcards allowed.
@@ -524,7 +913,6 @@ static char *
 findfont_nowildcard(const char *fontspec, int *height)
 {
 	int i, f;
-	char buffer[128];
 	char path[256];
 
 	if (!_nxfontcount)
@@ -539,17 +927,17 @@ findfont_nowildcard(const char *fontspec, int *height)
 	if (fontspec[0] == '/')
 		return strdup(fontspec);
 
-	/* loop through each font dir and read fonts.dir*/
+	/* loop through each font dir catalog*/
 	for (f = 0; f < _nxfontcount; f++) {
-		FILE *fontdir = _nxOpenFontDir(_nxfontlist[f]);
-		int fcount;
+		nxFontCatalog *cat = findcatalog(f);
+		nxFontEntry *found = NULL;
 
 		/*
 		 * If no fonts.dir file, check fontspec as filename.
 		 * This allows .ttf files to be found in typical font directory
 		 * installations for non-X11/XLFD fonts.
 		 */
-		if (!fontdir) {
+		if (!cat->hasfontsdir) {
 			sprintf(path, "%s/%s", _nxfontlist[f], fontspec);
 			if (access(path, F_OK) == 0) {
 				DPRINTF("findfont_nowild: partial path match %s = %s\n", fontspec, path);
@@ -560,116 +948,56 @@ findfont_nowildcard(const char *fontspec, int *height)
 			continue;
 		}
 
-		/* get fonts.dir linecount*/
-		if (!fgets(buffer, sizeof(buffer), fontdir) || !(fcount = atoi(buffer))) {
-			fclose(fontdir);
-			continue;
-		}
-
 		if (fontspec[0] == '-') {
-			/* Fontspec is XLFD: loop throuch each line in the fonts.dir file for XLFD match*/
-			for (i = 0; i < fcount; i++) {
-				char *xlfd;
+			nxFontKey key;
+			int first, last;
 
-				/* font filename is first field*/
-				if (!fgets(buffer, sizeof(buffer), fontdir))
+			/*
+			 * Fontspec is XLFD: check catalog entries with same family and
+			 * weight for exact XLFD match or scaleable -0- height match,
+			 * returning the earliest in fonts.dir.
+			 */
+			fontkey(fontspec, &key);
+			key.pixelsize = -1;
+			catalogrange(cat, &key, &first, &last);
+			for (i = catalogfirst(cat, first, last); i < cat->count; i = catalognext(cat, i, last)) {
+				nxFontEntry *e = &cat->fonts[i];
+
+				if (found && e->line > found->line)
 					continue;
-				buffer[strlen(buffer) - 1] = '\0';
-
-				/* XLFD is second field*/
-				xlfd = strchr(buffer, ' ');
-				if (!xlfd)
+				if (fontkeyreject(cat, i, &key))
 					continue;
-				*xlfd++ = '\0';
-
-				/* if XLFD matches fontspec, return full font pathname*/
-				if (strcmp(fontspec, xlfd) == 0) {
-
-					/* return full font pathname and height*/
-					sprintf(path, "%s/%s", _nxfontlist[f], buffer);
-					*height = xlfdheight(xlfd);
-					DPRINTF("findfont_nowild: exact XLFD match %s %s = %s (%d)\n",
-						fontspec, xlfd, path, *height);
-					fclose(fontdir);
-					return strdup(path);
-				} else {
-					int j;
-					int dashcount = 0;
-					int len;
-
-					/* no exact match, check for match with -0- height*/
-					if (xlfdheight(xlfd) != 0)
-						continue;		/* not scaleable, try next fonts.dir line*/
-
-					/* otherwise check for scaleable font match spec
-				 	 * with passed pixel size, that is:
-				 	 *     match XLFD  "...normal--0-0-0-0-0-..."
-				 	 * with passed     "...normal--12-0-0-0-0-..."
-				 	 * for height 12.
-				 	 */
-					len = MWMIN(strlen(xlfd), strlen(fontspec));
-
-					/* match before and after height at '--0-' in XLFD string*/
-					for (j = 0; j < len && dashcount < 8; j++) {
-						if (xlfd[j] == '-')
-							dashcount++;
-						if (xlfd[j] != fontspec[j]) {
-							if (dashcount == 7 && xlfd[j] == '0') {
-								int st = j;
-
-								/* pass over passed height*/
-								while (fontspec[j] >= '0' && fontspec[j] <= '9')
-									j++;
-
-								/* and check that rest of XLFD line matches*/
-								if (strcmp(&fontspec[j], &xlfd[st+1]) == 0) {
-
-									/* match - return full font pathname and height*/
-									sprintf(path, "%s/%s", _nxfontlist[f], buffer);
-									*height = xlfdheight(fontspec);
-									DPRINTF("findfont_nowild: XLFD -0- match %s %s = '%s' height %d\n", fontspec, xlfd, path, *height);
-									fclose(fontdir);
-									return strdup(path);
-								}
-							}
-							break;
-						}
-					}
-				}
+				if (strcmp(fontspec, e->xlfd) == 0 || scalematch(e->xlfd, fontspec))
+					found = e;
+			}
+			if (found) {
+				/* return full font pathname and height*/
+				sprintf(path, "%s/%s", _nxfontlist[f], found->file);
+				*height = xlfdheight(fontspec);
+				DPRINTF("findfont_nowild: XLFD match %s %s = '%s' height %d\n",
+					fontspec, found->xlfd, path, *height);
+				return strdup(path);
 			}
 		} else {	/* fontspec[0] != '-'*/
 			/*
-		 	 * Fontspec is not XLFD.  Loop through each fonts.dir line and look
+		 	 * Fontspec is not XLFD.  Check each fonts.dir entry and look
 		 	 * for fontspec being a prefix of the font filename.
 		 	 */
-			for (i = 0; i < fcount; i++) {
-				char *p;
-
-				/* font filename is first field*/
-				if (!fgets(buffer, sizeof(buffer), fontdir))
-					continue;
-				buffer[strlen(buffer) - 1] = '\0';
-				p = strchr(buffer, ' ');
-				if (!p)
-					continue;
-				*p = '\0';
+			for (i = 0; i < cat->count; i++) {
+				nxFontEntry *e = &cat->fonts[i];
 
 				/* prefix allows font.pcf to match font.pcf.gz for example*/
-				if (prefix(fontspec, buffer)) {
-					char path[256];
-
-					/* return full font pathname*/
-					sprintf(path, "%s/%s", _nxfontlist[f], buffer);
-					DPRINTF("findfont_nowild: non-XLFD prefix match %s %s = '%s'\n",
-						fontspec, buffer, path);
-					fclose(fontdir);
-					return strdup(path);
-				}
+				if ((!found || e->line < found->line) && prefix(fontspec, e->file))
+					found = e;
+			}
+			if (found) {
+				/* return full font pathname*/
+				sprintf(path, "%s/%s", _nxfontlist[f], found->file);
+				DPRINTF("findfont_nowild: non-XLFD prefix match %s %s = '%s'\n",
+					fontspec, found->file, path);
+				return strdup(path);
 			}
 		}
-
-		if (fontdir)
-			fclose(fontdir);
 	}
 
 #if HAVE_STATICFONTS
@@ -679,54 +1007,12 @@ findfont_nowildcard(const char *fontspec, int *height)
 			for (i=0; staticFontList[i].file; i++) {
 				char *xlfd = staticFontList[i].xlfd;
 
-				/* if XLFD matches fontspec, return full font pathname*/
-				if (strcmp(fontspec, xlfd) == 0) {
-
-					*height = xlfdheight(xlfd);
-					DPRINTF("findfont_nowild: exact XLFD match %s %s = %s (%d)\n",
+				/* if XLFD matches fontspec or scaleable XLFD, return full font pathname*/
+				if (strcmp(fontspec, xlfd) == 0 || scalematch(xlfd, fontspec)) {
+					*height = xlfdheight(fontspec);
+					DPRINTF("findfont_nowild: XLFD match %s %s = %s (%d)\n",
 						xlfd, fontspec, staticFontList[i].file, *height);
 					return strdup(staticFontList[i].file);
-				} else {
-					int j;
-					int dashcount = 0;
-					int len;
-
-					/* no exact match, check for match with -0- height*/
-					if (xlfdheight(xlfd) != 0)
-						continue;		/* not scaleable, try next fonts.dir line*/
-
-					/* otherwise check for scaleable font match spec
-				 	 * with passed pixel size, that is:
-				 	 *     match XLFD  "...normal--0-0-0-0-0-..."
-				 	 * with passed     "...normal--12-0-0-0-0-..."
-				 	 * for height 12.
-				 	 */
-					len = MWMIN(strlen(xlfd), strlen(fontspec));
-
-					/* match before and after height at '--0-' in XLFD string*/
-					for (j = 0; j < len && dashcount < 8; j++) {
-						if (xlfd[j] == '-')
-							dashcount++;
-						if (xlfd[j] != fontspec[j]) {
-							if (dashcount == 7 && xlfd[j] == '0') {
-								int st = j;
-
-								/* pass over passed height*/
-								while (fontspec[j] >= '0' && fontspec[j] <= '9')
-									j++;
-
-								/* and check that rest of XLFD line matches*/
-								if (strcmp(&fontspec[j], &xlfd[st+1]) == 0) {
-
-									/* match - return full font pathname and height*/
-									*height = xlfdheight(fontspec);
-									DPRINTF("findfont_nowild: exact XLFD match %s %s = %s (%d)\n", xlfd, fontspec, staticFontList[i].file, *height);
-									return strdup(staticFontList[i].file);
-								}
-							}
-							break;
-						}
-					}
 				}
 			}
 		}
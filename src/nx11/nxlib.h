@@ -91,6 +91,9 @@ int	   font_findstaticfont(char *fontname, unsigned char** data, int* size);
 /* ChProperty.c */
 int _nxDelAllProperty(Window w);
 
+/* NextEvent.c*/
+int _nxQueueEvent(Display *display, XEvent *event, int front);
+
 /* SelInput.c*/
 GR_EVENT_MASK _nxTranslateEventMask(unsigned long mask);
 
@@ -104,6 +107,36 @@ void _XFreeDisplayStructure(Display *dpy);
 extern Font _nxCursorFont;
 
 /* CrGC.c*/
+/* Nano-X GC state set lazily before drawing*/
+typedef struct {
+	int		mode;		/* GR_MODE_ draw mode and clip mode*/
+	GR_COLOR	foreground;
+	GR_COLOR	background;
+	GR_BOOL		usebackground;
+	int		fillmode;	/* GR_FILL_*/
+	GR_FONT_ID	font;
+	GR_BOOL		exposure;
+	int		linestyle;	/* GR_LINE_*/
+} nxGCState;
+
+/* gc->ext_data, starts with XGCValues for (XGCValues *)gc->ext_data*/
+typedef struct {
+	XGCValues	values;		/* X11 GC values*/
+	nxGCState	want;		/* state required by next drawing request*/
+	nxGCState	sent;		/* shadow of server GC state*/
+	unsigned long	dirty;		/* GC components changed since last flush*/
+} nxGC;
+
+#define _nxGC(gc)	((nxGC *)(gc)->ext_data)
+
+/* gc->dirty bit for usebackground, not an X11 GC component*/
+#define GCnxUseBackground	(1L<<(GCLastBit+1))
+
 int _nxConvertROP(int Xrop);
+void _nxSetGCUseBackground(GC gc, GR_BOOL flag);
+void _nxFlushGC(GC gc);
+
+/* Image.c*/
+int _XSetImage(XImage *srcimg, XImage *dstimg, int x, int y);
 
 #endif /* _NXLIB_H_*/